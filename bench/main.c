@@ -0,0 +1,505 @@
+#include "../src/state.h"
+#include "../src/game.h"
+#include "../src/renderer.h"
+#include "../server/server.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+// headless map_update benchmark. loads a map, fills it with entities
+// and projectiles and times each phase of map_update for a fixed
+// number of ticks. results go to stdout as csv or json.
+//
+//   bin/bench/st-bench [--map outpost1] [--entity outpost1_knight]
+//                      [--entities 200] [--projectiles 2000] [--particles 0]
+//                      [--ticks 2000] [--warmup 200] [--seed 1]
+//                      [--tps 144] [--workers -1] [--format csv|json] [--no-header]
+//                      [--strategy adaptive|naive|spatial_hash|uniform_grid|quadtree]
+//                      [--snapshot] [--interest 0] [--verbose]
+//   bin/bench/st-bench --mapgen 50 [--map outpost1] [--seed 1] [--workers -1]
+//
+// entities, projectiles and particles that die are respawned between
+// ticks, outside the timed region, so every tick runs at the same load.
+// --workers sets the size of the job system pool, -1 picks one per core
+// and 0 runs every job inline on the bench thread. state_hash covers the
+// entities and projectiles left at the end. runs of the same strategy
+// must print the same hash for every worker count. strategies resolve
+// overlapping pairs in different orders (spatial_hash follows its
+// bucket lists), so hashes are not comparable between strategies.
+//
+// --snapshot also captures a replication snapshot after every tick
+// and reports the bytes a client that acknowledged the previous tick
+// is sent (delta) against the bytes of the whole frame (full).
+// --interest r only sends the objects within r of the spawn point,
+// nearest first, 0 sends everything.
+//
+// --mapgen n generates the map n times instead, seeding each run with
+// seed, seed + 1, ... and times map_create. layout_hash covers the
+// rooms placed by every run, so it only changes with the generated maps.
+
+typedef enum {
+    PHASE_UPDATE_OBJECTS,
+    PHASE_COLLIDE_TILEMAP,
+    PHASE_COLLIDE_OBJECTS,
+    PHASE_TOTAL,
+    NUM_PHASES
+} PhaseEnum;
+
+static const char* phase_names[NUM_PHASES] = {
+    "update_objects",
+    "collide_tilemap",
+    "collide_objects",
+    "total"
+};
+
+typedef struct {
+    const char* map;
+    const char* entity;
+    i32 num_entities;
+    i32 num_projectiles;
+    i32 num_particles;
+    i32 ticks;
+    i32 warmup;
+    i32 seed;
+    i32 tps;
+    i32 workers;
+    i32 mapgen;
+    const char* strategy;
+    bool snapshot;
+    i32 interest;
+    bool json;
+    bool header;
+    bool verbose;
+} BenchArgs;
+
+typedef struct {
+    f64 mean, p50, p99, max;
+} PhaseStats;
+
+static BenchArgs args = {
+    .map = "outpost1",
+    .entity = "outpost1_knight",
+    .num_entities = 200,
+    .num_projectiles = 2000,
+    .num_particles = 0,
+    .ticks = 2000,
+    .warmup = 200,
+    .seed = 1,
+    .tps = GAME_DEFAULT_TPS,
+    .workers = JOB_WORKERS_AUTO,
+    .mapgen = 0,
+    .strategy = "adaptive",
+    .snapshot = false,
+    .interest = 0,
+    .json = false,
+    .header = true,
+    .verbose = false
+};
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [--map name] [--entity name] [--entities n] [--projectiles n] [--particles n] "
+                    "[--ticks n] [--warmup n] [--seed n] [--tps n] [--workers n] [--mapgen n] [--format csv|json] "
+                    "[--strategy adaptive|naive|spatial_hash|uniform_grid|quadtree] [--snapshot] [--interest r] [--no-header] [--verbose]\n", name);
+    exit(1);
+}
+
+static void parse_args(i32 argc, char** argv)
+{
+    for (i32 i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* val = (i + 1 < argc) ? argv[i+1] : NULL;
+        if (strcmp(arg, "--no-header") == 0)
+            args.header = false;
+        else if (strcmp(arg, "--verbose") == 0)
+            args.verbose = true;
+        else if (strcmp(arg, "--snapshot") == 0)
+            args.snapshot = true;
+        else if (val == NULL)
+            usage(argv[0]);
+        else {
+            if (strcmp(arg, "--map") == 0)
+                args.map = val;
+            else if (strcmp(arg, "--entity") == 0)
+                args.entity = val;
+            else if (strcmp(arg, "--entities") == 0)
+                args.num_entities = atoi(val);
+            else if (strcmp(arg, "--projectiles") == 0)
+                args.num_projectiles = atoi(val);
+            else if (strcmp(arg, "--particles") == 0)
+                args.num_particles = atoi(val);
+            else if (strcmp(arg, "--ticks") == 0)
+                args.ticks = atoi(val);
+            else if (strcmp(arg, "--warmup") == 0)
+                args.warmup = atoi(val);
+            else if (strcmp(arg, "--seed") == 0)
+                args.seed = atoi(val);
+            else if (strcmp(arg, "--tps") == 0)
+                args.tps = atoi(val);
+            else if (strcmp(arg, "--workers") == 0)
+                args.workers = atoi(val);
+            else if (strcmp(arg, "--interest") == 0)
+                args.interest = atoi(val);
+            else if (strcmp(arg, "--mapgen") == 0)
+                args.mapgen = atoi(val);
+            else if (strcmp(arg, "--strategy") == 0)
+                args.strategy = val;
+            else if (strcmp(arg, "--format") == 0)
+                args.json = strcmp(val, "json") == 0;
+            else
+                usage(argv[0]);
+            i++;
+        }
+    }
+    if (args.ticks <= 0 || args.tps <= 0 || args.mapgen < 0)
+        usage(argv[0]);
+    if (strcmp(args.strategy, "adaptive") != 0
+     && strcmp(args.strategy, "naive") != 0
+     && strcmp(args.strategy, "spatial_hash") != 0
+     && strcmp(args.strategy, "uniform_grid") != 0
+     && strcmp(args.strategy, "quadtree") != 0)
+        usage(argv[0]);
+}
+
+static vec2 random_floor_position(Map* map)
+{
+    i32 x, z;
+    for (i32 i = 0; i < 10000; i++) {
+        x = randi_range(0, map->width - 1);
+        z = randi_range(0, map->length - 1);
+        if (map_get_tile(map, x, z) != NULL && !map_is_wall(map, x, z))
+            return vec2_create(x + 0.5f, z + 0.5f);
+    }
+    return map->spawn_point;
+}
+
+static void spawn_entities(Map* map, i32 id)
+{
+    while (map->entities->length < args.num_entities + game_context.clients->length)
+        map_create_entity(random_floor_position(map), id);
+}
+
+static void spawn_projectiles(Map* map, i32 tex)
+{
+    Projectile* proj;
+    while (map->projectiles->length < args.num_projectiles) {
+        proj = map_create_projectile(PROJECTILE_CREATE(
+            .position = random_floor_position(map),
+            .direction = vec2_direction(randf_range(0, 2 * PI)),
+            .speed = randf_range(2, 10),
+            .size = randf_range(0.25, 0.75),
+            .tex = tex
+        ));
+        if (proj == NULL)
+            break;
+        projectile_set_flag(proj, PROJECTILE_FLAG_FRIENDLY, randi_range(0, 1));
+    }
+}
+
+static void spawn_particles(Map* map)
+{
+    vec2 position;
+    while (map->particles.length < args.num_particles) {
+        position = random_floor_position(map);
+        if (!map_create_particle(PARTICLE_CREATE(
+            .position = vec3_create(position.x, 0.5, position.z),
+            .velocity = vec3_create(randf_range(-2, 2), randf_range(2, 6), randf_range(-2, 2)),
+            .acceleration = vec3_create(0, GRAVITY, 0),
+            .color = vec3_create(randf(), randf(), randf()),
+            .lifetime = randf_range(0.25, 2)
+        )))
+            break;
+    }
+}
+
+// fnv-1a over the bytes of the simulated fields
+static u64 hash_bytes(u64 hash, const void* ptr, size_t size)
+{
+    const unsigned char* bytes = ptr;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    return hash;
+}
+
+static u64 hash_state(Map* map)
+{
+    u64 hash = 0xcbf29ce484222325ull;
+    for (i32 i = 0; i < map->entities->length; i++) {
+        Entity* entity = list_get(map->entities, i);
+        hash = hash_bytes(hash, &entity->position, sizeof(entity->position));
+        hash = hash_bytes(hash, &entity->health, sizeof(entity->health));
+    }
+    for (i32 i = 0; i < map->projectiles->length; i++) {
+        Projectile* projectile = list_get(map->projectiles, i);
+        vec2 position = projectile_position(projectile);
+        f32 lifetime = projectile_lifetime(projectile);
+        hash = hash_bytes(hash, &position, sizeof(position));
+        hash = hash_bytes(hash, &lifetime, sizeof(lifetime));
+    }
+    return hash;
+}
+
+static u64 hash_layout(u64 hash, MapNode* node, i32* num_rooms)
+{
+    if (node->room != NULL) {
+        hash = hash_bytes(hash, &node->origin_x, sizeof(node->origin_x));
+        hash = hash_bytes(hash, &node->origin_z, sizeof(node->origin_z));
+        hash = hash_bytes(hash, &node->orientation, sizeof(node->orientation));
+        hash = hash_bytes(hash, node->room->type, strlen(node->room->type));
+        (*num_rooms)++;
+    }
+    for (i32 i = 0; i < node->num_children; i++)
+        hash = hash_layout(hash, node->children[i], num_rooms);
+    return hash;
+}
+
+static i32 cmp_f64(const void* ptr1, const void* ptr2)
+{
+    f64 a = *(const f64*)ptr1;
+    f64 b = *(const f64*)ptr2;
+    return (a > b) - (a < b);
+}
+
+static PhaseStats compute_stats(f64* samples, i32 n)
+{
+    PhaseStats stats;
+    f64 sum = 0;
+    qsort(samples, n, sizeof(f64), cmp_f64);
+    for (i32 i = 0; i < n; i++)
+        sum += samples[i];
+    stats.mean = sum / n;
+    stats.p50 = samples[n / 2];
+    stats.p99 = samples[(i32)(0.99 * (n - 1))];
+    stats.max = samples[n - 1];
+    return stats;
+}
+
+static void setup(void)
+{
+    log_init();
+    if (!args.verbose)
+        log_set_level(WARNING);
+    state_context.config = config_create();
+    job_init(args.workers);
+    server_texture_init();
+
+    game_reset_uids();
+    game_context.clients = list_create();
+    game_context.updated_uids = list_i32_create();
+    game_context.singleplayer = true;
+    game_context.this_client = client_create();
+    client_set_username(game_context.this_client, string_copy("bench"));
+
+    map_init();
+    item_init();
+    entity_init();
+    particle_init();
+    parjicle_init();
+    synergy_init();
+    snapshot_init();
+}
+
+static void cleanup(void)
+{
+    map_cleanup();
+    item_cleanup();
+    synergy_cleanup();
+    entity_cleanup();
+    particle_cleanup();
+    parjicle_cleanup();
+    snapshot_cleanup();
+    client_destroy(game_context.this_client);
+    list_destroy(game_context.clients);
+    list_i32_destroy(game_context.updated_uids);
+    server_texture_cleanup();
+    job_cleanup();
+    config_destroy(state_context.config);
+    log_cleanup();
+}
+
+// snapshot_write counts the bytes, nothing is sent
+static void discard_packet(Packet* packet, void* arg)
+{
+}
+
+static void print_results(PhaseStats* stats, f64 allocs, f64 frees, f64 delta_bytes, f64 full_bytes, Map* map)
+{
+    if (args.json) {
+        printf("{\"map\": \"%s\", \"entity\": \"%s\", \"strategy\": \"%s\", \"seed\": %d, \"tps\": %d, \"ticks\": %d, "
+               "\"workers\": %d, \"entities\": %d, \"projectiles\": %d, \"particles\": %d",
+               args.map, args.entity, args.strategy, args.seed, args.tps, args.ticks, job_num_workers(),
+               map->entities->length, map->projectiles->length, map->particles.length);
+        for (i32 i = 0; i < NUM_PHASES; i++)
+            printf(", \"%s\": {\"mean_ns\": %.0f, \"p50_ns\": %.0f, \"p99_ns\": %.0f, \"max_ns\": %.0f}",
+                   phase_names[i], stats[i].mean, stats[i].p50, stats[i].p99, stats[i].max);
+        printf(", \"allocs_per_tick\": %.2f, \"frees_per_tick\": %.2f", allocs, frees);
+        if (args.snapshot)
+            printf(", \"delta_bytes_per_tick\": %.0f, \"full_bytes_per_tick\": %.0f", delta_bytes, full_bytes);
+        printf(", \"state_hash\": \"%016llx\"}\n", (unsigned long long)hash_state(map));
+        return;
+    }
+    if (args.header) {
+        printf("map,entity,strategy,seed,tps,ticks,workers,entities,projectiles,particles");
+        for (i32 i = 0; i < NUM_PHASES; i++)
+            printf(",%s_mean_ns,%s_p50_ns,%s_p99_ns,%s_max_ns",
+                   phase_names[i], phase_names[i], phase_names[i], phase_names[i]);
+        printf(",allocs_per_tick,frees_per_tick%s,state_hash\n",
+               args.snapshot ? ",delta_bytes_per_tick,full_bytes_per_tick" : "");
+    }
+    printf("%s,%s,%s,%d,%d,%d,%d,%d,%d,%d",
+           args.map, args.entity, args.strategy, args.seed, args.tps, args.ticks, job_num_workers(),
+           map->entities->length, map->projectiles->length, map->particles.length);
+    for (i32 i = 0; i < NUM_PHASES; i++)
+        printf(",%.0f,%.0f,%.0f,%.0f", stats[i].mean, stats[i].p50, stats[i].p99, stats[i].max);
+    printf(",%.2f,%.2f", allocs, frees);
+    if (args.snapshot)
+        printf(",%.0f,%.0f", delta_bytes, full_bytes);
+    printf(",%016llx\n", (unsigned long long)hash_state(map));
+}
+
+static void run_mapgen(i32 map_id)
+{
+    PhaseStats stats;
+    f64* samples;
+    f64 t0, t1;
+    u64 hash = 0xcbf29ce484222325ull;
+    i32 num_rooms = 0;
+    Map* map;
+
+    samples = st_malloc(args.mapgen * sizeof(f64));
+    for (i32 i = 0; i < args.mapgen; i++) {
+        if (game_context.current_map != NULL) {
+            map_destroy(game_context.current_map);
+            game_context.current_map = NULL;
+        }
+        rng_init(args.seed + i);
+        t0 = pacer_now();
+        map = map_create(map_id);
+        t1 = pacer_now();
+        samples[i] = (t1 - t0) * 1e9;
+        hash = hash_layout(hash, map->root, &num_rooms);
+    }
+    stats = compute_stats(samples, args.mapgen);
+    st_free(samples);
+
+    if (args.json) {
+        printf("{\"map\": \"%s\", \"seed\": %d, \"maps\": %d, \"workers\": %d, \"rooms_per_map\": %.2f, "
+               "\"map_create\": {\"mean_ns\": %.0f, \"p50_ns\": %.0f, \"p99_ns\": %.0f, \"max_ns\": %.0f}, "
+               "\"layout_hash\": \"%016llx\"}\n",
+               args.map, args.seed, args.mapgen, job_num_workers(), (f64)num_rooms / args.mapgen,
+               stats.mean, stats.p50, stats.p99, stats.max, (unsigned long long)hash);
+        return;
+    }
+    if (args.header)
+        printf("map,seed,maps,workers,rooms_per_map,map_create_mean_ns,map_create_p50_ns,map_create_p99_ns,map_create_max_ns,layout_hash\n");
+    printf("%s,%d,%d,%d,%.2f,%.0f,%.0f,%.0f,%.0f,%016llx\n",
+           args.map, args.seed, args.mapgen, job_num_workers(), (f64)num_rooms / args.mapgen,
+           stats.mean, stats.p50, stats.p99, stats.max, (unsigned long long)hash);
+}
+
+int main(int argc, char** argv)
+{
+    PhaseStats stats[NUM_PHASES];
+    f64* samples[NUM_PHASES];
+    f64 t[NUM_PHASES];
+    u64 allocs, frees, a0, f0;
+    u64 delta_bytes, full_bytes;
+    SnapshotView delta_view, full_view;
+    SnapshotInterest interest;
+    u32 frame;
+    i32 bytes;
+    f32 dt;
+    i32 map_id, entity_id, tex, tick;
+    Map* map;
+
+    parse_args(argc, argv);
+    setup();
+    rng_init(args.seed);
+
+    map_id = map_get_id(args.map);
+    if (args.mapgen > 0) {
+        if (map_id == -1) {
+            fprintf(stderr, "unknown map %s\n", args.map);
+            cleanup();
+            return 1;
+        }
+        run_mapgen(map_id);
+        cleanup();
+        return 0;
+    }
+    entity_id = entity_get_id(args.entity);
+    if (map_id == -1 || entity_id == -1) {
+        fprintf(stderr, "unknown map %s or entity %s\n", args.map, args.entity);
+        cleanup();
+        return 1;
+    }
+
+    map = map_create(map_id);
+    if (strcmp(args.strategy, "adaptive") != 0)
+        map->adaptive_collision = false;
+    if (strcmp(args.strategy, "naive") == 0)
+        map_use_naive(map);
+    else if (strcmp(args.strategy, "spatial_hash") == 0)
+        map_use_spatial_hash(map, sqrt(MAP_MAX_WIDTH));
+    else if (strcmp(args.strategy, "uniform_grid") == 0)
+        map_use_uniform_grid(map, MAP_GRID_CELL_WIDTH);
+    else if (strcmp(args.strategy, "quadtree") == 0)
+        map_use_quadtree(map, MAP_QUADTREE_SPLIT_THRESHOLD);
+    tex = texture_get_id("placeholder");
+    dt = 1.0f / args.tps;
+
+    for (i32 i = 0; i < NUM_PHASES; i++)
+        samples[i] = st_malloc(args.ticks * sizeof(f64));
+
+    allocs = frees = 0;
+    delta_bytes = full_bytes = 0;
+    memset(&delta_view, 0, sizeof(delta_view));
+    memset(&full_view, 0, sizeof(full_view));
+    interest.center = map->spawn_point;
+    interest.radius = args.interest;
+    interest.max_objects = 0;
+    for (tick = -args.warmup; tick < args.ticks; tick++) {
+        spawn_entities(map, entity_id);
+        spawn_projectiles(map, tex);
+        spawn_particles(map);
+
+        a0 = st_alloc_count();
+        f0 = st_free_count();
+        t[0] = pacer_now();
+        map_update_objects(map, dt);
+        t[1] = pacer_now();
+        map_collide_tilemap(map);
+        t[2] = pacer_now();
+        map_collide_objects(map);
+        t[3] = pacer_now();
+
+        game_context.time += dt;
+        if (args.snapshot) {
+            // the delta client acknowledges every frame right away,
+            // the full one never does
+            frame = snapshot_capture(map);
+            bytes = snapshot_write(&delta_view, &interest, discard_packet, NULL);
+            atomic_store(&delta_view.ack, frame);
+            delta_bytes += (tick >= 0) ? bytes : 0;
+            bytes = snapshot_write(&full_view, &interest, discard_packet, NULL);
+            full_bytes += (tick >= 0) ? bytes : 0;
+        }
+        if (tick < 0)
+            continue;
+        allocs += st_alloc_count() - a0;
+        frees += st_free_count() - f0;
+        for (i32 i = 0; i < PHASE_TOTAL; i++)
+            samples[i][tick] = (t[i+1] - t[i]) * 1e9;
+        samples[PHASE_TOTAL][tick] = (t[3] - t[0]) * 1e9;
+    }
+
+    for (i32 i = 0; i < NUM_PHASES; i++) {
+        stats[i] = compute_stats(samples[i], args.ticks);
+        st_free(samples[i]);
+    }
+    print_results(stats, (f64)allocs / args.ticks, (f64)frees / args.ticks,
+                  (f64)delta_bytes / args.ticks, (f64)full_bytes / args.ticks, map);
+
+    cleanup();
+    return 0;
+}
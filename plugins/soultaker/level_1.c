@@ -49,11 +49,11 @@ bool level_1_branch(LocalMapGenerationSettings* settings)
     LevelData* gdata = map_get_data();
     if (gdata->num_branches == 6)
         return false;
-    int roll = rand() % 10;
+    int roll = rng_range(settings->rng, 0, 9);
     if (roll >= 0) {
         settings->current_branch = "dead_end";
         settings->current_room_type = "enemy";
-        settings->num_rooms_left = 5 + rand() % 3;
+        settings->num_rooms_left = rng_range(settings->rng, 5, 7);
         settings->num_rooms_left = 100;
         settings->succeed_even_if_no_path = true;
         gdata->num_branches++;
@@ -71,10 +71,10 @@ bool outpost1_branch(LocalMapGenerationSettings* settings)
     return false;
     if (strcmp(settings->current_branch, "main") != 0)
         return false;
-    if (rand() % 10 == 0) {
+    if (rng_range(settings->rng, 0, 9) == 0) {
         settings->current_branch = "dead_end";
         settings->current_room_type = "enemy";
-        settings->num_rooms_left = 5 + rand() % 3;
+        settings->num_rooms_left = rng_range(settings->rng, 5, 7);
         return true;
     }
     return false;
@@ -128,7 +128,7 @@ void outpost1_knight_create(Entity* entity)
     data->spawn_point = entity->position;
     data->wander_cooldown = 0;
     data->shot_cooldown = 0;
-    data->rotate_direction = (2*(rand()%2))-1;
+    data->rotate_direction = 2 * randi_range(0, 1) - 1;
     entity->health = entity->max_health = 10;
     entity->size = 1.5f;
     entity->hitbox_radius = 0.7;
@@ -219,13 +219,14 @@ void outpost1_knight_attack_update(Entity* entity, f32 dt)
         log_write(DEBUG, "%f %f %f %f %i", entity->direction.x, entity->direction.z, entity->position.x, entity->position.z, data->rotate_direction);
     }
     if (data->shot_cooldown < 0) {
+        direction = vec2_rotate(direction, randf_range(-0.3, 0.3));
         proj = map_create_projectile(PROJECTILE_CREATE(
                     .position = entity->position,
-                    .direction = vec2_rotate(direction, randf_range(-0.3, 0.3)),
+                    .direction = direction,
                     .speed = 6.5,
                     .size = 0.5,
                     .tex = texture_get_id("bullet"),
-                    .facing = vec2_radians(proj->direction)
+                    .facing = vec2_radians(direction)
                     ));
         data->shot_cooldown += 1.0f;
     }
@@ -275,7 +276,7 @@ static void reposition_archer(Entity* entity)
     vec2 player_position = game_get_nearest_player_position();
     vec2 direction = vec2_sub(entity->position, player_position);
     f32 cur_rad = vec2_radians(direction);
-    cur_rad += (2*(rand()%2)-1) * randf_range(0.1, 0.2);
+    cur_rad += (2 * randi_range(0, 1) - 1) * randf_range(0.1, 0.2);
     vec2 offset = vec2_scale(vec2_direction(cur_rad), 6.5f);
     vec2 target = vec2_add(player_position, offset);
     direction = vec2_sub(target, entity->position);
@@ -328,13 +329,14 @@ void outpost1_archer_attack_update(Entity* entity, f32 dt)
     data->attack_timer -= dt;
     if (data->attack_timer < 0) {
         player_position = game_get_nearest_player_position();
+        direction = vec2_normalize(vec2_sub(player_position, entity->position));
         proj = map_create_projectile(PROJECTILE_CREATE(
                     .position = entity->position,
-                    .direction = vec2_normalize(vec2_sub(player_position, entity->position)),
+                    .direction = direction,
                     .speed = 10.0f,
                     .size = 0.5f,
                     .tex = texture_get_id("bullet"),
-                    .facing = vec2_radians(proj->direction),
+                    .facing = vec2_radians(direction),
                     ));
         data->attack_timer += 0.5f;
     }
@@ -399,7 +401,7 @@ static void reposition_mage(Entity* entity)
     vec2 player_position = game_get_nearest_player_position();
     vec2 direction = vec2_sub(entity->position, player_position);
     f32 cur_rad = vec2_radians(direction);
-    cur_rad += (2*(rand()%2)-1) * randf_range(0.1, 0.2);
+    cur_rad += (2 * randi_range(0, 1) - 1) * randf_range(0.1, 0.2);
     vec2 offset = vec2_scale(vec2_direction(cur_rad), 6.5f);
     vec2 target = vec2_add(player_position, offset);
     direction = vec2_sub(target, entity->position);
@@ -447,10 +449,10 @@ void outpost1_mage_wander_update(Entity* entity, f32 dt)
 static void mage_projectile_update(Projectile* proj, f32 dt)
 {
     vec2 player_position = game_get_nearest_player_position();
-    vec2 acceleration = vec2_normalize(vec2_sub(player_position, proj->position));
-    vec2 direction = vec2_add(proj->direction, vec2_scale(acceleration, 3 * dt));
-    proj->direction = vec2_normalize(direction);
-    proj->facing = vec2_radians(proj->direction);
+    vec2 acceleration = vec2_normalize(vec2_sub(player_position, projectile_position(proj)));
+    vec2 direction = vec2_add(projectile_direction(proj), vec2_scale(acceleration, 3 * dt));
+    projectile_set_direction(proj, vec2_normalize(direction));
+    proj->facing = vec2_radians(projectile_direction(proj));
 }
 
 void outpost1_mage_attack_update(Entity* entity, f32 dt)
@@ -461,13 +463,14 @@ void outpost1_mage_attack_update(Entity* entity, f32 dt)
     data->attack_timer -= dt;
     if (data->attack_timer < 0) {
         player_position = game_get_nearest_player_position();
+        direction = vec2_normalize(vec2_sub(player_position, entity->position));
         proj = map_create_projectile(PROJECTILE_CREATE(
                     .position = entity->position,
-                    .direction = vec2_normalize(vec2_sub(player_position, entity->position)),
+                    .direction = direction,
                     .speed = 10.0f,
                     .size = 0.5f,
                     .tex = texture_get_id("bullet"),
-                    .facing = vec2_radians(proj->direction),
+                    .facing = vec2_radians(direction),
                     .update = mage_projectile_update,
                     ));
         data->attack_timer += 0.5f;
@@ -579,8 +582,8 @@ static void sword_update(Projectile* proj, f32 dt)
     SwordProjData* data = proj->data;
     data->delay_timer -= dt;
     if (data->delay_timer < 0) {
-        proj->speed = data->speed;
-        proj->update = NULL;
+        projectile_set_speed(proj, data->speed);
+        projectile_set_update(proj, NULL);
     }
 }
 
@@ -902,7 +905,7 @@ void outpost1_boss_phase1_update(Entity* entity, f32 dt)
         delay = 1.0;
         speed = 15.0;
         lifetime = (f32)(boss_room_width-23)/speed;
-        i32 opening = rand() % (boss_num_swords-6-1) + 3;
+        i32 opening = randi_range(3, boss_num_swords - 5);
         for (i32 i = 3; i < boss_num_swords-3; i++)
             if (i != opening && i != opening + 1)
                 spawn_sword_at_wall_with_delay(i, UP, lifetime, speed, delay);
@@ -937,11 +940,11 @@ static void sword_circle_proj_update(Projectile* proj, f32 dt)
 {
     ProjCircleData* data = proj->data;
     if (data->clockwise)
-        data->radians += proj->speed * dt;
+        data->radians += projectile_speed(proj) * dt;
     else
-        data->radians -= proj->speed * dt;
+        data->radians -= projectile_speed(proj) * dt;
     proj->facing = data->initial_facing + data->radians - data->initial_angle_offset;
-    proj->position = vec2_add(data->origin, vec2_scale(vec2_direction(data->radians), data->distance));
+    projectile_set_position(proj, vec2_add(data->origin, vec2_scale(vec2_direction(data->radians), data->distance)));
 }
 
 static f32 spawn_circle_sword(f32 start_rad, f32 arc_length, vec2 origin, f32 dist_from_origin, f32 speed_per_rad, bool clockwise)
@@ -1063,7 +1066,7 @@ void outpost1_boss_phase2_update(Entity* entity, f32 dt)
     if (data->shot_timer > 0)
         return;
     data->shot_timer += 1.0 - 0.21 * data->attack;
-    i32 sword_idx = rand() % (boss_num_swords - 6) + 3;
+    i32 sword_idx = randi_range(3, boss_num_swords - 4);
     f32 speed = 15.0;
     f32 delay = 1.0;
     f32 lifetime = (f32)(boss_room_width-23)/speed;
@@ -1145,8 +1148,8 @@ void outpost1_boss_phase3_update(Entity* entity, f32 dt)
         f32 delay = 1.0;
         f32 speed = 15.0;
         f32 lifetime = 10.0;
-        i32 wall_idx = rand() % 4;
-        i32 sword_idx = rand() % boss_num_swords;
+        i32 wall_idx = randi_range(0, 3);
+        i32 sword_idx = randi_range(0, boss_num_swords - 1);
         spawn_sword_at_wall_with_delay_toward_player(sword_idx, wall_idx, lifetime, speed, delay);
     }
 }
@@ -1213,9 +1216,9 @@ void outpost1_boss_phase4_update(Entity* entity, f32 dt)
         f32 delay = 1.0;
         f32 speed = 15.0;
         f32 lifetime = 10.0;
-        i32 sword_idx = rand() % boss_num_swords;
+        i32 sword_idx = randi_range(0, boss_num_swords - 1);
         spawn_sword_at_wall_with_delay_toward_player(sword_idx, data->wall_idx, lifetime, speed, delay);
-        sword_idx = rand() % (boss_num_swords - 14) + 7;
+        sword_idx = randi_range(7, boss_num_swords - 8);
         speed = 15.0;
         delay = 1.0;
         lifetime = (f32)(boss_room_width-23)/speed;
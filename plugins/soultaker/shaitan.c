@@ -234,7 +234,7 @@ static void shaitan_attack_1_firestorm(Entity* entity)
     Projectile* proj;
     i32 tex_id = texture_get_id("shaitan_firestorm");
     vec2 direction;
-    i32 dir = rand() % 2;
+    i32 dir = randi_range(0, 1);
     for (i32 i = 0; i < 5; i++) {
         proj = map_create_projectile(PROJECTILE_CREATE(
                     .position = entity->position,
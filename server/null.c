@@ -0,0 +1,84 @@
+#include "server.h"
+#include "../src/game.h"
+#include "../src/gui.h"
+#include "../src/window.h"
+
+// null backends for everything the game and plugins call outside of
+// src/game and src/util. none of them have anything to draw on the
+// server, they only keep the calls cheap and the values sane
+
+// cameras are still created for every client, give them a nominal
+// viewport so zoom and aspect ratio dont divide by zero
+WindowContext window_context = {
+    .width = 1920,
+    .height = 1080,
+};
+
+bool window_get_key(i32 key)
+{
+    return false;
+}
+
+bool window_get_mouse_button(i32 button)
+{
+    return false;
+}
+
+i32 window_height(void)
+{
+    return window_context.height;
+}
+
+void game_render_framebuffer_size_callback(void)
+{
+}
+
+void game_render_update_obstacles(void)
+{
+}
+
+void game_render_update_parstacles(void)
+{
+}
+
+void game_render_update_tiles(void)
+{
+}
+
+void game_render_update_walls(void)
+{
+}
+
+void gui_preset_load(GUIPreset preset)
+{
+}
+
+bool gui_cursor_pos_callback(f64 xpos, f64 ypos)
+{
+    return false;
+}
+
+void gui_create_boss_healthbar(char* name, Entity* boss_ptr)
+{
+}
+
+void gui_update_boss_healthbar(Entity* boss)
+{
+}
+
+void gui_destroy_boss_healthbar(Entity* boss)
+{
+}
+
+void gui_create_notification(char* notif)
+{
+    log_write(DEBUG, "%s", notif);
+}
+
+void gui_set_interactable(const char* desc, InteractableFuncPtr func_ptr, Map* map, MapNode* map_node)
+{
+}
+
+void gui_refresh_inventory(void)
+{
+}
@@ -0,0 +1,22 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "../src/util.h"
+
+// headless dedicated server. built with `make server`, which links
+// src/game, src/util and the plugins against the null backends in
+// this directory instead of the window, renderer, gui and audio
+
+#define SERVER_DEFAULT_IP   "0.0.0.0"
+#define SERVER_DEFAULT_PORT "6969"
+#define SERVER_DEFAULT_MAP  "outpost1"
+// how often the main thread checks for new clients, in ms
+#define SERVER_POLL_MSEC    100
+
+// the renderer is what assigns texture ids on the client. the server
+// still has to hand out the same ids for projectiles, entities and
+// tiles it sends, so it builds the sorted name table from the config
+void server_texture_init(void);
+void server_texture_cleanup(void);
+
+#endif
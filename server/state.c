@@ -0,0 +1,109 @@
+#include "server.h"
+#include "../src/state.h"
+#include "../src/game.h"
+#include <signal.h>
+#include <time.h>
+
+StateContext state_context;
+
+static volatile sig_atomic_t server_running;
+
+static void handle_signal(int sig)
+{
+    server_running = 0;
+}
+
+void state_init(void)
+{
+    pthread_mutex_init(&state_context.mutex, 0);
+
+    log_init();
+    state_context.config = config_create();
+
+    thread_link("Main");
+    job_init(config_get_setting_int(state_context.config, "job_workers", JOB_WORKERS_AUTO));
+    rng_init(config_get_setting_int(state_context.config, "seed", time(NULL)));
+
+    server_texture_init();
+    game_init();
+
+    pthread_mutex_lock(&game_context.handler_thread_mutex);
+    game_net_start_hosting(
+        config_get_setting_string(state_context.config, "server_ip", SERVER_DEFAULT_IP),
+        config_get_setting_string(state_context.config, "server_port", SERVER_DEFAULT_PORT));
+    pthread_mutex_unlock(&game_context.handler_thread_mutex);
+
+    server_running = 1;
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+}
+
+// the game thread does all of the simulating and sending. the map is
+// loaded once at startup and keeps running, the main thread only hands
+// clients that finished joining a player entity and the map state
+void state_loop(void)
+{
+    const char* map_name = config_get_setting_string(state_context.config, "server_map", SERVER_DEFAULT_MAP);
+    i32 map_id = map_get_id(map_name);
+    i32 num_synced = 0;
+    Client* client;
+    f64 start, end;
+
+    if (map_id == -1) {
+        log_write(CRITICAL, "Server map %s does not exist", map_name);
+        return;
+    }
+
+    pthread_mutex_lock(&game_context.handler_thread_mutex);
+    game_change_map(map_id);
+    pthread_mutex_unlock(&game_context.handler_thread_mutex);
+
+    log_write(INFO, "Server running %s at %d tps", map_name, game_context.tps);
+    start = get_time();
+    while (server_running) {
+        st_sleep(SERVER_POLL_MSEC);
+        pthread_mutex_lock(&game_context.handler_thread_mutex);
+        // clients are appended when they connect and get a username
+        // at the end of the handshake, in the same order
+        while (num_synced < game_context.clients->length) {
+            client = list_get(game_context.clients, num_synced);
+            if (client->username == NULL)
+                break;
+            map_sync_client(game_context.current_map, client);
+            num_synced++;
+            log_write(INFO, "%s joined, %d client(s) connected", client->username, num_synced);
+        }
+        pthread_mutex_unlock(&game_context.handler_thread_mutex);
+        end = get_time();
+        state_context.dt = end - start;
+        start = end;
+    }
+}
+
+f32 state_dt(void)
+{
+    return state_context.dt;
+}
+
+void state_cleanup(void)
+{
+    log_unlock();
+    game_cleanup();
+    job_cleanup();
+    server_texture_cleanup();
+
+    config_destroy(state_context.config);
+
+#ifdef DEBUG_BUILD
+    print_heap_info();
+#endif
+
+    log_cleanup();
+
+    pthread_mutex_destroy(&state_context.mutex);
+}
+
+void* state_load_function(const char* name)
+{
+    return config_get_function(state_context.config, name);
+}
@@ -0,0 +1,94 @@
+#include "server.h"
+#include "../src/renderer.h"
+#include "../src/state.h"
+#include <string.h>
+
+static struct {
+    const char** names;
+    i32 num_names;
+} texture_table;
+
+static i32 name_cmp(const void* ptr1, const void* ptr2)
+{
+    return strcmp(*(const char**)ptr1, *(const char**)ptr2);
+}
+
+static void add_name(const char* name)
+{
+    texture_table.names = st_realloc(texture_table.names, (texture_table.num_names + 1) * sizeof(const char*));
+    texture_table.names[texture_table.num_names++] = name;
+}
+
+static void add_spritesheet(JsonObject* object)
+{
+    JsonValue* value = json_object_get_value(object, "textures");
+    JsonIterator* it;
+    log_assert(value != NULL && json_value_get_type(value) == JTYPE_OBJECT, "Spritesheet is missing textures");
+    object = json_value_get_object(value);
+    it = json_iterator_create(object);
+    for (i32 i = 0; i < json_object_length(object); i++) {
+        add_name(json_member_get_key(json_iterator_get(it)));
+        json_iterator_increment(it);
+    }
+    json_iterator_destroy(it);
+}
+
+// mirrors the naming rules in renderer/texture.c: one texture per
+// image, or one per entry of a spritesheet
+void server_texture_init(void)
+{
+    JsonObject* json = state_context.config->textures;
+    JsonIterator* it = json_iterator_create(json);
+    JsonMember* member;
+    JsonValue* value;
+    JsonObject* object;
+    log_assert(it != NULL, "Failed to create json iterator for textures");
+    texture_table.names = NULL;
+    texture_table.num_names = 0;
+    for (i32 i = 0; i < json_object_length(json); i++) {
+        member = json_iterator_get(it);
+        value = json_member_get_value(member);
+        if (json_value_get_type(value) == JTYPE_OBJECT) {
+            object = json_value_get_object(value);
+            value = json_object_get_value(object, "spritesheet");
+            if (value != NULL && json_value_get_type(value) == JTYPE_TRUE)
+                add_spritesheet(object);
+            else
+                add_name(json_member_get_key(member));
+        } else
+            add_name(json_member_get_key(member));
+        json_iterator_increment(it);
+    }
+    json_iterator_destroy(it);
+    qsort(texture_table.names, texture_table.num_names, sizeof(const char*), name_cmp);
+    log_write(INFO, "Loaded %d texture names", texture_table.num_names);
+}
+
+void server_texture_cleanup(void)
+{
+    st_free(texture_table.names);
+    texture_table.names = NULL;
+    texture_table.num_names = 0;
+}
+
+i32 texture_get_id(const char* name)
+{
+    i32 l, m, r, a;
+    l = 0, r = texture_table.num_names - 1;
+    while (l <= r) {
+        m = l + (r - l) / 2;
+        a = strcmp(name, texture_table.names[m]);
+        if (a > 0)
+            l = m + 1;
+        else if (a < 0)
+            r = m - 1;
+        else
+            return m;
+    }
+    if (strcmp(name, "placeholder") != 0) {
+        log_write(WARNING, "Failed to get id for %s, returning placeholder", name);
+        return texture_get_id("placeholder");
+    }
+    log_write(FATAL, "Placeholder image doesn't exist");
+    return -1;
+}
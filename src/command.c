@@ -9,6 +9,7 @@
 #include "event.h"
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
 
 typedef struct {
     i32 l, r;
@@ -152,8 +153,70 @@ static char* parse_set(List* string_views, const char* command)
         }
         string_view = list_get(string_views, 2);
         c_str = string_view_c_str(string_view, command);
-        game_context.tps = atoi(c_str);
-        game_context.timestep = 1.0 / game_context.tps;
+        i32 tps = game_set_tps(atoi(c_str));
+        st_free(c_str);
+        response = string_create("set tps to %d", tps);
+    } else if (strcmp(var_name, "frame_rate") == 0) {
+        if (string_views->length < 3) {
+            response = string_copy("set frame_rate {frame_rate}");
+            goto fail;
+        }
+        string_view = list_get(string_views, 2);
+        c_str = string_view_c_str(string_view, command);
+        i32 frame_rate = game_set_frame_rate(atoi(c_str));
+        st_free(c_str);
+        response = string_create("set frame rate to %d", frame_rate);
+    } else if (strcmp(var_name, "seed") == 0) {
+        if (string_views->length < 3) {
+            response = string_copy("set seed {seed}");
+            goto fail;
+        }
+        string_view = list_get(string_views, 2);
+        c_str = string_view_c_str(string_view, command);
+        u64 seed = strtoull(c_str, NULL, 10);
+        st_free(c_str);
+        rng_request_seed(seed);
+        response = string_create("seed %llu is used from the next map load", (unsigned long long)seed);
+    } else if (strcmp(var_name, "snapshot_rate") == 0) {
+        if (string_views->length < 3) {
+            response = string_copy("set snapshot_rate {rate}");
+            goto fail;
+        }
+        string_view = list_get(string_views, 2);
+        c_str = string_view_c_str(string_view, command);
+        i32 rate = atoi(c_str);
+        st_free(c_str);
+        if (game_context.hosting || game_context.singleplayer) {
+            if (rate <= 0)
+                rate = GAME_DEFAULT_SNAPSHOT_RATE;
+            game_context.net_timestep = 1.0 / rate;
+            response = string_create("set default snapshot rate to %d", rate);
+        } else {
+            client_request_snapshot_rate(rate);
+            response = string_create("asked the host for %d snapshots per second", rate);
+        }
+    } else if (strcmp(var_name, "collision") == 0) {
+        if (string_views->length < 3 || game_context.current_map == NULL) {
+            response = string_copy("set collision {adaptive|naive|spatial_hash|uniform_grid|quadtree}");
+            goto fail;
+        }
+        string_view = list_get(string_views, 2);
+        c_str = string_view_c_str(string_view, command);
+        game_context.current_map->adaptive_collision = false;
+        if (strcmp(c_str, "adaptive") == 0)
+            map_use_adaptive(game_context.current_map);
+        else if (strcmp(c_str, "naive") == 0)
+            map_use_naive(game_context.current_map);
+        else if (strcmp(c_str, "spatial_hash") == 0)
+            map_use_spatial_hash(game_context.current_map, sqrt(MAP_MAX_WIDTH));
+        else if (strcmp(c_str, "uniform_grid") == 0)
+            map_use_uniform_grid(game_context.current_map, MAP_GRID_CELL_WIDTH);
+        else if (strcmp(c_str, "quadtree") == 0)
+            map_use_quadtree(game_context.current_map, MAP_QUADTREE_SPLIT_THRESHOLD);
+        else
+            response = string_create("unknown collision strategy %s", c_str);
+        if (response == NULL)
+            response = string_create("set collision strategy to %s", c_str);
         st_free(c_str);
     }
 fail:
@@ -210,6 +273,18 @@ char* command_parse(char* command)
     } else if (string_view_eq(string_view, command, "defog")) {
         map_fog_clear(game_context.current_map);
         response = string_copy("defogged map");
+    } else if (string_view_eq(string_view, command, "pools")) {
+        Map* map = game_context.current_map;
+        if (map == NULL) {
+            response = string_copy("no map loaded");
+            goto destroy;
+        }
+        response = string_create("live/peak: projectiles %d/%d entities %d/%d particles %d/%d triggers %d/%d aoes %d/%d",
+            map->projectile_pool.stats.live, map->projectile_pool.stats.peak,
+            map->entity_slab.stats.live, map->entity_slab.stats.peak,
+            map->particles.length, map->particles.peak,
+            map->trigger_slab.stats.live, map->trigger_slab.stats.peak,
+            map->aoe_slab.stats.live, map->aoe_slab.stats.peak);
     } else if (string_view_eq(string_view, command, "pos")) {
         vec2 target_position = camera_get_target_position();
         response = string_create("%f %f", target_position.x, target_position.z);
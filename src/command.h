@@ -22,7 +22,13 @@ set [var_name] [arg1] [arg2] ...
 > set a variable. different types require different args
 > var_name can be one of
     camera_target: vec2
-    tps: i32
+    tps: i32 (simulation steps per second)
+    frame_rate: i32 (game loop wakeups per second, positions are interpolated between steps)
+    seed: u64 (reseeds every random stream, the seed can also be set with "seed" in config/settings.json)
+    snapshot_rate: i32 (snapshots per second, the default for every client when hosting, otherwise
+                   asked of the host for this client. 0 goes back to the default of the host)
+    collision: adaptive | naive | spatial_hash | uniform_grid | quadtree (broadphase used by map_collide_objects,
+               adaptive picks one from the live object counts and keeps retuning it)
 
 pause
 > pause the game
@@ -29,7 +29,11 @@ int dlclose(void* handle)
 #else
 #include <dlfcn.h>
 const char* shared_ext = ".so";
-#ifdef DEBUG_BUILD
+#if defined(BENCH_BUILD)
+const char* pathname = "bin/bench/plugins/soultaker.so";
+#elif defined(SERVER_BUILD)
+const char* pathname = "bin/server/plugins/soultaker.so";
+#elif defined(DEBUG_BUILD)
 const char* pathname = "bin/dev/plugins/soultaker.so";
 #else
 const char* pathname = "bin/release/plugins/soultaker.so";
@@ -334,6 +338,19 @@ static void read_parjicles(Config* config, const char* dir_path)
     closedir(cur_dir);
 }
 
+static void read_settings(Config* config, const char* path)
+{
+    JsonObject* object;
+    log_write(INFO, "Reading settings: %s", path);
+    object = json_read(path);
+    if (object == NULL) {
+        log_write(CRITICAL, "Error reading %s", path);
+        return;
+    }
+    json_object_destroy(config->settings);
+    config->settings = object;
+}
+
 static void read_config(Config* config)
 {
     const char* dir_path = "config";
@@ -374,6 +391,10 @@ static void read_config(Config* config)
             new_dir = string_create("%s/%s", dir_path, config_type->d_name);
             read_parjicles(config, new_dir);
             string_free(new_dir);
+        } else if (strcmp(config_type->d_name, "settings.json") == 0) {
+            new_dir = string_create("%s/%s", dir_path, config_type->d_name);
+            read_settings(config, new_dir);
+            string_free(new_dir);
         }
         config_type = readdir(config_dir);
     }
@@ -390,6 +411,7 @@ Config* config_create(void)
     config->maps = json_object_create();
     config->particles = json_object_create();
     config->parjicles = json_object_create();
+    config->settings = json_object_create();
     read_config(config);
     if (json_object_length(config->textures) == 0)
         log_write(FATAL, "Did not find any textures");
@@ -412,6 +434,7 @@ void config_destroy(Config* config)
     json_object_destroy(config->maps);
     json_object_destroy(config->particles);
     json_object_destroy(config->parjicles);
+    json_object_destroy(config->settings);
     dlclose(config->shared_handle);
     st_free(config);
 }
@@ -420,3 +443,27 @@ void* config_get_function(Config* config, const char* name)
 {
     return dlsym(config->shared_handle, name);
 }
+
+i32 config_get_setting_int(Config* config, const char* name, i32 fallback)
+{
+    JsonValue* value = json_object_get_value(config->settings, name);
+    if (value == NULL)
+        return fallback;
+    if (json_value_get_type(value) != JTYPE_INT) {
+        log_write(WARNING, "Setting %s is not an integer", name);
+        return fallback;
+    }
+    return json_value_get_int(value);
+}
+
+const char* config_get_setting_string(Config* config, const char* name, const char* fallback)
+{
+    JsonValue* value = json_object_get_value(config->settings, name);
+    if (value == NULL)
+        return fallback;
+    if (json_value_get_type(value) != JTYPE_STRING) {
+        log_write(WARNING, "Setting %s is not a string", name);
+        return fallback;
+    }
+    return json_value_get_string(value);
+}
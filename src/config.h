@@ -2,6 +2,7 @@
 #define CONFIG_H
 
 #include "util/json.h"
+#include "util/type.h"
 
 typedef struct Config {
     JsonObject* items;
@@ -11,6 +12,7 @@ typedef struct Config {
     JsonObject* maps;
     JsonObject* particles;
     JsonObject* parjicles;
+    JsonObject* settings;
     void* shared_handle;
 } Config;
 
@@ -18,4 +20,9 @@ Config*     config_create(void);
 void        config_destroy(Config* config);
 void*       config_get_function(Config* config, const char* name);
 
+// reads a setting from config/settings.json, returns fallback
+// if the setting is missing or has the wrong type
+i32         config_get_setting_int(Config* config, const char* name, i32 fallback);
+const char* config_get_setting_string(Config* config, const char* name, const char* fallback);
+
 #endif
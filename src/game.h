@@ -11,11 +11,56 @@
 #define GRAVITY                 -9.8
 #define PROJ_PIERCE_COOLDOWN    1
 #define MAX_UID                 65535
+#define GAME_DEFAULT_TPS        144
+#define GAME_DEFAULT_FRAME_RATE 144
+// snapshots sent to each client per second, clients can ask for
+// their own rate up to the tick rate
+#define GAME_DEFAULT_SNAPSHOT_RATE 30
+// datagrams queued per tick before a flush is forced, and
+// datagrams taken per receive on the udp handler threads
+#define GAME_NET_SEND_BATCH     256
+#define GAME_NET_RECV_BATCH     16
+// maximum simulation steps run per frame before the game
+// gives up on catching up to real time
+#define GAME_MAX_SUBSTEPS       8
 #define MAP_MAX_WIDTH   1000
 #define MAP_MAX_LENGTH  1000
+// distinct tile collide functions per map, id 0 is no function
+#define MAP_MAX_TILE_COLLIDE_FUNCS 256
+// the tilemap is stored in square chunks allocated on demand
+#define MAP_CHUNK_SHIFT 5
+#define MAP_CHUNK_WIDTH (1 << MAP_CHUNK_SHIFT)
+#define MAP_CHUNK_AREA  (MAP_CHUNK_WIDTH * MAP_CHUNK_WIDTH)
+#define MAP_CHUNKS_WIDE ((MAP_MAX_WIDTH + MAP_CHUNK_WIDTH - 1) / MAP_CHUNK_WIDTH)
+#define MAP_CHUNKS_LONG ((MAP_MAX_LENGTH + MAP_CHUNK_WIDTH - 1) / MAP_CHUNK_WIDTH)
+// chunks per PACKET_CREATE_MAP_NODES, about 128 KB with 8 byte pointers
+#define MAP_NODES_PACKET_CHUNKS 16
+// cell width for the uniform grid broadphase, a little larger
+// than most entities and projectiles
+#define MAP_GRID_CELL_WIDTH 4
+// a quadtree leaf splits once it holds more objects than this
+#define MAP_QUADTREE_SPLIT_THRESHOLD 16
+#define MAP_QUADTREE_MAX_DEPTH 8
+// fewest spatial hash buckets searched for contacts by one job
+#define MAP_CONTACT_MIN_GRAIN 4
+// four rotations, each of them mirrored
+#define ROOM_NUM_ORIENTATIONS 8
+// adaptive collision re-evaluates every window of ticks
+#define MAP_ADAPT_WINDOW  128
+#define MAP_ADAPT_CONFIRM 2
 #define PARTICLE_QUEUE_LENGTH 10000
+// objects per slab in the per map entity, particle, trigger
+// and aoe allocators
+#define MAP_SLAB_LENGTH 256
 #define PARJICLE_QUEUE_LENGTH 10000
 #define GAME_OBJECT_QUEUE_LENGTH 10000
+// replication frames kept by the host and clients
+#define SNAPSHOT_HISTORY 32
+// cell width of the grid snapshots are searched through for the
+// objects near a client, and the area kept around its view
+#define SNAPSHOT_INTEREST_CELL_WIDTH 16
+#define SNAPSHOT_INTEREST_MARGIN 8
+#define SNAPSHOT_DEFAULT_MAX_OBJECTS 1024
 
 typedef enum PacketEnum {
     PACKET_TEST,
@@ -45,6 +90,10 @@ typedef enum PacketEnum {
     PACKET_CLIENT_INPUT,
     PACKET_CLIENT_STATS,
 
+    PACKET_SNAPSHOT,
+    PACKET_SNAPSHOT_ACK,
+    PACKET_CLIENT_SNAPSHOT_RATE,
+
     NUM_PACKET_TYPES
 } PacketEnum;
 
@@ -143,11 +192,25 @@ typedef void (*UseFuncPtr)(Player*, vec2, vec2);
 // Actual declarations
 //**************************************************************************
 
+// objects spanning at most this many spatial hash buckets keep
+// their index into each bucket list, larger ones are searched for
+#define MAP_INFO_BUCKET_SLOTS 4
+
 typedef struct MapInfo {
     MapNode* spawn_node;
     MapNode* current_node;
     i32 tr_bucket_idx;
     i32 bl_bucket_idx;
+    // bucket coordinates of bl_bucket_idx and the width of bl..tr,
+    // 0 if the range is too large for bucket_slots
+    i32 bl_bucket_x;
+    i32 bl_bucket_z;
+    i32 bucket_slots_wide;
+    // index of the object in each bucket list of bl..tr, row major
+    i32 bucket_slots[MAP_INFO_BUCKET_SLOTS];
+    // quadtree node the object is in, its index in the node's
+    // list is kept in bucket_slots[0]
+    i32 node_idx;
 } MapInfo;
 
 //**************************************************************************
@@ -214,12 +277,56 @@ typedef struct Particle {
         __VA_ARGS__ \
     }
 
+// every particle (or parjicle) of a map, one array per field so
+// they can all be moved a few at a time with sse. the Particle and
+// Parjicle structs are only used to create them and to hand them to
+// the create, update and destroy functions of their id
+typedef struct ParticleSystem {
+    f32* position[3];
+    f32* velocity[3];
+    f32* acceleration[3];
+    f32* color[3];
+    f32* lifetime;
+    f32* size;
+    // parjicles only, NULL for particles
+    f32* rotation;
+    bool* rotate_tex;
+    i32* id;
+    void** data;
+    // indices of the particles whose id has an update function
+    i32* updates;
+    // position, velocity, acceleration and lifetime point into this
+    void* aligned_block;
+    i32 num_updates;
+    i32 length, capacity;
+    i32 max_length;
+    i32 peak;
+    u64 allocs;
+} ParticleSystem;
+
+// creating a particle fails once this many are alive in one system
+#define PARTICLE_SYSTEM_MAX_LENGTH 65536
+
+void particle_system_init(ParticleSystem* ps, bool rotation, i32 max_length);
+void particle_system_destroy(ParticleSystem* ps);
+// index of a new uninitialized particle, -1 if the system is full
+i32  particle_system_add(ParticleSystem* ps);
+// position, velocity and lifetime of every particle
+void particle_system_integrate(ParticleSystem* ps, f32 dt);
+// drops the particles in [0, n) with no lifetime left, keeping the
+// order of the rest, and rebuilds the update list. update_mask[id]
+// tells whether particles with that id have an update function
+void particle_system_compact(ParticleSystem* ps, i32 n, const bool* update_mask);
+
 void particle_init(void);
 void particle_cleanup(void);
-Particle* particle_create_from_struct(Particle particle);
-//Particle* particle_create(vec3 position, vec3 velocity, vec3 acceleration, vec3 color, f32 lifetime, f32 size, i32 id);
-void particle_update(Particle* particle, f32 dt);
-void particle_destroy(Particle* particle);
+// false if the system is full
+bool particle_create_from_struct(ParticleSystem* ps, Particle particle);
+// moves every particle, runs the update functions and destroys
+// the ones whose lifetime ran out
+void particle_update_all(ParticleSystem* ps, f32 dt);
+// runs the destroy functions of every particle still alive
+void particle_destroy_all(ParticleSystem* ps);
 
 i32 particle_get_id(const char* name);
 
@@ -262,9 +369,9 @@ typedef struct Parjicle {
 
 void parjicle_init(void);
 void parjicle_cleanup(void);
-Parjicle* parjicle_create_from_struct(Parjicle parjicle);
-void parjicle_update(Parjicle* parjicle, f32 dt);
-void parjicle_destroy(Parjicle* parjicle);
+bool parjicle_create_from_struct(ParticleSystem* ps, Parjicle parjicle);
+void parjicle_update_all(ParticleSystem* ps, f32 dt);
+void parjicle_destroy_all(ParticleSystem* ps);
 i32 parjicle_get_id(const char* name);
 
 //**************************************************************************
@@ -316,10 +423,10 @@ typedef enum {
 
 // create trigger at position with hitbox radius
 // must set the enter, stay, leave, and destroy functions. they default to null
-Trigger* trigger_create(vec2 position, f32 radius);
+Trigger* trigger_create(Slab* slab, vec2 position, f32 radius);
 // if trigger->destroy is NULL, will call free on args
 // otherwise, will run destroy function (without touching args)
-void trigger_destroy(Trigger* trigger);
+void trigger_destroy(Slab* slab, Trigger* trigger);
 // checks entity list to find ones that left
 void trigger_update(Trigger* trigger);
 void trigger_set_flag(Trigger* trigger, TriggerFlagEnum flag, bool val);
@@ -564,9 +671,9 @@ void entity_set_state(Entity* entity, const char* name);
 // Each entitiy has a create, update, and delete
 // function that are called when passed as arguments
 // in these functions
-Entity* entity_create(vec2 position, i32 id);
+Entity* entity_create(Slab* slab, vec2 position, i32 id);
 void entity_update(Entity* entity, f32 dt);
-void entity_destroy(Entity* entity);
+void entity_destroy(Slab* slab, Entity* entity);
 
 // this will change the damage taken by an entity depending
 // on any modifiers it might have
@@ -652,8 +759,35 @@ void    wall_destroy(Wall* wall);
 // Projectile _projectile definitions
 //**************************************************************************
 
+typedef struct ProjectileChunk ProjectileChunk;
+
+// position, direction, speed, lifetime and pierce timer are not
+// in here, they are stored per field in the ProjectileChunk the
+// projectile lives in. use projectile_position and the others
 typedef struct Projectile {
     MapInfo map_info;
+    ProjectileUpdateFuncPtr update;
+    ProjectileDestroyFuncPtr destroy;
+    void* data;
+    ProjectileChunk* chunk;
+    f32 elevation;
+    f32 facing;
+    f32 rotation;
+    f32 size;
+    f32 prev_size;
+    u32 flags;
+    i32 owner_uid;
+    i32 tex;
+    i32 uid;
+    // slot in the map's ProjectilePool and the generation it was
+    // handed out with, see ProjectileHandle
+    i32 pool_idx;
+    u32 generation;
+} Projectile;
+
+// what a projectile is created from, see PROJECTILE_CREATE. also
+// what is read from and queued for the network
+typedef struct {
     ProjectileUpdateFuncPtr update;
     ProjectileDestroyFuncPtr destroy;
     void* data;
@@ -664,25 +798,87 @@ typedef struct Projectile {
     f32 rotation;
     f64 speed;
     f32 size;
-    f32 prev_size;
     f32 lifetime;
     f32 pierce_timer;
     u32 flags;
     i32 owner_uid;
     i32 tex;
     i32 uid;
-} Projectile;
+} ProjectileDesc;
+
+// projectiles live in fixed size chunks that are never moved while
+// the map exists, so a Projectile* stays valid for as long as the
+// projectile is alive. plugins that hold on to one across ticks
+// should keep a handle instead, which goes stale once the slot is
+// reused
+#define PROJECTILE_POOL_CHUNK 256
+
+// what projectile_update_all does with a slot besides moving it, the
+// flags and update function of the projectile in it. 0 for free slots
+typedef enum {
+    PROJECTILE_INTEGRATE_AGE = 1 << 0,
+    PROJECTILE_INTEGRATE_PIERCE = 1 << 1,
+    PROJECTILE_INTEGRATE_HIT_WALL = 1 << 2,
+    PROJECTILE_INTEGRATE_UPDATE = 1 << 3
+} ProjectileIntegrateEnum;
+
+// the fields projectile_update_all integrates, one array per field
+// so the loop over a chunk vectorizes
+typedef struct ProjectileChunk {
+    f64 position_x[PROJECTILE_POOL_CHUNK];
+    f64 position_z[PROJECTILE_POOL_CHUNK];
+    f64 prev_position_x[PROJECTILE_POOL_CHUNK];
+    f64 prev_position_z[PROJECTILE_POOL_CHUNK];
+    f64 direction_x[PROJECTILE_POOL_CHUNK];
+    f64 direction_z[PROJECTILE_POOL_CHUNK];
+    f64 speed[PROJECTILE_POOL_CHUNK];
+    f32 lifetime[PROJECTILE_POOL_CHUNK];
+    f32 pierce_timer[PROJECTILE_POOL_CHUNK];
+    // ProjectileIntegrateEnum bits
+    u8 integrate[PROJECTILE_POOL_CHUNK];
+    Projectile projectiles[PROJECTILE_POOL_CHUNK];
+} ProjectileChunk;
+
+typedef struct {
+    i32 idx;
+    u32 generation;
+} ProjectileHandle;
+
+typedef enum {
+    PROJECTILE_SLOT_FREE,
+    PROJECTILE_SLOT_LIVE,
+    // handed out while projectile_update_all walks the chunks
+    PROJECTILE_SLOT_SPAWNED
+} ProjectileSlotState;
+
+typedef struct {
+    ProjectileChunk** chunks;
+    i32 num_chunks;
+    // per slot, bumped whenever the slot is freed
+    u32* generations;
+    // per slot, a ProjectileSlotState
+    u8* slot_states;
+    i32* free_slots;
+    i32 num_free_slots;
+    // slots handed out during projectile_update_all, in order
+    i32* spawned;
+    i32 num_spawned, spawned_capacity;
+    bool updating;
+    SlabStats stats;
+} ProjectilePool;
 
 typedef enum {
     PROJECTILE_FLAG_AUTO_FREE_DATA,
     PROJECTILE_FLAG_TEX_ROTATION,
     PROJECTILE_FLAG_PIERCE,
     PROJECTILE_FLAG_IGNORE_LIFETIME,
-    PROJECTILE_FLAG_FRIENDLY
+    PROJECTILE_FLAG_FRIENDLY,
+    // stopped at a wall this tick, destroyed on the next update
+    PROJECTILE_FLAG_HIT_WALL
 } ProjectileFlagEnum;
 
 #define PROJECTILE_CREATE(...) \
-    (Projectile) { \
+    (ProjectileDesc) { \
         .update = NULL, \
         .destroy = NULL, \
         .data = NULL, \
@@ -705,17 +901,101 @@ typedef enum {
 // not have a create function. They do not have ids mapped to a 
 // function ptr (like entities) because it is not necessary to 
 // know projectile information + it would be a headache.
-Projectile* projectile_create(Projectile projectile);
+Projectile* projectile_create(ProjectilePool* pool, ProjectileDesc desc);
 void projectile_update(Projectile* projectile, f32 dt);
-void projectile_destroy(Projectile* projectile);
-
+void projectile_destroy(ProjectilePool* pool, Projectile* projectile);
+
+// moves every projectile in one loop per chunk, then runs the update
+// functions of the ones that have one, in slot order. ones created by
+// update functions also move this tick
+void projectile_update_all(ProjectilePool* pool, f32 dt);
+
+void        projectile_pool_init(ProjectilePool* pool);
+void        projectile_pool_destroy(ProjectilePool* pool);
+// projectile made from desc, uid included, not registered with it
+Projectile* projectile_pool_alloc(ProjectilePool* pool, ProjectileDesc* desc);
+void        projectile_pool_free(ProjectilePool* pool, Projectile* proj);
+// NULL once the projectile the handle was made from is destroyed
+Projectile* projectile_pool_get(ProjectilePool* pool, ProjectileHandle handle);
+ProjectileHandle projectile_get_handle(Projectile* proj);
+
+// flags and update decide which path projectile_update_all takes,
+// so they are only changed through these
+void projectile_set_update(Projectile* proj, ProjectileUpdateFuncPtr update);
 void projectile_set_flag(Projectile* proj, ProjectileFlagEnum flag, bool val);
 bool projectile_get_flag(Projectile* proj, ProjectileFlagEnum flag);
 
 size_t      projectile_sizeof(void);
-char*       projectile_read(Projectile* proj, char* buffer);
+char*       projectile_read(ProjectileDesc* desc, char* buffer);
 char*       projectile_write(Projectile* projectile, char* buffer);
 
+static inline i32 projectile_slot(Projectile* proj)
+{
+    return (u32)proj->pool_idx % PROJECTILE_POOL_CHUNK;
+}
+
+static inline vec2 projectile_position(Projectile* proj)
+{
+    i32 i = projectile_slot(proj);
+    return (vec2) { proj->chunk->position_x[i], { proj->chunk->position_z[i] } };
+}
+
+static inline void projectile_set_position(Projectile* proj, vec2 position)
+{
+    i32 i = projectile_slot(proj);
+    proj->chunk->position_x[i] = position.x;
+    proj->chunk->position_z[i] = position.z;
+}
+
+static inline vec2 projectile_prev_position(Projectile* proj)
+{
+    i32 i = projectile_slot(proj);
+    return (vec2) { proj->chunk->prev_position_x[i], { proj->chunk->prev_position_z[i] } };
+}
+
+static inline vec2 projectile_direction(Projectile* proj)
+{
+    i32 i = projectile_slot(proj);
+    return (vec2) { proj->chunk->direction_x[i], { proj->chunk->direction_z[i] } };
+}
+
+static inline void projectile_set_direction(Projectile* proj, vec2 direction)
+{
+    i32 i = projectile_slot(proj);
+    proj->chunk->direction_x[i] = direction.x;
+    proj->chunk->direction_z[i] = direction.z;
+}
+
+static inline f64 projectile_speed(Projectile* proj)
+{
+    return proj->chunk->speed[projectile_slot(proj)];
+}
+
+static inline void projectile_set_speed(Projectile* proj, f64 speed)
+{
+    proj->chunk->speed[projectile_slot(proj)] = speed;
+}
+
+static inline f32 projectile_lifetime(Projectile* proj)
+{
+    return proj->chunk->lifetime[projectile_slot(proj)];
+}
+
+static inline void projectile_set_lifetime(Projectile* proj, f32 lifetime)
+{
+    proj->chunk->lifetime[projectile_slot(proj)] = lifetime;
+}
+
+static inline f32 projectile_pierce_timer(Projectile* proj)
+{
+    return proj->chunk->pierce_timer[projectile_slot(proj)];
+}
+
+static inline void projectile_set_pierce_timer(Projectile* proj, f32 pierce_timer)
+{
+    proj->chunk->pierce_timer[projectile_slot(proj)] = pierce_timer;
+}
+
 //**************************************************************************
 // AOE _aoe definitions
 //**************************************************************************
@@ -749,9 +1029,9 @@ typedef enum {
 // not have a create function. They do not have ids mapped to a 
 // function ptr (like entities) because it is not necessary to 
 // know aoe information + it would be a headache.
-AOE* aoe_create(vec2 position, f32 lifetime);
+AOE* aoe_create(Slab* slab, vec2 position, f32 lifetime);
 void aoe_update(AOE* aoe, f32 dt);
-void aoe_destroy(AOE* aoe);
+void aoe_destroy(Slab* slab, AOE* aoe);
 
 void aoe_set_flag(AOE* proj, AOEFlagEnum flag, bool val);
 bool aoe_get_flag(AOE* proj, AOEFlagEnum flag);
@@ -802,6 +1082,9 @@ void parstacle_write(Parstacle* parstacle, char* buffer);
 //**************************************************************************
 
 typedef struct LocalMapGenerationSettings {
+    // stream of the map being generated, roomset
+    // callbacks should draw from it too
+    Rng* rng;
     const char* current_branch;
     const char* current_room_type;
     i32 num_rooms_left;
@@ -858,6 +1141,12 @@ typedef struct Room {
     RoomExitFuncPtr exit;
     List* male_alternates;
     List* female_alternates;
+    // non preset pixels of the room in each orientation, the stamp
+    // goes at the room origin plus (stamp_dx, stamp_dz). only the
+    // first one is created for rooms that do not rotate
+    Quadmask* stamps[ROOM_NUM_ORIENTATIONS];
+    i32 stamp_dx[ROOM_NUM_ORIENTATIONS];
+    i32 stamp_dz[ROOM_NUM_ORIENTATIONS];
     bool rotate;
 } Room;
 
@@ -878,6 +1167,14 @@ typedef enum {
     // Partitions map into equal-sized buckets 
     MAP_COLLIDE_SPATIAL_HASH,
 
+    // Rebuilds a flat grid of small cells every tick, only
+    // occupied cells are visited
+    MAP_COLLIDE_UNIFORM_GRID,
+
+    // Loose quadtree, nodes split where objects crowd so empty
+    // space costs nothing
+    MAP_COLLIDE_QUADTREE,
+
     // Allocates no extra memory but is very slow
     MAP_COLLIDE_NAIVE
 } MapCollisionStrategy;
@@ -891,14 +1188,119 @@ typedef struct {
     List* aoes;
 } Bucket;
 
+typedef enum {
+    CONTACT_ENTITY_OBSTACLE,
+    CONTACT_ENTITY_FREE_WALL,
+    CONTACT_ENTITY_PROJECTILE,
+    CONTACT_ENTITY_TRIGGER,
+    CONTACT_ENTITY_AOE,
+    CONTACT_PROJECTILE_OBSTACLE,
+    CONTACT_PROJECTILE_FREE_WALL
+} ContactType;
+
+// overlapping pair found by the parallel collision pass, as
+// indices into the lists of the bucket it was found in
+typedef struct {
+    i32 type;
+    i32 i, j;
+} Contact;
+
+// what a bucket held when its contacts were found
+typedef struct {
+    i32 lengths[6];
+    i32 contacts_start, contacts_end;
+    i32 positions_start;
+} BucketContacts;
+
+// contacts of one range of buckets, written by a single job, plus
+// the position of every entity of the range when it was tested
+typedef struct {
+    Contact* contacts;
+    i32 num_contacts, contacts_capacity;
+    vec2* positions;
+    i32 num_positions, positions_capacity;
+    u64 candidate_pairs;
+} ContactList;
+
 typedef struct {
     i32 bucket_width;
     i32 num_buckets_wide; // x
     i32 num_buckets_long; // z
     i32 num_buckets;
     Bucket* buckets;
+    // scratch for the two phase collision pass, kept between ticks
+    BucketContacts* bucket_contacts;
+    ContactList* contact_lists;
+    i32 num_contact_lists;
+    i32 contact_grain;
 } SpatialHashData;
 
+typedef struct {
+    void* object;
+    i32 type;
+    // inclusive range of cells the object overlaps
+    i32 x1, z1, x2, z2;
+} GridObject;
+
+typedef struct {
+    i32 cell_width;
+    i32 num_cells_wide; // x
+    i32 num_cells_long; // z
+    i32 num_cells;
+    // objects are counting sorted into cells each tick. cell_count
+    // is kept zeroed between ticks, only occupied cells are reset
+    i32* cell_count;
+    i32* cell_start;
+    i32* occupied_cells;
+    i32 num_occupied_cells;
+    GridObject* objects;
+    i32 num_objects;
+    i32 objects_capacity;
+    // indices into objects, grouped by cell
+    i32* cell_objects;
+    i32 cell_objects_capacity;
+} UniformGridData;
+
+typedef struct {
+    Bucket bucket;
+    // objects of each bucket type in this node and all below it
+    i32 counts[6];
+    // objects are kept in the node that holds their center and
+    // is at least as large as them. the loose bounds are twice
+    // the node width so objects never stick out of them
+    f32 x, z;
+    f32 half_width;
+    i32 depth;
+    i32 parent;
+    // index of the first of four children, -1 for leaves
+    i32 children;
+} QuadtreeNode;
+
+typedef struct {
+    i32 split_threshold;
+    // nodes[0] is the root. nodes are never merged, empty
+    // subtrees are skipped using their counts
+    QuadtreeNode* nodes;
+    i32 num_nodes;
+    i32 nodes_capacity;
+} QuadtreeData;
+
+typedef struct {
+    // summed over the ticks of the current window
+    u64 entities;
+    u64 projectiles;
+    // obstacles, free walls, triggers and aoes
+    u64 targets;
+    // pairs handed to the narrow phase by the active strategy
+    u64 candidate_pairs;
+    i32 ticks;
+    // a different strategy has to win this many windows in a row
+    // before the map switches to it
+    MapCollisionStrategy pending_strategy;
+    i32 pending_cell_width;
+    i32 pending_windows;
+} CollisionStats;
+
 typedef struct {
     Particle buffer[PARTICLE_QUEUE_LENGTH+1];
     i32 head;
@@ -917,7 +1319,7 @@ typedef struct {
             Tile tile;
             Wall wall;
             Entity entity;
-            Projectile proj;
+            ProjectileDesc proj;
         };
         GameObj type;
     } buffer[GAME_OBJECT_QUEUE_LENGTH+1];
@@ -925,6 +1327,21 @@ typedef struct {
     i32 tail;
 } GameObjectQueue;
 
+// MAP_CHUNK_WIDTH x MAP_CHUNK_WIDTH tiles, indexed by the tile
+// coordinates masked to the chunk. the masks hold one row per z
+// with bit x set
+typedef struct MapChunk {
+    // Tile* or Wall*, depending on wall_mask
+    void* tiles[MAP_CHUNK_AREA];
+    MapNode* nodes[MAP_CHUNK_AREA];
+    // index into the map's tile_collide_funcs
+    u8 tile_collide[MAP_CHUNK_AREA];
+    u32 wall_mask[MAP_CHUNK_WIDTH];
+    // walls and tiles with a collide function, everything
+    // else is skipped by map_collide_tilemap with one bit test
+    u32 collide_mask[MAP_CHUNK_WIDTH];
+} MapChunk;
+
 typedef struct Map {
 
     GameObjectQueue object_queue;
@@ -935,11 +1352,20 @@ typedef struct Map {
     vec2 spawn_point;
     Roomset* roomset;
     MapNode* root;
-    void** tilemap;
-    MapNode** map_nodes;
-    Quadmask* tile_mask;
+    // layout randomness, seeded from RNG_STREAM_MAP
+    Rng rng;
+    // NULL where no tile or map node was ever placed
+    MapChunk* chunks[MAP_CHUNKS_WIDE * MAP_CHUNKS_LONG];
+    i32 num_chunks;
+    TileCollideFuncPtr tile_collide_funcs[MAP_MAX_TILE_COLLIDE_FUNCS];
+    i32 num_tile_collide_funcs;
     Quadmask* fog_mask;
     SpatialHashData spatial_hash_data;
+    UniformGridData uniform_grid_data;
+    QuadtreeData quadtree_data;
+    // when set, map_collide_objects picks and retunes the strategy
+    bool adaptive_collision;
+    CollisionStats collision_stats;
     MapCollisionStrategy collision_strategy;
     List* bosses;
     List* entities;
@@ -947,15 +1373,24 @@ typedef struct Map {
     List* walls;
     List* free_walls;
     List* projectiles;
+    ProjectilePool projectile_pool;
+    // backing memory for the objects of the matching lists. everything
+    // still live when the map is destroyed is released a slab at a time
+    Slab entity_slab;
+    Slab trigger_slab;
+    Slab aoe_slab;
     List* obstacles;
     List* parstacles;
-    List* particles;
-    List* parjicles;
+    ParticleSystem particles;
+    ParticleSystem parjicles;
     List* triggers;
     List* aoes;
     List* lines;
     bool active;
     bool show_spatial_hash_lines;
+    // whether lines has the grid lines, map_update makes or frees
+    // them on the game thread when show_spatial_hash_lines changes
+    bool spatial_hash_lines_created;
 } Map;
 
 typedef struct MapNode {
@@ -986,19 +1421,37 @@ void map_unmake_boss(Entity* entity);
 void map_init(void);
 i32  map_get_id(const char* name);
 Map* map_create(i32 id);
+// sends map, objects and cleared fog to a client that joined after
+// map_create and gives it a player entity
+void map_sync_client(Map* map, Client* client);
 
 void map_update(Map* map, f32 dt);
+// the phases of map_update on the host, in order. exposed so
+// the benchmark can time them separately
+void map_update_objects(Map* map, f32 dt);
+void map_collide_tilemap(Map* map);
+void map_collide_objects(Map* map);
 void map_set_active(Map* map);
 void map_set_inactive(Map* map);
 void map_destroy(Map* map);
 void map_cleanup(void);
 
+// set up the projectile pool, object slabs and particle systems
+// of a new map
+void map_init_allocators(Map* map);
+// live and peak object counts, one line per allocator
+void map_log_allocator_stats(Map* map, LogLevel level);
+
 void map_destroy_projectiles_with_owner_id(i32 uid);
+// NULL if the projectile is gone or the handle is from another map
+Projectile* map_get_projectile(ProjectileHandle handle);
 
 // switch collision strategy for map
 void map_use_quadtree(Map* map, i32 split_threshold);
 void map_use_spatial_hash(Map* map, i32 bucket_width);
+void map_use_uniform_grid(Map* map, i32 cell_width);
 void map_use_naive(Map* map);
+void map_use_adaptive(Map* map);
 
 void bucket_create(Bucket* bucket);
 void bucket_destroy(Bucket* bucket);
@@ -1042,6 +1495,13 @@ Wall* map_get_wall(Map* map, i32 x, i32 z);
 void map_set_tile(Map* map, i32 x, i32 z, Tile* tile);
 void map_set_wall(Map* map, i32 x, i32 z, Wall* wall);
 
+// the map node of the room covering (x, z), NULL outside of rooms
+MapNode* map_get_node(Map* map, i32 x, i32 z);
+void     map_set_node(Map* map, i32 x, i32 z, MapNode* node);
+
+// lifts the fog from the cells of node between x1..x2 and z1..z2
+void map_clear_node_fog_rect(Map* map, MapNode* node, i32 x1, i32 x2, i32 z1, i32 z2);
+
 // returns whether coordinate in fog
 bool map_fog_contains(Map* map, vec2 position);
 bool map_fog_contains_tile(Map* map, Tile* tile);
@@ -1076,7 +1536,7 @@ vec3 map_to_room_position3(vec3 position);
 
 void map_queue_particle(Particle particle);
 void map_queue_parjicle(Parjicle parjicle);
-void map_queue_projectile(Projectile proj);
+void map_queue_projectile(ProjectileDesc proj);
 void map_queue_entity(Entity entity);
 void map_queue_game_obj(void* obj, GameObj type);
 
@@ -1088,7 +1548,7 @@ void map_queue_game_obj(void* obj, GameObj type);
 Entity*         map_create_entity(vec2 position, i32 id);
 bool            map_create_parjicle(Parjicle parjicle);
 bool            map_create_particle(Particle particle);
-Projectile*     map_create_projectile(Projectile projectile);
+Projectile*     map_create_projectile(ProjectileDesc desc);
 Trigger*        map_create_trigger(vec2 position, f32 radius);
 AOE*            map_create_aoe(vec2 position, f32 lifetime);
 Line*           map_create_line(void);
@@ -1097,7 +1557,7 @@ Line*           map_create_line(void);
 Entity*         room_create_entity(vec2 position, i32 id);
 Obstacle*       room_create_obstacle(vec2 position);
 Parstacle*      room_create_parstacle(vec2 position);
-Projectile*     room_create_projectile(Projectile projectile);
+Projectile*     room_create_projectile(ProjectileDesc desc);
 Trigger*        room_create_trigger(vec2 position, f32 radius);
 AOE*            room_create_aoe(vec2 position, f32 lifetime);
 Wall*           room_create_wall(vec2 position, f32 height, f32 width, f32 length, u32 minimap_color);
@@ -1108,6 +1568,63 @@ Line*           room_create_line(void);
 Tile*           room_set_tilemap_tile(i32 x, i32 z, u32 minimap_color);
 Wall*           room_set_tilemap_wall(i32 x, i32 z, f32 height, u32 minimap_color);
 
+//**************************************************************************
+// Snapshot _snapshot
+//**************************************************************************
+
+typedef void (*SnapshotSendFunc)(Packet* packet, void* arg);
+
+// what part of a frame a client is sent: objects within radius of
+// center, at most max_objects of them, nearest first. a radius of 0
+// selects everything and a max_objects of 0 does not limit it
+typedef struct {
+    u32 frame;
+    vec2 center;
+    f32 radius;
+    i32 max_objects;
+} SnapshotInterest;
+
+// replication state of one client on the host
+typedef struct {
+    // interest of every frame in the history, the part of the
+    // acknowledged frame the client has is selected again from it
+    SnapshotInterest interests[SNAPSHOT_HISTORY];
+    // newest frame the client received completely, the host
+    // sends deltas against it. 0 if there is none
+    _Atomic u32 ack;
+    // seconds between snapshots, 0 for game_context.net_timestep.
+    // a snapshot is due once timer runs out
+    f32 interval;
+    f32 timer;
+} SnapshotView;
+
+void snapshot_init(void);
+void snapshot_cleanup(void);
+// forget every frame, called when a new map is created
+void snapshot_reset(void);
+// records the replicated state of the entities and projectiles
+// of map as a new frame and returns its number
+u32  snapshot_capture(Map* map);
+// writes the part of the newest frame selected by interest (everything
+// if NULL) as a delta to the frame view acknowledged, or in full if
+// that frame is no longer known, and passes every datagram to send.
+// returns the number of bytes sent
+i32  snapshot_write(SnapshotView* view, SnapshotInterest* interest, SnapshotSendFunc send, void* arg);
+// interest of a client, around the target of its camera
+SnapshotInterest snapshot_client_interest(Client* client);
+// rate of 0 goes back to the default of the host
+void snapshot_set_rate(SnapshotView* view, i32 rate);
+// sends a snapshot to every client that is due for one
+void host_send_snapshot(Map* map, f32 dt);
+void host_set_snapshot_rate(Packet* packet);
+void host_snapshot_ack(Packet* packet);
+void client_read_snapshot(Packet* packet);
+// asks the host for rate snapshots per second
+void client_request_snapshot_rate(i32 rate);
+// moves the entities and projectiles to where they were a little
+// in the past, between the two received snapshots around that time
+void client_interpolate_snapshots(void);
+
 //**************************************************************************
 // Client _client
 //**************************************************************************
@@ -1129,6 +1646,8 @@ typedef struct Client {
 
     i32 control_flags;
     i32 uid;
+
+    SnapshotView snapshot_view;
 } Client;
 
 Client* client_create(void);
@@ -1154,6 +1673,8 @@ void client_map_create_parjicle(Packet* packet);
 void client_update_stats(Packet* packet);
 
 void host_create_game_obj(i32 uid);
+// the create packet of one object, only to client
+void host_send_game_obj(Client* client, i32 uid);
 void host_destroy_game_obj(i32 uid);
 void host_swap_items(Packet* packet);
 void host_handle_client_input(Packet* packet);
@@ -1186,11 +1707,24 @@ typedef struct {
     pthread_t thread_id;
     pthread_mutex_t handler_thread_mutex;
     pthread_mutex_t getter_mutex;
+    // paces the game loop at frame_rate. the simulation runs
+    // at tps in fixed steps out of the accumulator
+    Pacer pacer;
     f64 time;
+    f64 accumulator;
     f32 timestep;
     f32 net_timer;
     f32 net_timestep;
+    // how far real time is between the last two simulation
+    // steps, used to interpolate render positions
+    f32 alpha;
     i32 tps;
+    i32 frame_rate;
+    // set from other threads by game_set_tps and game_set_frame_rate,
+    // taken by the game loop between frames. 0 when nothing is asked
+    _Atomic i32 requested_tps;
+    _Atomic i32 requested_frame_rate;
+    i32 dropped_steps;
     f32 real_dt;
     bool kill_thread;
     bool halt_input;
@@ -1227,6 +1761,10 @@ void game_net_send_tcp_packet_to_clients(Packet* packet);
 void game_net_send_udp_packet_to_clients(Packet* packet);
 void game_net_send_packet_udp(Client* client, Packet* packet);
 void game_net_send_packet_tcp(Client* client, Packet* packet);
+// host only, copies packet for client into the udp batch, which goes
+// out in as few syscalls as possible on game_net_flush_udp
+void game_net_queue_packet_udp(Client* client, Packet* packet);
+void game_net_flush_udp(void);
 
 // setup and cleanup opengl buffers. this is
 // done on the main thread on program creation
@@ -1252,16 +1790,32 @@ void game_render_update_parstacles(void);
 void game_render_update_tiles(void);
 void game_render_update_walls(void);
 
-void game_update_vertex_data(void);
+// alpha in [0, 1] blends render positions between the previous
+// and current simulation step
+void game_update_vertex_data(f32 alpha);
 
 void game_change_map(i32 id);
 
 size_t game_object_write(GameObj type, void* obj, char* buffer);
+size_t game_object_sizeof(GameObj type);
 
 //**************************************************************************
 // Collision functions
 //**************************************************************************
 
+bool overlap_entity_wall(Entity* entity, Wall* wall);
+bool overlap_entity_tile(Entity* entity, i32 x, i32 z);
+bool overlap_entity_obstacle(Entity* entity, Obstacle* obstacle);
+bool overlap_entity_projectile(Entity* entity, Projectile* projectile);
+bool overlap_entity_trigger(Entity* entity, Trigger* trigger);
+bool overlap_entity_aoe(Entity* entity, AOE* aoe);
+bool overlap_projectile_wall(Projectile* projectile, Wall* wall);
+bool overlap_projectile_obstacle(Projectile* projectile, Obstacle* obstacle);
+// time in [0, 1] along the projectile's move from prev_position to
+// position at which it first touches the object, -1 if it never does
+f32  sweep_entity_projectile(Entity* entity, Projectile* projectile);
+f32  sweep_projectile_wall(Projectile* projectile, Wall* wall);
+f32  sweep_projectile_obstacle(Projectile* projectile, Obstacle* obstacle);
 void collide_entity_wall(Entity* entity, Wall* wall);
 void collide_entity_tile(Entity* entity, Tile* tile);
 void collide_entity_obstacle(Entity* entity, Obstacle* obstacle);
@@ -1285,6 +1839,16 @@ void game_resume_render(void);
 void game_pause(void);
 void game_resume(void);
 
+// change the simulation tick rate. clamped to the range the pacer
+// supports, the clamped rate is returned. safe from any thread, the
+// game loop switches to it before its next frame
+i32 game_set_tps(i32 tps);
+
+// change how often the game loop wakes up to process input and
+// build vertex data. independent of the simulation tick rate,
+// applied the same way as game_set_tps
+i32 game_set_frame_rate(i32 frame_rate);
+
 void game_init(void);
 void game_cleanup(void);
 void game_process_input(f32 dt);
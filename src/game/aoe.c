@@ -1,8 +1,8 @@
 #include "../game.h"
 
-AOE* aoe_create(vec2 position, f32 lifetime)
+AOE* aoe_create(Slab* slab, vec2 position, f32 lifetime)
 {
-    AOE* aoe = st_malloc(sizeof(AOE));
+    AOE* aoe = slab_alloc(slab);
     aoe->update = NULL;
     aoe->destroy = NULL;
     aoe->data = NULL;
@@ -26,11 +26,11 @@ void aoe_update(AOE* aoe, f32 dt)
         aoe->update(aoe, dt);
 }
 
-void aoe_destroy(AOE* aoe)
+void aoe_destroy(Slab* slab, AOE* aoe)
 {
     if (aoe->destroy != NULL)
         aoe->destroy(aoe);
-    st_free(aoe);
+    slab_free(slab, aoe);
 }
 
 void aoe_set_flag(AOE* aoe, AOEFlagEnum flag, bool val)
@@ -94,15 +94,14 @@ Map* client_map_create(void)
     if (map != NULL)
         map_destroy(map);
 
+    snapshot_reset();
+
     map = st_calloc(1, sizeof(Map));
     map->width = MAP_MAX_WIDTH;
     map->length = MAP_MAX_LENGTH;
     map->root = NULL;
     map->roomset = NULL;
-    map->tile_mask = quadmask_create(MAP_MAX_WIDTH, MAP_MAX_LENGTH);
     map->fog_mask = quadmask_create(MAP_MAX_WIDTH, MAP_MAX_LENGTH);
-    map->tilemap = NULL;
-    map->map_nodes = st_calloc(map->width * map->length, sizeof(MapNode*));
     map->bosses = list_create();
     map->entities = list_create();
     map->tiles = list_create();
@@ -111,11 +110,10 @@ Map* client_map_create(void)
     map->projectiles = list_create();
     map->obstacles = list_create();
     map->parstacles = list_create();
-    map->particles = list_create();
-    map->parjicles = list_create();
     map->triggers = list_create();
     map->aoes = list_create();
     map->lines = list_create();
+    map_init_allocators(map);
     map->spawn_point = vec2_create(MAP_MAX_WIDTH / 2 + 0.5, MAP_MAX_LENGTH / 2 + 0.5);
     map->active = true;
     
@@ -137,14 +135,15 @@ void client_map_create_game_object(Packet* packet)
 
     switch (type) {
         case GAME_OBJ_ENTITY:
-            Entity* entity = st_calloc(1, sizeof(Entity));
+            Entity* entity = slab_alloc(&map->entity_slab);
             entity_read(entity, buffer);
             list_append(map->entities, entity);
             game_set_uid(entity, type, entity->uid);
             break;
         case GAME_OBJ_PROJECTILE:
-            Projectile* proj = st_calloc(1, sizeof(Projectile));
-            projectile_read(proj, buffer);
+            ProjectileDesc desc;
+            projectile_read(&desc, buffer);
+            Projectile* proj = projectile_pool_alloc(&map->projectile_pool, &desc);
             list_append(map->projectiles, proj);
             game_set_uid(proj, type, proj->uid);
             break;
@@ -209,7 +208,7 @@ void client_map_update_game_object(Packet* packet)
             }
             break;
         case GAME_OBJ_PROJECTILE:
-            Projectile proj;
+            ProjectileDesc proj;
             size = projectile_sizeof();
             for (i32 i = 0; i < high; i++) {
                 projectile_read(&proj, buffer);
@@ -255,7 +254,7 @@ void client_map_destroy_game_object(Packet* packet)
         case GAME_OBJ_PROJECTILE:
             Projectile* this_proj = game_context.uid_map[uid];
             if (this_proj != NULL) {
-                this_proj->lifetime = -1;
+                projectile_set_lifetime(this_proj, -1);
             }
             break;
         default:
@@ -276,10 +275,7 @@ void client_map_clear_fog(Packet* packet)
     memcpy((char*)&z1, packet->buffer + 2 * size, size);
     memcpy((char*)&z2, packet->buffer + 3 * size, size);
     memcpy(&node, packet->buffer + 4 * size, sizeof(void*));
-    for (i32 z = z1; z <= z2; z++)
-        for (i32 x = x1; x <= x2; x++)
-            if (node == map->map_nodes[z * map->width + x])
-                quadmask_set(map->fog_mask, x, z);
+    map_clear_node_fog_rect(map, node, x1, x2, z1, z2);
 
     game_render_update_obstacles();
     game_render_update_parstacles();
@@ -290,10 +286,23 @@ void client_map_clear_fog(Packet* packet)
 void client_map_create_map_nodes(Packet* packet)
 {
     Map* map = game_context.current_map;
+    size_t entry_size = sizeof(i32) + MAP_CHUNK_AREA * sizeof(MapNode*);
+    MapNode* node;
+    char* entry;
+    i32 chunk, x0, z0;
     if  (map == NULL)
         return;
 
-    memcpy(map->map_nodes, packet->buffer, packet->length);
+    for (entry = packet->buffer; entry + entry_size <= packet->buffer + packet->length; entry += entry_size) {
+        memcpy(&chunk, entry, sizeof(i32));
+        x0 = (chunk % MAP_CHUNKS_WIDE) * MAP_CHUNK_WIDTH;
+        z0 = (chunk / MAP_CHUNKS_WIDE) * MAP_CHUNK_WIDTH;
+        for (i32 i = 0; i < MAP_CHUNK_AREA; i++) {
+            memcpy(&node, entry + sizeof(i32) + i * sizeof(MapNode*), sizeof(MapNode*));
+            if (node != NULL)
+                map_set_node(map, x0 + i % MAP_CHUNK_WIDTH, z0 + i / MAP_CHUNK_WIDTH, node);
+        }
+    }
 }
 
 void client_map_create_particle(Packet* packet)
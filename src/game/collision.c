@@ -3,9 +3,105 @@
 
 extern GameContext game_context;
 
-void collide_entity_wall(Entity* entity, Wall* wall)
+// the overlap tests only read both objects. the collide functions
+// below go through them too, so a pair found by an overlap test is
+// exactly a pair the matching collide function responds to.
+// projectiles are swept from prev_position to position, so fast ones
+// cannot skip over a wall or a hitbox between two ticks
+
+// the sweeps return the earliest t in [0, 1] at which p + t * d is
+// strictly inside the object, -1 if it never is. a projectile that
+// starts the tick inside an object only hits it if it is still inside
+// at the end (t = 1), so it can fly out of a wall it was spawned in
+
+static f32 sweep_box(vec2 p, vec2 d, vec2 lo, vec2 hi)
 {
-    f32 ex, ez, er, dx, dz, wx, wz, sx, sz;
+    f64 t0 = 0, t1 = 1, a, b, tmp;
+    f64 pc[2] = { p.x, p.z }, dc[2] = { d.x, d.z };
+    f64 lc[2] = { lo.x, lo.z }, hc[2] = { hi.x, hi.z };
+    bool inside = true;
+    for (i32 i = 0; i < 2; i++)
+        inside = inside && pc[i] > lc[i] && pc[i] < hc[i];
+    if (inside) {
+        for (i32 i = 0; i < 2; i++)
+            if (pc[i] + dc[i] <= lc[i] || pc[i] + dc[i] >= hc[i])
+                return -1;
+        return 1;
+    }
+    for (i32 i = 0; i < 2; i++) {
+        if (dc[i] == 0) {
+            if (pc[i] <= lc[i] || pc[i] >= hc[i])
+                return -1;
+            continue;
+        }
+        a = (lc[i] - pc[i]) / dc[i];
+        b = (hc[i] - pc[i]) / dc[i];
+        if (a > b) {
+            tmp = a;
+            a = b;
+            b = tmp;
+        }
+        t0 = fmax(t0, a);
+        t1 = fmin(t1, b);
+        if (t0 >= t1)
+            return -1;
+    }
+    return t0;
+}
+
+static f32 sweep_circle(vec2 p, vec2 d, vec2 c, f32 r)
+{
+    f64 mx, mz, a, b, k, disc, t;
+    mx = p.x - c.x;
+    mz = p.z - c.z;
+    a = d.x * d.x + d.z * d.z;
+    b = mx * d.x + mz * d.z;
+    k = mx * mx + mz * mz - (f64)r * r;
+    // |m + d|^2 - r^2 is the same test at the end
+    if (k < 0)
+        return k + 2 * b + a < 0 ? 1 : -1;
+    if (a == 0 || b >= 0)
+        return -1;
+    disc = b * b - a * k;
+    if (disc <= 0)
+        return -1;
+    t = (-b - sqrt(disc)) / a;
+    return t <= 1 ? t : -1;
+}
+
+// moves the projectile back to where it hit something at time t
+static void stop_projectile(Projectile* projectile, f32 t)
+{
+    vec2 d = vec2_sub(projectile_position(projectile), projectile_prev_position(projectile));
+    projectile_set_position(projectile, vec2_add(projectile_prev_position(projectile), vec2_scale(d, t)));
+}
+
+f32 sweep_entity_projectile(Entity* entity, Projectile* projectile)
+{
+    f32 r = entity->hitbox_radius + projectile->size / 2;
+    vec2 d = vec2_sub(projectile_position(projectile), projectile_prev_position(projectile));
+    return sweep_circle(projectile_prev_position(projectile), d, entity->position, r);
+}
+
+f32 sweep_projectile_wall(Projectile* projectile, Wall* wall)
+{
+    f32 pr = projectile->size / 2;
+    vec2 lo = vec2_create(wall->position.x - pr, wall->position.z - pr);
+    vec2 hi = vec2_create(wall->position.x + wall->size.x + pr, wall->position.z + wall->size.z + pr);
+    vec2 d = vec2_sub(projectile_position(projectile), projectile_prev_position(projectile));
+    return sweep_box(projectile_prev_position(projectile), d, lo, hi);
+}
+
+f32 sweep_projectile_obstacle(Projectile* projectile, Obstacle* obstacle)
+{
+    f32 r = projectile->size / 2 + obstacle->size / 2;
+    vec2 d = vec2_sub(projectile_position(projectile), projectile_prev_position(projectile));
+    return sweep_circle(projectile_prev_position(projectile), d, obstacle->position, r);
+}
+
+bool overlap_entity_wall(Entity* entity, Wall* wall)
+{
+    f32 ex, ez, er, wx, wz, sx, sz;
     ex = entity->position.x;
     ez = entity->position.z;
     er = entity->size / 2;
@@ -13,8 +109,79 @@ void collide_entity_wall(Entity* entity, Wall* wall)
     wz = wall->position.z;
     sx = wall->size.x;
     sz = wall->size.z;
-    if (!(ex + er > wx && ex - er < wx + sx && ez + er > wz && ez - er < wz + sz))
+    return ex + er > wx && ex - er < wx + sx && ez + er > wz && ez - er < wz + sz;
+}
+
+// the tile at (x, z) is the one under the center of the entity
+bool overlap_entity_tile(Entity* entity, i32 x, i32 z)
+{
+    f32 ex, ez;
+    ex = entity->position.x;
+    ez = entity->position.y;
+    return ex >= x && ex < x + 1 && ez >= z && ez < z + 1;
+}
+
+bool overlap_entity_obstacle(Entity* entity, Obstacle* obstacle)
+{
+    f32 ex, ez, er, ox, oz, or;
+    ex = entity->position.x;
+    ez = entity->position.y;
+    er = entity->size / 2;
+    ox = obstacle->position.x;
+    oz = obstacle->position.y;
+    or = obstacle->size / 2;
+    return vec2_mag(vec2_create(ex - ox, ez - oz)) < er + or;
+}
+
+bool overlap_entity_projectile(Entity* entity, Projectile* projectile)
+{
+    return sweep_entity_projectile(entity, projectile) >= 0;
+}
+
+bool overlap_entity_trigger(Entity* entity, Trigger* trigger)
+{
+    f32 ex, ez, er, tx, tz, tr;
+    ex = entity->position.x;
+    ez = entity->position.y;
+    er = entity->hitbox_radius;
+    tx = trigger->position.x;
+    tz = trigger->position.y;
+    tr = trigger->radius;
+    return vec2_mag(vec2_create(ex - tx, ez - tz)) < er + tr;
+}
+
+bool overlap_entity_aoe(Entity* entity, AOE* aoe)
+{
+    f32 ex, ez, er, ax, az, ar;
+    ex = entity->position.x;
+    ez = entity->position.y;
+    er = entity->hitbox_radius;
+    ax = aoe->position.x;
+    az = aoe->position.y;
+    ar = aoe->radius;
+    return vec2_mag(vec2_create(ex - ax, ez - az)) < er + ar;
+}
+
+bool overlap_projectile_wall(Projectile* projectile, Wall* wall)
+{
+    return sweep_projectile_wall(projectile, wall) >= 0;
+}
+
+bool overlap_projectile_obstacle(Projectile* projectile, Obstacle* obstacle)
+{
+    return sweep_projectile_obstacle(projectile, obstacle) >= 0;
+}
+
+void collide_entity_wall(Entity* entity, Wall* wall)
+{
+    f32 ex, ez, er, dx, dz, wx, wz, sx, sz;
+    if (!overlap_entity_wall(entity, wall))
         return;
+    er = entity->size / 2;
+    wx = wall->position.x;
+    wz = wall->position.z;
+    sx = wall->size.x;
+    sz = wall->size.z;
     entity_set_flag(entity, ENTITY_FLAG_HIT_WALL, true);
     ex = entity->prev_position.x;
     ez = entity->prev_position.z;
@@ -39,14 +206,7 @@ void collide_entity_tile(Entity* entity, Tile* tile)
 {
     if (tile->collide == NULL)
         return;
-
-    f32 ex, ez, tx, tz, sx, sz;
-    ex = entity->position.x;
-    ez = entity->position.y;
-    tx = tile->position.x;
-    tz = tile->position.y;
-    sx = sz = 1.0f;
-    if (!(ex >= tx && ex < tx + sx && ez >= tz && ez < tz + sz))
+    if (!overlap_entity_tile(entity, tile->position.x, tile->position.y))
         return;
     tile->collide(entity);
 }
@@ -55,6 +215,8 @@ void collide_entity_obstacle(Entity* entity, Obstacle* obstacle)
 {
     f32 ex, ez, er, ox, oz, or;
     vec2 dir;
+    if (!overlap_entity_obstacle(entity, obstacle))
+        return;
     ex = entity->position.x;
     ez = entity->position.y;
     er = entity->size / 2;
@@ -62,8 +224,6 @@ void collide_entity_obstacle(Entity* entity, Obstacle* obstacle)
     oz = obstacle->position.y;
     or = obstacle->size / 2;
     dir = vec2_create(ex - ox, ez - oz);
-    if (vec2_mag(dir) >= er + or)
-        return;
     dir = vec2_scale(vec2_normalize(dir), er + or);
     entity->position.x = ox + dir.x;
     entity->position.y = oz + dir.y;
@@ -71,7 +231,7 @@ void collide_entity_obstacle(Entity* entity, Obstacle* obstacle)
 
 void collide_entity_projectile(Entity* entity, Projectile* projectile)
 {
-    if (projectile->lifetime <= 0)
+    if (projectile_lifetime(projectile) <= 0)
         return;
 
     bool is_entity_invulnerable = entity_get_flag(entity, ENTITY_FLAG_INVULNERABLE);
@@ -82,32 +242,23 @@ void collide_entity_projectile(Entity* entity, Projectile* projectile)
         return;
     if (is_entity_invulnerable)
         return;
-    if (is_projectile_pierce && projectile->pierce_timer >= 0)
+    if (is_projectile_pierce && projectile_pierce_timer(projectile) >= 0)
         return;
-
-    f32 ex, ez, er, px, pz, pr;
-    vec2 offset;
-    ex = entity->position.x;
-    ez = entity->position.y;
-    er = entity->hitbox_radius;
-    px = projectile->position.x;
-    pz = projectile->position.y;
-    pr = projectile->size / 2;
-    offset = vec2_create(ex - px, ez - pz);
-    if (vec2_mag(offset) >= er + pr)
+    f32 t = sweep_entity_projectile(entity, projectile);
+    if (t < 0)
         return;
 
     entity_damage(entity, 1);
     if (is_projectile_pierce)
-        projectile->pierce_timer = PROJ_PIERCE_COOLDOWN;
-    else
-        projectile->lifetime = 0;
+        projectile_set_pierce_timer(projectile, PROJ_PIERCE_COOLDOWN);
+    else {
+        projectile_set_lifetime(projectile, 0);
+        stop_projectile(projectile, t);
+    }
 }
 
 void collide_entity_trigger(Entity* entity, Trigger* trigger)
 {
-    f32 ex, ez, er, tx, tz, tr;
-    vec2 offset;
     i32 i;
     bool delete = trigger_get_flag(trigger, TRIGGER_FLAG_DELETE);
     bool once = trigger_get_flag(trigger, TRIGGER_FLAG_ONCE);
@@ -116,14 +267,7 @@ void collide_entity_trigger(Entity* entity, Trigger* trigger)
         return;
     if (!entity_get_flag(entity, ENTITY_FLAG_PLAYER) && trigger_get_flag(trigger, TRIGGER_FLAG_PLAYER))
         return;
-    ex = entity->position.x;
-    ez = entity->position.y;
-    er = entity->hitbox_radius;
-    tx = trigger->position.x;
-    tz = trigger->position.y;
-    tr = trigger->radius;
-    offset = vec2_create(ex - tx, ez - tz);
-    if (vec2_mag(offset) >= er + tr)
+    if (!overlap_entity_trigger(entity, trigger))
         return;
     trigger_set_flag(trigger, TRIGGER_FLAG_USED, true);
     for (i = 0; i < trigger->bitset->length; i++) {
@@ -139,48 +283,27 @@ void collide_entity_trigger(Entity* entity, Trigger* trigger)
 
 void collide_entity_aoe(Entity* entity, AOE* aoe)
 {
-    f32 ex, ez, er, ax, az, ar;
-    vec2 offset;
-    ex = entity->position.x;
-    ez = entity->position.y;
-    er = entity->hitbox_radius;
-    ax = aoe->position.x;
-    az = aoe->position.y;
-    ar = aoe->radius;
-    offset = vec2_create(ex - ax, ez - az);
-    if (vec2_mag(offset) >= er + ar)
+    if (!overlap_entity_aoe(entity, aoe))
         return;
     entity_damage(entity, aoe->damage);
 }
 
+// the projectile stays alive until the next update so entities
+// between its previous position and the wall are still hit
 void collide_projectile_wall(Projectile* projectile, Wall* wall)
 {
-    f32 px, pz, pr, wx, wz, sx, sz;
-    px = projectile->position.x;
-    pz = projectile->position.y;
-    pr = projectile->size / 2;
-    wx = wall->position.x;
-    wz = wall->position.y;
-    sx = wall->size.x;
-    sz = wall->size.y;
-    if (!(px + pr > wx && px - pr < wx + sx
-       && pz + pr > wz && pz - pr < wz + sz))
+    f32 t = sweep_projectile_wall(projectile, wall);
+    if (t < 0)
         return;
-    projectile->lifetime = 0;
+    projectile_set_flag(projectile, PROJECTILE_FLAG_HIT_WALL, true);
+    stop_projectile(projectile, t);
 }
 
 void collide_projectile_obstacle(Projectile* projectile, Obstacle* obstacle)
 {
-    f32 px, pz, pr, ox, oz, or;
-    vec2 dir;
-    px = projectile->position.x;
-    pz = projectile->position.y;
-    pr = projectile->size / 2;
-    ox = obstacle->position.x;
-    oz = obstacle->position.y;
-    or = obstacle->size / 2;
-    dir = vec2_create(px - ox, pz - oz);
-    if (vec2_mag(dir) >= pr + or)
+    f32 t = sweep_projectile_obstacle(projectile, obstacle);
+    if (t < 0)
         return;
-    projectile->lifetime = 0;
+    projectile_set_lifetime(projectile, 0);
+    stop_projectile(projectile, t);
 }
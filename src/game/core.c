@@ -1,7 +1,9 @@
 #include "../game.h"
 #include "../renderer.h"
 #include "../event.h"
+#include "../state.h"
 #include <string.h>
+#include <math.h>
 
 GameContext game_context;
 
@@ -11,25 +13,71 @@ void handle_callback(void)
         gui_cursor_pos_callback(window_context.cursor.x, window_context.cursor.y);
 }
 
+// advance the simulation by one fixed timestep
+static void game_step(f32 dt)
+{
+    game_context.time += dt;
+#ifdef SERVER_BUILD
+    // dedicated servers have no local input or camera, player_update
+    // on the host runs state, stats and inventories for every client
+    if (game_context.current_map != NULL) {
+        if (!game_context.paused)
+            map_update(game_context.current_map, dt);
+        player_update(&game_context.this_client->player, dt);
+    }
+#else
+    game_process_input(dt);
+    if (game_context.current_map != NULL) {
+        if (!game_context.paused)
+            map_update(game_context.current_map, dt);
+        client_update(game_context.this_client, dt);
+    }
+#endif
+}
+
+// the rates asked for with game_set_tps and game_set_frame_rate,
+// only called on the game thread between frames
+static void apply_requested_rates(void)
+{
+    i32 tps = atomic_exchange(&game_context.requested_tps, 0);
+    i32 frame_rate = atomic_exchange(&game_context.requested_frame_rate, 0);
+    if (tps != 0) {
+        game_context.tps = tps;
+        game_context.timestep = 1.0 / tps;
+    }
+    if (frame_rate != 0) {
+        pacer_set_tps(&game_context.pacer, frame_rate);
+        pacer_reset_stats(&game_context.pacer);
+        game_context.frame_rate = game_context.pacer.tps;
+    }
+}
+
 void* game_loop(void* vargp)
 {
     Client* client;
-    f64 start, end;
-    f64 real_start;
-    f32 dt;
+    f64 real_start, prev_start;
+    f32 frame_dt;
+    i32 num_steps;
     pthread_mutex_t* init_mutex = vargp;
     thread_link("Game");
     game_reset_uids();
-    end = start = get_time();
     game_context.time = 0;
-    game_context.tps = 144;
-    game_context.timestep = 1.0 / game_context.tps;
+    game_context.accumulator = 0;
+    pacer_init(&game_context.pacer, GAME_DEFAULT_FRAME_RATE);
+    game_set_tps(config_get_setting_int(state_context.config, "tps", GAME_DEFAULT_TPS));
+    game_set_frame_rate(config_get_setting_int(state_context.config, "frame_rate", GAME_DEFAULT_FRAME_RATE));
+    apply_requested_rates();
     game_context.clients = list_create();
     game_context.updated_uids = list_i32_create();
-    game_context.net_timestep = 1.0 / 30.0;
+    game_context.net_timestep = 1.0 / maxi(config_get_setting_int(state_context.config, "snapshot_rate", GAME_DEFAULT_SNAPSHOT_RATE), 1);
     client = client_create();
     client_set_username(client, string_copy("fancy"));
     game_context.this_client = client;
+#ifdef SERVER_BUILD
+    // the server only owns the listen sockets, it should not
+    // get a player entity when maps are created
+    list_remove(game_context.clients, list_search(game_context.clients, client));
+#endif
 
     map_init();
     item_init();
@@ -37,38 +85,61 @@ void* game_loop(void* vargp)
     particle_init();
     parjicle_init();
     synergy_init();
+    snapshot_init();
+#ifndef SERVER_BUILD
     gui_comp_init();
+    game_context.singleplayer = true;
+#endif
 
     pthread_mutex_unlock(init_mutex);
+#ifndef SERVER_BUILD
     gui_preset_load(GUI_PRESET_MP);
     //gui_preset_load(GUI_PRESET_GAME);
     game_resume_render();
     //map_create(map_get_id("outpost1"));
-    game_context.singleplayer = true;
+#endif
+    pacer_resync(&game_context.pacer);
+    prev_start = pacer_now();
     while (!game_context.kill_thread)
     {
-        while (end - start < game_context.timestep)
-            end = get_time();
-        dt = game_context.timestep;
-        game_context.time += dt;
-        start = end;
-        real_start = get_time();
+        apply_requested_rates();
+        real_start = pacer_wait(&game_context.pacer);
+        frame_dt = real_start - prev_start;
+        prev_start = real_start;
         pthread_mutex_lock(&game_context.handler_thread_mutex);
+#ifndef SERVER_BUILD
         handle_callback();
         event_queue_flush();
-        gui_update_comps(dt);
-        game_process_input(dt);
-        if (game_context.current_map != NULL) {
-            if (!game_context.paused)
-                map_update(game_context.current_map, dt);
-            client_update(game_context.this_client, dt);
-            game_update_vertex_data();
+        gui_update_comps(frame_dt);
+#endif
+
+        // run as many fixed steps as real time allows. if the game
+        // falls too far behind (map loads, breakpoints), drop the
+        // remaining steps instead of spiraling
+        game_context.accumulator += frame_dt;
+        num_steps = 0;
+        while (game_context.accumulator >= game_context.timestep && num_steps < GAME_MAX_SUBSTEPS) {
+            game_step(game_context.timestep);
+            game_context.accumulator -= game_context.timestep;
+            num_steps++;
+        }
+        if (game_context.accumulator >= game_context.timestep) {
+            game_context.dropped_steps += (i32)(game_context.accumulator / game_context.timestep);
+            game_context.accumulator = fmod(game_context.accumulator, game_context.timestep);
         }
+        game_context.alpha = game_context.accumulator / game_context.timestep;
+
+#ifndef SERVER_BUILD
+        if (game_context.current_map != NULL)
+            game_update_vertex_data(game_context.alpha);
+#endif
         pthread_mutex_unlock(&game_context.handler_thread_mutex);
-        game_context.real_dt = get_time() - real_start;
+        game_context.real_dt = pacer_now() - real_start;
     }
     log_write(DEBUG, "clients list: %d", game_context.clients->length);
+#ifndef SERVER_BUILD
     gui_comp_cleanup();
+#endif
     map_cleanup();
     item_cleanup();
     synergy_cleanup();
@@ -76,6 +147,7 @@ void* game_loop(void* vargp)
     particle_cleanup();
     parjicle_cleanup();
     game_net_cleanup();
+    snapshot_cleanup();
     client_destroy(game_context.this_client);
     list_destroy(game_context.clients);
     list_i32_destroy(game_context.updated_uids);
@@ -155,6 +227,29 @@ void game_resume_render(void)
     game_context.halt_render = false;
 }
 
+static i32 clamp_rate(i32 rate)
+{
+    if (rate < PACER_MIN_TPS)
+        return PACER_MIN_TPS;
+    if (rate > PACER_MAX_TPS)
+        return PACER_MAX_TPS;
+    return rate;
+}
+
+i32 game_set_tps(i32 tps)
+{
+    tps = clamp_rate(tps);
+    atomic_store(&game_context.requested_tps, tps);
+    return tps;
+}
+
+i32 game_set_frame_rate(i32 frame_rate)
+{
+    frame_rate = clamp_rate(frame_rate);
+    atomic_store(&game_context.requested_frame_rate, frame_rate);
+    return frame_rate;
+}
+
 void game_pause(void)
 {
     game_context.paused = true;
@@ -171,8 +266,10 @@ void game_init(void)
     pthread_mutex_init(&init_mutex, NULL);
 
     game_halt_render();
+#ifndef SERVER_BUILD
     game_render_init();
     gui_render_init();
+#endif
     pthread_mutex_lock(&init_mutex);
     pthread_create(&game_context.thread_id, NULL, game_loop, &init_mutex);
     pthread_mutex_lock(&init_mutex);
@@ -185,8 +282,10 @@ void game_cleanup(void)
     game_context.halt_input = false;
     pthread_join(game_context.thread_id, NULL);
     pthread_mutex_destroy(&game_context.getter_mutex);
+#ifndef SERVER_BUILD
     game_render_cleanup();
     gui_render_cleanup();
+#endif
 }
 
 void game_summon(i32 id)
@@ -225,3 +324,26 @@ size_t game_object_write(GameObj type, void* obj, char* buffer)
     //log_write(WARNING, "writing unrecognized object %d", type);
     return 0;
 }
+
+size_t game_object_sizeof(GameObj type)
+{
+    switch (type) {
+        case GAME_OBJ_ENTITY:
+            return entity_sizeof();
+        case GAME_OBJ_PROJECTILE:
+            return projectile_sizeof();
+        case GAME_OBJ_OBSTACLE:
+            return obstacle_sizeof();
+        case GAME_OBJ_PARSTACLE:
+            return parstacle_sizeof();
+        case GAME_OBJ_TILE:
+            return tile_sizeof();
+        case GAME_OBJ_WALL:
+            return wall_sizeof();
+        case GAME_OBJ_ITEM:
+            return sizeof(Item);
+        default:
+            break;
+    }
+    return 0;
+}
@@ -357,9 +357,9 @@ void entity_init(void)
     load_entity_info();
 }
 
-Entity* entity_create(vec2 position, i32 id)
+Entity* entity_create(Slab* slab, vec2 position, i32 id)
 {
-    Entity* entity = st_calloc(1, sizeof(Entity));
+    Entity* entity = slab_alloc(slab);
     entity->map_info = (MapInfo) {0};
     entity->position = position;
     entity->prev_position = position;
@@ -501,7 +501,7 @@ i32 entity_get_texture(Entity* entity)
     return state.frames[num_frames * dir + entity->frame];
 }
 
-void entity_destroy(Entity* entity)
+void entity_destroy(Slab* slab, Entity* entity)
 {
     EntityDestroyFuncPtr destroy = entity_context.infos[entity->id].destroy;
     game_free_uid(entity->uid);
@@ -511,7 +511,7 @@ void entity_destroy(Entity* entity)
         st_free(entity->data);
     if (entity->player != NULL)
         entity->player->entity = NULL;
-    st_free(entity);
+    slab_free(slab, entity);
 }
 
 void entity_cleanup(void)
@@ -33,26 +33,40 @@ void host_swap_items(Packet* packet)
     inventory_sync(client);
 }
 
-void host_create_game_obj(i32 uid)
+// returns the size of the object, 0 for types that are not sent
+static size_t create_game_obj_packet(Packet* packet, char* packet_buffer, i32 uid)
 {
-    Packet packet;
     GameObj type;
-    static char packet_buffer[UDP_MAX_PAYLOAD];
-    packet.buffer = packet_buffer + PACKET_HEADER_BYTES;
+    packet->buffer = packet_buffer + PACKET_HEADER_BYTES;
 
-    packet.id = PACKET_CREATE_GAME_OBJ;
+    packet->id = PACKET_CREATE_GAME_OBJ;
     type = game_context.uid_map_type[uid];
 
-    memcpy(packet.buffer, &type, sizeof(type));
-    size_t size = game_object_write(type, game_context.uid_map[uid], packet.buffer + sizeof(type));
+    memcpy(packet->buffer, &type, sizeof(type));
+    size_t size = game_object_write(type, game_context.uid_map[uid], packet->buffer + sizeof(type));
 
-    packet.length = size + sizeof(type);
+    packet->length = size + sizeof(type);
 
-    memcpy(packet_buffer, &packet.length, sizeof(packet.length));
-    memcpy(packet_buffer + sizeof(packet.length), &packet.id, sizeof(packet.id));
+    memcpy(packet_buffer, &packet->length, sizeof(packet->length));
+    memcpy(packet_buffer + sizeof(packet->length), &packet->id, sizeof(packet->id));
+
+    return size;
+}
 
+void host_create_game_obj(i32 uid)
+{
+    Packet packet;
+    static char packet_buffer[UDP_MAX_PAYLOAD];
+    create_game_obj_packet(&packet, packet_buffer, uid);
     game_net_send_tcp_packet_to_clients(&packet);
-    
+}
+
+void host_send_game_obj(Client* client, i32 uid)
+{
+    Packet packet;
+    static char packet_buffer[UDP_MAX_PAYLOAD];
+    if (create_game_obj_packet(&packet, packet_buffer, uid) > 0)
+        game_net_send_packet_tcp(client, &packet);
 }
 
 void host_destroy_game_obj(i32 uid)
@@ -672,6 +672,9 @@ static void roomset_destroy(Roomset* roomset)
         for (j = 0; j < list->length; j++)
             st_free(list_get(list, j));
         list_destroy(list);
+        for (j = 0; j < ROOM_NUM_ORIENTATIONS; j++)
+            if (roomset->rooms[i].stamps[j] != NULL)
+                quadmask_destroy(roomset->rooms[i].stamps[j]);
     }
     st_free(roomset->rooms);
     st_free(roomset->pixels);
@@ -703,7 +706,7 @@ typedef enum {
     ROTATION_MR1,
     ROTATION_MR2,
     ROTATION_MR3,
-    NUM_ORIENTATIONS
+    NUM_ORIENTATIONS = ROOM_NUM_ORIENTATIONS
 } Orientation;
 
 static i32 calculate_room_dx(Room* room, Orientation orientation, i32 u, i32 v)
@@ -902,33 +905,66 @@ static i32 calculate_alternate_dz(Room* room, Alternate* alternate, i32 orientat
     return calculate_room_dz(room, orientation, ru, rv);
 }
 
-static bool can_preload_room(PreloadArgs* args)
+static Quadmask* create_room_stamp(Roomset* roomset, Room* room, Orientation orientation)
 {
-    Quadmask* qm = args->qm;
-    Roomset* roomset = args->roomset;
-    Room* room = args->room;
-    i32 origin_x = args->origin_x;
-    i32 origin_z = args->origin_z;
-    i32 orientation = args->orientation;
-    u32 color;
-    i32 u, v, dx, dz, map_x, map_z;
+    Quadmask* stamp;
+    i32 u, v, dx, dz;
+    i32 x1 = INT32_MAX, z1 = INT32_MAX;
+    i32 x2 = INT32_MIN, z2 = INT32_MIN;
     for (v = room->v1; v <= room->v2; v++) {
         for (u = room->u1; u <= room->u2; u++) {
             dx = calculate_room_dx(room, orientation, u, v);
             dz = calculate_room_dz(room, orientation, u, v);
-            color = roomset_get_color(roomset, u, v);
-            map_x = origin_x + dx;
-            map_z = origin_z + dz;
-            if (!quadmask_in_bounds(qm, map_x, map_z))
-                return false;
-            if (color_is_preset(color))
-                continue;
-            if (!quadmask_isset(qm, map_x, map_z))
+            x1 = mini(x1, dx);
+            x2 = maxi(x2, dx);
+            z1 = mini(z1, dz);
+            z2 = maxi(z2, dz);
+        }
+    }
+    // the stamp covers every pixel of the room so the
+    // bounds check of the whole room is a check of its corners
+    stamp = quadmask_create(x2 - x1 + 1, z2 - z1 + 1);
+    for (v = room->v1; v <= room->v2; v++) {
+        for (u = room->u1; u <= room->u2; u++) {
+            if (color_is_preset(roomset_get_color(roomset, u, v)))
                 continue;
-            return false;
+            dx = calculate_room_dx(room, orientation, u, v);
+            dz = calculate_room_dz(room, orientation, u, v);
+            quadmask_set(stamp, dx - x1, dz - z1);
         }
     }
-    return true;
+    room->stamp_dx[orientation] = x1;
+    room->stamp_dz[orientation] = z1;
+    return stamp;
+}
+
+static void create_room_stamps(Roomset* roomset)
+{
+    Room* room;
+    i32 i, orientation;
+    for (i = 0; i < roomset->num_rooms; i++) {
+        room = &roomset->rooms[i];
+        for (orientation = 0; orientation < NUM_ORIENTATIONS; orientation++) {
+            room->stamps[orientation] = NULL;
+            if (orientation == 0 || room->rotate)
+                room->stamps[orientation] = create_room_stamp(roomset, room, orientation);
+        }
+    }
+}
+
+static bool can_preload_room(PreloadArgs* args)
+{
+    Quadmask* qm = args->qm;
+    Room* room = args->room;
+    i32 orientation = args->orientation;
+    Quadmask* stamp = room->stamps[orientation];
+    i32 x = args->origin_x + room->stamp_dx[orientation];
+    i32 z = args->origin_z + room->stamp_dz[orientation];
+    if (!quadmask_in_bounds(qm, x, z))
+        return false;
+    if (!quadmask_in_bounds(qm, x + stamp->width - 1, z + stamp->length - 1))
+        return false;
+    return !quadmask_any_in_stamp(qm, stamp, x, z);
 }
 
 static bool can_preload_room_alternate(PreloadArgs* args)
@@ -967,26 +1003,11 @@ static bool can_preload_room_alternate(PreloadArgs* args)
 
 static void preload_room(PreloadArgs* args)
 {
-    Quadmask* qm = args->qm;
-    Roomset* roomset = args->roomset;
     Room* room = args->room;
-    i32 origin_x = args->origin_x;
-    i32 origin_z = args->origin_z;
     i32 orientation = args->orientation;
-    u32 color;
-    i32 u, v, dx, dz, map_x, map_z;
-    for (v = room->v1; v <= room->v2; v++) {
-        for (u = room->u1; u <= room->u2; u++) {
-            dx = calculate_room_dx(room, orientation, u, v);
-            dz = calculate_room_dz(room, orientation, u, v);
-            color = roomset_get_color(roomset, u, v);
-            map_x = origin_x + dx;
-            map_z = origin_z + dz;
-            if (color_is_preset(color))
-                continue;
-            quadmask_set(qm, map_x, map_z);
-        }
-    }
+    quadmask_set_stamp(args->qm, room->stamps[orientation],
+                       args->origin_x + room->stamp_dx[orientation],
+                       args->origin_z + room->stamp_dz[orientation]);
 }
 
 static Quadmask* preload_room_alternate(PreloadArgs* args)
@@ -1022,26 +1043,11 @@ static Quadmask* preload_room_alternate(PreloadArgs* args)
 
 static void unpreload_room(PreloadArgs* args)
 {
-    Quadmask* qm = args->qm;
-    Roomset* roomset = args->roomset;
     Room* room = args->room;
-    i32 origin_x = args->origin_x;
-    i32 origin_z = args->origin_z;
     i32 orientation = args->orientation;
-    u32 color;
-    i32 u, v, dx, dz, map_x, map_z;
-    for (v = room->v1; v <= room->v2; v++) {
-        for (u = room->u1; u <= room->u2; u++) {
-            dx = calculate_room_dx(room, orientation, u, v);
-            dz = calculate_room_dz(room, orientation, u, v);
-            color = roomset_get_color(roomset, u, v);
-            map_x = origin_x + dx;
-            map_z = origin_z + dz;
-            if (color_is_preset(color))
-                continue;
-            quadmask_unset(qm, map_x, map_z);
-        }
-    }
+    quadmask_clear_stamp(args->qm, room->stamps[orientation],
+                         args->origin_x + room->stamp_dx[orientation],
+                         args->origin_z + room->stamp_dz[orientation]);
 }
 
 static void unpreload_room_alternate(PreloadArgs* args, Quadmask* alt_qm)
@@ -1114,10 +1120,66 @@ static void map_node_detach(MapNode* parent, MapNode* child)
     }
 }
 
+// stamp cells a batch of placements has to cover before it is worth
+// handing to the job system. a check runs at about 0.3 ns per cell and
+// a job_parallel_for costs about 12 us, so below this the workers only
+// add the wake up. no room in the shipped maps gets close
+#define PLACEMENT_PARALLEL_CELLS 65536
+
+typedef enum {
+    PLACEMENT_UNKNOWN,
+    PLACEMENT_VALID,
+    PLACEMENT_INVALID
+} PlacementState;
+
+typedef struct {
+    PreloadArgs args;
+    PlacementState state;
+} Placement;
+
+static bool can_place(PreloadArgs* args)
+{
+    return can_preload_room(args) && can_preload_room_alternate(args);
+}
+
+static void check_placement_range(void* arg, i32 start, i32 end)
+{
+    Placement* placements = arg;
+    for (i32 i = start; i < end; i++)
+        placements[i].state = can_place(&placements[i].args) ? PLACEMENT_VALID : PLACEMENT_INVALID;
+}
+
+// placements of a batch only read the mask, so a big enough batch is
+// checked up front by the workers against the same mask. the search
+// still tries them in order, which generates the same map as checking
+// them one at a time. otherwise they are checked when the search gets
+// to them
+static void check_placements(Placement* placements, i32 n)
+{
+    Quadmask* stamp;
+    i64 cells = 0;
+    i32 i;
+    for (i = 0; i < n; i++) {
+        placements[i].state = PLACEMENT_UNKNOWN;
+        stamp = placements[i].args.room->stamps[placements[i].args.orientation];
+        cells += (i64)stamp->width * stamp->length;
+    }
+    if (job_num_workers() > 0 && n > 1 && cells >= PLACEMENT_PARALLEL_CELLS)
+        job_parallel_for(check_placement_range, placements, n, 1);
+}
+
+static bool placement_is_valid(Placement* placement)
+{
+    if (placement->state == PLACEMENT_UNKNOWN)
+        placement->state = can_place(&placement->args) ? PLACEMENT_VALID : PLACEMENT_INVALID;
+    return placement->state == PLACEMENT_VALID;
+}
+
 // returns true if successfully generated a room, false otherwise
 static bool pregenerate_map_helper(GlobalMapGenerationSettings* global_settings, LocalMapGenerationSettings local_settings, MapNode* parent)
 {
     PreloadArgs args;
+    Placement placements[NUM_ORIENTATIONS];
     Quadmask* qm = global_settings->qm;
     Quadmask* fem_qm = NULL;
     Quadmask* male_qm = NULL;
@@ -1137,6 +1199,7 @@ static bool pregenerate_map_helper(GlobalMapGenerationSettings* global_settings,
     i32 orientation;
     i32 origin_x, origin_z;
     i32 room_idx, fem_idx, male_idx;
+    i32 num_placements, placement_idx;
     i32 u, v, dx, dz;
     i32 list_idx;
 
@@ -1152,33 +1215,46 @@ static bool pregenerate_map_helper(GlobalMapGenerationSettings* global_settings,
     local_settings.num_rooms_loaded = 0;
 
     rooms = roomset_get_rooms(roomset, current_room_type);
-    list_shuffle(rooms);
+    list_shuffle(rooms, local_settings.rng);
     for (room_idx = 0; room_idx < rooms->length; room_idx++) {
         room = list_get(rooms, room_idx);
         args.room = room;
         female_alternates = list_copy(room->female_alternates);
-        list_shuffle(female_alternates);
-        for (fem_idx = 0; fem_idx < female_alternates->length; fem_idx++) {
-            female_alternate = list_get(female_alternates, fem_idx);
-            args.alternate = female_alternate;
-            initial_orientation = (room->rotate) ? rand() % NUM_ORIENTATIONS : 0;
-            for (orientation_iter = 0; orientation_iter < NUM_ORIENTATIONS; orientation_iter++) {
-                if (!room->rotate && orientation_iter != 0)
-                    break;
-                orientation = (initial_orientation + orientation_iter) % NUM_ORIENTATIONS;
-                u = female_alternate->loc_u;
-                v = female_alternate->loc_v;
-                dx = calculate_room_dx(room, orientation, u, v);
-                dz = calculate_room_dz(room, orientation, u, v);
-                origin_x = male_x - dx;
-                origin_z = male_z - dz;
-                args.origin_x = origin_x;
-                args.origin_z = origin_z;
-                args.orientation = orientation;
-                if (!can_preload_room(&args))
-                    continue;
-                if (!can_preload_room_alternate(&args))
+        list_shuffle(female_alternates, local_settings.rng);
+        fem_idx = 0;
+        while (fem_idx < female_alternates->length) {
+            // a batch is every orientation of one female alternate, or a few
+            // female alternates of a room that does not rotate. batching more
+            // would draw the orientations in a different order
+            num_placements = 0;
+            do {
+                female_alternate = list_get(female_alternates, fem_idx++);
+                initial_orientation = (room->rotate) ? rng_range(local_settings.rng, 0, NUM_ORIENTATIONS - 1) : 0;
+                for (orientation_iter = 0; orientation_iter < NUM_ORIENTATIONS; orientation_iter++) {
+                    if (!room->rotate && orientation_iter != 0)
+                        break;
+                    orientation = (initial_orientation + orientation_iter) % NUM_ORIENTATIONS;
+                    u = female_alternate->loc_u;
+                    v = female_alternate->loc_v;
+                    dx = calculate_room_dx(room, orientation, u, v);
+                    dz = calculate_room_dz(room, orientation, u, v);
+                    placements[num_placements].args = args;
+                    placements[num_placements].args.alternate = female_alternate;
+                    placements[num_placements].args.origin_x = male_x - dx;
+                    placements[num_placements].args.origin_z = male_z - dz;
+                    placements[num_placements].args.orientation = orientation;
+                    num_placements++;
+                }
+            } while (!room->rotate && fem_idx < female_alternates->length && num_placements < NUM_ORIENTATIONS);
+            check_placements(placements, num_placements);
+            for (placement_idx = 0; placement_idx < num_placements; placement_idx++) {
+                if (!placement_is_valid(&placements[placement_idx]))
                     continue;
+                args = placements[placement_idx].args;
+                female_alternate = args.alternate;
+                origin_x = args.origin_x;
+                origin_z = args.origin_z;
+                orientation = args.orientation;
                 preload_room(&args);
                 fem_qm = preload_room_alternate(&args);
                 local_settings.num_rooms_left--;
@@ -1194,7 +1270,7 @@ static bool pregenerate_map_helper(GlobalMapGenerationSettings* global_settings,
                 male_alternates = list_copy(room->male_alternates);
                 if (local_settings.create_no_path)
                     goto no_path;
-                list_shuffle(male_alternates);
+                list_shuffle(male_alternates, local_settings.rng);
                 for (male_idx = 0; male_idx < male_alternates->length; male_idx++) {
                     male_alternate = list_get(male_alternates, male_idx);
                     args.alternate = male_alternate;
@@ -1239,6 +1315,9 @@ no_path:
                 quadmask_destroy(fem_qm);
                 fem_qm = NULL;
                 unpreload_room(&args);
+                // rooms kept by a branch are not unloaded when backtracking,
+                // so the rest of the batch is checked again
+                check_placements(placements + placement_idx + 1, num_placements - placement_idx - 1);
             }
         }
         list_destroy(female_alternates);
@@ -1269,18 +1348,92 @@ typedef struct {
     i32 orientation;
 } LoadArgs;
 
+// chunk holding (x, z), allocated first if create is set. NULL out
+// of bounds or where nothing was placed yet
+static MapChunk* get_chunk(Map* map, i32 x, i32 z, bool create)
+{
+    MapChunk** chunk;
+    if (x < 0 || x >= map->width || z < 0 || z >= map->length)
+        return NULL;
+    chunk = &map->chunks[(z >> MAP_CHUNK_SHIFT) * MAP_CHUNKS_WIDE + (x >> MAP_CHUNK_SHIFT)];
+    if (*chunk == NULL && create) {
+        *chunk = st_calloc(1, sizeof(MapChunk));
+        map->num_chunks++;
+    }
+    return *chunk;
+}
+
+static i32 chunk_idx(i32 x, i32 z)
+{
+    return ((z & (MAP_CHUNK_WIDTH - 1)) << MAP_CHUNK_SHIFT) | (x & (MAP_CHUNK_WIDTH - 1));
+}
+
+static bool chunk_mask_isset(u32* mask, i32 x, i32 z)
+{
+    return (mask[z & (MAP_CHUNK_WIDTH - 1)] >> (x & (MAP_CHUNK_WIDTH - 1))) & 1;
+}
+
+static void chunk_mask_set(u32* mask, i32 x, i32 z, bool val)
+{
+    u32 bit = 1u << (x & (MAP_CHUNK_WIDTH - 1));
+    if (val)
+        mask[z & (MAP_CHUNK_WIDTH - 1)] |= bit;
+    else
+        mask[z & (MAP_CHUNK_WIDTH - 1)] &= ~bit;
+}
+
+static void destroy_chunks(Map* map)
+{
+    for (i32 i = 0; i < MAP_CHUNKS_WIDE * MAP_CHUNKS_LONG; i++)
+        st_free(map->chunks[i]);
+    memset(map->chunks, 0, sizeof(map->chunks));
+    map->num_chunks = 0;
+}
+
+static u8 tile_collide_id(Map* map, TileCollideFuncPtr collide)
+{
+    i32 id;
+    if (collide == NULL)
+        return 0;
+    // slot 0 stays NULL for tiles without a collide function
+    if (map->num_tile_collide_funcs == 0)
+        map->num_tile_collide_funcs = 1;
+    for (id = 1; id < map->num_tile_collide_funcs; id++)
+        if (map->tile_collide_funcs[id] == collide)
+            return id;
+    log_assert(id < MAP_MAX_TILE_COLLIDE_FUNCS, "Too many tile collide functions");
+    map->tile_collide_funcs[map->num_tile_collide_funcs++] = collide;
+    return id;
+}
+
+// keeps collide_mask and tile_collide in sync with the tiles
+static void update_collide_cell(Map* map, MapChunk* chunk, i32 x, i32 z)
+{
+    i32 idx = chunk_idx(x, z);
+    bool wall = chunk_mask_isset(chunk->wall_mask, x, z);
+    Tile* tile = chunk->tiles[idx];
+    u8 id = 0;
+    if (!wall && tile != NULL)
+        id = tile_collide_id(map, tile->collide);
+    chunk->tile_collide[idx] = id;
+    chunk_mask_set(chunk->collide_mask, x, z, wall || id != 0);
+}
+
 static void place_tile(Map* map, TileColor* tile_color, i32 x, i32 z)
 {
     Tile* tile = NULL;
     Wall* wall = NULL;
+    MapChunk* chunk = get_chunk(map, x, z, true);
     vec2 position = vec2_create(x, z);
+    if (chunk == NULL)
+        return;
     if (tile_color->is_wall) {
         wall = wall_create(position, tile_color->height, tile_color->color);
         list_append(map->walls, wall);
         wall->side_tex = tile_color->side_tex;
         wall->top_tex = tile_color->top_tex;
-        quadmask_set(map->tile_mask, x, z);
-        map->tilemap[z * map->width + x] = wall;
+        chunk_mask_set(chunk->wall_mask, x, z, true);
+        chunk->tiles[chunk_idx(x, z)] = wall;
     } else {
         tile = tile_create(position, tile_color->color);
         list_append(map->tiles, tile);
@@ -1288,13 +1441,9 @@ static void place_tile(Map* map, TileColor* tile_color, i32 x, i32 z)
         tile->collide = tile_color->collide;
         if (tile_color->create != NULL)
             tile_color->create(tile);
-        map->tilemap[z * map->width + x] = tile;
+        chunk->tiles[chunk_idx(x, z)] = tile;
     }
-}
-
-static void set_map_node(Map* map, MapNode* node, i32 map_x, i32 map_z)
-{
-    map->map_nodes[map_z * MAP_MAX_WIDTH + map_x] = node;
+    update_collide_cell(map, chunk, x, z);
 }
 
 static void load_room(LoadArgs* args)
@@ -1330,7 +1479,7 @@ static void load_room(LoadArgs* args)
             if (tile_color == NULL)
                 continue;
             quadmask_set(qm, map_x, map_z);
-            set_map_node(map, node, map_x, map_z);
+            map_set_node(map, map_x, map_z, node);
             place_tile(map, tile_color, map_x, map_z);
         }
     }
@@ -1371,7 +1520,7 @@ static void load_room_alternate(LoadArgs* args)
             if (tile_color == NULL)
                 continue;
             quadmask_set(qm, map_x, map_z);
-            set_map_node(map, node, map_x, map_z);
+            map_set_node(map, map_x, map_z, node);
             place_tile(map, tile_color, map_x, map_z);
         }
     }
@@ -1402,7 +1551,7 @@ static void load_room_alternate_default(LoadArgs* args)
     if (tile_color == NULL)
         return;
     quadmask_set(qm, map_x, map_z);
-    set_map_node(map, node, map_x, map_z);
+    map_set_node(map, map_x, map_z, node);
     place_tile(map, tile_color, map_x, map_z);
 }
 
@@ -1511,9 +1660,15 @@ static Map* generate_map(i32 id)
     path = json_value_get_string(value);
     palette = palette_create(object);
     roomset = roomset_create(object, path, palette);
+    create_room_stamps(roomset);
+
+    // a seed set from the console takes effect here, on the game thread
+    rng_apply_requested_seed();
+    rng_seed(&map->rng, rng_u64(rng_stream(RNG_STREAM_MAP)), id);
 
     global_settings.qm = qm;
     global_settings.roomset = roomset;
+    local_settings.rng = &map->rng;
     //global_settings.num_branches = 0;
     local_settings.current_branch = "main";
     local_settings.current_room_type = "spawn";
@@ -1529,10 +1684,10 @@ static Map* generate_map(i32 id)
     map->width = MAP_MAX_WIDTH;
     map->length = MAP_MAX_LENGTH;
     map->roomset = roomset;
-    map->tile_mask = quadmask_create(MAP_MAX_WIDTH, MAP_MAX_LENGTH);
     map->fog_mask = quadmask_create(MAP_MAX_WIDTH, MAP_MAX_LENGTH);
-    map->tilemap = st_calloc(map->width * map->length, sizeof(void*));
-    map->map_nodes = st_calloc(map->width * map->length, sizeof(MapNode*));
+    memset(map->chunks, 0, sizeof(map->chunks));
+    map->num_chunks = 0;
+    map->num_tile_collide_funcs = 0;
     map->bosses = list_create();
     map->entities = list_create();
     map->tiles = list_create();
@@ -1541,15 +1696,17 @@ static Map* generate_map(i32 id)
     map->projectiles = list_create();
     map->obstacles = list_create();
     map->parstacles = list_create();
-    map->particles = list_create();
-    map->parjicles = list_create();
     map->triggers = list_create();
     map->aoes = list_create();
     map->lines = list_create();
+    map_init_allocators(map);
     map->root = root;
     map->spawn_point = vec2_create(MAP_MAX_WIDTH / 2 + 0.5, MAP_MAX_LENGTH / 2 + 0.5);
     map->active = true;
     map->collision_strategy = MAP_COLLIDE_NAIVE;
+    map->adaptive_collision = false;
+    map->show_spatial_hash_lines = false;
+    map->spatial_hash_lines_created = false;
 
     map_context.current_map = map;
 
@@ -1567,12 +1724,56 @@ static Map* generate_map(i32 id)
     return map;
 }
 
-static MapNode* get_map_node(Map* map, i32 x, i32 z)
+MapNode* map_get_node(Map* map, i32 x, i32 z)
 {
     log_assert(map != NULL, "map is null");
-    if (x < 0 || z < 0 || x >= MAP_MAX_WIDTH || z >= MAP_MAX_WIDTH)
+    MapChunk* chunk = get_chunk(map, x, z, false);
+    if (chunk == NULL)
         return NULL;
-    return map->map_nodes[z * MAP_MAX_WIDTH + x];
+    return chunk->nodes[chunk_idx(x, z)];
+}
+
+void map_set_node(Map* map, i32 x, i32 z, MapNode* node)
+{
+    log_assert(map != NULL, "map is null");
+    MapChunk* chunk = get_chunk(map, x, z, node != NULL);
+    if (chunk != NULL)
+        chunk->nodes[chunk_idx(x, z)] = node;
+}
+
+void map_clear_node_fog_rect(Map* map, MapNode* node, i32 x1, i32 x2, i32 z1, i32 z2)
+{
+    MapChunk* chunk = NULL;
+    u64 bits;
+    i32 x, z, i, n;
+    log_assert(map != NULL, "map is null");
+    // gathers up to 64 cells of a row and sets their fog bits at once
+    for (z = z1; z <= z2; z++) {
+        for (x = x1; x <= x2; x += n) {
+            n = mini(64, x2 - x + 1);
+            bits = 0;
+            for (i = 0; i < n; i++) {
+                if (i == 0 || ((x + i) & (MAP_CHUNK_WIDTH - 1)) == 0)
+                    chunk = get_chunk(map, x + i, z, false);
+                if (chunk != NULL && chunk->nodes[chunk_idx(x + i, z)] == node)
+                    bits |= 1ULL << (63 - i);
+            }
+            if (bits != 0)
+                quadmask_set_bits(map->fog_mask, x, z, bits, n);
+        }
+    }
+}
+
+static Packet* create_clear_fog_packet(MapNode* node)
+{
+    size_t size = sizeof(node->x1);
+    char buffer[4 * size + sizeof(void*)];
+    memcpy(buffer, &node->x1, size);
+    memcpy(buffer+size, &node->x2, size);
+    memcpy(buffer+2*size, &node->z1, size);
+    memcpy(buffer+3*size, &node->z2, size);
+    memcpy(buffer+4*size, &node, sizeof(void*));
+    return packet_create(PACKET_CLEAR_FOG, sizeof(buffer), buffer);
 }
 
 static void clear_map_node_fog(Map* map, MapNode* node)
@@ -1581,20 +1782,10 @@ static void clear_map_node_fog(Map* map, MapNode* node)
     if (node->cleared)
         return;
     node->cleared = true;
-    for (i32 z = node->z1; z <= node->z2; z++)
-        for (i32 x = node->x1; x <= node->x2; x++)
-            if (node == get_map_node(map, x, z))
-                quadmask_set(map->fog_mask, x, z);
+    map_clear_node_fog_rect(map, node, node->x1, node->x2, node->z1, node->z2);
 
     if (game_context.hosting) {
-        size_t size = sizeof(node->x1);
-        char buffer[4 * size + sizeof(void*)];
-        memcpy(buffer, &node->x1, size);
-        memcpy(buffer+size, &node->x2, size);
-        memcpy(buffer+2*size, &node->z1, size);
-        memcpy(buffer+3*size, &node->z2, size);
-        memcpy(buffer+4*size, &node, sizeof(void*));
-        Packet* packet = packet_create(PACKET_CLEAR_FOG, sizeof(buffer), buffer);
+        Packet* packet = create_clear_fog_packet(node);
         game_net_send_tcp_packet_to_clients(packet);
         packet_destroy(packet);
     }
@@ -1666,7 +1857,7 @@ void map_fog_explore(Map* map, vec2 position)
     z = (i32) position.z;
     if (map == NULL)
         return;
-    MapNode* node = get_map_node(map, x, z);
+    MapNode* node = map_get_node(map, x, z);
     if (node == NULL)
         return;
     //if (map_context.current_map_node != node) {
@@ -1703,6 +1894,7 @@ void map_fog_clear(Map* map)
     game_render_update_parstacles();
 }
 
+// called from the console, the lines are made by map_update
 void map_toggle_spatial_hash_lines(Map* map)
 {
     map->show_spatial_hash_lines = !map->show_spatial_hash_lines;
@@ -1871,7 +2063,7 @@ Entity* map_create_entity(vec2 position, i32 id)
         return NULL;
     if (!game_context.singleplayer && !game_context.hosting)
         return NULL;
-    entity = entity_create(position, id);
+    entity = entity_create(&map->entity_slab, position, id);
     list_append(map->entities, entity);
     buckets_insert_entity(map, entity);
     return entity;
@@ -1879,28 +2071,26 @@ Entity* map_create_entity(vec2 position, i32 id)
 
 bool map_create_parjicle(Parjicle parjicle)
 {
-    Parjicle* parj;
+    bool created;
     Map* map = map_context.current_map;
     if (!map->active)
         return false;
-    parj = parjicle_create_from_struct(parjicle);
-    list_append(map->parjicles, parj);
+    created = parjicle_create_from_struct(&map->parjicles, parjicle);
     if (game_context.hosting) {
         Packet* packet = packet_create(PACKET_CREATE_PARJICLE, sizeof(parjicle), (char*)&parjicle);
         game_net_send_udp_packet_to_clients(packet);
         packet_destroy(packet);
     }
-    return parj;
+    return created;
 }
 
 bool map_create_particle(Particle particle)
 {
-    Particle* part;
+    bool created;
     Map* map = map_context.current_map;
     if (!map->active)
         return false;
-    part = particle_create_from_struct(particle);
-    list_append(map->particles, part);
+    created = particle_create_from_struct(&map->particles, particle);
 
     if (game_context.hosting) {
         Packet* packet = packet_create(PACKET_CREATE_PARTICLE, sizeof(particle), (char*)&particle);
@@ -1908,10 +2098,10 @@ bool map_create_particle(Particle particle)
         packet_destroy(packet);
     }
 
-    return part != NULL;
+    return created;
 }
 
-Projectile* map_create_projectile(Projectile projectile)
+Projectile* map_create_projectile(ProjectileDesc projectile)
 {
     Projectile* proj;
     Map* map = map_context.current_map;
@@ -1919,7 +2109,7 @@ Projectile* map_create_projectile(Projectile projectile)
         return NULL;
     if (!game_context.singleplayer && !game_context.hosting)
         return NULL;
-    proj = projectile_create(projectile);
+    proj = projectile_create(&map->projectile_pool, projectile);
     list_append(map->projectiles, proj);
     buckets_insert_projectile(map, proj);
     return proj;
@@ -1933,7 +2123,7 @@ Trigger* map_create_trigger(vec2 position, f32 radius)
         return NULL;
     if (!game_context.singleplayer && !game_context.hosting)
         return NULL;
-    trigger = trigger_create(position, radius);
+    trigger = trigger_create(&map->trigger_slab, position, radius);
     trigger->map_info.spawn_node = NULL;
     list_append(map->triggers, trigger);
     buckets_insert_trigger(map, trigger);
@@ -1948,7 +2138,7 @@ AOE* map_create_aoe(vec2 position, f32 lifetime)
         return NULL;
     if (!game_context.singleplayer && !game_context.hosting)
         return NULL;
-    aoe = aoe_create(position, lifetime);
+    aoe = aoe_create(&map->aoe_slab, position, lifetime);
     list_append(map->aoes, aoe);
     buckets_insert_aoe(map, aoe);
     return aoe;
@@ -1980,7 +2170,7 @@ Entity* room_create_entity(vec2 position, i32 id)
         return NULL;
     }
     vec2 new_position = room_to_map_position(position);
-    Entity* entity = entity_create(new_position, id);
+    Entity* entity = entity_create(&map->entity_slab, new_position, id);
     entity->map_info.spawn_node = node;
     entity->map_info.current_node = NULL;
     list_append(map->entities, entity);
@@ -2002,7 +2192,7 @@ Trigger* room_create_trigger(vec2 position, f32 radius)
         return NULL;
     }
     vec2 new_position = room_to_map_position(position);
-    trigger = trigger_create(new_position, radius);
+    trigger = trigger_create(&map->trigger_slab, new_position, radius);
     trigger->map_info.spawn_node = node;
     list_append(map->triggers, trigger);
     buckets_insert_trigger(map, trigger);
@@ -2023,7 +2213,7 @@ AOE* room_create_aoe(vec2 position, f32 lifetime)
         return NULL;
     }
     vec2 new_position = room_to_map_position(position);
-    aoe = aoe_create(new_position, lifetime);
+    aoe = aoe_create(&map->aoe_slab, new_position, lifetime);
     aoe->map_info.spawn_node = node;
     list_append(map->aoes, aoe);
     buckets_insert_aoe(map, aoe);
@@ -2044,8 +2234,7 @@ bool room_create_parjicle(Parjicle parjicle)
     }
 
     parjicle.position = room_to_map_position3(parjicle.position);
-    Parjicle* parj = parjicle_create_from_struct(parjicle);
-    list_append(map->parjicles, parj);
+    bool created = parjicle_create_from_struct(&map->parjicles, parjicle);
 
     if (game_context.hosting) {
         Packet* packet = packet_create(PACKET_CREATE_PARJICLE, sizeof(parjicle), (char*)&parjicle);
@@ -2053,7 +2242,7 @@ bool room_create_parjicle(Parjicle parjicle)
         packet_destroy(packet);
     }
 
-    return parj;
+    return created;
 }
 
 bool room_create_particle(Particle particle)
@@ -2069,8 +2258,7 @@ bool room_create_particle(Particle particle)
         return false;
     }
     particle.position = room_to_map_position3(particle.position);
-    Particle* part = particle_create_from_struct(particle);
-    list_append(map->particles, part);
+    bool created = particle_create_from_struct(&map->particles, particle);
 
     if (game_context.hosting) {
         Packet* packet = packet_create(PACKET_CREATE_PARTICLE, sizeof(particle), (char*)&particle);
@@ -2078,7 +2266,7 @@ bool room_create_particle(Particle particle)
         packet_destroy(packet);
     }
 
-    return part != NULL;
+    return created;
 }
 
 Obstacle* room_create_obstacle(vec2 position)
@@ -2121,7 +2309,7 @@ Parstacle* room_create_parstacle(vec2 position)
     return parstacle;
 }
 
-Projectile* room_create_projectile(Projectile projectile)
+Projectile* room_create_projectile(ProjectileDesc projectile)
 {
     Projectile* proj;
     Map* map = map_context.current_map;
@@ -2135,7 +2323,7 @@ Projectile* room_create_projectile(Projectile projectile)
         return NULL;
     }
     projectile.position = room_to_map_position(projectile.position);
-    proj = projectile_create(projectile);
+    proj = projectile_create(&map->projectile_pool, projectile);
     proj->map_info.spawn_node = node;
     list_append(map->projectiles, proj);
     buckets_insert_projectile(map, proj);
@@ -2275,76 +2463,73 @@ bool map_is_wall(Map* map, i32 x, i32 z)
 {
     log_assert(map != NULL, "map is null");
     if (map == NULL) return false;
-    if (x < 0 || x >= map->width) return false;
-    if (z < 0 || z >= map->length) return false;
-    return quadmask_isset(map->tile_mask, x, z);
+    MapChunk* chunk = get_chunk(map, x, z, false);
+    if (chunk == NULL) return false;
+    return chunk_mask_isset(chunk->wall_mask, x, z);
 }
 
 void* map_get(Map* map, i32 x, i32 z)
 {
     log_assert(map != NULL, "map is null");
     if (map == NULL) return NULL;
-    if (x < 0 || x >= map->width) return NULL;
-    if (z < 0 || z >= map->length) return NULL;
-    return map->tilemap[z * map->width + x];
+    MapChunk* chunk = get_chunk(map, x, z, false);
+    if (chunk == NULL) return NULL;
+    return chunk->tiles[chunk_idx(x, z)];
 }
 
 Tile* map_get_tile(Map* map, i32 x, i32 z)
 {
     log_assert(map != NULL, "map is null");
     if (map == NULL) return NULL;
-    if (x < 0 || x >= map->width) return NULL;
-    if (z < 0 || z >= map->length) return NULL;
-    if (quadmask_isset(map->tile_mask, x, z))
+    MapChunk* chunk = get_chunk(map, x, z, false);
+    if (chunk == NULL) return NULL;
+    if (chunk_mask_isset(chunk->wall_mask, x, z))
         return NULL;
-    return map->tilemap[z * map->width + x];
+    return chunk->tiles[chunk_idx(x, z)];
 }
 
 Wall* map_get_wall(Map* map, i32 x, i32 z)
 {
     log_assert(map != NULL, "map is null");
     if (map == NULL) return NULL;
-    if (x < 0 || x >= map->width) return NULL;
-    if (z < 0 || z >= map->length) return NULL;
-    if (!quadmask_isset(map->tile_mask, x, z))
+    MapChunk* chunk = get_chunk(map, x, z, false);
+    if (chunk == NULL) return NULL;
+    if (!chunk_mask_isset(chunk->wall_mask, x, z))
         return NULL;
-    return map->tilemap[z * map->width + x];
+    return chunk->tiles[chunk_idx(x, z)];
 }
 
-void map_set_tile(Map* map, i32 x, i32 z, Tile* tile)
+static void set_tile_or_wall(Map* map, i32 x, i32 z, void* tile, bool is_wall)
 {
-    log_assert(map != NULL, "map is null");
     void* prev_tile;
-    if (map == NULL) return;
-    if (x < 0 || x >= map->width) return;
-    if (z < 0 || z >= map->length) return;
-    prev_tile = map->tilemap[z * map->width + x];
-    if (quadmask_isset(map->tile_mask, x, z))
-        wall_set_flag(prev_tile, WALL_FLAG_ACTIVE, false);
-    else
-        tile_set_flag(prev_tile, TILE_FLAG_ACTIVE, false);
-    map->tilemap[z * map->width + x] = tile;
-    quadmask_unset(map->tile_mask, x, z);
+    MapChunk* chunk = get_chunk(map, x, z, true);
+    if (chunk == NULL) return;
+    prev_tile = chunk->tiles[chunk_idx(x, z)];
+    if (prev_tile != NULL) {
+        if (chunk_mask_isset(chunk->wall_mask, x, z))
+            wall_set_flag(prev_tile, WALL_FLAG_ACTIVE, false);
+        else
+            tile_set_flag(prev_tile, TILE_FLAG_ACTIVE, false);
+    }
+    chunk->tiles[chunk_idx(x, z)] = tile;
+    chunk_mask_set(chunk->wall_mask, x, z, is_wall);
+    update_collide_cell(map, chunk, x, z);
     game_render_update_tiles();
     game_render_update_walls();
 }
 
+void map_set_tile(Map* map, i32 x, i32 z, Tile* tile)
+{
+    log_assert(map != NULL, "map is null");
+    if (map == NULL) return;
+    set_tile_or_wall(map, x, z, tile, false);
+}
+
 void map_set_wall(Map* map, i32 x, i32 z, Wall* wall)
 {
     log_assert(map != NULL, "map is null");
-    void* prev_tile;
     if (map == NULL) return;
-    if (x < 0 || x >= map->width) return;
-    if (z < 0 || z >= map->length) return;
-    prev_tile = map->tilemap[z * map->width + x];
-    if (quadmask_isset(map->tile_mask, x, z))
-        wall_set_flag(prev_tile, WALL_FLAG_ACTIVE, false);
-    else
-        tile_set_flag(prev_tile, TILE_FLAG_ACTIVE, false);
-    map->tilemap[z * map->width + x] = wall;
-    quadmask_set(map->tile_mask, x, z);
-    game_render_update_tiles();
-    game_render_update_walls();
+    set_tile_or_wall(map, x, z, wall, true);
 }
 
 void map_init(void)
@@ -2399,10 +2584,50 @@ void map_destroy_projectiles_with_owner_id(i32 uid)
     for (i32 i = 0; i < map->projectiles->length; i++) {
         Projectile* proj = list_get(map->projectiles, i);
         if (proj->owner_uid == uid)
-            proj->lifetime = -1;
+            projectile_set_lifetime(proj, -1);
     }
 }
 
+Projectile* map_get_projectile(ProjectileHandle handle)
+{
+    Map* map = game_context.current_map;
+    if (map == NULL)
+        return NULL;
+    return projectile_pool_get(&map->projectile_pool, handle);
+}
+
+void map_init_allocators(Map* map)
+{
+    projectile_pool_init(&map->projectile_pool);
+    slab_init(&map->entity_slab, "entities", sizeof(Entity), MAP_SLAB_LENGTH);
+    slab_init(&map->trigger_slab, "triggers", sizeof(Trigger), MAP_SLAB_LENGTH);
+    slab_init(&map->aoe_slab, "aoes", sizeof(AOE), MAP_SLAB_LENGTH);
+    particle_system_init(&map->particles, false, PARTICLE_SYSTEM_MAX_LENGTH);
+    particle_system_init(&map->parjicles, true, PARTICLE_SYSTEM_MAX_LENGTH);
+}
+
+static void log_slab_stats(LogLevel level, const char* name, SlabStats* stats)
+{
+    log_write(level, "%-12s %6d live %6d peak %4d slabs %8llu allocs",
+        name, stats->live, stats->peak, stats->num_slabs, (unsigned long long)stats->allocs);
+}
+
+static void log_particle_stats(LogLevel level, const char* name, ParticleSystem* ps)
+{
+    log_write(level, "%-12s %6d live %6d peak %6d capacity %8llu allocs",
+        name, ps->length, ps->peak, ps->capacity, (unsigned long long)ps->allocs);
+}
+
+void map_log_allocator_stats(Map* map, LogLevel level)
+{
+    log_slab_stats(level, "projectiles", &map->projectile_pool.stats);
+    log_slab_stats(level, map->entity_slab.name, &map->entity_slab.stats);
+    log_slab_stats(level, map->trigger_slab.name, &map->trigger_slab.stats);
+    log_slab_stats(level, map->aoe_slab.name, &map->aoe_slab.stats);
+    log_particle_stats(level, "particles", &map->particles);
+    log_particle_stats(level, "parjicles", &map->parjicles);
+}
+
 void bucket_create(Bucket* bucket)
 {
     bucket->entities = list_create();
@@ -2423,12 +2648,93 @@ void bucket_destroy(Bucket* bucket)
     list_destroy(bucket->aoes);
 }
 
+static void destroy_grid_lines(Map* map)
+{
+    Line* line;
+    i32 i = 0;
+    if (!map->spatial_hash_lines_created)
+        return;
+    while (i < map->lines->length) {
+        line = list_get(map->lines, i);
+        if (line->is_spatial_hash_line)
+            line_destroy(list_remove(map->lines, i));
+        else
+            i++;
+    }
+    map->spatial_hash_lines_created = false;
+}
+
 static void clear_previous_collision_strategy(Map* map)
 {
+    UniformGridData* grid;
+    SpatialHashData* data;
+    i32 i;
+    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH) {
+        data = &map->spatial_hash_data;
+        for (i = 0; i < data->num_buckets; i++)
+            bucket_destroy(&data->buckets[i]);
+        st_free(data->buckets);
+        for (i = 0; i < data->num_contact_lists; i++) {
+            st_free(data->contact_lists[i].contacts);
+            st_free(data->contact_lists[i].positions);
+        }
+        st_free(data->contact_lists);
+        st_free(data->bucket_contacts);
+        memset(data, 0, sizeof(SpatialHashData));
+    }
+    else if (map->collision_strategy == MAP_COLLIDE_UNIFORM_GRID) {
+        grid = &map->uniform_grid_data;
+        st_free(grid->cell_count);
+        st_free(grid->cell_start);
+        st_free(grid->occupied_cells);
+        st_free(grid->objects);
+        st_free(grid->cell_objects);
+        memset(grid, 0, sizeof(UniformGridData));
+    }
+    else if (map->collision_strategy == MAP_COLLIDE_QUADTREE) {
+        for (i = 0; i < map->quadtree_data.num_nodes; i++)
+            bucket_destroy(&map->quadtree_data.nodes[i].bucket);
+        st_free(map->quadtree_data.nodes);
+        memset(&map->quadtree_data, 0, sizeof(QuadtreeData));
+    }
+    destroy_grid_lines(map);
+}
+
+// the lines of the spatial hash or uniform grid, only made while
+// show_spatial_hash_lines is on since the adaptive strategy switches
+// grids often
+static void create_grid_lines(Map* map)
+{
+    Line* line;
+    f32 h = 0;
+    f32 w = 0.25;
+    i32 num_wide, num_long, width;
+    map->spatial_hash_lines_created = true;
     if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH) {
-        for (i32 i = 0; i < map->spatial_hash_data.num_buckets; i++)
-            bucket_destroy(&map->spatial_hash_data.buckets[i]);
-        st_free(map->spatial_hash_data.buckets);
+        num_wide = map->spatial_hash_data.num_buckets_wide;
+        num_long = map->spatial_hash_data.num_buckets_long;
+        width = map->spatial_hash_data.bucket_width;
+    } else if (map->collision_strategy == MAP_COLLIDE_UNIFORM_GRID) {
+        num_wide = map->uniform_grid_data.num_cells_wide;
+        num_long = map->uniform_grid_data.num_cells_long;
+        width = map->uniform_grid_data.cell_width;
+    } else
+        return;
+    for (i32 i = 0; i <= num_wide; i++) {
+        line = map_create_line();
+        line->is_spatial_hash_line = true;
+        line->width = w;
+        line->use_lifetime = false;
+        line->pos1 = vec3_create(i * width, h, 0);
+        line->pos2 = vec3_create(i * width, h, map->width);
+    }
+    for (i32 i = 0; i <= num_long; i++) {
+        line = map_create_line();
+        line->is_spatial_hash_line = true;
+        line->width = w;
+        line->use_lifetime = false;
+        line->pos1 = vec3_create(0, h, i * width);
+        line->pos2 = vec3_create(map->length, h, i * width);
     }
 }
 
@@ -2460,25 +2766,70 @@ void map_use_spatial_hash(Map* map, i32 bucket_width)
     for (i = 0; i < map->aoes->length; i++)
         buckets_insert_aoe(map, list_get(map->aoes, i));
 
-    Line* line;
-    f32 h = 0;
-    f32 w = 0.25;
-    for (i32 i = 0; i <= data->num_buckets_wide; i++) {
-        line = map_create_line();
-        line->is_spatial_hash_line = true;
-        line->width = w;
-        line->use_lifetime = false;
-        line->pos1 = vec3_create(i * bucket_width, h, 0);
-        line->pos2 = vec3_create(i * bucket_width, h, map->width);
-    }
-    for (i32 i = 0; i <= data->num_buckets_long; i++) {
-        line = map_create_line();
-        line->is_spatial_hash_line = true;
-        line->width = w;
-        line->use_lifetime = false;
-        line->pos1 = vec3_create(0, h, i * bucket_width);
-        line->pos2 = vec3_create(map->length, h, i * bucket_width);
-    }
+    if (map->show_spatial_hash_lines)
+        create_grid_lines(map);
+}
+
+// the grid keeps no per object state, everything is rebuilt
+// in map_collide_objects so only the cell arrays are allocated here
+void map_use_uniform_grid(Map* map, i32 cell_width)
+{
+    UniformGridData* grid;
+    log_write(INFO, "Switching to uniform grid strategy");
+    clear_previous_collision_strategy(map);
+    map->collision_strategy = MAP_COLLIDE_UNIFORM_GRID;
+    grid = &map->uniform_grid_data;
+    grid->cell_width = cell_width;
+    grid->num_cells_wide = (map->width + cell_width - 1) / cell_width;
+    grid->num_cells_long = (map->length + cell_width - 1) / cell_width;
+    grid->num_cells = grid->num_cells_wide * grid->num_cells_long;
+    grid->cell_count = st_calloc(grid->num_cells, sizeof(i32));
+    grid->cell_start = st_malloc(grid->num_cells * sizeof(i32));
+    grid->occupied_cells = st_malloc(grid->num_cells * sizeof(i32));
+    grid->num_occupied_cells = 0;
+    grid->objects = NULL;
+    grid->num_objects = 0;
+    grid->objects_capacity = 0;
+    grid->cell_objects = NULL;
+    grid->cell_objects_capacity = 0;
+
+    if (map->show_spatial_hash_lines)
+        create_grid_lines(map);
+}
+
+// entities are never stored in the tree, they only query it
+void map_use_quadtree(Map* map, i32 split_threshold)
+{
+    QuadtreeData* data;
+    QuadtreeNode* root;
+    i32 i;
+    log_write(INFO, "Switching to quadtree strategy");
+    clear_previous_collision_strategy(map);
+    map->collision_strategy = MAP_COLLIDE_QUADTREE;
+    data = &map->quadtree_data;
+    data->split_threshold = split_threshold;
+    data->nodes_capacity = 64;
+    data->nodes = st_malloc(data->nodes_capacity * sizeof(QuadtreeNode));
+    data->num_nodes = 1;
+    root = &data->nodes[0];
+    bucket_create(&root->bucket);
+    memset(root->counts, 0, sizeof(root->counts));
+    root->x = map->width / 2.0f;
+    root->z = map->length / 2.0f;
+    root->half_width = maxi(map->width, map->length) / 2.0f;
+    root->depth = 0;
+    root->parent = -1;
+    root->children = -1;
+    for (i = 0; i < map->free_walls->length; i++)
+        buckets_insert_free_wall(map, list_get(map->free_walls, i));
+    for (i = 0; i < map->projectiles->length; i++)
+        buckets_insert_projectile(map, list_get(map->projectiles, i));
+    for (i = 0; i < map->obstacles->length; i++)
+        buckets_insert_obstacle(map, list_get(map->obstacles, i));
+    for (i = 0; i < map->triggers->length; i++)
+        buckets_insert_trigger(map, list_get(map->triggers, i));
+    for (i = 0; i < map->aoes->length; i++)
+        buckets_insert_aoe(map, list_get(map->aoes, i));
 }
 
 void map_use_naive(Map* map)
@@ -2488,17 +2839,62 @@ void map_use_naive(Map* map)
     map->collision_strategy = MAP_COLLIDE_NAIVE;
 }
 
-Map* map_create(i32 id)
+// keeps the current strategy and lets map_collide_objects switch
+// and retune it from then on. the other map_use_* functions don't
+// turn this off, callers picking a strategy by hand have to
+void map_use_adaptive(Map* map)
 {
-    Map* map;
-    Entity* entity;
+    map->adaptive_collision = true;
+    memset(&map->collision_stats, 0, sizeof(CollisionStats));
+}
 
-    if (id == -1) {
-        log_write(WARNING, "Tried to load map with id of -1");
-        return NULL;
-    }
+static void send_map_nodes_packet(Client* client, char* buffer, char* end)
+{
+    Packet* packet = packet_create(PACKET_CREATE_MAP_NODES, end - buffer, buffer);
+    if (client == NULL)
+        game_net_send_tcp_packet_to_clients(packet);
+    else
+        game_net_send_packet_tcp(client, packet);
+    packet_destroy(packet);
+}
 
-    game_render_update_obstacles();
+// the map nodes of every chunk that has any, as the chunk index
+// followed by MAP_CHUNK_AREA node pointers. clients only compare
+// the pointers, see client_map_clear_fog. a whole map can be over
+// PACKET_MAX_SIZE, so it goes out MAP_NODES_PACKET_CHUNKS chunks
+// at a time. sent to every client if client is NULL
+static void send_map_nodes(Map* map, Client* client)
+{
+    size_t entry_size = sizeof(i32) + MAP_CHUNK_AREA * sizeof(MapNode*);
+    char* buffer = st_malloc(MAP_NODES_PACKET_CHUNKS * entry_size);
+    char* ptr = buffer;
+    for (i32 i = 0; i < MAP_CHUNKS_WIDE * MAP_CHUNKS_LONG; i++) {
+        if (map->chunks[i] == NULL)
+            continue;
+        memcpy(ptr, &i, sizeof(i32));
+        memcpy(ptr + sizeof(i32), map->chunks[i]->nodes, MAP_CHUNK_AREA * sizeof(MapNode*));
+        ptr += entry_size;
+        if (ptr == buffer + MAP_NODES_PACKET_CHUNKS * entry_size) {
+            send_map_nodes_packet(client, buffer, ptr);
+            ptr = buffer;
+        }
+    }
+    if (ptr != buffer)
+        send_map_nodes_packet(client, buffer, ptr);
+    st_free(buffer);
+}
+
+Map* map_create(i32 id)
+{
+    Map* map;
+    Entity* entity;
+
+    if (id == -1) {
+        log_write(WARNING, "Tried to load map with id of -1");
+        return NULL;
+    }
+
+    game_render_update_obstacles();
     game_render_update_parstacles();
     game_render_update_tiles();
     game_render_update_walls();
@@ -2507,26 +2903,67 @@ Map* map_create(i32 id)
     game_context.this_client->player.entity = NULL;
 
     map = generate_map(id);
+    snapshot_reset();
 
-    Packet* packet = packet_create(PACKET_CREATE_MAP_NODES, map->width * map->length * sizeof(void*), (char*)map->map_nodes);
-    game_net_send_tcp_packet_to_clients(packet);
-    packet_destroy(packet);
+    send_map_nodes(map, NULL);
 
     for (i32 i = 0; i < game_context.clients->length; i++) {
         Client* client = list_get(game_context.clients, i);
         entity = map_create_entity(map->spawn_point, 0);
         player_reset(client, entity);
         entity->max_health = 101;
+        atomic_store(&client->snapshot_view.ack, 0);
     }
 
     game_context.current_map = map;
 
-    map_use_spatial_hash(map, sqrt(MAP_MAX_WIDTH));
+    map_use_uniform_grid(map, MAP_GRID_CELL_WIDTH);
+    map_use_adaptive(map);
     log_write(DEBUG, "loaded");
 
     return map;
 }
 
+static void sync_cleared_fog(Client* client, MapNode* node)
+{
+    Packet* packet;
+    if (node->cleared) {
+        packet = create_clear_fog_packet(node);
+        game_net_send_packet_tcp(client, packet);
+        packet_destroy(packet);
+    }
+    for (i32 i = 0; i < node->num_children; i++)
+        sync_cleared_fog(client, node->children[i]);
+}
+
+// same packets a client gets from map_create, but only to this one.
+// the map keeps running for everyone else
+void map_sync_client(Map* map, Client* client)
+{
+    Entity* entity;
+    Packet* packet;
+    i32 uid;
+
+    packet = packet_create(PACKET_LOAD_GAME, 0, NULL);
+    game_net_send_packet_tcp(client, packet);
+    packet_destroy(packet);
+
+    send_map_nodes(map, client);
+
+    for (uid = 0; uid < MAX_UID; uid++)
+        if (game_context.uid_map_type[uid] != GAME_OBJ_NONE)
+            host_send_game_obj(client, uid);
+
+    if (map->root != NULL)
+        sync_cleared_fog(client, map->root);
+
+    // created for everyone, the other clients see the new player too
+    entity = map_create_entity(map->spawn_point, 0);
+    player_reset(client, entity);
+    entity->max_health = 101;
+    atomic_store(&client->snapshot_view.ack, 0);
+}
+
 static void destroy_entities(Map* map)
 {
     Entity* entity;
@@ -2536,10 +2973,11 @@ static void destroy_entities(Map* map)
         if (entity_get_flag(entity, ENTITY_FLAG_BOSS))
             gui_destroy_boss_healthbar(entity);
         map_context.current_map_node = entity->map_info.spawn_node;
-        entity_destroy(entity);
+        entity_destroy(&map->entity_slab, entity);
         map_context.current_map_node = NULL;
     }
     list_destroy(map->entities);
+    slab_destroy(&map->entity_slab);
 }
 
 static void destroy_projectiles(Map* map)
@@ -2548,9 +2986,10 @@ static void destroy_projectiles(Map* map)
     i32 i;
     for (i = 0; i < map->projectiles->length; i++) {
         proj = list_get(map->projectiles, i);
-        projectile_destroy(proj);
+        projectile_destroy(&map->projectile_pool, proj);
     }
     list_destroy(map->projectiles);
+    projectile_pool_destroy(&map->projectile_pool);
 }
 
 static void destroy_obstacles(Map* map)
@@ -2577,24 +3016,14 @@ static void destroy_parstacles(Map* map)
 
 static void destroy_particles(Map* map)
 {
-    Particle* particle;
-    i32 i;
-    for (i = 0; i < map->particles->length; i++) {
-        particle = list_get(map->particles, i);
-        particle_destroy(particle);
-    }
-    list_destroy(map->particles);
+    particle_destroy_all(&map->particles);
+    particle_system_destroy(&map->particles);
 }
 
 static void destroy_parjicles(Map* map)
 {
-    Parjicle* parjicle;
-    i32 i;
-    for (i = 0; i < map->parjicles->length; i++) {
-        parjicle = list_get(map->parjicles, i);
-        parjicle_destroy(parjicle);
-    }
-    list_destroy(map->parjicles);
+    parjicle_destroy_all(&map->parjicles);
+    particle_system_destroy(&map->parjicles);
 }
 
 static void destroy_triggers(Map* map)
@@ -2603,9 +3032,10 @@ static void destroy_triggers(Map* map)
     i32 i;
     for (i = 0; i < map->triggers->length; i++) {
         trigger = list_get(map->triggers, i);
-        trigger_destroy(trigger);
+        trigger_destroy(&map->trigger_slab, trigger);
     }
     list_destroy(map->triggers);
+    slab_destroy(&map->trigger_slab);
 }
 
 static void destroy_aoes(Map* map)
@@ -2614,9 +3044,10 @@ static void destroy_aoes(Map* map)
     i32 i;
     for (i = 0; i < map->aoes->length; i++) {
         aoe = list_get(map->aoes, i);
-        aoe_destroy(aoe);
+        aoe_destroy(&map->aoe_slab, aoe);
     }
     list_destroy(map->aoes);
+    slab_destroy(&map->aoe_slab);
 }
 
 static void destroy_lines(Map* map)
@@ -2649,6 +3080,7 @@ void map_destroy(Map* map)
 {
     map_context.current_map = map;
     map->active = false;
+    map_log_allocator_stats(map, DEBUG);
     clear_previous_collision_strategy(map);
     destroy_entities(map);
     destroy_projectiles(map);
@@ -2662,9 +3094,7 @@ void map_destroy(Map* map)
     destroy_tiles(map);
     destroy_walls(map);
     list_destroy(map->bosses);
-    st_free(map->tilemap);
-    st_free(map->map_nodes);
-    quadmask_destroy(map->tile_mask);
+    destroy_chunks(map);
     quadmask_destroy(map->fog_mask);
     if (map->root != NULL)
         map_node_destroy(map->root);
@@ -2734,9 +3164,16 @@ static List* get_bucket_list_from_type(Bucket* bucket, i32 list_type)
 
 static i32 least_common_bucket_idx_assuming_same_bucket(SpatialHashData* data, MapInfo* map_info1, MapInfo* map_info2)
 {
-    IntPair bottom_left1 = spatial_hash_position(data, map_info1->bl_bucket_idx);
-    IntPair bottom_left2 = spatial_hash_position(data, map_info2->bl_bucket_idx);
-    return maxi(bottom_left1.idx_x, bottom_left2.idx_x) + maxi(bottom_left1.idx_z, bottom_left2.idx_z) * data->num_buckets_wide;
+    return maxi(map_info1->bl_bucket_x, map_info2->bl_bucket_x) + maxi(map_info1->bl_bucket_z, map_info2->bl_bucket_z) * data->num_buckets_wide;
+}
+
+// circle around everything a projectile touched this tick, it is
+// swept from prev_position to position by the collision tests
+static void projectile_bounds(Projectile* projectile, vec2* center, f32* radius)
+{
+    vec2 d = vec2_scale(vec2_sub(projectile_position(projectile), projectile_prev_position(projectile)), 0.5);
+    *center = vec2_add(projectile_prev_position(projectile), d);
+    *radius = projectile->size / 2 + vec2_mag(d);
 }
 
 static IntPair compute_bucket_range(SpatialHashData* data, vec2 position, f32 radius)
@@ -2763,38 +3200,101 @@ static IntPair compute_bucket_range(SpatialHashData* data, vec2 position, f32 ra
     };
 }
 
-static void remove_object(void* object, i32 list_type, SpatialHashData* data, i32 bucket_idx)
+static MapInfo* get_map_info_from_type(void* object, i32 list_type)
+{
+    if (list_type == BUCKET_ENTITIES)
+        return &((Entity*)object)->map_info;
+    else if (list_type == BUCKET_FREE_WALLS)
+        return &((Wall*)object)->map_info;
+    else if (list_type == BUCKET_PROJECTILES)
+        return &((Projectile*)object)->map_info;
+    else if (list_type == BUCKET_OBSTACLES)
+        return &((Obstacle*)object)->map_info;
+    else if (list_type == BUCKET_TRIGGERS)
+        return &((Trigger*)object)->map_info;
+    else if (list_type == BUCKET_AOES)
+        return &((AOE*)object)->map_info;
+    return NULL;
+}
+
+// the range bl..tr of the object, with what bucket_slot_idx needs
+static void set_bucket_range(SpatialHashData* data, MapInfo* map_info, IntPair bottom_left, IntPair top_right)
+{
+    i32 w = top_right.idx_x - bottom_left.idx_x + 1;
+    i32 l = top_right.idx_z - bottom_left.idx_z + 1;
+    map_info->tr_bucket_idx = top_right.idx_x + top_right.idx_z * data->num_buckets_wide;
+    map_info->bl_bucket_idx = bottom_left.idx_x + bottom_left.idx_z * data->num_buckets_wide;
+    map_info->bl_bucket_x = bottom_left.idx_x;
+    map_info->bl_bucket_z = bottom_left.idx_z;
+    map_info->bucket_slots_wide = (w > 0 && l > 0 && w * l <= MAP_INFO_BUCKET_SLOTS) ? w : 0;
+}
+
+// index into MapInfo.bucket_slots for the bucket at idx_x, idx_z in
+// the range of the object, or -1 if the range is too large to keep
+// slots for
+static i32 bucket_slot_idx(MapInfo* map_info, i32 idx_x, i32 idx_z)
+{
+    if (map_info->bucket_slots_wide == 0)
+        return -1;
+    return (idx_x - map_info->bl_bucket_x) + (idx_z - map_info->bl_bucket_z) * map_info->bucket_slots_wide;
+}
+
+// returns the index of the object in the bucket list
+static i32 find_object(void* object, List* list, MapInfo* map_info, i32 idx_x, i32 idx_z)
 {
+    i32 slot = bucket_slot_idx(map_info, idx_x, idx_z);
+    if (slot == -1)
+        return list_search(list, object);
+    return map_info->bucket_slots[slot];
+}
+
+static void remove_object(void* object, i32 list_type, MapInfo* map_info, SpatialHashData* data, i32 idx_x, i32 idx_z)
+{
+    i32 bucket_idx = idx_x + idx_z * data->num_buckets_wide;
     //log_write(DEBUG, "Remove: Removing %s %p from bucket %d", list_type_str[list_type], object, bucket_idx);
     Bucket* bucket = &data->buckets[bucket_idx];
     List* list = get_bucket_list_from_type(bucket, list_type);
-    i32 list_idx = list_search(list, object);
-    log_assert(list_idx != -1, "Expected %s %p to be in bucket %d", list_type_str[list_type], object, bucket_idx);
+    MapInfo* moved_info;
+    i32 list_idx, slot;
+    list_idx = find_object(object, list, map_info, idx_x, idx_z);
+    log_assert(list_idx != -1 && list_get(list, list_idx) == object, "Expected %s %p to be in bucket %d", list_type_str[list_type], object, bucket_idx);
     list_remove(list, list_idx);
+    // list_remove swaps the last object into list_idx, so its slot
+    // for this bucket has to follow it
+    if (list_idx == list->length)
+        return;
+    moved_info = get_map_info_from_type(list_get(list, list_idx), list_type);
+    slot = bucket_slot_idx(moved_info, idx_x, idx_z);
+    if (slot != -1)
+        moved_info->bucket_slots[slot] = list_idx;
 }
 
-static void add_object(void* object, i32 list_type, SpatialHashData* data, i32 bucket_idx)
+// returns the index of the object in the bucket list
+static i32 add_object(void* object, i32 list_type, SpatialHashData* data, i32 bucket_idx)
 {
     //log_write(DEBUG, "Insert: Inserting %s %p into bucket %d", list_type_str[list_type], object, bucket_idx);
     Bucket* bucket = &data->buckets[bucket_idx];
     List* list = get_bucket_list_from_type(bucket, list_type);
     list_append(list, object);
+    return list->length - 1;
 }
 
 static void buckets_insert_object_spatial_hash(Map* map, void* object, i32 list_type, MapInfo* map_info, i32 bl_bucket_idx, i32 tr_bucket_idx)
 {
     SpatialHashData* data = &map->spatial_hash_data;
-    i32 idx, i;
-    vec2 position;
-    Bucket* bucket;
-    List* list;
+    i32 bucket_idx, list_idx, slot;
     IntPair top_right = spatial_hash_position(data, tr_bucket_idx);
     IntPair bottom_left = spatial_hash_position(data, bl_bucket_idx);
-    for (i32 idx_z = bottom_left.idx_z; idx_z <= top_right.idx_z; idx_z++)
-        for (i32 idx_x = bottom_left.idx_x; idx_x <= top_right.idx_x; idx_x++)
-            add_object(object, list_type, data, idx_x + idx_z * data->num_buckets_wide);
-    map_info->tr_bucket_idx = top_right.idx_x + top_right.idx_z * data->num_buckets_wide;
-    map_info->bl_bucket_idx = bottom_left.idx_x + bottom_left.idx_z * data->num_buckets_wide;
+    set_bucket_range(data, map_info, bottom_left, top_right);
+    for (i32 idx_z = bottom_left.idx_z; idx_z <= top_right.idx_z; idx_z++) {
+        for (i32 idx_x = bottom_left.idx_x; idx_x <= top_right.idx_x; idx_x++) {
+            bucket_idx = idx_x + idx_z * data->num_buckets_wide;
+            list_idx = add_object(object, list_type, data, bucket_idx);
+            slot = bucket_slot_idx(map_info, idx_x, idx_z);
+            if (slot != -1)
+                map_info->bucket_slots[slot] = list_idx;
+        }
+    }
 }
 
 static void buckets_update_object_spatial_hash(Map* map, void* object, i32 list_type, MapInfo* map_info, i32 bl_bucket_idx, i32 tr_bucket_idx)
@@ -2802,31 +3302,44 @@ static void buckets_update_object_spatial_hash(Map* map, void* object, i32 list_
     if (bl_bucket_idx == map_info->bl_bucket_idx && tr_bucket_idx == map_info->tr_bucket_idx)
         return;
 
-    Bucket* bucket;
     List* list;
-    i32 i, idx, list_idx;
+    i32 bucket_idx, list_idx, slot;
     i32 idx_x, idx_z, prev_idx_x, prev_idx_z;
-    vec2 position;
     SpatialHashData* data = &map->spatial_hash_data;
+    MapInfo prev_map_info;
     IntPair top_right = spatial_hash_position(data, tr_bucket_idx);
     IntPair bottom_left = spatial_hash_position(data, bl_bucket_idx);
     IntPair prev_top_right = spatial_hash_position(data, map_info->tr_bucket_idx);
-    IntPair prev_bottom_left = spatial_hash_position(data, map_info->bl_bucket_idx);
+    IntPair prev_bottom_left = (IntPair) { .idx_x = map_info->bl_bucket_x, .idx_z = map_info->bl_bucket_z };
 
     // get rid of everything in previous buckets not in current buckets
     for (prev_idx_x = prev_bottom_left.idx_x; prev_idx_x <= prev_top_right.idx_x; prev_idx_x++)
         for (prev_idx_z = prev_bottom_left.idx_z; prev_idx_z <= prev_top_right.idx_z; prev_idx_z++)
             if (prev_idx_x < bottom_left.idx_x || prev_idx_z < bottom_left.idx_z || prev_idx_x > top_right.idx_x || prev_idx_z > top_right.idx_z)
-                remove_object(object, list_type, data, prev_idx_x + prev_idx_z * data->num_buckets_wide);
-
-    // add everything in current buckets not in previous buckets
-    for (idx_x = bottom_left.idx_x; idx_x <= top_right.idx_x; idx_x++)
-        for (idx_z = bottom_left.idx_z; idx_z <= top_right.idx_z; idx_z++)
+                remove_object(object, list_type, map_info, data, prev_idx_x, prev_idx_z);
+
+    // slots are laid out over the range, so the ones for buckets in
+    // both ranges move to their place in the new layout
+    prev_map_info = *map_info;
+    set_bucket_range(data, map_info, bottom_left, top_right);
+    for (idx_x = bottom_left.idx_x; idx_x <= top_right.idx_x; idx_x++) {
+        for (idx_z = bottom_left.idx_z; idx_z <= top_right.idx_z; idx_z++) {
+            bucket_idx = idx_x + idx_z * data->num_buckets_wide;
+            // add everything in current buckets not in previous buckets
             if (idx_x < prev_bottom_left.idx_x || idx_z < prev_bottom_left.idx_z || idx_x > prev_top_right.idx_x || idx_z > prev_top_right.idx_z)
-                add_object(object, list_type, data, idx_x + idx_z * data->num_buckets_wide);
-
-    map_info->tr_bucket_idx = top_right.idx_x + top_right.idx_z * data->num_buckets_wide;
-    map_info->bl_bucket_idx = bottom_left.idx_x + bottom_left.idx_z * data->num_buckets_wide;
+                list_idx = add_object(object, list_type, data, bucket_idx);
+            else {
+                slot = bucket_slot_idx(map_info, idx_x, idx_z);
+                if (slot == -1)
+                    continue;
+                list = get_bucket_list_from_type(&data->buckets[bucket_idx], list_type);
+                list_idx = find_object(object, list, &prev_map_info, idx_x, idx_z);
+            }
+            slot = bucket_slot_idx(map_info, idx_x, idx_z);
+            if (slot != -1)
+                map_info->bucket_slots[slot] = list_idx;
+        }
+    }
 }
 
 static void buckets_remove_object_spatial_hash(Map* map, void* object, i32 list_type, MapInfo* map_info)
@@ -2836,83 +3349,293 @@ static void buckets_remove_object_spatial_hash(Map* map, void* object, i32 list_
     IntPair bottom_left = spatial_hash_position(data, map_info->bl_bucket_idx);
     for (i32 idx_z = bottom_left.idx_z; idx_z <= top_right.idx_z; idx_z++)
         for (i32 idx_x = bottom_left.idx_x; idx_x <= top_right.idx_x; idx_x++)
-            remove_object(object, list_type, data, idx_x + idx_z * data->num_buckets_wide);
+            remove_object(object, list_type, map_info, data, idx_x, idx_z);
+}
+
+static void quadtree_object_bounds(void* object, i32 list_type, vec2* center, f32* radius)
+{
+    if (list_type == BUCKET_ENTITIES) {
+        Entity* entity = object;
+        *center = entity->position;
+        *radius = fmax(entity->size / 2, entity->hitbox_radius);
+    } else if (list_type == BUCKET_FREE_WALLS) {
+        Wall* wall = object;
+        *center = vec2_add(wall->position, vec2_scale(wall->size, 0.5));
+        *radius = fmax(wall->size.x, wall->size.z) / 2;
+    } else if (list_type == BUCKET_PROJECTILES) {
+        projectile_bounds(object, center, radius);
+    } else if (list_type == BUCKET_OBSTACLES) {
+        Obstacle* obstacle = object;
+        *center = obstacle->position;
+        *radius = obstacle->size / 2;
+    } else if (list_type == BUCKET_TRIGGERS) {
+        Trigger* trigger = object;
+        *center = trigger->position;
+        *radius = trigger->radius;
+    } else if (list_type == BUCKET_AOES) {
+        AOE* aoe = object;
+        *center = aoe->position;
+        *radius = aoe->radius;
+    }
+}
+
+static i32 quadtree_create_nodes(QuadtreeData* data, i32 num_nodes)
+{
+    i32 node_idx = data->num_nodes;
+    if (data->num_nodes + num_nodes > data->nodes_capacity) {
+        data->nodes_capacity = maxi(2 * data->nodes_capacity, data->num_nodes + num_nodes);
+        data->nodes = st_realloc(data->nodes, data->nodes_capacity * sizeof(QuadtreeNode));
+    }
+    data->num_nodes += num_nodes;
+    return node_idx;
+}
+
+static void quadtree_node_init(QuadtreeNode* node, f32 x, f32 z, f32 half_width, i32 depth, i32 parent)
+{
+    bucket_create(&node->bucket);
+    memset(node->counts, 0, sizeof(node->counts));
+    node->x = x;
+    node->z = z;
+    node->half_width = half_width;
+    node->depth = depth;
+    node->parent = parent;
+    node->children = -1;
+}
+
+static i32 quadtree_node_length(QuadtreeNode* node)
+{
+    Bucket* bucket = &node->bucket;
+    return bucket->free_walls->length + bucket->projectiles->length + bucket->obstacles->length
+         + bucket->triggers->length + bucket->aoes->length;
+}
+
+static bool quadtree_node_contains(QuadtreeNode* node, vec2 center)
+{
+    return fabs(center.x - node->x) <= node->half_width && fabs(center.z - node->z) <= node->half_width;
+}
+
+// deepest node holding the center that is still at least as large
+// as the object. objects centered outside the map stay in the root
+static i32 quadtree_find_node(QuadtreeData* data, vec2 center, f32 radius)
+{
+    QuadtreeNode* node = &data->nodes[0];
+    i32 node_idx = 0;
+    if (!quadtree_node_contains(node, center))
+        return 0;
+    while (node->children != -1 && radius <= node->half_width / 2) {
+        node_idx = node->children + (center.x >= node->x) + 2 * (center.z >= node->z);
+        node = &data->nodes[node_idx];
+    }
+    return node_idx;
+}
+
+static void quadtree_add_object(QuadtreeData* data, void* object, i32 list_type, MapInfo* map_info, i32 node_idx)
+{
+    List* list = get_bucket_list_from_type(&data->nodes[node_idx].bucket, list_type);
+    list_append(list, object);
+    map_info->node_idx = node_idx;
+    map_info->bucket_slots[0] = list->length - 1;
+    for (; node_idx != -1; node_idx = data->nodes[node_idx].parent)
+        data->nodes[node_idx].counts[list_type]++;
+}
+
+static void quadtree_remove_object(QuadtreeData* data, void* object, i32 list_type, MapInfo* map_info)
+{
+    i32 node_idx = map_info->node_idx;
+    i32 list_idx = map_info->bucket_slots[0];
+    List* list = get_bucket_list_from_type(&data->nodes[node_idx].bucket, list_type);
+    log_assert(list_idx < list->length && list_get(list, list_idx) == object, "Expected %s %p to be in node %d", list_type_str[list_type], object, node_idx);
+    list_remove(list, list_idx);
+    if (list_idx < list->length)
+        get_map_info_from_type(list_get(list, list_idx), list_type)->bucket_slots[0] = list_idx;
+    for (; node_idx != -1; node_idx = data->nodes[node_idx].parent)
+        data->nodes[node_idx].counts[list_type]--;
+}
+
+static void quadtree_split(QuadtreeData* data, i32 node_idx)
+{
+    QuadtreeNode* node;
+    MapInfo* map_info;
+    List* list;
+    void* object;
+    vec2 center;
+    f32 radius, h;
+    i32 children, list_type, i;
+
+    children = quadtree_create_nodes(data, 4);
+    node = &data->nodes[node_idx];
+    h = node->half_width / 2;
+    for (i = 0; i < 4; i++)
+        quadtree_node_init(&data->nodes[children + i],
+            node->x + ((i & 1) ? h : -h),
+            node->z + ((i & 2) ? h : -h),
+            h, node->depth + 1, node_idx);
+    node->children = children;
+
+    // push down everything small enough for a child. walking the
+    // lists backwards keeps the swap in list_remove from skipping
+    // objects
+    for (list_type = 0; list_type < 6; list_type++) {
+        list = get_bucket_list_from_type(&node->bucket, list_type);
+        for (i = list->length - 1; i >= 0; i--) {
+            object = list_get(list, i);
+            quadtree_object_bounds(object, list_type, &center, &radius);
+            if (radius > h || !quadtree_node_contains(node, center))
+                continue;
+            map_info = get_map_info_from_type(object, list_type);
+            quadtree_remove_object(data, object, list_type, map_info);
+            quadtree_add_object(data, object, list_type, map_info, children + (center.x >= node->x) + 2 * (center.z >= node->z));
+        }
+    }
+}
+
+static void quadtree_add_object_and_split(QuadtreeData* data, void* object, i32 list_type, MapInfo* map_info, i32 node_idx)
+{
+    QuadtreeNode* node;
+    quadtree_add_object(data, object, list_type, map_info, node_idx);
+    node = &data->nodes[node_idx];
+    if (node->children == -1 && node->depth < MAP_QUADTREE_MAX_DEPTH && quadtree_node_length(node) > data->split_threshold)
+        quadtree_split(data, node_idx);
+}
+
+static void buckets_insert_object_quadtree(Map* map, void* object, i32 list_type, MapInfo* map_info)
+{
+    QuadtreeData* data = &map->quadtree_data;
+    vec2 center;
+    f32 radius;
+    quadtree_object_bounds(object, list_type, &center, &radius);
+    quadtree_add_object_and_split(data, object, list_type, map_info, quadtree_find_node(data, center, radius));
+}
+
+static void buckets_update_object_quadtree(Map* map, void* object, i32 list_type, MapInfo* map_info)
+{
+    QuadtreeData* data = &map->quadtree_data;
+    vec2 center;
+    f32 radius;
+    i32 node_idx;
+    quadtree_object_bounds(object, list_type, &center, &radius);
+    node_idx = quadtree_find_node(data, center, radius);
+    if (node_idx == map_info->node_idx)
+        return;
+    quadtree_remove_object(data, object, list_type, map_info);
+    quadtree_add_object_and_split(data, object, list_type, map_info, node_idx);
+}
+
+static void buckets_remove_object_quadtree(Map* map, void* object, i32 list_type, MapInfo* map_info)
+{
+    quadtree_remove_object(&map->quadtree_data, object, list_type, map_info);
 }
 
 void buckets_insert_trigger(Map* map, Trigger* trigger)
 {
-    IntPair pair = compute_bucket_range(&map->spatial_hash_data, trigger->position, trigger->radius);
-    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH)
+    IntPair pair;
+    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH) {
+        pair = compute_bucket_range(&map->spatial_hash_data, trigger->position, trigger->radius);
         buckets_insert_object_spatial_hash(map, trigger, BUCKET_TRIGGERS, &trigger->map_info, pair.bl_bucket_idx, pair.tr_bucket_idx);
+    } else if (map->collision_strategy == MAP_COLLIDE_QUADTREE)
+        buckets_insert_object_quadtree(map, trigger, BUCKET_TRIGGERS, &trigger->map_info);
 }
 
 void buckets_insert_entity(Map* map, Entity* entity)
 {
-    IntPair pair = compute_bucket_range(&map->spatial_hash_data, entity->position, entity->size / 2);
-    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH)
+    IntPair pair;
+    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH) {
+        pair = compute_bucket_range(&map->spatial_hash_data, entity->position, entity->size / 2);
         buckets_insert_object_spatial_hash(map, entity, BUCKET_ENTITIES, &entity->map_info, pair.bl_bucket_idx, pair.tr_bucket_idx);
+    }
 }
 
 void buckets_insert_projectile(Map* map, Projectile* projectile)
 {
-    IntPair pair = compute_bucket_range(&map->spatial_hash_data, projectile->position, projectile->size / 2);
-    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH)
+    IntPair pair;
+    vec2 center;
+    f32 radius;
+    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH) {
+        projectile_bounds(projectile, &center, &radius);
+        pair = compute_bucket_range(&map->spatial_hash_data, center, radius);
         buckets_insert_object_spatial_hash(map, projectile, BUCKET_PROJECTILES, &projectile->map_info, pair.bl_bucket_idx, pair.tr_bucket_idx);
+    } else if (map->collision_strategy == MAP_COLLIDE_QUADTREE)
+        buckets_insert_object_quadtree(map, projectile, BUCKET_PROJECTILES, &projectile->map_info);
 }
 
 void buckets_insert_obstacle(Map* map, Obstacle* obstacle)
 {
-    IntPair pair = compute_bucket_range(&map->spatial_hash_data, obstacle->position, obstacle->size / 2);
-    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH) 
+    IntPair pair;
+    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH) {
+        pair = compute_bucket_range(&map->spatial_hash_data, obstacle->position, obstacle->size / 2);
         buckets_insert_object_spatial_hash(map, obstacle, BUCKET_OBSTACLES, &obstacle->map_info, pair.bl_bucket_idx, pair.tr_bucket_idx);
+    } else if (map->collision_strategy == MAP_COLLIDE_QUADTREE)
+        buckets_insert_object_quadtree(map, obstacle, BUCKET_OBSTACLES, &obstacle->map_info);
 }
 
 void buckets_insert_aoe(Map* map, AOE* aoe)
 {
-    IntPair pair = compute_bucket_range(&map->spatial_hash_data, aoe->position, aoe->radius);
-    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH)
+    IntPair pair;
+    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH) {
+        pair = compute_bucket_range(&map->spatial_hash_data, aoe->position, aoe->radius);
         buckets_insert_object_spatial_hash(map, aoe, BUCKET_AOES, &aoe->map_info, pair.bl_bucket_idx, pair.tr_bucket_idx);
+    } else if (map->collision_strategy == MAP_COLLIDE_QUADTREE)
+        buckets_insert_object_quadtree(map, aoe, BUCKET_AOES, &aoe->map_info);
 }
 
 void buckets_update_trigger(Map* map, Trigger* trigger)
 {
-    IntPair pair = compute_bucket_range(&map->spatial_hash_data, trigger->position, trigger->radius);
-    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH)
+    IntPair pair;
+    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH) {
+        pair = compute_bucket_range(&map->spatial_hash_data, trigger->position, trigger->radius);
         buckets_update_object_spatial_hash(map, trigger, BUCKET_TRIGGERS, &trigger->map_info, pair.bl_bucket_idx, pair.tr_bucket_idx);
+    } else if (map->collision_strategy == MAP_COLLIDE_QUADTREE)
+        buckets_update_object_quadtree(map, trigger, BUCKET_TRIGGERS, &trigger->map_info);
 }
 
 void buckets_update_entity(Map* map, Entity* entity)
 {
-    IntPair pair = compute_bucket_range(&map->spatial_hash_data, entity->position, entity->size / 2);
-    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH)
+    IntPair pair;
+    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH) {
+        pair = compute_bucket_range(&map->spatial_hash_data, entity->position, entity->size / 2);
         buckets_update_object_spatial_hash(map, entity, BUCKET_ENTITIES, &entity->map_info, pair.bl_bucket_idx, pair.tr_bucket_idx);
+    }
 }
 
 void buckets_update_projectile(Map* map, Projectile* projectile)
 {
-    IntPair pair = compute_bucket_range(&map->spatial_hash_data, projectile->position, projectile->size / 2);
-    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH)
+    IntPair pair;
+    vec2 center;
+    f32 radius;
+    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH) {
+        projectile_bounds(projectile, &center, &radius);
+        pair = compute_bucket_range(&map->spatial_hash_data, center, radius);
         buckets_update_object_spatial_hash(map, projectile, BUCKET_PROJECTILES, &projectile->map_info, pair.bl_bucket_idx, pair.tr_bucket_idx);
+    } else if (map->collision_strategy == MAP_COLLIDE_QUADTREE)
+        buckets_update_object_quadtree(map, projectile, BUCKET_PROJECTILES, &projectile->map_info);
 }
 
 void buckets_update_obstacle(Map* map, Obstacle* obstacle)
 {
-    IntPair pair = compute_bucket_range(&map->spatial_hash_data, obstacle->position, obstacle->size / 2);
-    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH)
+    IntPair pair;
+    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH) {
+        pair = compute_bucket_range(&map->spatial_hash_data, obstacle->position, obstacle->size / 2);
         buckets_update_object_spatial_hash(map, obstacle, BUCKET_OBSTACLES, &obstacle->map_info, pair.bl_bucket_idx, pair.tr_bucket_idx);
+    } else if (map->collision_strategy == MAP_COLLIDE_QUADTREE)
+        buckets_update_object_quadtree(map, obstacle, BUCKET_OBSTACLES, &obstacle->map_info);
 }
 
 void buckets_update_aoe(Map* map, AOE* aoe)
 {
-    IntPair pair = compute_bucket_range(&map->spatial_hash_data, aoe->position, aoe->radius);
-    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH)
+    IntPair pair;
+    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH) {
+        pair = compute_bucket_range(&map->spatial_hash_data, aoe->position, aoe->radius);
         buckets_update_object_spatial_hash(map, aoe, BUCKET_AOES, &aoe->map_info, pair.bl_bucket_idx, pair.tr_bucket_idx);
+    } else if (map->collision_strategy == MAP_COLLIDE_QUADTREE)
+        buckets_update_object_quadtree(map, aoe, BUCKET_AOES, &aoe->map_info);
 }
 
 void buckets_remove_trigger(Map* map, Trigger* trigger)
 {
     if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH)
         buckets_remove_object_spatial_hash(map, trigger, BUCKET_TRIGGERS, &trigger->map_info);
+    else if (map->collision_strategy == MAP_COLLIDE_QUADTREE)
+        buckets_remove_object_quadtree(map, trigger, BUCKET_TRIGGERS, &trigger->map_info);
 }
 
 void buckets_remove_entity(Map* map, Entity* entity)
@@ -2925,43 +3648,57 @@ void buckets_remove_projectile(Map* map, Projectile* projectile)
 {
     if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH)
         buckets_remove_object_spatial_hash(map, projectile, BUCKET_PROJECTILES, &projectile->map_info);
+    else if (map->collision_strategy == MAP_COLLIDE_QUADTREE)
+        buckets_remove_object_quadtree(map, projectile, BUCKET_PROJECTILES, &projectile->map_info);
 }
 
 void buckets_remove_obstacle(Map* map, Obstacle* obstacle)
 {
     if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH)
         buckets_remove_object_spatial_hash(map, obstacle, BUCKET_OBSTACLES, &obstacle->map_info);
+    else if (map->collision_strategy == MAP_COLLIDE_QUADTREE)
+        buckets_remove_object_quadtree(map, obstacle, BUCKET_OBSTACLES, &obstacle->map_info);
 }
 
 void buckets_remove_aoe(Map* map, AOE* aoe)
 {
     if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH)
         buckets_remove_object_spatial_hash(map, aoe, BUCKET_AOES, &aoe->map_info);
+    else if (map->collision_strategy == MAP_COLLIDE_QUADTREE)
+        buckets_remove_object_quadtree(map, aoe, BUCKET_AOES, &aoe->map_info);
 }
 
 void buckets_insert_free_wall(Map* map, Wall* wall)
 {
-    i32 bl_bucket_idx = spatial_hash_bucket_idx(&map->spatial_hash_data, wall->position);
-    i32 tr_bucket_idx = spatial_hash_bucket_idx(&map->spatial_hash_data, vec2_add(wall->position, wall->size));
-    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH)
+    i32 bl_bucket_idx, tr_bucket_idx;
+    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH) {
+        bl_bucket_idx = spatial_hash_bucket_idx(&map->spatial_hash_data, wall->position);
+        tr_bucket_idx = spatial_hash_bucket_idx(&map->spatial_hash_data, vec2_add(wall->position, wall->size));
         buckets_insert_object_spatial_hash(map, wall, BUCKET_FREE_WALLS, &wall->map_info, bl_bucket_idx, tr_bucket_idx);
+    } else if (map->collision_strategy == MAP_COLLIDE_QUADTREE)
+        buckets_insert_object_quadtree(map, wall, BUCKET_FREE_WALLS, &wall->map_info);
 }
 
 void buckets_update_free_wall(Map* map, Wall* wall)
 {
-    i32 bl_bucket_idx = spatial_hash_bucket_idx(&map->spatial_hash_data, wall->position);
-    i32 tr_bucket_idx = spatial_hash_bucket_idx(&map->spatial_hash_data, vec2_add(wall->position, wall->size));
-    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH)
+    i32 bl_bucket_idx, tr_bucket_idx;
+    if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH) {
+        bl_bucket_idx = spatial_hash_bucket_idx(&map->spatial_hash_data, wall->position);
+        tr_bucket_idx = spatial_hash_bucket_idx(&map->spatial_hash_data, vec2_add(wall->position, wall->size));
         buckets_update_object_spatial_hash(map, wall, BUCKET_FREE_WALLS, &wall->map_info, bl_bucket_idx, tr_bucket_idx);
+    } else if (map->collision_strategy == MAP_COLLIDE_QUADTREE)
+        buckets_update_object_quadtree(map, wall, BUCKET_FREE_WALLS, &wall->map_info);
 }
 
 void buckets_remove_free_wall(Map* map, Wall* wall)
 {
     if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH)
         buckets_remove_object_spatial_hash(map, wall, BUCKET_FREE_WALLS, &wall->map_info);
+    else if (map->collision_strategy == MAP_COLLIDE_QUADTREE)
+        buckets_remove_object_quadtree(map, wall, BUCKET_FREE_WALLS, &wall->map_info);
 }
 
-static void map_update_objects(Map* map, f32 dt)
+void map_update_objects(Map* map, f32 dt)
 {
     i32 i, once, used, delete;
     // trigger updates MUST be before entity updates since trigger updates
@@ -2975,7 +3712,7 @@ static void map_update_objects(Map* map, f32 dt)
         used = trigger_get_flag(trigger, TRIGGER_FLAG_USED);
         if ((once && used) || delete) {
             buckets_remove_trigger(map, trigger);
-            trigger_destroy(list_remove(map->triggers, i));
+            trigger_destroy(&map->trigger_slab, list_remove(map->triggers, i));
         } else {
             trigger_update(trigger);
             buckets_update_trigger(map, trigger);
@@ -2992,50 +3729,34 @@ static void map_update_objects(Map* map, f32 dt)
             if (entity_get_flag(entity, ENTITY_FLAG_BOSS))
                 map_unmake_boss(entity);
             buckets_remove_entity(map, entity);
-            entity_destroy(list_remove(map->entities, i));
+            entity_destroy(&map->entity_slab, list_remove(map->entities, i));
         } else {
             buckets_update_entity(map, entity);
             i++;
         }
     }
     map_context.current_map_node = NULL;
+    projectile_update_all(&map->projectile_pool, dt);
     i = 0;
     while (i < map->projectiles->length) {
         Projectile* projectile = list_get(map->projectiles, i);
-        projectile_update(projectile, dt);
-        if (projectile->lifetime <= 0) {
+        if (projectile_lifetime(projectile) <= 0) {
             buckets_remove_projectile(map, projectile);
-            projectile_destroy(list_remove(map->projectiles, i));
+            projectile_destroy(&map->projectile_pool, list_remove(map->projectiles, i));
         } else {
             buckets_update_projectile(map, projectile);
             i++;
         }
     }
-    i = 0;
-    while (i < map->particles->length) {
-        Particle* particle = list_get(map->particles, i);
-        particle_update(particle, dt);
-        if (particle->lifetime <= 0)
-            particle_destroy(list_remove(map->particles, i));
-        else
-            i++;
-    }
-    i = 0;
-    while (i < map->parjicles->length) {
-        Parjicle* parjicle = list_get(map->parjicles, i);
-        parjicle_update(parjicle, dt);
-        if (parjicle->lifetime <= 0)
-            parjicle_destroy(list_remove(map->parjicles, i));
-        else
-            i++;
-    }
+    particle_update_all(&map->particles, dt);
+    parjicle_update_all(&map->parjicles, dt);
     i = 0;
     while (i < map->aoes->length) {
         AOE* aoe = list_get(map->aoes, i);
         aoe_update(aoe, dt);
         if ((!aoe_get_flag(aoe, AOE_FLAG_LINGER) && aoe_get_flag(aoe, AOE_FLAG_USED)) || (aoe_get_flag(aoe, AOE_FLAG_LINGER) && aoe->lifetime <= 0)) {
             buckets_remove_aoe(map, aoe);
-            aoe_destroy(list_remove(map->aoes, i));
+            aoe_destroy(&map->aoe_slab, list_remove(map->aoes, i));
         } else {
             aoe_set_flag(aoe, AOE_FLAG_USED, true);
             buckets_update_aoe(map, aoe);
@@ -3052,99 +3773,420 @@ static void map_update_objects(Map* map, f32 dt)
     }
 }
 
-static void map_collide_tilemap(Map* map)
+// walks the tiles under the segment from prev_position to position
+// in order with a dda, testing the walls around each tile the
+// projectile square can touch. stops once a tile is entered later
+// than the earliest wall hit, only that wall stops the projectile
+static void collide_projectile_tilemap(Map* map, Projectile* projectile)
+{
+    vec2 p = projectile_prev_position(projectile);
+    vec2 d = vec2_sub(projectile_position(projectile), p);
+    i32 reach = ceil(projectile->size / 2);
+    i32 x = floor(p.x), z = floor(p.z);
+    i32 end_x = floor(p.x + d.x), end_z = floor(p.z + d.z);
+    i32 step_x = d.x > 0 ? 1 : -1, step_z = d.z > 0 ? 1 : -1;
+    f64 delta_x = d.x != 0 ? fabs(1 / d.x) : INFINITY;
+    f64 delta_z = d.z != 0 ? fabs(1 / d.z) : INFINITY;
+    f64 next_x = d.x > 0 ? (x + 1 - p.x) * delta_x : (p.x - x) * delta_x;
+    f64 next_z = d.z > 0 ? (z + 1 - p.z) * delta_z : (p.z - z) * delta_z;
+    f64 t = 0;
+    f32 best_t = 2, hit_t;
+    Wall* best = NULL;
+    Wall* wall;
+    i32 i, j;
+    if (d.x == 0)
+        next_x = INFINITY;
+    if (d.z == 0)
+        next_z = INFINITY;
+    while (true) {
+        for (i = x - reach; i <= x + reach; i++) {
+            for (j = z - reach; j <= z + reach; j++) {
+                wall = map_get_wall(map, i, j);
+                if (wall == NULL)
+                    continue;
+                hit_t = sweep_projectile_wall(projectile, wall);
+                if (hit_t >= 0 && hit_t < best_t) {
+                    best_t = hit_t;
+                    best = wall;
+                }
+            }
+        }
+        if (x == end_x && z == end_z)
+            break;
+        if (z == end_z || (x != end_x && next_x < next_z)) {
+            t = next_x;
+            next_x += delta_x;
+            x += step_x;
+        } else {
+            t = next_z;
+            next_z += delta_z;
+            z += step_z;
+        }
+        if (t > best_t)
+            break;
+    }
+    if (best != NULL)
+        collide_projectile_wall(projectile, best);
+}
+
+void map_collide_tilemap(Map* map)
 {
     vec2 pos;
     f32 r;
-    i32 i, x, z;
-    Tile* tile;
-    Wall* wall;
+    i32 i, x, z, idx;
+    MapChunk* chunk;
     for (i = 0; i < map->entities->length; i++) {
         Entity* entity = list_get(map->entities, i);
         pos = entity->position;
         r = entity->size / 2;
         for (x = floor(pos.x-r); x <= ceil(pos.x+r); x++) {
             for (z = floor(pos.z-r); z <= ceil(pos.z+r); z++) {
-                tile = map_get_tile(map, x, z);
-                wall = map_get_wall(map, x, z);
-                if (tile != NULL)
-                    collide_entity_tile(entity, tile);
-                if (wall != NULL)
-                    collide_entity_wall(entity, wall);
+                // tiles with nothing to collide with are skipped
+                // with one bit test
+                chunk = get_chunk(map, x, z, false);
+                if (chunk == NULL || !chunk_mask_isset(chunk->collide_mask, x, z))
+                    continue;
+                idx = chunk_idx(x, z);
+                if (chunk_mask_isset(chunk->wall_mask, x, z))
+                    collide_entity_wall(entity, chunk->tiles[idx]);
+                else if (overlap_entity_tile(entity, x, z))
+                    map->tile_collide_funcs[chunk->tile_collide[idx]](entity);
             }
         }
     }
-    for (i = 0; i < map->projectiles->length; i++) {
-        Projectile* projectile = list_get(map->projectiles, i);
-        pos = projectile->position;
-        r = projectile->size / 2;
-        for (x = floor(pos.x-r); x <= ceil(pos.x+r); x++) {
-            for (z = floor(pos.z-r); z <= ceil(pos.z+r); z++) {
-                wall = map_get_wall(map, x, z);
-                if (wall != NULL)
-                    collide_projectile_wall(projectile, wall);
+    for (i = 0; i < map->projectiles->length; i++)
+        collide_projectile_tilemap(map, list_get(map->projectiles, i));
+}
+
+// collisions of entity with the objects of a bucket, in the serial
+// order, starting at the start-th object of the type list
+static u64 spatial_hash_collide_entity(Map* map, i32 bucket_idx, Entity* entity, ContactType type, i32 start)
+{
+    SpatialHashData* data = &map->spatial_hash_data;
+    Bucket* bucket = &data->buckets[bucket_idx];
+    u64 candidate_pairs = 0;
+    i32 j;
+    if (type <= CONTACT_ENTITY_OBSTACLE) {
+        for (j = start; j < bucket->obstacles->length; j++) {
+            Obstacle* obstacle = list_get(bucket->obstacles, j);
+            if (bucket_idx == least_common_bucket_idx_assuming_same_bucket(data, &entity->map_info, &obstacle->map_info)) {
+                candidate_pairs++;
+                collide_entity_obstacle(entity, obstacle);
+            }
+        }
+        start = 0;
+    }
+    if (type <= CONTACT_ENTITY_FREE_WALL) {
+        for (j = start; j < bucket->free_walls->length; j++) {
+            Wall* wall = list_get(bucket->free_walls, j);
+            candidate_pairs++;
+            collide_entity_wall(entity, wall);
+        }
+        start = 0;
+    }
+    if (type <= CONTACT_ENTITY_PROJECTILE) {
+        for (j = start; j < bucket->projectiles->length; j++) {
+            Projectile* projectile = list_get(bucket->projectiles, j);
+            if (bucket_idx == least_common_bucket_idx_assuming_same_bucket(data, &entity->map_info, &projectile->map_info)) {
+                candidate_pairs++;
+                collide_entity_projectile(entity, projectile);
             }
         }
+        start = 0;
     }
+    if (type <= CONTACT_ENTITY_TRIGGER) {
+        for (j = start; j < bucket->triggers->length; j++) {
+            Trigger* trigger = list_get(bucket->triggers, j);
+            if (bucket_idx == least_common_bucket_idx_assuming_same_bucket(data, &entity->map_info, &trigger->map_info)) {
+                candidate_pairs++;
+                collide_entity_trigger(entity, trigger);
+            }
+        }
+        start = 0;
+    }
+    if (type <= CONTACT_ENTITY_AOE) {
+        for (j = start; j < bucket->aoes->length; j++) {
+            AOE* aoe = list_get(bucket->aoes, j);
+            if  (aoe->timer >= 0) continue;
+            if (bucket_idx == least_common_bucket_idx_assuming_same_bucket(data, &entity->map_info, &aoe->map_info)) {
+                candidate_pairs++;
+                collide_entity_aoe(entity, aoe);
+            }
+        }
+    }
+    return candidate_pairs;
+}
+
+static u64 spatial_hash_collide_projectiles(Map* map, i32 bucket_idx)
+{
+    SpatialHashData* data = &map->spatial_hash_data;
+    Bucket* bucket = &data->buckets[bucket_idx];
+    u64 candidate_pairs = 0;
+    i32 i, j;
+    for (i = 0; i < bucket->projectiles->length; i++) {
+        Projectile* projectile = list_get(bucket->projectiles, i);
+        if (projectile_lifetime(projectile) <= 0) continue;
+        for (j = 0; j < bucket->obstacles->length; j++) {
+            Obstacle* obstacle = list_get(bucket->obstacles, j);
+            if (bucket_idx == least_common_bucket_idx_assuming_same_bucket(data, &projectile->map_info, &obstacle->map_info)) {
+                candidate_pairs++;
+                collide_projectile_obstacle(projectile, obstacle);
+            }
+        }
+        for (j = 0; j < bucket->free_walls->length; j++) {
+            Wall* wall = list_get(bucket->free_walls, j);
+            candidate_pairs++;
+            collide_projectile_wall(projectile, wall);
+        }
+    }
+    return candidate_pairs;
+}
+
+static u64 spatial_hash_collide_bucket(Map* map, i32 bucket_idx)
+{
+    Bucket* bucket = &map->spatial_hash_data.buckets[bucket_idx];
+    u64 candidate_pairs = 0;
+    for (i32 i = 0; i < bucket->entities->length; i++)
+        candidate_pairs += spatial_hash_collide_entity(map, bucket_idx, list_get(bucket->entities, i), CONTACT_ENTITY_OBSTACLE, 0);
+    candidate_pairs += spatial_hash_collide_projectiles(map, bucket_idx);
+    return candidate_pairs;
+}
+
+static void contact_list_push(ContactList* list, ContactType type, i32 i, i32 j)
+{
+    if (list->num_contacts == list->contacts_capacity) {
+        list->contacts_capacity = (list->contacts_capacity == 0) ? 256 : 2 * list->contacts_capacity;
+        list->contacts = st_realloc(list->contacts, list->contacts_capacity * sizeof(Contact));
+    }
+    list->contacts[list->num_contacts++] = (Contact) { type, i, j };
+}
+
+static void contact_list_push_position(ContactList* list, vec2 position)
+{
+    if (list->num_positions == list->positions_capacity) {
+        list->positions_capacity = (list->positions_capacity == 0) ? 256 : 2 * list->positions_capacity;
+        list->positions = st_realloc(list->positions, list->positions_capacity * sizeof(vec2));
+    }
+    list->positions[list->num_positions++] = position;
 }
 
-static void map_collide_objects_spatial_hash(Map* map)
+// first phase, run in parallel over ranges of buckets. walks each bucket
+// in the serial order and records every pair that overlaps, without
+// touching the objects. the only filters applied besides the overlap
+// tests are ones a response can never undo (dead projectiles, pierce
+// cooldowns, friendliness), so no pair the serial pass would respond
+// to is missed as long as nothing moves
+static void spatial_hash_find_contacts(void* arg, i32 start, i32 end)
 {
+    Map* map = arg;
     SpatialHashData* data = &map->spatial_hash_data;
-    for (i32 bucket_idx = 0; bucket_idx < data->num_buckets; bucket_idx++) {
-        i32 i, j;
-        Bucket* bucket = &data->buckets[bucket_idx];
-        List* entities = bucket->entities;
-        List* obstacles = bucket->obstacles;
-        List* free_walls = bucket->free_walls;
-        List* projectiles = bucket->projectiles;
-        List* triggers = bucket->triggers;
-        List* aoes = bucket->aoes;
-        for (i = 0; i < entities->length; i++) {
-            Entity* entity = list_get(entities, i);
-            for (j = 0; j < obstacles->length; j++) {
-                Obstacle* obstacle = list_get(obstacles, j);
-                if (bucket_idx == least_common_bucket_idx_assuming_same_bucket(&map->spatial_hash_data, &entity->map_info, &obstacle->map_info))
-                    collide_entity_obstacle(entity, obstacle);
+    ContactList* list = &data->contact_lists[start / data->contact_grain];
+    BucketContacts* bucket_contacts;
+    Bucket* bucket;
+    i32 bucket_idx, i, j;
+
+    list->num_contacts = 0;
+    list->num_positions = 0;
+    list->candidate_pairs = 0;
+    for (bucket_idx = start; bucket_idx < end; bucket_idx++) {
+        bucket = &data->buckets[bucket_idx];
+        bucket_contacts = &data->bucket_contacts[bucket_idx];
+        for (i = 0; i < 6; i++)
+            bucket_contacts->lengths[i] = get_bucket_list_from_type(bucket, i)->length;
+        bucket_contacts->contacts_start = list->num_contacts;
+        bucket_contacts->positions_start = list->num_positions;
+        for (i = 0; i < bucket->entities->length; i++) {
+            Entity* entity = list_get(bucket->entities, i);
+            contact_list_push_position(list, entity->position);
+            for (j = 0; j < bucket->obstacles->length; j++) {
+                Obstacle* obstacle = list_get(bucket->obstacles, j);
+                if (bucket_idx != least_common_bucket_idx_assuming_same_bucket(data, &entity->map_info, &obstacle->map_info))
+                    continue;
+                list->candidate_pairs++;
+                if (overlap_entity_obstacle(entity, obstacle))
+                    contact_list_push(list, CONTACT_ENTITY_OBSTACLE, i, j);
             }
-            for (j = 0; j < free_walls->length; j++) {
-                Wall* wall = list_get(free_walls, j);
-                collide_entity_wall(entity, wall);
+            for (j = 0; j < bucket->free_walls->length; j++) {
+                Wall* wall = list_get(bucket->free_walls, j);
+                list->candidate_pairs++;
+                if (overlap_entity_wall(entity, wall))
+                    contact_list_push(list, CONTACT_ENTITY_FREE_WALL, i, j);
             }
-            for (j = 0; j < projectiles->length; j++) {
-                Projectile* projectile = list_get(projectiles, j);
-                if (bucket_idx == least_common_bucket_idx_assuming_same_bucket(&map->spatial_hash_data, &entity->map_info, &projectile->map_info))
-                    collide_entity_projectile(entity, projectile);
+            for (j = 0; j < bucket->projectiles->length; j++) {
+                Projectile* projectile = list_get(bucket->projectiles, j);
+                if (bucket_idx != least_common_bucket_idx_assuming_same_bucket(data, &entity->map_info, &projectile->map_info))
+                    continue;
+                list->candidate_pairs++;
+                if (projectile_lifetime(projectile) <= 0)
+                    continue;
+                if (entity_get_flag(entity, ENTITY_FLAG_FRIENDLY) == projectile_get_flag(projectile, PROJECTILE_FLAG_FRIENDLY))
+                    continue;
+                if (projectile_get_flag(projectile, PROJECTILE_FLAG_PIERCE) && projectile_pierce_timer(projectile) >= 0)
+                    continue;
+                if (overlap_entity_projectile(entity, projectile))
+                    contact_list_push(list, CONTACT_ENTITY_PROJECTILE, i, j);
             }
-            for (j = 0; j < triggers->length; j++) {
-                Trigger* trigger = list_get(triggers, j);
-                if (bucket_idx == least_common_bucket_idx_assuming_same_bucket(&map->spatial_hash_data, &entity->map_info, &trigger->map_info))
-                    collide_entity_trigger(entity, trigger);
+            for (j = 0; j < bucket->triggers->length; j++) {
+                Trigger* trigger = list_get(bucket->triggers, j);
+                if (bucket_idx != least_common_bucket_idx_assuming_same_bucket(data, &entity->map_info, &trigger->map_info))
+                    continue;
+                list->candidate_pairs++;
+                if (overlap_entity_trigger(entity, trigger))
+                    contact_list_push(list, CONTACT_ENTITY_TRIGGER, i, j);
             }
-            for (j = 0; j < aoes->length; j++) {
-                AOE* aoe = list_get(aoes, j);
+            for (j = 0; j < bucket->aoes->length; j++) {
+                AOE* aoe = list_get(bucket->aoes, j);
                 if  (aoe->timer >= 0) continue;
-                if (bucket_idx == least_common_bucket_idx_assuming_same_bucket(&map->spatial_hash_data, &entity->map_info, &aoe->map_info))
-                    collide_entity_aoe(entity, aoe);
+                if (bucket_idx != least_common_bucket_idx_assuming_same_bucket(data, &entity->map_info, &aoe->map_info))
+                    continue;
+                list->candidate_pairs++;
+                if (overlap_entity_aoe(entity, aoe))
+                    contact_list_push(list, CONTACT_ENTITY_AOE, i, j);
             }
         }
-        for (i = 0; i < projectiles->length; i++) {
-            Projectile* projectile = list_get(projectiles, i);
-            if (projectile->lifetime <= 0) continue;
-            for (j = 0; j < obstacles->length; j++) {
-                Obstacle* obstacle = list_get(obstacles, j);
-                if (bucket_idx == least_common_bucket_idx_assuming_same_bucket(&map->spatial_hash_data, &projectile->map_info, &obstacle->map_info))
-                    collide_projectile_obstacle(projectile, obstacle);
+        for (i = 0; i < bucket->projectiles->length; i++) {
+            Projectile* projectile = list_get(bucket->projectiles, i);
+            if (projectile_lifetime(projectile) <= 0) continue;
+            for (j = 0; j < bucket->obstacles->length; j++) {
+                Obstacle* obstacle = list_get(bucket->obstacles, j);
+                if (bucket_idx != least_common_bucket_idx_assuming_same_bucket(data, &projectile->map_info, &obstacle->map_info))
+                    continue;
+                list->candidate_pairs++;
+                if (overlap_projectile_obstacle(projectile, obstacle))
+                    contact_list_push(list, CONTACT_PROJECTILE_OBSTACLE, i, j);
+            }
+            for (j = 0; j < bucket->free_walls->length; j++) {
+                Wall* wall = list_get(bucket->free_walls, j);
+                list->candidate_pairs++;
+                if (overlap_projectile_wall(projectile, wall))
+                    contact_list_push(list, CONTACT_PROJECTILE_FREE_WALL, i, j);
             }
-            for (j = 0; j < free_walls->length; j++) {
-                Wall* wall = list_get(free_walls, j);
-                collide_projectile_wall(projectile, wall);
+        }
+        bucket_contacts->contacts_end = list->num_contacts;
+    }
+}
+
+static void spatial_hash_resolve_contact(Bucket* bucket, Contact* contact)
+{
+    switch (contact->type) {
+        case CONTACT_ENTITY_OBSTACLE:
+            collide_entity_obstacle(list_get(bucket->entities, contact->i), list_get(bucket->obstacles, contact->j));
+            break;
+        case CONTACT_ENTITY_FREE_WALL:
+            collide_entity_wall(list_get(bucket->entities, contact->i), list_get(bucket->free_walls, contact->j));
+            break;
+        case CONTACT_ENTITY_PROJECTILE:
+            collide_entity_projectile(list_get(bucket->entities, contact->i), list_get(bucket->projectiles, contact->j));
+            break;
+        case CONTACT_ENTITY_TRIGGER:
+            collide_entity_trigger(list_get(bucket->entities, contact->i), list_get(bucket->triggers, contact->j));
+            break;
+        case CONTACT_ENTITY_AOE:
+            collide_entity_aoe(list_get(bucket->entities, contact->i), list_get(bucket->aoes, contact->j));
+            break;
+        case CONTACT_PROJECTILE_OBSTACLE:
+            collide_projectile_obstacle(list_get(bucket->projectiles, contact->i), list_get(bucket->obstacles, contact->j));
+            break;
+        case CONTACT_PROJECTILE_FREE_WALL:
+            collide_projectile_wall(list_get(bucket->projectiles, contact->i), list_get(bucket->free_walls, contact->j));
+            break;
+    }
+}
+
+// second phase, on the calling thread. replays the contacts bucket by
+// bucket in the order the serial pass would have found them, calling
+// the same collide functions. pushing an entity out of an obstacle or
+// wall moves it, which can make pairs overlap that were not recorded,
+// so once an entity is no longer where it was tested the rest of its
+// work in the bucket is redone serially. buckets whose lists changed
+// under the replay (objects spawned by a hit or trigger) are redone
+// serially as a whole
+static void spatial_hash_resolve_bucket(Map* map, i32 bucket_idx)
+{
+    SpatialHashData* data = &map->spatial_hash_data;
+    BucketContacts* bucket_contacts = &data->bucket_contacts[bucket_idx];
+    ContactList* list = &data->contact_lists[bucket_idx / data->contact_grain];
+    Bucket* bucket = &data->buckets[bucket_idx];
+    Contact* contact;
+    Entity* entity;
+    vec2 position;
+    bool alive;
+    i32 i, k;
+
+    for (i = 0; i < 6; i++) {
+        if (get_bucket_list_from_type(bucket, i)->length != bucket_contacts->lengths[i]) {
+            spatial_hash_collide_bucket(map, bucket_idx);
+            return;
+        }
+    }
+
+    k = bucket_contacts->contacts_start;
+    for (i = 0; i < bucket->entities->length; i++) {
+        entity = list_get(bucket->entities, i);
+        position = list->positions[bucket_contacts->positions_start + i];
+        if (!vec2_equal(entity->position, position)) {
+            while (k < bucket_contacts->contacts_end && list->contacts[k].type <= CONTACT_ENTITY_AOE && list->contacts[k].i == i)
+                k++;
+            spatial_hash_collide_entity(map, bucket_idx, entity, CONTACT_ENTITY_OBSTACLE, 0);
+            continue;
+        }
+        while (k < bucket_contacts->contacts_end && list->contacts[k].type <= CONTACT_ENTITY_AOE && list->contacts[k].i == i) {
+            contact = &list->contacts[k++];
+            spatial_hash_resolve_contact(bucket, contact);
+            if (!vec2_equal(entity->position, position)) {
+                while (k < bucket_contacts->contacts_end && list->contacts[k].type <= CONTACT_ENTITY_AOE && list->contacts[k].i == i)
+                    k++;
+                spatial_hash_collide_entity(map, bucket_idx, entity, contact->type, contact->j + 1);
+                break;
             }
         }
     }
+    // a projectile can be killed after its contacts were found, by an
+    // entity or in an earlier bucket. like the serial pass it is then
+    // skipped, but one killed by its own first contact here still
+    // gets the rest of them
+    while (k < bucket_contacts->contacts_end) {
+        i = list->contacts[k].i;
+        alive = projectile_lifetime(list_get(bucket->projectiles, i)) > 0;
+        for (; k < bucket_contacts->contacts_end && list->contacts[k].i == i; k++)
+            if (alive)
+                spatial_hash_resolve_contact(bucket, &list->contacts[k]);
+    }
+}
+
+static u64 map_collide_objects_spatial_hash(Map* map)
+{
+    SpatialHashData* data = &map->spatial_hash_data;
+    u64 candidate_pairs = 0;
+    i32 num_lists, i;
+
+    if (job_num_workers() == 0) {
+        for (i = 0; i < data->num_buckets; i++)
+            candidate_pairs += spatial_hash_collide_bucket(map, i);
+        return candidate_pairs;
+    }
+
+    // a few ranges per thread so a crowded range does not stall the rest
+    data->contact_grain = maxi(MAP_CONTACT_MIN_GRAIN, data->num_buckets / (4 * (job_num_workers() + 1)));
+    num_lists = (data->num_buckets + data->contact_grain - 1) / data->contact_grain;
+    if (data->bucket_contacts == NULL)
+        data->bucket_contacts = st_malloc(data->num_buckets * sizeof(BucketContacts));
+    if (num_lists > data->num_contact_lists) {
+        data->contact_lists = st_realloc(data->contact_lists, num_lists * sizeof(ContactList));
+        memset(data->contact_lists + data->num_contact_lists, 0, (num_lists - data->num_contact_lists) * sizeof(ContactList));
+        data->num_contact_lists = num_lists;
+    }
+
+    job_parallel_for(spatial_hash_find_contacts, map, data->num_buckets, data->contact_grain);
+
+    for (i = 0; i < data->num_buckets; i++)
+        spatial_hash_resolve_bucket(map, i);
+    for (i = 0; i < num_lists; i++)
+        candidate_pairs += data->contact_lists[i].candidate_pairs;
+    return candidate_pairs;
 }
 
-static void map_collide_objects_naive(Map* map)
+static u64 map_collide_objects_naive(Map* map)
 {
     List* entities = map->entities;
     List* obstacles = map->obstacles;
@@ -3179,7 +4221,7 @@ static void map_collide_objects_naive(Map* map)
     }
     for (i = 0; i < projectiles->length; i++) {
         Projectile* projectile = list_get(projectiles, i);
-        if (projectile->lifetime <= 0) continue;
+        if (projectile_lifetime(projectile) <= 0) continue;
         for (j = 0; j < obstacles->length; j++) {
             Obstacle* obstacle = list_get(obstacles, j);
             collide_projectile_obstacle(projectile, obstacle);
@@ -3189,87 +4231,526 @@ static void map_collide_objects_naive(Map* map)
             collide_projectile_wall(projectile, wall);
         }
     }
+    return (u64)entities->length * (obstacles->length + free_walls->length + projectiles->length + triggers->length + aoes->length)
+         + (u64)projectiles->length * (obstacles->length + free_walls->length);
+}
+
+static inline i32 grid_clamp_cell(f32 x, i32 lo, i32 hi)
+{
+    if (x < lo) return lo;
+    if (x > hi) return hi;
+    return x;
+}
+
+static void grid_insert_object(UniformGridData* grid, void* object, i32 type, f32 x1, f32 z1, f32 x2, f32 z2)
+{
+    GridObject* grid_object;
+    i32 x, z, cell;
+    if (grid->num_objects == grid->objects_capacity) {
+        grid->objects_capacity = (grid->objects_capacity == 0) ? 256 : 2 * grid->objects_capacity;
+        grid->objects = st_realloc(grid->objects, grid->objects_capacity * sizeof(GridObject));
+    }
+    grid_object = &grid->objects[grid->num_objects++];
+    grid_object->object = object;
+    grid_object->type = type;
+    // objects outside the map are clamped onto the border cells
+    // so they still collide with each other
+    grid_object->x1 = grid_clamp_cell(floor(x1 / grid->cell_width), 0, grid->num_cells_wide - 1);
+    grid_object->z1 = grid_clamp_cell(floor(z1 / grid->cell_width), 0, grid->num_cells_long - 1);
+    grid_object->x2 = grid_clamp_cell(floor(x2 / grid->cell_width), 0, grid->num_cells_wide - 1);
+    grid_object->z2 = grid_clamp_cell(floor(z2 / grid->cell_width), 0, grid->num_cells_long - 1);
+    for (z = grid_object->z1; z <= grid_object->z2; z++) {
+        for (x = grid_object->x1; x <= grid_object->x2; x++) {
+            cell = x + z * grid->num_cells_wide;
+            if (grid->cell_count[cell]++ == 0)
+                grid->occupied_cells[grid->num_occupied_cells++] = cell;
+        }
+    }
+}
+
+static void grid_build(Map* map)
+{
+    UniformGridData* grid = &map->uniform_grid_data;
+    GridObject* grid_object;
+    i32 i, x, z, cell, total;
+    vec2 center;
+    f32 r;
+
+    grid->num_objects = 0;
+    grid->num_occupied_cells = 0;
+
+    // objects are inserted grouped by type, and the fill below is
+    // stable, so every cell ends up grouped by type as well
+    for (i = 0; i < map->entities->length; i++) {
+        Entity* entity = list_get(map->entities, i);
+        r = fmax(entity->size / 2, entity->hitbox_radius);
+        grid_insert_object(grid, entity, BUCKET_ENTITIES,
+            entity->position.x - r, entity->position.z - r,
+            entity->position.x + r, entity->position.z + r);
+    }
+    for (i = 0; i < map->free_walls->length; i++) {
+        Wall* wall = list_get(map->free_walls, i);
+        grid_insert_object(grid, wall, BUCKET_FREE_WALLS,
+            wall->position.x, wall->position.z,
+            wall->position.x + wall->size.x, wall->position.z + wall->size.z);
+    }
+    for (i = 0; i < map->projectiles->length; i++) {
+        Projectile* projectile = list_get(map->projectiles, i);
+        if (projectile_lifetime(projectile) <= 0) continue;
+        projectile_bounds(projectile, &center, &r);
+        grid_insert_object(grid, projectile, BUCKET_PROJECTILES,
+            center.x - r, center.z - r, center.x + r, center.z + r);
+    }
+    for (i = 0; i < map->obstacles->length; i++) {
+        Obstacle* obstacle = list_get(map->obstacles, i);
+        r = obstacle->size / 2;
+        grid_insert_object(grid, obstacle, BUCKET_OBSTACLES,
+            obstacle->position.x - r, obstacle->position.z - r,
+            obstacle->position.x + r, obstacle->position.z + r);
+    }
+    for (i = 0; i < map->triggers->length; i++) {
+        Trigger* trigger = list_get(map->triggers, i);
+        r = trigger->radius;
+        grid_insert_object(grid, trigger, BUCKET_TRIGGERS,
+            trigger->position.x - r, trigger->position.z - r,
+            trigger->position.x + r, trigger->position.z + r);
+    }
+    for (i = 0; i < map->aoes->length; i++) {
+        AOE* aoe = list_get(map->aoes, i);
+        if (aoe->timer >= 0) continue;
+        r = aoe->radius;
+        grid_insert_object(grid, aoe, BUCKET_AOES,
+            aoe->position.x - r, aoe->position.z - r,
+            aoe->position.x + r, aoe->position.z + r);
+    }
+
+    // cell_start holds the end of each cell's range until the fill
+    // below walks it back to the start
+    total = 0;
+    for (i = 0; i < grid->num_occupied_cells; i++) {
+        cell = grid->occupied_cells[i];
+        total += grid->cell_count[cell];
+        grid->cell_start[cell] = total;
+    }
+    if (total > grid->cell_objects_capacity) {
+        while (total > grid->cell_objects_capacity)
+            grid->cell_objects_capacity = (grid->cell_objects_capacity == 0) ? 1024 : 2 * grid->cell_objects_capacity;
+        grid->cell_objects = st_realloc(grid->cell_objects, grid->cell_objects_capacity * sizeof(i32));
+    }
+    for (i = grid->num_objects - 1; i >= 0; i--) {
+        grid_object = &grid->objects[i];
+        for (z = grid_object->z1; z <= grid_object->z2; z++)
+            for (x = grid_object->x1; x <= grid_object->x2; x++)
+                grid->cell_objects[--grid->cell_start[x + z * grid->num_cells_wide]] = i;
+    }
+}
+
+// a pair is only tested in the cell holding the min corner of
+// the overlap of both objects' cell ranges, so objects spanning
+// several cells are never tested twice
+static inline bool grid_owns_pair(GridObject* a, GridObject* b, i32 cx, i32 cz)
+{
+    i32 x = (a->x1 > b->x1) ? a->x1 : b->x1;
+    i32 z = (a->z1 > b->z1) ? a->z1 : b->z1;
+    return x == cx && z == cz;
+}
+
+static u64 map_collide_objects_uniform_grid(Map* map)
+{
+    UniformGridData* grid = &map->uniform_grid_data;
+    u64 candidate_pairs = 0;
+    GridObject *a, *b;
+    i32 type_start[7];
+    i32 i, j, k, cell, cx, cz, start, end, type;
+    i32* cell_objects;
+
+    grid_build(map);
+
+    for (k = 0; k < grid->num_occupied_cells; k++) {
+        cell = grid->occupied_cells[k];
+        cx = cell % grid->num_cells_wide;
+        cz = cell / grid->num_cells_wide;
+        start = grid->cell_start[cell];
+        end = start + grid->cell_count[cell];
+        cell_objects = grid->cell_objects;
+
+        type = 0;
+        for (i = start; i < end; i++)
+            while (type <= grid->objects[cell_objects[i]].type)
+                type_start[type++] = i;
+        while (type <= 6)
+            type_start[type++] = end;
+
+#define GRID_TYPE_BEGIN(t) type_start[t]
+#define GRID_TYPE_END(t)   type_start[(t)+1]
+        for (i = GRID_TYPE_BEGIN(BUCKET_ENTITIES); i < GRID_TYPE_END(BUCKET_ENTITIES); i++) {
+            a = &grid->objects[cell_objects[i]];
+            Entity* entity = a->object;
+            for (j = GRID_TYPE_BEGIN(BUCKET_OBSTACLES); j < GRID_TYPE_END(BUCKET_OBSTACLES); j++) {
+                b = &grid->objects[cell_objects[j]];
+                if (grid_owns_pair(a, b, cx, cz)) {
+                    candidate_pairs++;
+                    collide_entity_obstacle(entity, b->object);
+                }
+            }
+            for (j = GRID_TYPE_BEGIN(BUCKET_FREE_WALLS); j < GRID_TYPE_END(BUCKET_FREE_WALLS); j++) {
+                b = &grid->objects[cell_objects[j]];
+                if (grid_owns_pair(a, b, cx, cz)) {
+                    candidate_pairs++;
+                    collide_entity_wall(entity, b->object);
+                }
+            }
+            for (j = GRID_TYPE_BEGIN(BUCKET_PROJECTILES); j < GRID_TYPE_END(BUCKET_PROJECTILES); j++) {
+                b = &grid->objects[cell_objects[j]];
+                if (grid_owns_pair(a, b, cx, cz)) {
+                    candidate_pairs++;
+                    collide_entity_projectile(entity, b->object);
+                }
+            }
+            for (j = GRID_TYPE_BEGIN(BUCKET_TRIGGERS); j < GRID_TYPE_END(BUCKET_TRIGGERS); j++) {
+                b = &grid->objects[cell_objects[j]];
+                if (grid_owns_pair(a, b, cx, cz)) {
+                    candidate_pairs++;
+                    collide_entity_trigger(entity, b->object);
+                }
+            }
+            for (j = GRID_TYPE_BEGIN(BUCKET_AOES); j < GRID_TYPE_END(BUCKET_AOES); j++) {
+                b = &grid->objects[cell_objects[j]];
+                if (grid_owns_pair(a, b, cx, cz)) {
+                    candidate_pairs++;
+                    collide_entity_aoe(entity, b->object);
+                }
+            }
+        }
+        for (i = GRID_TYPE_BEGIN(BUCKET_PROJECTILES); i < GRID_TYPE_END(BUCKET_PROJECTILES); i++) {
+            a = &grid->objects[cell_objects[i]];
+            Projectile* projectile = a->object;
+            if (projectile_lifetime(projectile) <= 0) continue;
+            for (j = GRID_TYPE_BEGIN(BUCKET_OBSTACLES); j < GRID_TYPE_END(BUCKET_OBSTACLES); j++) {
+                b = &grid->objects[cell_objects[j]];
+                if (grid_owns_pair(a, b, cx, cz)) {
+                    candidate_pairs++;
+                    collide_projectile_obstacle(projectile, b->object);
+                }
+            }
+            for (j = GRID_TYPE_BEGIN(BUCKET_FREE_WALLS); j < GRID_TYPE_END(BUCKET_FREE_WALLS); j++) {
+                b = &grid->objects[cell_objects[j]];
+                if (grid_owns_pair(a, b, cx, cz)) {
+                    candidate_pairs++;
+                    collide_projectile_wall(projectile, b->object);
+                }
+            }
+        }
+#undef GRID_TYPE_BEGIN
+#undef GRID_TYPE_END
+    }
+
+    for (k = 0; k < grid->num_occupied_cells; k++)
+        grid->cell_count[grid->occupied_cells[k]] = 0;
+    return candidate_pairs;
+}
+
+static bool quadtree_node_overlaps(QuadtreeNode* node, f32 x1, f32 z1, f32 x2, f32 z2)
+{
+    f32 w = 2 * node->half_width;
+    // the root also holds everything centered outside the map
+    if (node->parent == -1)
+        return true;
+    return x2 >= node->x - w && x1 <= node->x + w && z2 >= node->z - w && z1 <= node->z + w;
+}
+
+// collision callbacks can create objects, which can split nodes and
+// reallocate data->nodes, so the node is only ever reached by index
+static u64 quadtree_collide_entity(QuadtreeData* data, i32 node_idx, Entity* entity, f32 x1, f32 z1, f32 x2, f32 z2)
+{
+    List* list;
+    i32 i, children;
+    u64 candidate_pairs;
+    if (data->nodes[node_idx].counts[BUCKET_OBSTACLES] + data->nodes[node_idx].counts[BUCKET_FREE_WALLS]
+      + data->nodes[node_idx].counts[BUCKET_PROJECTILES] + data->nodes[node_idx].counts[BUCKET_TRIGGERS]
+      + data->nodes[node_idx].counts[BUCKET_AOES] == 0)
+        return 0;
+    if (!quadtree_node_overlaps(&data->nodes[node_idx], x1, z1, x2, z2))
+        return 0;
+    candidate_pairs = quadtree_node_length(&data->nodes[node_idx]);
+    list = data->nodes[node_idx].bucket.obstacles;
+    for (i = 0; i < list->length; i++)
+        collide_entity_obstacle(entity, list_get(list, i));
+    list = data->nodes[node_idx].bucket.free_walls;
+    for (i = 0; i < list->length; i++)
+        collide_entity_wall(entity, list_get(list, i));
+    list = data->nodes[node_idx].bucket.projectiles;
+    for (i = 0; i < list->length; i++)
+        collide_entity_projectile(entity, list_get(list, i));
+    list = data->nodes[node_idx].bucket.triggers;
+    for (i = 0; i < list->length; i++)
+        collide_entity_trigger(entity, list_get(list, i));
+    list = data->nodes[node_idx].bucket.aoes;
+    for (i = 0; i < list->length; i++) {
+        AOE* aoe = list_get(list, i);
+        if  (aoe->timer >= 0) continue;
+        collide_entity_aoe(entity, aoe);
+    }
+    children = data->nodes[node_idx].children;
+    if (children != -1)
+        for (i = 0; i < 4; i++)
+            candidate_pairs += quadtree_collide_entity(data, children + i, entity, x1, z1, x2, z2);
+    return candidate_pairs;
+}
+
+// same as quadtree_collide_entity, nodes are reached by index only
+static u64 quadtree_collide_projectile(QuadtreeData* data, i32 node_idx, Projectile* projectile, f32 x1, f32 z1, f32 x2, f32 z2)
+{
+    List* list;
+    i32 i, children;
+    u64 candidate_pairs;
+    if (data->nodes[node_idx].counts[BUCKET_OBSTACLES] + data->nodes[node_idx].counts[BUCKET_FREE_WALLS] == 0)
+        return 0;
+    if (!quadtree_node_overlaps(&data->nodes[node_idx], x1, z1, x2, z2))
+        return 0;
+    candidate_pairs = data->nodes[node_idx].bucket.obstacles->length + data->nodes[node_idx].bucket.free_walls->length;
+    list = data->nodes[node_idx].bucket.obstacles;
+    for (i = 0; i < list->length; i++)
+        collide_projectile_obstacle(projectile, list_get(list, i));
+    list = data->nodes[node_idx].bucket.free_walls;
+    for (i = 0; i < list->length; i++)
+        collide_projectile_wall(projectile, list_get(list, i));
+    children = data->nodes[node_idx].children;
+    if (children != -1)
+        for (i = 0; i < 4; i++)
+            candidate_pairs += quadtree_collide_projectile(data, children + i, projectile, x1, z1, x2, z2);
+    return candidate_pairs;
+}
+
+// every object is in exactly one node, so querying the tree with
+// each entity and projectile tests every pair once
+static u64 map_collide_objects_quadtree(Map* map)
+{
+    QuadtreeData* data = &map->quadtree_data;
+    u64 candidate_pairs = 0;
+    vec2 center;
+    f32 r;
+    i32 i;
+    for (i = 0; i < map->entities->length; i++) {
+        Entity* entity = list_get(map->entities, i);
+        quadtree_object_bounds(entity, BUCKET_ENTITIES, &center, &r);
+        candidate_pairs += quadtree_collide_entity(data, 0, entity, center.x - r, center.z - r, center.x + r, center.z + r);
+    }
+    for (i = 0; i < map->projectiles->length; i++) {
+        Projectile* projectile = list_get(map->projectiles, i);
+        if (projectile_lifetime(projectile) <= 0) continue;
+        projectile_bounds(projectile, &center, &r);
+        candidate_pairs += quadtree_collide_projectile(data, 0, projectile,
+            center.x - r, center.z - r, center.x + r, center.z + r);
+    }
+    return candidate_pairs;
+}
+
+// naive is cheapest while every entity can simply test everything.
+// the bands keep a population hovering around one number from
+// switching back and forth
+#define ADAPT_NAIVE_ENTER_PAIRS     2048
+#define ADAPT_NAIVE_LEAVE_PAIRS     8192
+// grid cells are this many mean object diameters wide
+#define ADAPT_CELL_DIAMETERS        4
+#define ADAPT_MIN_CELL_WIDTH        2
+#define ADAPT_MAX_CELL_WIDTH        32
+// mixed sizes make large objects cover many grid cells
+#define ADAPT_TREE_ENTER_CELLS      6.0
+#define ADAPT_TREE_LEAVE_CELLS      3.0
+// candidate pairs per entity or projectile. cells far busier
+// than the mean object size suggests means objects are clustered
+#define ADAPT_TREE_ENTER_CLUSTERED  64.0
+#define ADAPT_TREE_LEAVE_CLUSTERED  16.0
+
+static f32 adapt_object_diameter(void* object, i32 list_type)
+{
+    vec2 center;
+    f32 radius;
+    quadtree_object_bounds(object, list_type, &center, &radius);
+    return 2 * radius;
+}
+
+static void adapt_sample_sizes(Map* map, i32 cell_width, f64* mean_diameter, f64* mean_cells)
+{
+    List* lists[6] = { map->entities, map->free_walls, map->projectiles, map->obstacles, map->triggers, map->aoes };
+    f64 diameter_sum = 0, cells_sum = 0, d, n = 0;
+    i32 list_type, i;
+    for (list_type = 0; list_type < 6; list_type++) {
+        for (i = 0; i < lists[list_type]->length; i++) {
+            d = adapt_object_diameter(list_get(lists[list_type], i), list_type);
+            diameter_sum += d;
+            if (cell_width > 0)
+                cells_sum += (ceil(d / cell_width) + 1) * (ceil(d / cell_width) + 1);
+            n += 1;
+        }
+    }
+    *mean_diameter = (n > 0) ? diameter_sum / n : 1;
+    *mean_cells = (n > 0) ? cells_sum / n : 1;
+}
+
+static void map_adapt_collision_strategy(Map* map, u64 candidate_pairs)
+{
+    CollisionStats* stats = &map->collision_stats;
+    MapCollisionStrategy current, strategy;
+    f64 entities, projectiles, targets, naive_pairs, pairs_per_object;
+    f64 mean_diameter, mean_cells;
+    i32 cell_width;
+
+    stats->entities += map->entities->length;
+    stats->projectiles += map->projectiles->length;
+    stats->targets += map->obstacles->length + map->free_walls->length + map->triggers->length + map->aoes->length;
+    stats->candidate_pairs += candidate_pairs;
+    if (++stats->ticks < MAP_ADAPT_WINDOW)
+        return;
+
+    entities = (f64)stats->entities / stats->ticks;
+    projectiles = (f64)stats->projectiles / stats->ticks;
+    targets = (f64)stats->targets / stats->ticks;
+    naive_pairs = entities * (projectiles + targets) + projectiles * targets;
+    pairs_per_object = (f64)stats->candidate_pairs / stats->ticks / fmax(entities + projectiles, 1);
+
+    current = map->collision_strategy;
+    adapt_sample_sizes(map, 0, &mean_diameter, &mean_cells);
+    cell_width = ceil(ADAPT_CELL_DIAMETERS * mean_diameter);
+    cell_width = maxi(ADAPT_MIN_CELL_WIDTH, mini(ADAPT_MAX_CELL_WIDTH, cell_width));
+    adapt_sample_sizes(map, cell_width, &mean_diameter, &mean_cells);
+
+    if (naive_pairs < ((current == MAP_COLLIDE_NAIVE) ? ADAPT_NAIVE_LEAVE_PAIRS : ADAPT_NAIVE_ENTER_PAIRS))
+        strategy = MAP_COLLIDE_NAIVE;
+    else if (current == MAP_COLLIDE_QUADTREE)
+        strategy = (mean_cells > ADAPT_TREE_LEAVE_CELLS || pairs_per_object > ADAPT_TREE_LEAVE_CLUSTERED)
+                 ? MAP_COLLIDE_QUADTREE : MAP_COLLIDE_UNIFORM_GRID;
+    else if (mean_cells > ADAPT_TREE_ENTER_CELLS || (current == MAP_COLLIDE_UNIFORM_GRID && pairs_per_object > ADAPT_TREE_ENTER_CLUSTERED))
+        strategy = MAP_COLLIDE_QUADTREE;
+    else
+        strategy = MAP_COLLIDE_UNIFORM_GRID;
+
+    // only retune the grid once the cell width is off by 2x
+    if (strategy == current && (strategy != MAP_COLLIDE_UNIFORM_GRID
+     || (cell_width < 2 * map->uniform_grid_data.cell_width && 2 * cell_width > map->uniform_grid_data.cell_width))) {
+        stats->pending_windows = 0;
+    } else if (stats->pending_windows > 0 && stats->pending_strategy == strategy) {
+        stats->pending_windows++;
+        stats->pending_cell_width = cell_width;
+    } else {
+        stats->pending_strategy = strategy;
+        stats->pending_cell_width = cell_width;
+        stats->pending_windows = 1;
+    }
+
+    stats->entities = stats->projectiles = stats->targets = stats->candidate_pairs = 0;
+    stats->ticks = 0;
+    if (stats->pending_windows < MAP_ADAPT_CONFIRM)
+        return;
+
+    log_write(INFO, "Adapting collision: %.0f entities, %.0f projectiles, %.0f targets, %.1f candidate pairs per object",
+              entities, projectiles, targets, pairs_per_object);
+    if (strategy == MAP_COLLIDE_NAIVE)
+        map_use_naive(map);
+    else if (strategy == MAP_COLLIDE_QUADTREE)
+        map_use_quadtree(map, MAP_QUADTREE_SPLIT_THRESHOLD);
+    else
+        map_use_uniform_grid(map, stats->pending_cell_width);
+    map_use_adaptive(map);
 }
 
 void map_collide_objects(Map* map)
 {
+    u64 candidate_pairs = 0;
     if (map->collision_strategy == MAP_COLLIDE_SPATIAL_HASH)
-        map_collide_objects_spatial_hash(map);
+        candidate_pairs = map_collide_objects_spatial_hash(map);
+    else if (map->collision_strategy == MAP_COLLIDE_UNIFORM_GRID)
+        candidate_pairs = map_collide_objects_uniform_grid(map);
+    else if (map->collision_strategy == MAP_COLLIDE_QUADTREE)
+        candidate_pairs = map_collide_objects_quadtree(map);
     else if (map->collision_strategy == MAP_COLLIDE_NAIVE)
-        map_collide_objects_naive(map);
+        candidate_pairs = map_collide_objects_naive(map);
+    if (map->adaptive_collision)
+        map_adapt_collision_strategy(map, candidate_pairs);
 }
 
-static void map_send_state(Map* map, f32 dt)
+static i32 cmp_updated_uid(const void* ptr1, const void* ptr2)
 {
-    // use only tcp connections for now so i dont have to deal with synchronization issues
-    GameObj type;
-    size_t size;
-    i32 uid;
-    i32 length, step, high;
-    char buffer[UDP_MAX_PAYLOAD];
+    i32 uid1 = *(const i32*)ptr1;
+    i32 uid2 = *(const i32*)ptr2;
+    GameObj type1 = game_context.uid_map_type[uid1];
+    GameObj type2 = game_context.uid_map_type[uid2];
+    if (type1 != type2)
+        return type1 - type2;
+    return uid1 - uid2;
+}
 
+static void send_updated_objects_packet(Packet* packet, char* packet_buffer, GameObj type, i32 count, char* end)
+{
+    packet->id = PACKET_UPDATE_GAME_OBJ;
+    packet->length = end - packet->buffer;
+    memcpy(packet->buffer, &type, sizeof(type));
+    memcpy(packet->buffer + sizeof(type), &count, sizeof(count));
+    memcpy(packet_buffer, &packet->length, sizeof(packet->length));
+    memcpy(packet_buffer + sizeof(packet->length), &packet->id, sizeof(packet->id));
+    game_net_send_tcp_packet_to_clients(packet);
+}
+
+// objects updated since the last send, packed by type into as few
+// packets as fit in UDP_MAX_PAYLOAD. an object updated several
+// times is sent once
+static void send_updated_objects(void)
+{
     Packet packet;
     static char packet_buffer[UDP_MAX_PAYLOAD];
-    packet.buffer = packet_buffer + PACKET_HEADER_BYTES;
+    List_i32* uids = game_context.updated_uids;
+    GameObj type, packet_type;
+    char* ptr;
+    char* start;
+    char* end = packet_buffer + UDP_MAX_PAYLOAD;
+    size_t size;
+    i32 uid, count;
 
-    for (i32 i = 0; i < game_context.updated_uids->length; i++) {
-        packet.id = PACKET_UPDATE_GAME_OBJ;
-        uid = game_context.updated_uids->buffer[i];
+    packet.buffer = packet_buffer + PACKET_HEADER_BYTES;
+    start = packet.buffer + sizeof(GameObj) + sizeof(i32);
+    qsort(uids->buffer, uids->length, sizeof(i32), cmp_updated_uid);
+
+    ptr = start;
+    count = 0;
+    packet_type = GAME_OBJ_NONE;
+    for (i32 i = 0; i < uids->length; i++) {
+        uid = uids->buffer[i];
         type = game_context.uid_map_type[uid];
-
-        memcpy(packet.buffer, &type, sizeof(type));
-        high = 1;
-        memcpy(packet.buffer + sizeof(type), &high, sizeof(high));
-        size = game_object_write(type, game_context.uid_map[uid], packet.buffer + sizeof(type) + sizeof(high));
-
-        packet.length = size + sizeof(type) + sizeof(high);
-
-        memcpy(packet_buffer, &packet.length, sizeof(packet.length));
-        memcpy(packet_buffer + sizeof(packet.length), &packet.id, sizeof(packet.id));
-
-        game_net_send_tcp_packet_to_clients(&packet);
-    }
-    game_context.updated_uids->length = 0;
-
-    size = entity_sizeof();
-    step = (UDP_MAX_PAYLOAD-sizeof(type)-sizeof(length)-sizeof(uid)-sizeof(high)) / size;
-    type = GAME_OBJ_ENTITY;
-    for (i32 i = 0; i < map->entities->length; i++) {
-        high = (step < map->entities->length - i) ? step : map->entities->length - i;
-        packet.length = sizeof(type) + sizeof(high) + size * high;
-        packet.id = PACKET_UPDATE_GAME_OBJ;
-        char* buffer = packet_buffer;
-        memcpyadv(&buffer, (char*)&packet.length, sizeof(packet.length));
-        memcpyadv(&buffer, (char*)&packet.id, sizeof(packet.id));
-        memcpyadv(&buffer, (char*)&type, sizeof(type));
-        memcpyadv(&buffer, (char*)&high, sizeof(high));
-        for (i32 j = 0; j < high; j++) {
-            game_object_write(GAME_OBJ_ENTITY, 
-                              list_get(map->entities, i+j), 
-                              buffer + j * size);
+        size = game_object_sizeof(type);
+        if ((i > 0 && uid == uids->buffer[i-1]) || size == 0)
+            continue;
+        if (count > 0 && (type != packet_type || ptr + size > end)) {
+            send_updated_objects_packet(&packet, packet_buffer, packet_type, count, ptr);
+            ptr = start;
+            count = 0;
         }
-        game_net_send_udp_packet_to_clients(&packet);
-    }
-
-    size = projectile_sizeof();
-    step = (UDP_MAX_PAYLOAD-sizeof(type)-sizeof(length)-sizeof(uid)-sizeof(high)) / size;
-    type = GAME_OBJ_PROJECTILE;
-    for (i32 i = 0; i < map->projectiles->length; i+=step) {
-        high = (step < map->projectiles->length - i) ? step : map->projectiles->length - i;
-        packet.length = sizeof(type) + sizeof(high) + size * high;
-        packet.id = PACKET_UPDATE_GAME_OBJ;
-        char* buffer = packet_buffer;
-        memcpyadv(&buffer, (char*)&packet.length, sizeof(packet.length));
-        memcpyadv(&buffer, (char*)&packet.id, sizeof(packet.id));
-        memcpyadv(&buffer, (char*)&type, sizeof(type));
-        memcpyadv(&buffer, (char*)&high, sizeof(high));
-        for (i32 j = 0; j < high; j++) {
-            game_object_write(GAME_OBJ_PROJECTILE, 
-                              list_get(map->projectiles, i+j), 
-                              buffer + j * size);
+        if (ptr + size > end) {
+            log_write(WARNING, "Object %d of type %d does not fit in a packet", uid, type);
+            continue;
         }
-        game_net_send_udp_packet_to_clients(&packet);
+        packet_type = type;
+        ptr += game_object_write(type, game_context.uid_map[uid], ptr);
+        count++;
+    }
+    if (count > 0)
+        send_updated_objects_packet(&packet, packet_buffer, packet_type, count, ptr);
+    uids->length = 0;
+}
+
+static void map_send_state(Map* map, f32 dt)
+{
+    // object updates go over tcp at the net rate, entities and
+    // projectiles over udp as deltas to the last snapshot each
+    // client acknowledged, at the rate of the client
+    game_context.net_timer -= dt;
+    if (game_context.net_timer <= 0) {
+        game_context.net_timer = maxf(game_context.net_timer + game_context.net_timestep, 0);
+        send_updated_objects();
     }
+    // snapshot datagrams of every client are queued, one flush sends them
+    host_send_snapshot(map, dt);
+    game_net_flush_udp();
 }
 
 void client_map_update(Map* map, f32 dt)
@@ -3300,6 +4781,8 @@ void client_map_update(Map* map, f32 dt)
                     this_entity->position = host_entity.position;
                     this_entity->direction = host_entity.direction;
                     this_entity->facing = host_entity.facing;
+                    this_entity->health = host_entity.health;
+                    this_entity->max_health = host_entity.max_health;
                     this_entity->flags = host_entity.flags;
                     this_entity->state = host_entity.state;
                     this_entity->frame = host_entity.frame;
@@ -3307,11 +4790,11 @@ void client_map_update(Map* map, f32 dt)
                 }
                 break;
             case GAME_OBJ_PROJECTILE:
-                Projectile host_proj = map->object_queue.buffer[map->object_queue.tail].proj;
+                ProjectileDesc host_proj = map->object_queue.buffer[map->object_queue.tail].proj;
                 Projectile* this_proj = game_context.uid_map[host_proj.uid];
                 if (this_proj != NULL) {
-                    this_proj->position = host_proj.position;
-                    this_proj->direction = host_proj.direction;
+                    projectile_set_position(this_proj, host_proj.position);
+                    projectile_set_direction(this_proj, host_proj.direction);
                     this_proj->tex = host_proj.tex;
                     this_proj->facing = host_proj.facing;
                 }
@@ -3322,52 +4805,36 @@ void client_map_update(Map* map, f32 dt)
         map->object_queue.tail = (map->object_queue.tail + 1) % (PARTICLE_QUEUE_LENGTH + 1);
     }
 
-    i = 0;
-    while (i < map->particles->length) {
-        Particle* particle = list_get(map->particles, i);
-        particle_update(particle, dt);
-        if (particle->lifetime <= 0)
-            particle_destroy(list_remove(map->particles, i));
-        else
-            i++;
-    }
-
-    i = 0;
-    while (i < map->parjicles->length) {
-        Parjicle* parjicle = list_get(map->parjicles, i);
-        parjicle_update(parjicle, dt);
-        if (parjicle->lifetime <= 0)
-            parjicle_destroy(list_remove(map->parjicles, i));
-        else
-            i++;
-    }
+    particle_update_all(&map->particles, dt);
+    parjicle_update_all(&map->parjicles, dt);
 
+    projectile_update_all(&map->projectile_pool, dt);
     i = 0;
     while (i < map->projectiles->length) {
         Projectile* projectile = list_get(map->projectiles, i);
-        projectile_update(projectile, dt);
-        if (projectile->lifetime <= 0)
-            projectile_destroy(list_remove(map->projectiles, i));
+        if (projectile_lifetime(projectile) <= 0)
+            projectile_destroy(&map->projectile_pool, list_remove(map->projectiles, i));
         else
             i++;
     }
+
+    client_interpolate_snapshots();
 }
 
 void map_update(Map* map, f32 dt)
 {
     if (map == NULL)
         return;
+    if (map->show_spatial_hash_lines && !map->spatial_hash_lines_created)
+        create_grid_lines(map);
+    else if (!map->show_spatial_hash_lines && map->spatial_hash_lines_created)
+        destroy_grid_lines(map);
     if (game_context.singleplayer || game_context.hosting) {
         map_update_objects(map, dt);
         map_collide_tilemap(map);
         map_collide_objects(map);
-        if (game_context.hosting) {
+        if (game_context.hosting)
             map_send_state(map, dt);
-            //game_context.net_timer -= dt;
-            //if (game_context.net_timer < 0) {
-            //    game_context.net_timer += game_context.net_timestep;
-            //}
-        }
     } else {
         client_map_update(map, dt);
     }
@@ -3445,7 +4912,7 @@ void map_queue_parjicle(Parjicle parjicle)
     map->parjicle_queue.head = (map->parjicle_queue.head+1)%(PARJICLE_QUEUE_LENGTH+1);
 }
 
-void map_queue_projectile(Projectile proj)
+void map_queue_projectile(ProjectileDesc proj)
 {
     Map* map = game_context.current_map;
     if (map == NULL)
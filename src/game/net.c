@@ -1,5 +1,6 @@
 #include "../game.h"
 #include "../gui.h"
+#include "../state.h"
 #include <string.h>
 #include <pthread.h>
 
@@ -7,6 +8,8 @@ extern GameContext game_context;
 
 static bool kill_net_host_thread;
 static bool kill_net_handler_threads;
+// host datagrams queued on the game thread, flushed once per tick
+static SocketBatch* udp_batch;
 
 void game_net_set_host_ip(const char* ip)
 {
@@ -38,9 +41,15 @@ static void host_handle_packet(Packet* packet)
         case PACKET_SWAP_ITEMS:
             host_swap_items(packet);
             break;
+        case PACKET_CLIENT_SNAPSHOT_RATE:
+            host_set_snapshot_rate(packet);
+            break;
         case PACKET_CLIENT_INPUT:
             host_handle_client_input(packet);
             break;
+        case PACKET_SNAPSHOT_ACK:
+            host_snapshot_ack(packet);
+            break;
         default:
             break;
     }
@@ -48,19 +57,19 @@ static void host_handle_packet(Packet* packet)
 
 static void* host_tcp_client_handler(void* vargp)
 {
-    Packet* packet;
+    PacketBuffer buffer;
     Client* client = vargp;
+    packet_buffer_init(&buffer, UDP_MAX_PAYLOAD);
     while (!kill_net_host_thread) {
-        packet = socket_recv(client->tcp_socket);
-        if (packet == NULL) {
+        if (!socket_recv_into(client->tcp_socket, &buffer)) {
             log_write(WARNING, "packet is null");
             break;
         }
         pthread_mutex_lock(&game_context.handler_thread_mutex);
-        host_handle_packet(packet);
+        host_handle_packet(&buffer.packet);
         pthread_mutex_unlock(&game_context.handler_thread_mutex);
-        packet_destroy(packet);
     }
+    packet_buffer_cleanup(&buffer);
     return NULL;
 }
 
@@ -70,23 +79,27 @@ static void* host_udp_handler(void* vargp)
     NetContext* net_ctx = game_context.net;
     char* ip = game_context.host_ip;
     Socket* listen_socket = socket_create(net_ctx, ip, NULL, BIT_UDP);
-    SocketAddr* addr = NULL;
-    Packet* packet;
+    PacketBuffer buffers[GAME_NET_RECV_BATCH];
+    i32 num_packets;
     socket_bind(listen_socket);
     game_context.this_client->udp_socket = listen_socket;
+    udp_batch = socket_batch_create(listen_socket, GAME_NET_SEND_BATCH);
     game_net_set_host_udp_port(socket_port(listen_socket));
     log_write(DEBUG, "Listening over UDP on %s:%s", socket_ip(listen_socket), socket_port(listen_socket));
     pthread_barrier_wait(net_listen_barrier);
+    for (i32 i = 0; i < GAME_NET_RECV_BATCH; i++)
+        packet_buffer_init(&buffers[i], UDP_MAX_PAYLOAD);
     while (!kill_net_host_thread) {
-        packet = socket_recvfrom(listen_socket, &addr);
-        if (packet == NULL) {
+        num_packets = socket_recvfrom_batch(listen_socket, buffers, GAME_NET_RECV_BATCH);
+        if (num_packets <= 0) {
             log_write(WARNING, "packet is null");
             continue;
         }
-        host_handle_packet(packet);
-        packet_destroy(packet);
-        socket_address_destroy(addr);
+        for (i32 i = 0; i < num_packets; i++)
+            host_handle_packet(&buffers[i].packet);
     }
+    for (i32 i = 0; i < GAME_NET_RECV_BATCH; i++)
+        packet_buffer_cleanup(&buffers[i]);
     return NULL;
 }
 
@@ -172,7 +185,11 @@ static void* host_tcp_handler(void* vargp)
 
         packet = socket_recv(client_socket);
         log_assert(packet->id == PACKET_CLIENT_TO_HOST_USERNAME, "");
+        // set last, once it is there the handshake is done and the
+        // game can send to the client
+        pthread_mutex_lock(&game_context.handler_thread_mutex);
         client->username = string_copy(packet->buffer);
+        pthread_mutex_unlock(&game_context.handler_thread_mutex);
         packet_destroy(packet);
 
         pthread_t thread_id;
@@ -223,6 +240,9 @@ static void client_handle_packet(Packet* packet)
         case PACKET_CLIENT_STATS:
             client_update_stats(packet);
             break;
+        case PACKET_SNAPSHOT:
+            client_read_snapshot(packet);
+            break;
         default:
             log_write(WARNING, "Received unknown packed: %d %d", packet->id, packet->length);
     }
@@ -231,38 +251,41 @@ static void client_handle_packet(Packet* packet)
 static void* client_tcp_handler(void* vargp)
 {
     Socket* server_socket = vargp;
-    Packet* packet;
+    PacketBuffer buffer;
     log_write(DEBUG, "initalized client tcp handler");
+    packet_buffer_init(&buffer, UDP_MAX_PAYLOAD);
     while (!kill_net_handler_threads) {
-        packet = socket_recv(server_socket);
-        if (packet == NULL) {
+        if (!socket_recv_into(server_socket, &buffer)) {
             log_write(DEBUG, "received null packet");
             break;
         }
         pthread_mutex_lock(&game_context.handler_thread_mutex);
-        client_handle_packet(packet);
+        client_handle_packet(&buffer.packet);
         pthread_mutex_unlock(&game_context.handler_thread_mutex);
-        packet_destroy(packet);
     }
+    packet_buffer_cleanup(&buffer);
     return NULL;
 }
 
 static void* client_udp_handler(void* vargp)
 {
-    Packet* packet;
-    SocketAddr* server_addr;
+    PacketBuffer buffers[GAME_NET_RECV_BATCH];
     Socket* udp_socket = vargp;
+    i32 num_packets;
     log_write(DEBUG, "initalized client udp handler");
+    for (i32 i = 0; i < GAME_NET_RECV_BATCH; i++)
+        packet_buffer_init(&buffers[i], UDP_MAX_PAYLOAD);
     while (!kill_net_handler_threads) {
-        packet = socket_recvfrom(udp_socket, &server_addr);
-        if (packet == NULL) {
+        num_packets = socket_recvfrom_batch(udp_socket, buffers, GAME_NET_RECV_BATCH);
+        if (num_packets <= 0) {
             log_write(WARNING, "received null packet");
             continue;
         }
-        client_handle_packet(packet);
-        packet_destroy(packet);
-        socket_address_destroy(server_addr);
+        for (i32 i = 0; i < num_packets; i++)
+            client_handle_packet(&buffers[i].packet);
     }
+    for (i32 i = 0; i < GAME_NET_RECV_BATCH; i++)
+        packet_buffer_cleanup(&buffers[i]);
     return NULL;
 }
 
@@ -338,6 +361,10 @@ void game_net_join(const char* ip, const char* port)
     socket_send(server_socket, packet);
     packet_destroy(packet);
 
+    i32 snapshot_rate = config_get_setting_int(state_context.config, "snapshot_rate", 0);
+    if (snapshot_rate > 0)
+        client_request_snapshot_rate(snapshot_rate);
+
     pthread_t thread_id;
     pthread_create(&thread_id, NULL, client_tcp_handler, server_socket);
     pthread_create(&thread_id, NULL, client_udp_handler, this_client->udp_socket);
@@ -348,8 +375,10 @@ void game_net_join(const char* ip, const char* port)
 
 void game_net_start_hosting(const char* ip, const char* port)
 {
+#ifndef SERVER_BUILD
     log_write(WARNING, "Multiplayer is disabled because skill issue");
     return;
+#endif
 
     if (game_context.net != NULL) {
         log_write(WARNING, "game is already hosting, ignoring");
@@ -376,8 +405,10 @@ void game_net_start_hosting(const char* ip, const char* port)
 
 void game_net_cleanup(void)
 {
+#ifndef SERVER_BUILD
     log_write(WARNING, "Multiplayer is disabled because skill issue");
     return;
+#endif
 
     if (game_context.net == NULL)
         return;
@@ -404,6 +435,9 @@ void game_net_cleanup(void)
         pthread_join(game_context.net_tcp_listen_thread_id, NULL);
         pthread_join(game_context.net_udp_listen_thread_id, NULL);
     }
+    if (udp_batch != NULL)
+        socket_batch_destroy(udp_batch);
+    udp_batch = NULL;
     networking_cleanup(game_context.net);
     game_context.hosting = false;
     game_context.singleplayer = true;
@@ -448,3 +482,17 @@ void game_net_send_packet_tcp(Client* client, Packet* packet)
 {
     socket_send(client->tcp_socket, packet);
 }
+
+void game_net_queue_packet_udp(Client* client, Packet* packet)
+{
+    // the client has not told us its udp port yet
+    if (udp_batch == NULL || client->udp_address == NULL)
+        return;
+    socket_batch_queue(udp_batch, client->udp_address, packet);
+}
+
+void game_net_flush_udp(void)
+{
+    if (udp_batch != NULL)
+        socket_batch_flush(udp_batch);
+}
@@ -11,6 +11,8 @@ typedef struct {
 
 typedef struct {
     ParjicleInfo* infos;
+    // per id, whether it has an update function
+    bool* update_mask;
     i32 num_parjicles;
 } ParjicleContext;
 
@@ -49,6 +51,7 @@ void parjicle_init(void)
 
     JsonIterator* it = json_iterator_create(json);
     parjicle_context.infos = st_malloc(parjicle_context.num_parjicles * sizeof(ParjicleInfo));
+    parjicle_context.update_mask = st_malloc(parjicle_context.num_parjicles * sizeof(bool));
     for (i32 i = 0; i < parjicle_context.num_parjicles; i++) {
         member = json_iterator_get(it);
         log_assert(member != NULL, "");
@@ -62,6 +65,7 @@ void parjicle_init(void)
         parjicle_context.infos[i].create = load_function(object, "create");
         parjicle_context.infos[i].update = load_function(object, "update");
         parjicle_context.infos[i].destroy = load_function(object, "destroy");
+        parjicle_context.update_mask[i] = parjicle_context.infos[i].update != NULL;
         json_iterator_increment(it);
     }
     json_iterator_destroy(it);
@@ -70,6 +74,7 @@ void parjicle_init(void)
 void parjicle_cleanup(void)
 {
     st_free(parjicle_context.infos);
+    st_free(parjicle_context.update_mask);
 }
 
 i32 parjicle_get_id(const char* name)
@@ -91,48 +96,105 @@ i32 parjicle_get_id(const char* name)
     return -1;
 }
 
-Parjicle* parjicle_create_from_struct(Parjicle parjicle)
+static void parjicle_gather(ParticleSystem* ps, i32 i, Parjicle* parj)
 {
-    Parjicle* parj = st_malloc(sizeof(Parjicle));
-    parj->data = NULL;
-    parj->position = parjicle.position;
-    parj->velocity = parjicle.velocity;
-    parj->acceleration = parjicle.acceleration;
-    parj->color = parjicle.color;
-    parj->lifetime = parjicle.lifetime;
-    parj->size = parjicle.size;
-    parj->rotation = parjicle.rotation;
-    parj->rotate_tex = parjicle.rotate_tex;
-    parj->id = parjicle.id;
-
-    if (parj->id != -1) {
-        ParjicleCreateFuncPtr create = parjicle_context.infos[parj->id].create;
+    parj->data = ps->data[i];
+    parj->position = vec3_create(ps->position[0][i], ps->position[1][i], ps->position[2][i]);
+    parj->velocity = vec3_create(ps->velocity[0][i], ps->velocity[1][i], ps->velocity[2][i]);
+    parj->acceleration = vec3_create(ps->acceleration[0][i], ps->acceleration[1][i], ps->acceleration[2][i]);
+    parj->color = vec3_create(ps->color[0][i], ps->color[1][i], ps->color[2][i]);
+    parj->lifetime = ps->lifetime[i];
+    parj->size = ps->size[i];
+    parj->rotation = ps->rotation[i];
+    parj->rotate_tex = ps->rotate_tex[i];
+    parj->id = ps->id[i];
+}
+
+static void parjicle_scatter(ParticleSystem* ps, i32 i, Parjicle* parj)
+{
+    ps->data[i] = parj->data;
+    ps->position[0][i] = parj->position.x;
+    ps->position[1][i] = parj->position.y;
+    ps->position[2][i] = parj->position.z;
+    ps->velocity[0][i] = parj->velocity.x;
+    ps->velocity[1][i] = parj->velocity.y;
+    ps->velocity[2][i] = parj->velocity.z;
+    ps->acceleration[0][i] = parj->acceleration.x;
+    ps->acceleration[1][i] = parj->acceleration.y;
+    ps->acceleration[2][i] = parj->acceleration.z;
+    ps->color[0][i] = parj->color.x;
+    ps->color[1][i] = parj->color.y;
+    ps->color[2][i] = parj->color.z;
+    ps->lifetime[i] = parj->lifetime;
+    ps->size[i] = parj->size;
+    ps->rotation[i] = parj->rotation;
+    ps->rotate_tex[i] = parj->rotate_tex;
+    ps->id[i] = parj->id;
+}
+
+bool parjicle_create_from_struct(ParticleSystem* ps, Parjicle parjicle)
+{
+    ParjicleCreateFuncPtr create;
+    i32 idx = particle_system_add(ps);
+    if (idx == -1)
+        return false;
+
+    parjicle.data = NULL;
+    if (parjicle.id != -1) {
+        create = parjicle_context.infos[parjicle.id].create;
         if (create != NULL)
-            create(parj);
+            create(&parjicle);
     }
+    parjicle_scatter(ps, idx, &parjicle);
+    if (parjicle.id != -1 && parjicle_context.update_mask[parjicle.id])
+        ps->updates[ps->num_updates++] = idx;
 
-    return parj;
+    return true;
 }
 
-void parjicle_destroy(Parjicle* parjicle)
+void parjicle_update_all(ParticleSystem* ps, f32 dt)
 {
-    if (parjicle->id != -1) {
-        ParjicleDestroyFuncPtr destroy = parjicle_context.infos[parjicle->id].destroy;
-        if (destroy != NULL)
-            destroy(parjicle);
+    ParjicleDestroyFuncPtr destroy;
+    Parjicle parj;
+    i32 i, idx, n, num_updates;
+
+    particle_system_integrate(ps, dt);
+
+    n = ps->length;
+    num_updates = ps->num_updates;
+    for (i = 0; i < num_updates; i++) {
+        idx = ps->updates[i];
+        parjicle_gather(ps, idx, &parj);
+        parjicle_context.infos[parj.id].update(&parj, dt);
+        parjicle_scatter(ps, idx, &parj);
+    }
+
+    for (i = 0; i < n; i++) {
+        if (ps->lifetime[i] > 0 || ps->id[i] == -1)
+            continue;
+        destroy = parjicle_context.infos[ps->id[i]].destroy;
+        if (destroy == NULL)
+            continue;
+        parjicle_gather(ps, i, &parj);
+        destroy(&parj);
     }
-    st_free(parjicle);
+
+    particle_system_compact(ps, n, parjicle_context.update_mask);
 }
 
-void parjicle_update(Parjicle* parjicle, f32 dt)
+void parjicle_destroy_all(ParticleSystem* ps)
 {
-    parjicle->position = vec3_add(parjicle->position, vec3_scale(parjicle->velocity, dt));
-    parjicle->velocity = vec3_add(parjicle->velocity, vec3_scale(parjicle->acceleration, dt));
-    parjicle->lifetime -= dt;
-
-    if (parjicle->id != -1) {
-        ParjicleUpdateFuncPtr update = parjicle_context.infos[parjicle->id].update;
-        if (update != NULL)
-            update(parjicle, dt);
+    ParjicleDestroyFuncPtr destroy;
+    Parjicle parj;
+    for (i32 i = 0; i < ps->length; i++) {
+        if (ps->id[i] == -1)
+            continue;
+        destroy = parjicle_context.infos[ps->id[i]].destroy;
+        if (destroy == NULL)
+            continue;
+        parjicle_gather(ps, i, &parj);
+        destroy(&parj);
     }
+    ps->length = 0;
+    ps->num_updates = 0;
 }
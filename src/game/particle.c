@@ -11,6 +11,8 @@ typedef struct {
 
 typedef struct {
     ParticleInfo* infos;
+    // per id, whether it has an update function
+    bool* update_mask;
     i32 num_particles;
 } ParticleContext;
 
@@ -46,6 +48,7 @@ void particle_init(void)
     const char* string;
     particle_context.num_particles = json_object_length(json);
     particle_context.infos = st_malloc(particle_context.num_particles * sizeof(ParticleInfo));
+    particle_context.update_mask = st_malloc(particle_context.num_particles * sizeof(bool));
     for (i32 i = 0; i < particle_context.num_particles; i++) {
         member = json_iterator_get(it);
         log_assert(member != NULL, "");
@@ -59,6 +62,7 @@ void particle_init(void)
         particle_context.infos[i].create = load_function(object, "create");
         particle_context.infos[i].update = load_function(object, "update");
         particle_context.infos[i].destroy = load_function(object, "destroy");
+        particle_context.update_mask[i] = particle_context.infos[i].update != NULL;
         json_iterator_increment(it);
     }
     json_iterator_destroy(it);
@@ -86,48 +90,107 @@ i32 particle_get_id(const char* name)
 void particle_cleanup(void)
 {
     st_free(particle_context.infos);
+    st_free(particle_context.update_mask);
 }
 
-Particle* particle_create_from_struct(Particle particle)
+static void particle_gather(ParticleSystem* ps, i32 i, Particle* part)
 {
-    Particle* part = st_malloc(sizeof(Particle));
-    part->data = NULL;
-    part->position = particle.position;
-    part->velocity = particle.velocity;
-    part->acceleration = particle.acceleration;
-    part->size = particle.size;
-    part->color = particle.color;
-    part->lifetime = particle.lifetime;
-    part->id = particle.id;
-    
-    if (part->id != -1) {
-        ParticleCreateFuncPtr create = particle_context.infos[part->id].create;
+    part->data = ps->data[i];
+    part->position = vec3_create(ps->position[0][i], ps->position[1][i], ps->position[2][i]);
+    part->velocity = vec3_create(ps->velocity[0][i], ps->velocity[1][i], ps->velocity[2][i]);
+    part->acceleration = vec3_create(ps->acceleration[0][i], ps->acceleration[1][i], ps->acceleration[2][i]);
+    part->color = vec3_create(ps->color[0][i], ps->color[1][i], ps->color[2][i]);
+    part->lifetime = ps->lifetime[i];
+    part->size = ps->size[i];
+    part->id = ps->id[i];
+}
+
+static void particle_scatter(ParticleSystem* ps, i32 i, Particle* part)
+{
+    ps->data[i] = part->data;
+    ps->position[0][i] = part->position.x;
+    ps->position[1][i] = part->position.y;
+    ps->position[2][i] = part->position.z;
+    ps->velocity[0][i] = part->velocity.x;
+    ps->velocity[1][i] = part->velocity.y;
+    ps->velocity[2][i] = part->velocity.z;
+    ps->acceleration[0][i] = part->acceleration.x;
+    ps->acceleration[1][i] = part->acceleration.y;
+    ps->acceleration[2][i] = part->acceleration.z;
+    ps->color[0][i] = part->color.x;
+    ps->color[1][i] = part->color.y;
+    ps->color[2][i] = part->color.z;
+    ps->lifetime[i] = part->lifetime;
+    ps->size[i] = part->size;
+    ps->id[i] = part->id;
+}
+
+bool particle_create_from_struct(ParticleSystem* ps, Particle particle)
+{
+    ParticleCreateFuncPtr create;
+    i32 idx = particle_system_add(ps);
+    if (idx == -1)
+        return false;
+
+    particle.data = NULL;
+    if (particle.id != -1) {
+        create = particle_context.infos[particle.id].create;
         if (create != NULL)
-            create(part);
+            create(&particle);
     }
+    particle_scatter(ps, idx, &particle);
+    if (particle.id != -1 && particle_context.update_mask[particle.id])
+        ps->updates[ps->num_updates++] = idx;
 
-    return part;
+    return true;
 }
 
-void particle_update(Particle* particle, f32 dt)
+// particles created by the update and destroy functions are added
+// past the ones that were alive at the start, they start moving
+// next tick
+void particle_update_all(ParticleSystem* ps, f32 dt)
 {
-    particle->position = vec3_add(particle->position, vec3_scale(particle->velocity, dt));
-    particle->velocity = vec3_add(particle->velocity, vec3_scale(particle->acceleration, dt));
-    particle->lifetime -= dt;
-
-    if (particle->id != -1) {
-        ParticleUpdateFuncPtr update = particle_context.infos[particle->id].update;
-        if (update != NULL)
-            update(particle, dt);
+    ParticleDestroyFuncPtr destroy;
+    Particle part;
+    i32 i, idx, n, num_updates;
+
+    particle_system_integrate(ps, dt);
+
+    n = ps->length;
+    num_updates = ps->num_updates;
+    for (i = 0; i < num_updates; i++) {
+        idx = ps->updates[i];
+        particle_gather(ps, idx, &part);
+        particle_context.infos[part.id].update(&part, dt);
+        particle_scatter(ps, idx, &part);
     }
+
+    for (i = 0; i < n; i++) {
+        if (ps->lifetime[i] > 0 || ps->id[i] == -1)
+            continue;
+        destroy = particle_context.infos[ps->id[i]].destroy;
+        if (destroy == NULL)
+            continue;
+        particle_gather(ps, i, &part);
+        destroy(&part);
+    }
+
+    particle_system_compact(ps, n, particle_context.update_mask);
 }
 
-void particle_destroy(Particle* particle)
+void particle_destroy_all(ParticleSystem* ps)
 {
-    if (particle->id != -1) {
-        ParticleDestroyFuncPtr destroy = particle_context.infos[particle->id].destroy;
-        if (destroy != NULL)
-            destroy(particle);
+    ParticleDestroyFuncPtr destroy;
+    Particle part;
+    for (i32 i = 0; i < ps->length; i++) {
+        if (ps->id[i] == -1)
+            continue;
+        destroy = particle_context.infos[ps->id[i]].destroy;
+        if (destroy == NULL)
+            continue;
+        particle_gather(ps, i, &part);
+        destroy(&part);
     }
-    st_free(particle);
+    ps->length = 0;
+    ps->num_updates = 0;
 }
@@ -0,0 +1,174 @@
+#include "../game.h"
+#include <stdint.h>
+#include <string.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#define PARTICLE_SYSTEM_MIN_CAPACITY 256
+
+// integrate and decay use aligned loads, the arrays they run over
+// share one block and each starts on this boundary
+#define PARTICLE_SYSTEM_ALIGN 32
+#define PARTICLE_SYSTEM_NUM_ALIGNED 10
+
+static void resize_aligned(ParticleSystem* ps, i32 capacity)
+{
+    f32** arrays[PARTICLE_SYSTEM_NUM_ALIGNED] = {
+        &ps->position[0], &ps->position[1], &ps->position[2],
+        &ps->velocity[0], &ps->velocity[1], &ps->velocity[2],
+        &ps->acceleration[0], &ps->acceleration[1], &ps->acceleration[2],
+        &ps->lifetime
+    };
+    i32 stride = (capacity + PARTICLE_SYSTEM_ALIGN / sizeof(f32) - 1) & ~(PARTICLE_SYSTEM_ALIGN / sizeof(f32) - 1);
+    void* block = st_malloc(PARTICLE_SYSTEM_NUM_ALIGNED * stride * sizeof(f32) + PARTICLE_SYSTEM_ALIGN - 1);
+    f32* base = (f32*)(((uintptr_t)block + PARTICLE_SYSTEM_ALIGN - 1) & ~(uintptr_t)(PARTICLE_SYSTEM_ALIGN - 1));
+    for (i32 i = 0; i < PARTICLE_SYSTEM_NUM_ALIGNED; i++) {
+        if (ps->length > 0)
+            memcpy(base + i * stride, *arrays[i], ps->length * sizeof(f32));
+        *arrays[i] = base + i * stride;
+    }
+    st_free(ps->aligned_block);
+    ps->aligned_block = block;
+}
+
+static void resize(ParticleSystem* ps, i32 capacity)
+{
+    resize_aligned(ps, capacity);
+    for (i32 c = 0; c < 3; c++)
+        ps->color[c] = st_realloc(ps->color[c], capacity * sizeof(f32));
+    ps->size = st_realloc(ps->size, capacity * sizeof(f32));
+    if (ps->rotation != NULL) {
+        ps->rotation = st_realloc(ps->rotation, capacity * sizeof(f32));
+        ps->rotate_tex = st_realloc(ps->rotate_tex, capacity * sizeof(bool));
+    }
+    ps->id = st_realloc(ps->id, capacity * sizeof(i32));
+    ps->data = st_realloc(ps->data, capacity * sizeof(void*));
+    ps->updates = st_realloc(ps->updates, capacity * sizeof(i32));
+    ps->capacity = capacity;
+}
+
+void particle_system_init(ParticleSystem* ps, bool rotation, i32 max_length)
+{
+    memset(ps, 0, sizeof(ParticleSystem));
+    ps->max_length = max_length;
+    // resize only grows the rotation arrays once they exist
+    if (rotation) {
+        ps->rotation = st_malloc(sizeof(f32));
+        ps->rotate_tex = st_malloc(sizeof(bool));
+    }
+    resize(ps, mini(PARTICLE_SYSTEM_MIN_CAPACITY, max_length));
+}
+
+void particle_system_destroy(ParticleSystem* ps)
+{
+    for (i32 c = 0; c < 3; c++)
+        st_free(ps->color[c]);
+    st_free(ps->aligned_block);
+    st_free(ps->size);
+    st_free(ps->rotation);
+    st_free(ps->rotate_tex);
+    st_free(ps->id);
+    st_free(ps->data);
+    st_free(ps->updates);
+    memset(ps, 0, sizeof(ParticleSystem));
+}
+
+i32 particle_system_add(ParticleSystem* ps)
+{
+    if (ps->length == ps->max_length)
+        return -1;
+    if (ps->length == ps->capacity)
+        resize(ps, mini(2 * ps->capacity, ps->max_length));
+    ps->allocs++;
+    if (ps->length + 1 > ps->peak)
+        ps->peak = ps->length + 1;
+    return ps->length++;
+}
+
+// p += v * dt, then v += a * dt, for n particles. the arrays are
+// PARTICLE_SYSTEM_ALIGN aligned and i only steps by whole vectors
+static void integrate(f32* restrict p, f32* restrict v, const f32* restrict a, i32 n, f32 dt)
+{
+    i32 i = 0;
+#if defined(__AVX__)
+    __m256 dt8 = _mm256_set1_ps(dt);
+    for (; i + 8 <= n; i += 8) {
+        __m256 v8 = _mm256_load_ps(v + i);
+        _mm256_store_ps(p + i, _mm256_add_ps(_mm256_load_ps(p + i), _mm256_mul_ps(v8, dt8)));
+        _mm256_store_ps(v + i, _mm256_add_ps(v8, _mm256_mul_ps(_mm256_load_ps(a + i), dt8)));
+    }
+#endif
+#if defined(__SSE__)
+    __m128 dt4 = _mm_set1_ps(dt);
+    for (; i + 4 <= n; i += 4) {
+        __m128 v4 = _mm_load_ps(v + i);
+        _mm_store_ps(p + i, _mm_add_ps(_mm_load_ps(p + i), _mm_mul_ps(v4, dt4)));
+        _mm_store_ps(v + i, _mm_add_ps(v4, _mm_mul_ps(_mm_load_ps(a + i), dt4)));
+    }
+#endif
+    for (; i < n; i++) {
+        p[i] += v[i] * dt;
+        v[i] += a[i] * dt;
+    }
+}
+
+static void decay(f32* restrict lifetime, i32 n, f32 dt)
+{
+    i32 i = 0;
+#if defined(__AVX__)
+    __m256 dt8 = _mm256_set1_ps(dt);
+    for (; i + 8 <= n; i += 8)
+        _mm256_store_ps(lifetime + i, _mm256_sub_ps(_mm256_load_ps(lifetime + i), dt8));
+#endif
+#if defined(__SSE__)
+    __m128 dt4 = _mm_set1_ps(dt);
+    for (; i + 4 <= n; i += 4)
+        _mm_store_ps(lifetime + i, _mm_sub_ps(_mm_load_ps(lifetime + i), dt4));
+#endif
+    for (; i < n; i++)
+        lifetime[i] -= dt;
+}
+
+void particle_system_integrate(ParticleSystem* ps, f32 dt)
+{
+    for (i32 c = 0; c < 3; c++)
+        integrate(ps->position[c], ps->velocity[c], ps->acceleration[c], ps->length, dt);
+    decay(ps->lifetime, ps->length, dt);
+}
+
+static void move(ParticleSystem* ps, i32 dst, i32 src)
+{
+    for (i32 c = 0; c < 3; c++) {
+        ps->position[c][dst] = ps->position[c][src];
+        ps->velocity[c][dst] = ps->velocity[c][src];
+        ps->acceleration[c][dst] = ps->acceleration[c][src];
+        ps->color[c][dst] = ps->color[c][src];
+    }
+    ps->lifetime[dst] = ps->lifetime[src];
+    ps->size[dst] = ps->size[src];
+    if (ps->rotation != NULL) {
+        ps->rotation[dst] = ps->rotation[src];
+        ps->rotate_tex[dst] = ps->rotate_tex[src];
+    }
+    ps->id[dst] = ps->id[src];
+    ps->data[dst] = ps->data[src];
+}
+
+void particle_system_compact(ParticleSystem* ps, i32 n, const bool* update_mask)
+{
+    i32 i, j;
+    ps->num_updates = 0;
+    for (i = j = 0; i < ps->length; i++) {
+        if (i < n && ps->lifetime[i] <= 0)
+            continue;
+        if (i != j)
+            move(ps, j, i);
+        if (ps->id[j] != -1 && update_mask[ps->id[j]])
+            ps->updates[ps->num_updates++] = j;
+        j++;
+    }
+    ps->length = j;
+}
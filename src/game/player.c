@@ -108,10 +108,10 @@ void player_reset(Client* client, Entity* entity)
 {
     Player* player = &client->player;
     inventory_reset(client);
-    if (player->entity != NULL) {
+    // the old entity belongs to the slab of the map it was created
+    // in, which frees it along with everything else on that map
+    if (player->entity != NULL)
         log_write(WARNING, "Did not destroy player entity before resetting");
-        entity_destroy(player->entity);
-    }
     for (i32 i = 0; i < NUM_STATS; i++)
         player->base_stats[i] = 100;
     player->stats[STAT_MP] = 50;
@@ -3,25 +3,135 @@
 
 extern GameContext game_context;
 
-Projectile* projectile_create(Projectile projectile)
-{
-    Projectile* proj = st_malloc(sizeof(Projectile));
-    memcpy(proj, &projectile, sizeof(Projectile));
-    //proj->position = position;
-    //proj->direction = vec2_create(0, 0);
-    //proj->elevation = 0.5;
-    //proj->facing = 0;
-    //proj->rotation = 0;
-    //proj->speed = 1;
-    //proj->tex = 0;
-    //proj->size = 0.5;
-    //proj->lifetime = 1000;
-    //proj->flags = 0;
-    //proj->pierce_timer = 0;
-    //proj->owner_uid = -1;
-    //proj->update = NULL;
-    //proj->destroy = NULL;
-    //proj->data = NULL;
+void projectile_pool_init(ProjectilePool* pool)
+{
+    memset(pool, 0, sizeof(ProjectilePool));
+}
+
+void projectile_pool_destroy(ProjectilePool* pool)
+{
+    for (i32 i = 0; i < pool->num_chunks; i++)
+        st_free(pool->chunks[i]);
+    st_free(pool->chunks);
+    st_free(pool->generations);
+    st_free(pool->slot_states);
+    st_free(pool->free_slots);
+    st_free(pool->spawned);
+    memset(pool, 0, sizeof(ProjectilePool));
+}
+
+static void pool_add_chunk(ProjectilePool* pool)
+{
+    i32 num_slots, i;
+    pool->chunks = st_realloc(pool->chunks, (pool->num_chunks + 1) * sizeof(ProjectileChunk*));
+    // zeroed so the integrate loop never reads garbage from free slots
+    pool->chunks[pool->num_chunks] = st_calloc(1, sizeof(ProjectileChunk));
+    num_slots = (pool->num_chunks + 1) * PROJECTILE_POOL_CHUNK;
+    pool->generations = st_realloc(pool->generations, num_slots * sizeof(u32));
+    pool->slot_states = st_realloc(pool->slot_states, num_slots * sizeof(u8));
+    pool->free_slots = st_realloc(pool->free_slots, num_slots * sizeof(i32));
+    // pushed in reverse so the chunk fills front to back
+    for (i = PROJECTILE_POOL_CHUNK - 1; i >= 0; i--) {
+        pool->generations[pool->num_chunks * PROJECTILE_POOL_CHUNK + i] = 0;
+        pool->slot_states[pool->num_chunks * PROJECTILE_POOL_CHUNK + i] = PROJECTILE_SLOT_FREE;
+        pool->free_slots[pool->num_free_slots++] = pool->num_chunks * PROJECTILE_POOL_CHUNK + i;
+    }
+    pool->num_chunks++;
+    pool->stats.num_slabs = pool->num_chunks;
+}
+
+// has to be called whenever update or flags change
+static void update_integrate_bits(Projectile* proj)
+{
+    u8 bits = 0;
+    if (projectile_get_flag(proj, PROJECTILE_FLAG_HIT_WALL))
+        bits = PROJECTILE_INTEGRATE_HIT_WALL;
+    else {
+        if (!projectile_get_flag(proj, PROJECTILE_FLAG_IGNORE_LIFETIME))
+            bits |= PROJECTILE_INTEGRATE_AGE;
+        if (projectile_get_flag(proj, PROJECTILE_FLAG_PIERCE))
+            bits |= PROJECTILE_INTEGRATE_PIERCE;
+        if (proj->update != NULL)
+            bits |= PROJECTILE_INTEGRATE_UPDATE;
+    }
+    proj->chunk->integrate[projectile_slot(proj)] = bits;
+}
+
+Projectile* projectile_pool_alloc(ProjectilePool* pool, ProjectileDesc* desc)
+{
+    ProjectileChunk* chunk;
+    Projectile* proj;
+    i32 idx, i;
+    if (pool->num_free_slots == 0)
+        pool_add_chunk(pool);
+    idx = pool->free_slots[--pool->num_free_slots];
+    chunk = pool->chunks[idx / PROJECTILE_POOL_CHUNK];
+    i = idx % PROJECTILE_POOL_CHUNK;
+    proj = &chunk->projectiles[i];
+    memset(proj, 0, sizeof(Projectile));
+    proj->update = desc->update;
+    proj->destroy = desc->destroy;
+    proj->data = desc->data;
+    proj->chunk = chunk;
+    proj->elevation = desc->elevation;
+    proj->facing = desc->facing;
+    proj->rotation = desc->rotation;
+    proj->size = desc->size;
+    proj->flags = desc->flags;
+    proj->owner_uid = desc->owner_uid;
+    proj->tex = desc->tex;
+    proj->uid = desc->uid;
+    proj->pool_idx = idx;
+    proj->generation = pool->generations[idx];
+    chunk->position_x[i] = chunk->prev_position_x[i] = desc->position.x;
+    chunk->position_z[i] = chunk->prev_position_z[i] = desc->position.z;
+    chunk->direction_x[i] = desc->direction.x;
+    chunk->direction_z[i] = desc->direction.z;
+    chunk->speed[i] = desc->speed;
+    chunk->lifetime[i] = desc->lifetime;
+    chunk->pierce_timer[i] = desc->pierce_timer;
+    update_integrate_bits(proj);
+    if (pool->updating) {
+        pool->slot_states[idx] = PROJECTILE_SLOT_SPAWNED;
+        if (pool->num_spawned == pool->spawned_capacity) {
+            pool->spawned_capacity = (pool->spawned_capacity == 0) ? 64 : 2 * pool->spawned_capacity;
+            pool->spawned = st_realloc(pool->spawned, pool->spawned_capacity * sizeof(i32));
+        }
+        pool->spawned[pool->num_spawned++] = idx;
+    } else
+        pool->slot_states[idx] = PROJECTILE_SLOT_LIVE;
+    pool->stats.allocs++;
+    if (++pool->stats.live > pool->stats.peak)
+        pool->stats.peak = pool->stats.live;
+    return proj;
+}
+
+void projectile_pool_free(ProjectilePool* pool, Projectile* proj)
+{
+    proj->chunk->integrate[projectile_slot(proj)] = 0;
+    pool->generations[proj->pool_idx]++;
+    pool->slot_states[proj->pool_idx] = PROJECTILE_SLOT_FREE;
+    pool->free_slots[pool->num_free_slots++] = proj->pool_idx;
+    pool->stats.live--;
+}
+
+Projectile* projectile_pool_get(ProjectilePool* pool, ProjectileHandle handle)
+{
+    if (handle.idx < 0 || handle.idx >= pool->num_chunks * PROJECTILE_POOL_CHUNK)
+        return NULL;
+    if (pool->generations[handle.idx] != handle.generation)
+        return NULL;
+    return &pool->chunks[handle.idx / PROJECTILE_POOL_CHUNK]->projectiles[handle.idx % PROJECTILE_POOL_CHUNK];
+}
+
+ProjectileHandle projectile_get_handle(Projectile* proj)
+{
+    return (ProjectileHandle) { .idx = proj->pool_idx, .generation = proj->generation };
+}
+
+Projectile* projectile_create(ProjectilePool* pool, ProjectileDesc desc)
+{
+    Projectile* proj = projectile_pool_alloc(pool, &desc);
     proj->uid = game_map_uid(proj, GAME_OBJ_PROJECTILE);
 
     if (game_context.hosting)
@@ -30,20 +140,106 @@ Projectile* projectile_create(Projectile projectile)
     return proj;
 }
 
+// the position is computed exactly like
+// vec2_add(position, vec2_scale(direction, speed * dt))
 void projectile_update(Projectile* proj, f32 dt)
 {
-    proj->position = vec2_add(proj->position, vec2_scale(proj->direction, proj->speed * dt));
+    ProjectileChunk* chunk = proj->chunk;
+    i32 i = projectile_slot(proj);
+    f64 scale;
+    if (projectile_get_flag(proj, PROJECTILE_FLAG_HIT_WALL)) {
+        chunk->lifetime[i] = 0;
+        return;
+    }
+    scale = chunk->speed[i] * dt;
+    chunk->prev_position_x[i] = chunk->position_x[i];
+    chunk->prev_position_z[i] = chunk->position_z[i];
+    chunk->position_x[i] += chunk->direction_x[i] * scale;
+    chunk->position_z[i] += chunk->direction_z[i] * scale;
     if (!projectile_get_flag(proj, PROJECTILE_FLAG_IGNORE_LIFETIME))
-        proj->lifetime -= dt;
-    if (projectile_get_flag(proj, PROJECTILE_FLAG_PIERCE) && proj->pierce_timer >= 0)
-        proj->pierce_timer -= dt;
-    if (proj->update != NULL)
+        chunk->lifetime[i] -= dt;
+    if (projectile_get_flag(proj, PROJECTILE_FLAG_PIERCE) && chunk->pierce_timer[i] >= 0)
+        chunk->pierce_timer[i] -= dt;
+    if (proj->update != NULL) {
         proj->update(proj, dt);
+        update_integrate_bits(proj);
+    }
+}
+
+// projectile_update without the update function for every slot of
+// the chunk, free ones included, their values are overwritten on
+// alloc. no branches and no selects so it vectorizes: aging and
+// piercing subtract dt times 0 or 1, which is exact either way. ones
+// that hit a wall move too and are zeroed, they are destroyed right
+// after projectile_update_all before anything reads the position
+static void integrate_chunk(ProjectileChunk* chunk, f32 dt)
+{
+    f64 scale;
+    i32 age, pierce, alive;
+    u8 bits;
+    for (i32 i = 0; i < PROJECTILE_POOL_CHUNK; i++) {
+        bits = chunk->integrate[i];
+        age = (bits & PROJECTILE_INTEGRATE_AGE) != 0;
+        pierce = ((bits & PROJECTILE_INTEGRATE_PIERCE) != 0) & (chunk->pierce_timer[i] >= 0);
+        alive = (bits & PROJECTILE_INTEGRATE_HIT_WALL) == 0;
+        scale = chunk->speed[i] * dt;
+        chunk->prev_position_x[i] = chunk->position_x[i];
+        chunk->prev_position_z[i] = chunk->position_z[i];
+        chunk->position_x[i] += chunk->direction_x[i] * scale;
+        chunk->position_z[i] += chunk->direction_z[i] * scale;
+        chunk->lifetime[i] = (chunk->lifetime[i] - dt * age) * alive;
+        chunk->pierce_timer[i] -= dt * pierce;
+    }
+}
+
+// every projectile is integrated first, a chunk at a time, then the
+// update functions are run in slot order. update functions only touch
+// their own projectile, so this ends up the same as projectile_update
+// on each in one ordered pass. projectiles created by update functions
+// are skipped by the walk and updated after it in the order they were
+// created, so everything alive at the end moved
+void projectile_update_all(ProjectilePool* pool, f32 dt)
+{
+    ProjectileChunk* chunk;
+    Projectile* proj;
+    i32 c, i, idx;
+    pool->updating = true;
+    pool->num_spawned = 0;
+    for (c = 0; c < pool->num_chunks; c++)
+        integrate_chunk(pool->chunks[c], dt);
+    for (c = 0; c < pool->num_chunks; c++) {
+        chunk = pool->chunks[c];
+        for (i = 0; i < PROJECTILE_POOL_CHUNK; i++) {
+            if (!(chunk->integrate[i] & PROJECTILE_INTEGRATE_UPDATE))
+                continue;
+            if (pool->slot_states[c * PROJECTILE_POOL_CHUNK + i] != PROJECTILE_SLOT_LIVE)
+                continue;
+            proj = &chunk->projectiles[i];
+            proj->update(proj, dt);
+            update_integrate_bits(proj);
+        }
+    }
+    // updates of these can spawn more, num_spawned is read every time
+    for (i = 0; i < pool->num_spawned; i++) {
+        idx = pool->spawned[i];
+        if (pool->slot_states[idx] != PROJECTILE_SLOT_SPAWNED)
+            continue;
+        pool->slot_states[idx] = PROJECTILE_SLOT_LIVE;
+        projectile_update(&pool->chunks[idx / PROJECTILE_POOL_CHUNK]->projectiles[idx % PROJECTILE_POOL_CHUNK], dt);
+    }
+    pool->updating = false;
+}
+
+void projectile_set_update(Projectile* proj, ProjectileUpdateFuncPtr update)
+{
+    proj->update = update;
+    update_integrate_bits(proj);
 }
 
 void projectile_set_flag(Projectile* proj, ProjectileFlagEnum flag, bool val)
 {
     proj->flags = (proj->flags & ~(1<<flag)) | (val<<flag);
+    update_integrate_bits(proj);
 }
 
 bool projectile_get_flag(Projectile* proj, ProjectileFlagEnum flag)
@@ -51,50 +247,54 @@ bool projectile_get_flag(Projectile* proj, ProjectileFlagEnum flag)
     return (proj->flags >> flag) & 1;
 }
 
-void projectile_destroy(Projectile* proj)
+void projectile_destroy(ProjectilePool* pool, Projectile* proj)
 {
     game_free_uid(proj->uid);
     if (proj->destroy != NULL)
         proj->destroy(proj);
     if (projectile_get_flag(proj, PROJECTILE_FLAG_AUTO_FREE_DATA))
         st_free(proj->data);
-    st_free(proj);
+    projectile_pool_free(pool, proj);
 }
 
 size_t projectile_sizeof(void)
 {
-    Projectile proj;
-    return sizeof(proj.position)
-         + sizeof(proj.direction)
-         + sizeof(proj.elevation)
-         + sizeof(proj.facing)
-         + sizeof(proj.rotation)
-         + sizeof(proj.speed)
-         + sizeof(proj.size)
-         + sizeof(proj.lifetime)
-         + sizeof(proj.flags)
-         + sizeof(proj.tex)
-         + sizeof(proj.uid);
+    ProjectileDesc desc;
+    return sizeof(desc.position)
+         + sizeof(desc.direction)
+         + sizeof(desc.elevation)
+         + sizeof(desc.facing)
+         + sizeof(desc.rotation)
+         + sizeof(desc.speed)
+         + sizeof(desc.size)
+         + sizeof(desc.lifetime)
+         + sizeof(desc.flags)
+         + sizeof(desc.tex)
+         + sizeof(desc.uid);
 }
 
 char* projectile_write(Projectile* proj, char* buffer)
 {
-    memcpy(buffer, &proj->position, sizeof(proj->position));
-    buffer += sizeof(proj->position);
-    memcpy(buffer, &proj->direction, sizeof(proj->direction));
-    buffer += sizeof(proj->direction);
+    vec2 position = projectile_position(proj);
+    vec2 direction = projectile_direction(proj);
+    f64 speed = projectile_speed(proj);
+    f32 lifetime = projectile_lifetime(proj);
+    memcpy(buffer, &position, sizeof(position));
+    buffer += sizeof(position);
+    memcpy(buffer, &direction, sizeof(direction));
+    buffer += sizeof(direction);
     memcpy(buffer, &proj->elevation, sizeof(proj->elevation));
     buffer += sizeof(proj->elevation);
     memcpy(buffer, &proj->facing, sizeof(proj->facing));
     buffer += sizeof(proj->facing);
     memcpy(buffer, &proj->rotation, sizeof(proj->rotation));
     buffer += sizeof(proj->rotation);
-    memcpy(buffer, &proj->speed, sizeof(proj->speed));
-    buffer += sizeof(proj->speed);
+    memcpy(buffer, &speed, sizeof(speed));
+    buffer += sizeof(speed);
     memcpy(buffer, &proj->size, sizeof(proj->size));
     buffer += sizeof(proj->size);
-    memcpy(buffer, &proj->lifetime, sizeof(proj->lifetime));
-    buffer += sizeof(proj->lifetime);
+    memcpy(buffer, &lifetime, sizeof(lifetime));
+    buffer += sizeof(lifetime);
     memcpy(buffer, &proj->flags, sizeof(proj->flags));
     buffer += sizeof(proj->flags);
     memcpy(buffer, &proj->tex, sizeof(proj->tex));
@@ -104,29 +304,30 @@ char* projectile_write(Projectile* proj, char* buffer)
     return buffer;
 }
 
-char* projectile_read(Projectile* proj, char* buffer)
+char* projectile_read(ProjectileDesc* desc, char* buffer)
 {
-    memcpy(&proj->position, buffer, sizeof(proj->position));
-    buffer += sizeof(proj->position);
-    memcpy(&proj->direction, buffer, sizeof(proj->direction));
-    buffer += sizeof(proj->direction);
-    memcpy(&proj->elevation, buffer, sizeof(proj->elevation));
-    buffer += sizeof(proj->elevation);
-    memcpy(&proj->facing, buffer, sizeof(proj->facing));
-    buffer += sizeof(proj->facing);
-    memcpy(&proj->rotation, buffer, sizeof(proj->rotation));
-    buffer += sizeof(proj->rotation);
-    memcpy(&proj->speed, buffer, sizeof(proj->speed));
-    buffer += sizeof(proj->speed);
-    memcpy(&proj->size, buffer, sizeof(proj->size));
-    buffer += sizeof(proj->size);
-    memcpy(&proj->lifetime, buffer, sizeof(proj->lifetime));
-    buffer += sizeof(proj->lifetime);
-    memcpy(&proj->flags, buffer, sizeof(proj->flags));
-    buffer += sizeof(proj->flags);
-    memcpy(&proj->tex, buffer, sizeof(proj->tex));
-    buffer += sizeof(proj->tex);
-    memcpy(&proj->uid, buffer, sizeof(proj->uid));
-    buffer += sizeof(proj->uid);
+    memset(desc, 0, sizeof(ProjectileDesc));
+    memcpy(&desc->position, buffer, sizeof(desc->position));
+    buffer += sizeof(desc->position);
+    memcpy(&desc->direction, buffer, sizeof(desc->direction));
+    buffer += sizeof(desc->direction);
+    memcpy(&desc->elevation, buffer, sizeof(desc->elevation));
+    buffer += sizeof(desc->elevation);
+    memcpy(&desc->facing, buffer, sizeof(desc->facing));
+    buffer += sizeof(desc->facing);
+    memcpy(&desc->rotation, buffer, sizeof(desc->rotation));
+    buffer += sizeof(desc->rotation);
+    memcpy(&desc->speed, buffer, sizeof(desc->speed));
+    buffer += sizeof(desc->speed);
+    memcpy(&desc->size, buffer, sizeof(desc->size));
+    buffer += sizeof(desc->size);
+    memcpy(&desc->lifetime, buffer, sizeof(desc->lifetime));
+    buffer += sizeof(desc->lifetime);
+    memcpy(&desc->flags, buffer, sizeof(desc->flags));
+    buffer += sizeof(desc->flags);
+    memcpy(&desc->tex, buffer, sizeof(desc->tex));
+    buffer += sizeof(desc->tex);
+    memcpy(&desc->uid, buffer, sizeof(desc->uid));
+    buffer += sizeof(desc->uid);
     return buffer;
 }
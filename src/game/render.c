@@ -1,6 +1,7 @@
 #include "../game.h"
 #include "../renderer.h"
 #include "../window.h"
+#include <string.h>
 
 #define NEAR_CLIP_DISTANCE  0.001f
 #define FAR_CLIP_DISTANCE   1000.0f
@@ -17,6 +18,9 @@
 #define SHADOW_FLOATS_PER_VERTEX        4
 #define LINE_FLOATS_PER_VERTEX          13
 
+// objects per parallel vertex generation task
+#define RENDER_CHUNK_LENGTH             1024
+
 typedef enum {
     VAO_QUAD,
     VAO_TILE,
@@ -147,10 +151,17 @@ static void update_proj_matrix(void)
     glBufferSubData(GL_UNIFORM_BUFFER, 3 * sizeof(GLfloat), sizeof(GLfloat), &cam->minimap_zoom);
 }
 
-static void copy_camera(void)
+static vec2 interpolate(vec2 prev_position, vec2 position, f32 alpha)
+{
+    return vec2_add(prev_position, vec2_scale(vec2_sub(position, prev_position), alpha));
+}
+
+static void copy_camera(f32 alpha)
 {
     Camera* game_cam = &game_context.this_client->camera;
     RenderCamera* render_cam = &render_context.camera;
+    Entity* entity = game_context.this_client->player.entity;
+    vec2 offset;
     render_cam->yaw          = game_cam->yaw;
     render_cam->pitch        = game_cam->pitch;
     render_cam->zoom         = game_cam->zoom;
@@ -161,6 +172,15 @@ static void copy_camera(void)
     render_cam->right        = game_cam->right;
     render_cam->up           = game_cam->up;
     render_cam->target       = game_cam->target;
+
+    // camera locks onto the player at the end of the step, so shift
+    // it back by the same amount the player is being interpolated
+    if (game_cam->follow && entity != NULL) {
+        offset = vec2_sub(interpolate(entity->prev_position, entity->position, alpha), entity->position);
+        render_cam->position.x += offset.x;
+        render_cam->position.z += offset.z;
+        render_cam->target = vec2_add(render_cam->target, offset);
+    }
 }
 
 static void resize_vertex_buffer(VertexBuffer* vb, i32 capacity)
@@ -187,124 +207,119 @@ static void update_game_time(void)
     glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(GLdouble), &game_context.time);
 }
     
-static void update_entity_vertex_data(Map* map)
-{
+// vertex writers fill out with the objects in [start, end) and return
+// the number of floats written. they only read the map, so chunks of
+// the same list can be written from several threads at once
+typedef i32 (*VertexWriteFunc)(Map* map, f32 alpha, GLfloat* out, i32 start, i32 end);
+typedef void (*VertexPassFunc)(Map* map, f32 alpha);
+
+typedef struct {
     VertexBuffer* vb;
-    VertexBuffer* shadow_vb;
-    VertexBuffer* map_vb;
-    vec2 pivot, stretch;
+    VertexWriteFunc write;
+    Map* map;
+    f32 alpha;
+    i32 stride;
+    i32* lengths;
+} VertexChunkContext;
+
+typedef struct {
+    Map* map;
+    f32 alpha;
+    VertexPassFunc passes[NUM_BUFFERS];
+} VertexPassContext;
+
+static i32 write_entity_vertices(Map* map, f32 alpha, GLfloat* out, i32 start, i32 end)
+{
+    vec2 pivot, stretch, position;
     f32 u, v, w, h;
     i32 location;
     i32 i, j;
     Entity* entity;
-    List* entities;
-
-    entities = map->entities;
-    vb = &render_context.data_swap->buffers[SSBO_ENTITY];
-    shadow_vb = &render_context.data_swap->buffers[SSBO_ENTITY_SHADOW];
-    map_vb = &render_context.data_swap->buffers[SSBO_ENTITY_MINIMAP];
-    resize_vertex_buffer(vb, ENTITY_FLOATS_PER_VERTEX * entities->capacity);
-    resize_vertex_buffer(shadow_vb, SHADOW_FLOATS_PER_VERTEX * entities->capacity);
-    resize_vertex_buffer(map_vb, MAP_CIRCLE_FLOATS_PER_VERTEX * entities->capacity);
-
-    for (i = j = 0; i < entities->length; i++) {
-        entity = list_get(entities, i);
+
+    for (i = start, j = 0; i < end; i++) {
+        entity = list_get(map->entities, i);
         if (map_fog_contains(map, entity->position))
             continue;
         texture_info(entity_get_texture(entity), &location, &u, &v, &w, &h, &pivot, &stretch);
-        vb->buffer[j++] = entity->position.x;
-        vb->buffer[j++] = entity->elevation;
-        vb->buffer[j++] = entity->position.z;
-        vb->buffer[j++] = entity->size;
-        vb->buffer[j++] = u;
-        vb->buffer[j++] = v;
-        vb->buffer[j++] = w;
-        vb->buffer[j++] = h;
-        vb->buffer[j++] = location;
-        vb->buffer[j++] = pivot.x;
-        vb->buffer[j++] = pivot.y;
-        vb->buffer[j++] = stretch.x;
-        vb->buffer[j++] = stretch.y;
+        position = interpolate(entity->prev_position, entity->position, alpha);
+        out[j++] = position.x;
+        out[j++] = entity->elevation;
+        out[j++] = position.z;
+        out[j++] = entity->size;
+        out[j++] = u;
+        out[j++] = v;
+        out[j++] = w;
+        out[j++] = h;
+        out[j++] = location;
+        out[j++] = pivot.x;
+        out[j++] = pivot.y;
+        out[j++] = stretch.x;
+        out[j++] = stretch.y;
     }
-    vb->length = j;
+    return j;
+}
+
+static i32 write_entity_minimap_vertices(Map* map, f32 alpha, GLfloat* out, i32 start, i32 end)
+{
+    vec2 position;
+    i32 i, j;
+    Entity* entity;
 
-    for (i = j = 0; i < entities->length; i++) {
-        entity = list_get(entities, i);
+    for (i = start, j = 0; i < end; i++) {
+        entity = list_get(map->entities, i);
         if (map_fog_contains(map, entity->position))
             continue;
-        map_vb->buffer[j++] = entity->position.x;
-        map_vb->buffer[j++] = entity->position.z;
-        map_vb->buffer[j++] = entity->hitbox_radius;
+        position = interpolate(entity->prev_position, entity->position, alpha);
+        out[j++] = position.x;
+        out[j++] = position.z;
+        out[j++] = entity->hitbox_radius;
         if (entity_get_flag(entity, ENTITY_FLAG_FRIENDLY)) {
-            map_vb->buffer[j++] = 0.0f;
-            map_vb->buffer[j++] = 1.0f;
-            map_vb->buffer[j++] = 0.0f;
+            out[j++] = 0.0f;
+            out[j++] = 1.0f;
+            out[j++] = 0.0f;
         } else {
-            map_vb->buffer[j++] = 1.0f;
-            map_vb->buffer[j++] = 0.0f;
-            map_vb->buffer[j++] = 0.0f;
+            out[j++] = 1.0f;
+            out[j++] = 0.0f;
+            out[j++] = 0.0f;
         }
     }
-    map_vb->length = j;
-    
-    return;
-
-    // invalid read of size 1
-    for (i = j = 0; i < entities->length; i++) {
-        entity = list_get(entities, i);
-        if (map_fog_contains(map, entity->position))
-            continue;
-        shadow_vb->buffer[j++] = entity->position.x;
-        shadow_vb->buffer[j++] = entity->elevation;
-        shadow_vb->buffer[j++] = entity->position.z;
-        shadow_vb->buffer[j++] = entity->size;
-    }
-    shadow_vb->length = j;
+    return j;
 }
 
-static void update_projectile_vertex_data(Map* map)
+static i32 write_projectile_vertices(Map* map, f32 alpha, GLfloat* out, i32 start, i32 end)
 {
-    VertexBuffer* vb;
-    vec2 pivot, stretch;
+    vec2 pivot, stretch, position;
     f32 u, v, w, h;
-    i32 location, tex;
+    i32 location;
     i32 i, j;
     Projectile* projectile;
     bool rotate_tex;
-    List* projectiles;
-
-    projectiles = map->projectiles;
-    vb = &render_context.data_swap->buffers[SSBO_PROJECTILE];
-    resize_vertex_buffer(vb, PROJECTILE_FLOATS_PER_VERTEX * projectiles->capacity);
 
-    for (i = j = 0; i < projectiles->length; i++) {
-        projectile = list_get(projectiles, i);
-        if (map_fog_contains(map, projectile->position))
+    for (i = start, j = 0; i < end; i++) {
+        projectile = list_get(map->projectiles, i);
+        if (map_fog_contains(map, projectile_position(projectile)))
             continue;
-        tex = projectile->tex;
-        texture_info(tex, &location, &u, &v, &w, &h, &pivot, &stretch);
+        texture_info(projectile->tex, &location, &u, &v, &w, &h, &pivot, &stretch);
         rotate_tex = projectile_get_flag(projectile, PROJECTILE_FLAG_TEX_ROTATION);
-        vb->buffer[j++] = projectile->position.x;
-        vb->buffer[j++] = projectile->elevation;
-        vb->buffer[j++] = projectile->position.z;
+        position = interpolate(projectile_prev_position(projectile), projectile_position(projectile), alpha);
+        out[j++] = position.x;
+        out[j++] = projectile->elevation;
+        out[j++] = position.z;
         // encode texture rotation as negative num
-        vb->buffer[j++] = projectile->size * (rotate_tex ? 1 : -1);
-        vb->buffer[j++] = projectile->facing;
-        vb->buffer[j++] = projectile->rotation;
-        vb->buffer[j++] = u;
-        vb->buffer[j++] = v;
-        vb->buffer[j++] = w;
-        vb->buffer[j++] = h;
-        vb->buffer[j++] = location; 
+        out[j++] = projectile->size * (rotate_tex ? 1 : -1);
+        out[j++] = projectile->facing;
+        out[j++] = projectile->rotation;
+        out[j++] = u;
+        out[j++] = v;
+        out[j++] = w;
+        out[j++] = h;
+        out[j++] = location; 
     }
-
-    vb->length = j;
+    return j;
 }
 
-static void update_tile_vertex_data(Map* map)
+static i32 write_tile_vertices(Map* map, f32 alpha, GLfloat* out, i32 start, i32 end)
 {
-    VertexBuffer* vb;
-    VertexBuffer* map_vb;
     vec2 pivot, stretch;
     f32 u, v, w, h;
     i32 location;
@@ -312,17 +327,9 @@ static void update_tile_vertex_data(Map* map)
     bool animate_horizontal_pos, animate_vertical_pos;
     bool animate_horizontal_neg, animate_vertical_neg;
     Tile* tile;
-    List* tiles;
-
-    tiles = map->tiles;
-    vb = &render_context.data_swap->buffers[VBO_TILE];
-    map_vb = &render_context.data_swap->buffers[VBO_TILE_MINIMAP];
-    resize_vertex_buffer(vb, TILE_VERTEX_LENGTH * tiles->capacity);
-    resize_vertex_buffer(map_vb, MAP_SQUARE_FLOATS_PER_VERTEX * tiles->capacity);
 
-    for (i = j = 0; i < tiles->length; i++) {
-        tile = list_get(tiles, i);
-        //log_write(DEBUG, "%d %d", tile->uid,tile->tex);
+    for (i = start, j = 0; i < end; i++) {
+        tile = list_get(map->tiles, i);
         if (!tile_get_flag(tile, TILE_FLAG_ACTIVE))
             continue;
         if (map_fog_contains_tile(map, tile))
@@ -332,69 +339,66 @@ static void update_tile_vertex_data(Map* map)
         animate_horizontal_neg = tile_get_flag(tile, TILE_FLAG_ANIMATE_HORIZONTAL_NEG);
         animate_vertical_neg = tile_get_flag(tile, TILE_FLAG_ANIMATE_VERTICAL_NEG);
         texture_info(tile->tex, &location, &u, &v, &w, &h, &pivot, &stretch);
-        vb->buffer[j++] = tile->position.x;
-        vb->buffer[j++] = tile->position.z;
-        vb->buffer[j++] = u;
-        vb->buffer[j++] = v;
-        vb->buffer[j++] = w;
-        vb->buffer[j++] = h;
-        vb->buffer[j++] = location;
-        vb->buffer[j++] = animate_horizontal_pos + (animate_horizontal_neg<<1)
+        out[j++] = tile->position.x;
+        out[j++] = tile->position.z;
+        out[j++] = u;
+        out[j++] = v;
+        out[j++] = w;
+        out[j++] = h;
+        out[j++] = location;
+        out[j++] = animate_horizontal_pos + (animate_horizontal_neg<<1)
             + (animate_vertical_pos<<2) + (animate_vertical_neg<<3);
     }
-    vb->length = j;
+    return j;
+}
+
+static i32 write_tile_minimap_vertices(Map* map, f32 alpha, GLfloat* out, i32 start, i32 end)
+{
+    i32 i, j;
+    Tile* tile;
 
-    for (i = j = 0; i < tiles->length; i++) {
-        tile = list_get(tiles, i);
+    for (i = start, j = 0; i < end; i++) {
+        tile = list_get(map->tiles, i);
         if (!tile_get_flag(tile, TILE_FLAG_ACTIVE))
             continue;
         if (map_fog_contains_tile(map, tile))
             continue;
-        map_vb->buffer[j++] = tile->position.x;
-        map_vb->buffer[j++] = tile->position.z;
-        map_vb->buffer[j++] = 1.0f; // tile width and height
-        map_vb->buffer[j++] = 1.0f; // always 1
-        map_vb->buffer[j++] = (((tile->minimap_color)>>16)&0xFF) / 255.0f;
-        map_vb->buffer[j++] = (((tile->minimap_color)>>8)&0xFF) / 255.0f;
-        map_vb->buffer[j++] = (tile->minimap_color&0xFF) / 255.0f;
+        out[j++] = tile->position.x;
+        out[j++] = tile->position.z;
+        out[j++] = 1.0f; // tile width and height
+        out[j++] = 1.0f; // always 1
+        out[j++] = (((tile->minimap_color)>>16)&0xFF) / 255.0f;
+        out[j++] = (((tile->minimap_color)>>8)&0xFF) / 255.0f;
+        out[j++] = (tile->minimap_color&0xFF) / 255.0f;
     }
-    map_vb->length = j;
+    return j;
 }
 
-static void update_wall_vertex_data(Map* map)
+static i32 write_wall_vertices(Map* map, f32 alpha, GLfloat* out, i32 start, i32 end)
 {
-    VertexBuffer* vb;
-    VertexBuffer* map_vb;
     vec2 pivot, stretch;
     f32 u, v, w, h;
     i32 location;
     i32 idx;
     i32 i, j, k;
     Wall* wall;
-    List* walls;
 
-    walls = map->walls;
-    vb = &render_context.data_swap->buffers[VBO_WALL];
-    map_vb = &render_context.data_swap->buffers[VBO_WALL_MINIMAP];
-    resize_vertex_buffer(vb, WALL_VERTEX_LENGTH * walls->capacity);
-    resize_vertex_buffer(map_vb, MAP_SQUARE_FLOATS_PER_VERTEX * walls->capacity);
-
-    static f32 dx[] = {0, 0, 0, 0, 1, 1, 1, 1};
-    static f32 dy[] = {0, 0, 1, 1, 0, 0, 1, 1};
-    static f32 dz[] = {0, 1, 0, 1, 0, 1, 0, 1};
-    static f32 tx[] = {0, 1, 1, 0};
-    static f32 ty[] = {0, 0, 1, 1};
-    static i32 side_order[5][4] = {
+    static const f32 dx[] = {0, 0, 0, 0, 1, 1, 1, 1};
+    static const f32 dy[] = {0, 0, 1, 1, 0, 0, 1, 1};
+    static const f32 dz[] = {0, 1, 0, 1, 0, 1, 0, 1};
+    static const f32 tx[] = {0, 1, 1, 0};
+    static const f32 ty[] = {0, 0, 1, 1};
+    static const i32 side_order[5][4] = {
         {4, 5, 7, 6}, // +x
         {3, 7, 5, 1}, // +z
         {1, 0, 2, 3}, // -x
         {0, 4, 6, 2}, // -z
         {2, 6, 7, 3}  // +y
     };
-    static i32 winding[] = {0, 1, 2, 0, 2, 3};
+    static const i32 winding[] = {0, 1, 2, 0, 2, 3};
 
-    for (i = j = 0; i < walls->length; i++) {
-        wall = list_get(walls, i);
+    for (i = start, j = 0; i < end; i++) {
+        wall = list_get(map->walls, i);
         if (!wall_get_flag(wall, WALL_FLAG_ACTIVE))
             continue;
         if (map_fog_contains_wall(map, wall))
@@ -404,220 +408,285 @@ static void update_wall_vertex_data(Map* map)
             for (k = 0; k < 6; k++) {
                 idx = side_order[side][winding[k]];
                 // nvidia rounding error? epsilon fixes kind of
-                vb->buffer[j++] = wall->position.x + dx[idx] * (wall->size.x + 0.001); 
-                vb->buffer[j++] = wall->height * dy[idx];
-                vb->buffer[j++] = wall->position.z + dz[idx] * (wall->size.y + 0.001);
-                vb->buffer[j++] = u + tx[winding[k]] * w;
-                vb->buffer[j++] = v + ty[winding[k]] * h;
-                vb->buffer[j++] = location;
-                vb->buffer[j++] = wall->position.x + wall->size.x / 2;
-                vb->buffer[j++] = wall->position.z + wall->size.y / 2;
+                out[j++] = wall->position.x + dx[idx] * (wall->size.x + 0.001); 
+                out[j++] = wall->height * dy[idx];
+                out[j++] = wall->position.z + dz[idx] * (wall->size.y + 0.001);
+                out[j++] = u + tx[winding[k]] * w;
+                out[j++] = v + ty[winding[k]] * h;
+                out[j++] = location;
+                out[j++] = wall->position.x + wall->size.x / 2;
+                out[j++] = wall->position.z + wall->size.y / 2;
             }
         }
         texture_info(wall->top_tex, &location, &u, &v, &w, &h, &pivot, &stretch);
         for (k = 0; k < 6; k++) {
             idx = side_order[4][winding[k]];
-            vb->buffer[j++] = wall->position.x + dx[idx] * wall->size.x; 
-            vb->buffer[j++] = wall->height * dy[idx];
-            vb->buffer[j++] = wall->position.z + dz[idx] * wall->size.y;
-            vb->buffer[j++] = u + tx[winding[k]] * w;
-            vb->buffer[j++] = v + ty[winding[k]] * h;
-            vb->buffer[j++] = location;
-            vb->buffer[j++] = wall->position.x + wall->size.x / 2;
-            vb->buffer[j++] = wall->position.z + wall->size.y / 2;
+            out[j++] = wall->position.x + dx[idx] * wall->size.x; 
+            out[j++] = wall->height * dy[idx];
+            out[j++] = wall->position.z + dz[idx] * wall->size.y;
+            out[j++] = u + tx[winding[k]] * w;
+            out[j++] = v + ty[winding[k]] * h;
+            out[j++] = location;
+            out[j++] = wall->position.x + wall->size.x / 2;
+            out[j++] = wall->position.z + wall->size.y / 2;
         }
     }
-    vb->length = j;
+    return j;
+}
+
+static i32 write_wall_minimap_vertices(Map* map, f32 alpha, GLfloat* out, i32 start, i32 end)
+{
+    i32 i, j;
+    Wall* wall;
 
-    for (i = j = 0; i < walls->length; i++) {
-        wall = list_get(walls, i);
+    for (i = start, j = 0; i < end; i++) {
+        wall = list_get(map->walls, i);
         if (!wall_get_flag(wall, WALL_FLAG_ACTIVE))
             continue;
         if (map_fog_contains_wall(map, wall))
             continue;
-        map_vb->buffer[j++] = wall->position.x;
-        map_vb->buffer[j++] = wall->position.z;
-        map_vb->buffer[j++] = wall->size.x;
-        map_vb->buffer[j++] = wall->size.z;
-        map_vb->buffer[j++] = (((wall->minimap_color)>>16)&0xFF) / 255.0f;
-        map_vb->buffer[j++] = (((wall->minimap_color)>>8)&0xFF) / 255.0f;
-        map_vb->buffer[j++] = (wall->minimap_color&0xFF) / 255.0f;
+        out[j++] = wall->position.x;
+        out[j++] = wall->position.z;
+        out[j++] = wall->size.x;
+        out[j++] = wall->size.z;
+        out[j++] = (((wall->minimap_color)>>16)&0xFF) / 255.0f;
+        out[j++] = (((wall->minimap_color)>>8)&0xFF) / 255.0f;
+        out[j++] = (wall->minimap_color&0xFF) / 255.0f;
     }
-    map_vb->length = j;
+    return j;
 }
 
-static void update_parstacle_vertex_data(Map* map)
+static i32 write_parstacle_vertices(Map* map, f32 alpha, GLfloat* out, i32 start, i32 end)
 {
-    VertexBuffer* vb;
     vec2 pivot, stretch;
     f32 u, v, w, h;
     i32 location;
     i32 i, j;
     Parstacle* parstacle;
-    List* parstacles;
 
-    parstacles = map->parstacles;
-    vb = &render_context.data_swap->buffers[SSBO_PARSTACLE];
-    resize_vertex_buffer(vb, OBSTACLE_FLOATS_PER_VERTEX * parstacles->capacity);
-
-    i32 tex = texture_get_id("bush");
-    texture_info(tex, &location, &u, &v, &w, &h, &pivot, &stretch);
+    texture_info(texture_get_id("bush"), &location, &u, &v, &w, &h, &pivot, &stretch);
     
-    for (i = j = 0; i < parstacles->length; i++) {
-        parstacle = list_get(parstacles, i);
+    for (i = start, j = 0; i < end; i++) {
+        parstacle = list_get(map->parstacles, i);
         if (map_fog_contains(map, parstacle->position))
             continue;
-        vb->buffer[j++] = parstacle->position.x;
-        vb->buffer[j++] = parstacle->position.z;
-        vb->buffer[j++] = parstacle->size;
-        vb->buffer[j++] = u;
-        vb->buffer[j++] = v;
-        vb->buffer[j++] = w;
-        vb->buffer[j++] = h;
-        vb->buffer[j++] = location;
+        out[j++] = parstacle->position.x;
+        out[j++] = parstacle->position.z;
+        out[j++] = parstacle->size;
+        out[j++] = u;
+        out[j++] = v;
+        out[j++] = w;
+        out[j++] = h;
+        out[j++] = location;
     }
-
-    vb->length = j;
+    return j;
 }
 
-static void update_obstacle_vertex_data(Map* map)
+static i32 write_obstacle_vertices(Map* map, f32 alpha, GLfloat* out, i32 start, i32 end)
 {
-    VertexBuffer* vb;
-    VertexBuffer* map_vb;
-    Obstacle* obstacle;
     vec2 pivot, stretch;
     f32 u, v, w, h;
     i32 location;
     i32 i, j;
-    List* obstacles;
-
-    obstacles = map->obstacles;
-    vb = &render_context.data_swap->buffers[SSBO_OBSTACLE];
-    map_vb = &render_context.data->buffers[SSBO_OBSTACLE_MINIMAP];
-    resize_vertex_buffer(vb, OBSTACLE_FLOATS_PER_VERTEX * obstacles->capacity);
-    resize_vertex_buffer(map_vb, MAP_CIRCLE_FLOATS_PER_VERTEX * obstacles->capacity);
+    Obstacle* obstacle;
 
-    i32 tex = texture_get_id("rock");
-    texture_info(tex, &location, &u, &v, &w, &h, &pivot, &stretch);
+    texture_info(texture_get_id("rock"), &location, &u, &v, &w, &h, &pivot, &stretch);
     
-    for (i = j = 0; i < obstacles->length; i++) {
-        obstacle = list_get(obstacles, i);
+    for (i = start, j = 0; i < end; i++) {
+        obstacle = list_get(map->obstacles, i);
         if (map_fog_contains(map, obstacle->position))
             continue;
-        vb->buffer[j++] = obstacle->position.x;
-        vb->buffer[j++] = obstacle->position.z;
-        vb->buffer[j++] = obstacle->size;
-        vb->buffer[j++] = u;
-        vb->buffer[j++] = v;
-        vb->buffer[j++] = w;
-        vb->buffer[j++] = h;
-        vb->buffer[j++] = location;
+        out[j++] = obstacle->position.x;
+        out[j++] = obstacle->position.z;
+        out[j++] = obstacle->size;
+        out[j++] = u;
+        out[j++] = v;
+        out[j++] = w;
+        out[j++] = h;
+        out[j++] = location;
     }
-    vb->length = j;
+    return j;
+}
 
-    for (i = j = 0; i < obstacles->length; i++) {
-        obstacle = list_get(obstacles, i);
+static i32 write_obstacle_minimap_vertices(Map* map, f32 alpha, GLfloat* out, i32 start, i32 end)
+{
+    i32 i, j;
+    Obstacle* obstacle;
+
+    for (i = start, j = 0; i < end; i++) {
+        obstacle = list_get(map->obstacles, i);
         if (map_fog_contains(map, obstacle->position))
             continue;
-        map_vb->buffer[j++] = obstacle->position.x;
-        map_vb->buffer[j++] = obstacle->position.z;
-        map_vb->buffer[j++] = obstacle->size / 2;
-        map_vb->buffer[j++] = 1.0f;
-        map_vb->buffer[j++] = 0.5f;
-        map_vb->buffer[j++] = 0.5f;
+        out[j++] = obstacle->position.x;
+        out[j++] = obstacle->position.z;
+        out[j++] = obstacle->size / 2;
+        out[j++] = 1.0f;
+        out[j++] = 0.5f;
+        out[j++] = 0.5f;
     }
-    map_vb->length = j;
+    return j;
 }
 
-static void update_particle_vertex_data(Map* map)
+static i32 write_particle_vertices(Map* map, f32 alpha, GLfloat* out, i32 start, i32 end)
 {
-    VertexBuffer* vb;
-    Particle* particle;
+    ParticleSystem* ps = &map->particles;
     i32 i, j;
-    List* particles;
-
-    particles = map->particles;
-    vb = &render_context.data_swap->buffers[SSBO_PARTICLE];
-    resize_vertex_buffer(vb, PARTICLE_FLOATS_PER_VERTEX * particles->capacity);
-   
-    for (i = j = 0; i < particles->length; i++) {
-        particle = list_get(particles, i);
-        if (map_fog_contains(map, vec2_create(particle->position.x, particle->position.z)))
+
+    for (i = start, j = 0; i < end; i++) {
+        if (map_fog_contains(map, vec2_create(ps->position[0][i], ps->position[2][i])))
             continue;
-        vb->buffer[j++] = particle->position.x;
-        vb->buffer[j++] = particle->position.y;
-        vb->buffer[j++] = particle->position.z;
-        vb->buffer[j++] = particle->color.x;
-        vb->buffer[j++] = particle->color.y;
-        vb->buffer[j++] = particle->color.z;
-        vb->buffer[j++] = particle->size;
+        out[j++] = ps->position[0][i];
+        out[j++] = ps->position[1][i];
+        out[j++] = ps->position[2][i];
+        out[j++] = ps->color[0][i];
+        out[j++] = ps->color[1][i];
+        out[j++] = ps->color[2][i];
+        out[j++] = ps->size[i];
     }
-    
-    vb->length = j;
+    return j;
 }
 
-static void update_parjicle_vertex_data(Map* map)
+static i32 write_parjicle_vertices(Map* map, f32 alpha, GLfloat* out, i32 start, i32 end)
 {
-    VertexBuffer* vb;
-    Parjicle* parjicle;
-    bool rotate_tex;
+    ParticleSystem* ps = &map->parjicles;
     i32 i, j;
-    List* parjicles;
-
-    parjicles = map->parjicles;
-    vb = &render_context.data_swap->buffers[SSBO_PARJICLE];
-    resize_vertex_buffer(vb, PARJICLE_FLOATS_PER_VERTEX * parjicles->capacity);
-   
-    for (i = j = 0; i < parjicles->length; i++) {
-        parjicle = list_get(parjicles, i);
-        if (map_fog_contains(map, vec2_create(parjicle->position.x, parjicle->position.z)))
+
+    for (i = start, j = 0; i < end; i++) {
+        if (map_fog_contains(map, vec2_create(ps->position[0][i], ps->position[2][i])))
             continue;
-        vb->buffer[j++] = parjicle->position.x;
-        vb->buffer[j++] = parjicle->position.y;
-        vb->buffer[j++] = parjicle->position.z;
-        vb->buffer[j++] = parjicle->color.x;
-        vb->buffer[j++] = parjicle->color.y;
-        vb->buffer[j++] = parjicle->color.z;
-        vb->buffer[j++] = parjicle->size * (parjicle->rotate_tex ? 1 : -1);
-        vb->buffer[j++] = parjicle->rotation;
+        out[j++] = ps->position[0][i];
+        out[j++] = ps->position[1][i];
+        out[j++] = ps->position[2][i];
+        out[j++] = ps->color[0][i];
+        out[j++] = ps->color[1][i];
+        out[j++] = ps->color[2][i];
+        out[j++] = ps->size[i] * (ps->rotate_tex[i] ? 1 : -1);
+        out[j++] = ps->rotation[i];
     }
-    
-    vb->length = j;
+    return j;
 }
 
-static void update_line_vertex_data(Map* map)
+static i32 write_line_vertices(Map* map, f32 alpha, GLfloat* out, i32 start, i32 end)
 {
-    VertexBuffer* vb;
     Line* line;
     i32 i, j;
-    List* lines;
-
-    lines = map->lines;
-    vb = &render_context.data_swap->buffers[SSBO_LINE];
-    resize_vertex_buffer(vb, LINE_FLOATS_PER_VERTEX * lines->capacity);
-   
-    for (i = j = 0; i < lines->length; i++) {
-        line = list_get(lines, i);
+
+    for (i = start, j = 0; i < end; i++) {
+        line = list_get(map->lines, i);
         if (line->is_spatial_hash_line && !map->show_spatial_hash_lines)
             continue;
-        vb->buffer[j++] = line->width;
-        vb->buffer[j++] = line->pos1.x;
-        vb->buffer[j++] = line->pos1.y;
-        vb->buffer[j++] = line->pos1.z;
-        vb->buffer[j++] = line->color1.x;
-        vb->buffer[j++] = line->color1.y;
-        vb->buffer[j++] = line->color1.z;
-        vb->buffer[j++] = line->pos2.x;
-        vb->buffer[j++] = line->pos2.y;
-        vb->buffer[j++] = line->pos2.z;
-        vb->buffer[j++] = line->color2.x;
-        vb->buffer[j++] = line->color2.y;
-        vb->buffer[j++] = line->color2.z;
+        out[j++] = line->width;
+        out[j++] = line->pos1.x;
+        out[j++] = line->pos1.y;
+        out[j++] = line->pos1.z;
+        out[j++] = line->color1.x;
+        out[j++] = line->color1.y;
+        out[j++] = line->color1.z;
+        out[j++] = line->pos2.x;
+        out[j++] = line->pos2.y;
+        out[j++] = line->pos2.z;
+        out[j++] = line->color2.x;
+        out[j++] = line->color2.y;
+        out[j++] = line->color2.z;
+    }
+    return j;
+}
+
+static void write_vertex_chunk(void* arg, i32 start, i32 end)
+{
+    VertexChunkContext* ctx = arg;
+    GLfloat* out = ctx->vb->buffer + (size_t)start * ctx->stride;
+    ctx->lengths[start / RENDER_CHUNK_LENGTH] = ctx->write(ctx->map, ctx->alpha, out, start, end);
+}
+
+// fills vb with the vertices of objects [0, n), which take at most
+// stride floats each. large lists are cut into chunks that are written
+// in parallel, each starting at the offset of its first object so no
+// two chunks overlap, and then packed down over the skipped objects
+static void write_vertex_buffer(VertexBuffer* vb, VertexWriteFunc write, Map* map, f32 alpha, i32 n, i32 stride)
+{
+    i32 num_chunks = (n + RENDER_CHUNK_LENGTH - 1) / RENDER_CHUNK_LENGTH;
+    i32 lengths[maxi(num_chunks, 1)];
+    VertexChunkContext ctx = { vb, write, map, alpha, stride, lengths };
+    i32 c, j;
+
+    resize_vertex_buffer(vb, stride * n);
+    if (num_chunks <= 1) {
+        vb->length = write(map, alpha, vb->buffer, 0, n);
+        return;
+    }
+
+    job_parallel_for(write_vertex_chunk, &ctx, n, RENDER_CHUNK_LENGTH);
+
+    for (c = j = 0; c < num_chunks; c++) {
+        memmove(vb->buffer + j, vb->buffer + (size_t)c * RENDER_CHUNK_LENGTH * stride, lengths[c] * sizeof(GLfloat));
+        j += lengths[c];
     }
-    
     vb->length = j;
 }
 
+static void update_entity_vertex_data(Map* map, f32 alpha)
+{
+    RenderData* data = render_context.data_swap;
+    i32 n = map->entities->length;
+    write_vertex_buffer(&data->buffers[SSBO_ENTITY], write_entity_vertices, map, alpha, n, ENTITY_FLOATS_PER_VERTEX);
+    write_vertex_buffer(&data->buffers[SSBO_ENTITY_MINIMAP], write_entity_minimap_vertices, map, alpha, n, MAP_CIRCLE_FLOATS_PER_VERTEX);
+}
+
+static void update_projectile_vertex_data(Map* map, f32 alpha)
+{
+    RenderData* data = render_context.data_swap;
+    write_vertex_buffer(&data->buffers[SSBO_PROJECTILE], write_projectile_vertices, map, alpha, map->projectiles->length, PROJECTILE_FLOATS_PER_VERTEX);
+}
+
+static void update_tile_vertex_data(Map* map, f32 alpha)
+{
+    RenderData* data = render_context.data_swap;
+    i32 n = map->tiles->length;
+    write_vertex_buffer(&data->buffers[VBO_TILE], write_tile_vertices, map, alpha, n, TILE_VERTEX_LENGTH);
+    write_vertex_buffer(&data->buffers[VBO_TILE_MINIMAP], write_tile_minimap_vertices, map, alpha, n, MAP_SQUARE_FLOATS_PER_VERTEX);
+}
+
+static void update_wall_vertex_data(Map* map, f32 alpha)
+{
+    RenderData* data = render_context.data_swap;
+    i32 n = map->walls->length;
+    write_vertex_buffer(&data->buffers[VBO_WALL], write_wall_vertices, map, alpha, n, WALL_VERTEX_LENGTH);
+    write_vertex_buffer(&data->buffers[VBO_WALL_MINIMAP], write_wall_minimap_vertices, map, alpha, n, MAP_SQUARE_FLOATS_PER_VERTEX);
+}
+
+static void update_parstacle_vertex_data(Map* map, f32 alpha)
+{
+    RenderData* data = render_context.data_swap;
+    write_vertex_buffer(&data->buffers[SSBO_PARSTACLE], write_parstacle_vertices, map, alpha, map->parstacles->length, OBSTACLE_FLOATS_PER_VERTEX);
+}
+
+static void update_obstacle_vertex_data(Map* map, f32 alpha)
+{
+    RenderData* data = render_context.data_swap;
+    i32 n = map->obstacles->length;
+    write_vertex_buffer(&data->buffers[SSBO_OBSTACLE], write_obstacle_vertices, map, alpha, n, OBSTACLE_FLOATS_PER_VERTEX);
+    write_vertex_buffer(&data->buffers[SSBO_OBSTACLE_MINIMAP], write_obstacle_minimap_vertices, map, alpha, n, MAP_CIRCLE_FLOATS_PER_VERTEX);
+}
+
+static void update_particle_vertex_data(Map* map, f32 alpha)
+{
+    RenderData* data = render_context.data_swap;
+    write_vertex_buffer(&data->buffers[SSBO_PARTICLE], write_particle_vertices, map, alpha, map->particles.length, PARTICLE_FLOATS_PER_VERTEX);
+}
+
+static void update_parjicle_vertex_data(Map* map, f32 alpha)
+{
+    RenderData* data = render_context.data_swap;
+    write_vertex_buffer(&data->buffers[SSBO_PARJICLE], write_parjicle_vertices, map, alpha, map->parjicles.length, PARJICLE_FLOATS_PER_VERTEX);
+}
+
+static void update_line_vertex_data(Map* map, f32 alpha)
+{
+    RenderData* data = render_context.data_swap;
+    write_vertex_buffer(&data->buffers[SSBO_LINE], write_line_vertices, map, alpha, map->lines->length, LINE_FLOATS_PER_VERTEX);
+}
+
 static bool is_vertex_buffer_update(GameBufferEnum type)
 {
     VertexBuffer* vb = &render_context.data_swap->buffers[type];
@@ -632,69 +701,92 @@ static void vertex_buffer_updated(GameBufferEnum type)
     buffer->update = true;
 }
 
-void game_update_vertex_data(void)
+static void update_vertex_data_range(void* arg, i32 start, i32 end)
+{
+    VertexPassContext* ctx = arg;
+    for (i32 i = start; i < end; i++)
+        ctx->passes[i](ctx->map, ctx->alpha);
+}
+
+void game_update_vertex_data(f32 alpha)
 {
+    VertexPassContext ctx;
     Map* map;
-    VertexBuffer* vb;
     RenderData* tmp;
+    i32 n;
 
     map = game_context.current_map;
     if (map == NULL)
         return;
 
+    // clients get positions from the host rather than
+    // simulating them, so there is nothing to blend
+    if (!game_context.hosting && !game_context.singleplayer)
+        alpha = 1;
+
     render_context.data_swap->buffers[SSBO_ENTITY].update = true;
     render_context.data_swap->buffers[SSBO_PROJECTILE].update = true;
     render_context.data_swap->buffers[SSBO_PARTICLE].update = true;
     render_context.data_swap->buffers[SSBO_PARJICLE].update = true;
     render_context.data_swap->buffers[SSBO_LINE].update = true;
 
+    // the render thread only ever reads render_context.data, so the
+    // back buffers are filled without the lock, one job per pass
+    ctx.map = map;
+    ctx.alpha = alpha;
+    n = 0;
+    if (is_vertex_buffer_update(SSBO_ENTITY))
+        ctx.passes[n++] = update_entity_vertex_data;
+    if (is_vertex_buffer_update(SSBO_PROJECTILE))
+        ctx.passes[n++] = update_projectile_vertex_data;
+    if (is_vertex_buffer_update(SSBO_PARSTACLE))
+        ctx.passes[n++] = update_parstacle_vertex_data;
+    if (is_vertex_buffer_update(SSBO_OBSTACLE))
+        ctx.passes[n++] = update_obstacle_vertex_data;
+    if (is_vertex_buffer_update(SSBO_PARTICLE))
+        ctx.passes[n++] = update_particle_vertex_data;
+    if (is_vertex_buffer_update(SSBO_PARJICLE))
+        ctx.passes[n++] = update_parjicle_vertex_data;
+    if (is_vertex_buffer_update(VBO_TILE))
+        ctx.passes[n++] = update_tile_vertex_data;
+    if (is_vertex_buffer_update(VBO_WALL))
+        ctx.passes[n++] = update_wall_vertex_data;
+    if (is_vertex_buffer_update(SSBO_LINE))
+        ctx.passes[n++] = update_line_vertex_data;
+    job_parallel_for(update_vertex_data_range, &ctx, n, 1);
+
     pthread_mutex_lock(&render_context.mutex);
     if (is_vertex_buffer_update(SSBO_ENTITY)) {
-        update_entity_vertex_data(map);
         vertex_buffer_updated(SSBO_ENTITY);
         vertex_buffer_updated(SSBO_ENTITY_MINIMAP);
-        vertex_buffer_updated(SSBO_ENTITY_SHADOW);
     }
-    if (is_vertex_buffer_update(SSBO_PROJECTILE)) {
-        update_projectile_vertex_data(map);
+    if (is_vertex_buffer_update(SSBO_PROJECTILE))
         vertex_buffer_updated(SSBO_PROJECTILE);
-    }
-    if (is_vertex_buffer_update(SSBO_PARSTACLE)) {
-        update_parstacle_vertex_data(map);
+    if (is_vertex_buffer_update(SSBO_PARSTACLE))
         vertex_buffer_updated(SSBO_PARSTACLE);
-    }
     if (is_vertex_buffer_update(SSBO_OBSTACLE)) {
-        update_obstacle_vertex_data(map);
         vertex_buffer_updated(SSBO_OBSTACLE);
         vertex_buffer_updated(SSBO_OBSTACLE_MINIMAP);
     }
-    if (is_vertex_buffer_update(SSBO_PARTICLE)) {
-        update_particle_vertex_data(map);
+    if (is_vertex_buffer_update(SSBO_PARTICLE))
         vertex_buffer_updated(SSBO_PARTICLE);
-    }
-    if (is_vertex_buffer_update(SSBO_PARJICLE)) {
-        update_parjicle_vertex_data(map);
+    if (is_vertex_buffer_update(SSBO_PARJICLE))
         vertex_buffer_updated(SSBO_PARJICLE);
-    }
     if (is_vertex_buffer_update(VBO_TILE)) {
-        update_tile_vertex_data(map);
         vertex_buffer_updated(VBO_TILE);
         vertex_buffer_updated(VBO_TILE_MINIMAP);
     }
     if (is_vertex_buffer_update(VBO_WALL)) {
-        update_wall_vertex_data(map);
         vertex_buffer_updated(VBO_WALL);
         vertex_buffer_updated(VBO_WALL_MINIMAP);
     }
-    if (is_vertex_buffer_update(SSBO_LINE)) {
-        update_line_vertex_data(map);
+    if (is_vertex_buffer_update(SSBO_LINE))
         vertex_buffer_updated(SSBO_LINE);
-    }
 
     tmp = render_context.data;
     render_context.data = render_context.data_swap;
     render_context.data_swap = tmp;
-    copy_camera();
+    copy_camera(alpha);
     pthread_mutex_unlock(&render_context.mutex);
 }
 
@@ -0,0 +1,1262 @@
+#include "../game.h"
+#include "../state.h"
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+// delta compressed replication of entities and projectiles. every send
+// the host captures a frame of quantized object state. each client
+// acknowledges the newest frame it received completely, and the next
+// frame is sent to it as the difference to that baseline: objects that
+// did not change are left out, changed objects carry a field mask and
+// only the fields in it, positions as offsets to the baseline when they
+// are small enough, and objects that are gone are sent with an
+// empty mask. a frame can take several datagrams, the client only
+// acknowledges it once all of them arrived. both sides keep the last
+// SNAPSHOT_HISTORY frames, a baseline that is no longer in the history
+// of the host is replaced by a full frame.
+//
+// a client is only sent the objects around its camera. every frame is
+// bucketed into a coarse grid when it is captured, the cells under the
+// area of interest are searched and the objects in it are written
+// nearest first. objects leaving the area are sent as removed, the
+// client keeps them where they were last seen.
+//
+// the host sends every client a snapshot at the rate of that client.
+// the complete frames a client received double as its jitter buffer:
+// objects are drawn a little in the past, between the two frames
+// around that time. how far in the past follows the measured interval
+// between snapshots and the jitter of their arrival.
+
+#define SNAPSHOT_MAX_PARTS      256
+#define SNAPSHOT_POSITION_SCALE 512.0
+#define SNAPSHOT_VECTOR_SCALE   8192.0
+#define SNAPSHOT_CELLS_WIDE     ((MAP_MAX_WIDTH + SNAPSHOT_INTEREST_CELL_WIDTH - 1) / SNAPSHOT_INTEREST_CELL_WIDTH)
+#define SNAPSHOT_CELLS_LONG     ((MAP_MAX_LENGTH + SNAPSHOT_INTEREST_CELL_WIDTH - 1) / SNAPSHOT_INTEREST_CELL_WIDTH)
+#define SNAPSHOT_NUM_CELLS      (SNAPSHOT_CELLS_WIDE * SNAPSHOT_CELLS_LONG)
+// playback delay in snapshot intervals and mean arrival deviations
+#define SNAPSHOT_DELAY_INTERVALS    1.0
+#define SNAPSHOT_DELAY_DEVIATIONS   3.0
+// weight of a new sample in the clock, interval and jitter estimates
+#define SNAPSHOT_CLOCK_SMOOTHING    0.05
+
+typedef enum {
+    ENTITY_FIELD_POSITION   = 1 << 0,
+    ENTITY_FIELD_DIRECTION  = 1 << 1,
+    ENTITY_FIELD_FACING     = 1 << 2,
+    ENTITY_FIELD_HEALTH     = 1 << 3,
+    ENTITY_FIELD_FLAGS      = 1 << 4,
+    ENTITY_FIELD_STATE      = 1 << 5,
+    ENTITY_FIELD_FRAME      = 1 << 6,
+    ENTITY_FIELD_ID         = 1 << 7,
+    ENTITY_FIELD_ALL        = (1 << 8) - 1,
+    // position as i16 offset to the baseline
+    ENTITY_FIELD_POSITION_DELTA = 1 << 8
+} EntityField;
+
+typedef enum {
+    PROJECTILE_FIELD_POSITION   = 1 << 0,
+    PROJECTILE_FIELD_DIRECTION  = 1 << 1,
+    PROJECTILE_FIELD_FACING     = 1 << 2,
+    PROJECTILE_FIELD_TEX        = 1 << 3,
+    PROJECTILE_FIELD_ALL        = (1 << 4) - 1,
+    PROJECTILE_FIELD_POSITION_DELTA = 1 << 4
+} ProjectileField;
+
+// replicated state, quantized so host and client compare the same values
+typedef struct {
+    i32 uid;
+    i32 position[2];
+    i16 direction[2];
+    i16 facing[2];
+    f32 health, max_health;
+    u32 flags;
+    i16 state, frame, id;
+} SnapshotEntity;
+
+typedef struct {
+    i32 uid;
+    i32 position[2];
+    i16 direction[2];
+    i16 facing;
+    i16 tex;
+} SnapshotProjectile;
+
+// indices of the objects of a frame grouped by grid cell
+typedef struct {
+    i32* cell_start;
+    i32* objects;
+    i32 objects_capacity;
+} SnapshotGrid;
+
+// objects sorted by uid. the grids are only built for host frames
+typedef struct {
+    u32 frame;
+    // game time of the host when the frame was captured
+    f64 time;
+    SnapshotEntity* entities;
+    SnapshotProjectile* projectiles;
+    i32 num_entities, entities_capacity;
+    i32 num_projectiles, projectiles_capacity;
+    SnapshotGrid entity_grid;
+    SnapshotGrid projectile_grid;
+} SnapshotFrame;
+
+typedef enum {
+    SNAPSHOT_ENTITY,
+    SNAPSHOT_PROJECTILE
+} SnapshotObjectType;
+
+typedef struct {
+    i64 dist2;
+    i32 idx;
+    i32 uid;
+    SnapshotObjectType type;
+} SnapshotCandidate;
+
+// objects of a frame within the interest of a client, nearest first,
+// and a flag per object of the frame telling if it is among them
+typedef struct {
+    SnapshotCandidate* candidates;
+    i32 num_candidates, candidates_capacity;
+    u8* entity_selected;
+    u8* projectile_selected;
+    i32 entity_capacity, projectile_capacity;
+} SnapshotSelection;
+
+// frame the client is still receiving the datagrams of
+typedef struct {
+    u32 frame;
+    u32 baseline;
+    f64 time;
+    i32 num_parts;
+    i32 parts_received;
+    u32 received[SNAPSHOT_MAX_PARTS / 32];
+    // changed objects and uids of removed objects
+    SnapshotFrame changes;
+    i32* removed;
+    i32 num_removed, removed_capacity;
+} SnapshotAssembly;
+
+typedef struct {
+    u32 frame;
+    u32 baseline;
+    f64 time;
+    u16 part;
+    u16 num_parts;
+    u16 num_entities;
+    u16 num_projectiles;
+} SnapshotHeader;
+
+static struct {
+    // host
+    SnapshotFrame history[SNAPSHOT_HISTORY];
+    // newest captured frame, read by the udp thread for acks
+    _Atomic u32 frame;
+    SnapshotSelection selection, base_selection;
+    i32 interest_radius;
+    i32 max_objects;
+    // client
+    SnapshotFrame received[SNAPSHOT_HISTORY];
+    SnapshotAssembly assemblies[SNAPSHOT_HISTORY];
+    // host time is local time + clock_offset
+    f64 clock_offset;
+    f64 jitter;
+    f64 interval;
+    f64 newest_time;
+    // host time objects were last drawn at
+    f64 render_time;
+    bool clock_valid;
+    pthread_mutex_t mutex;
+} snapshot_context;
+
+static i32 quantize(f64 x, f64 scale)
+{
+    return lround(x * scale);
+}
+
+static i16 quantize_i16(f64 x, f64 scale)
+{
+    f64 q = round(x * scale);
+    if (q > INT16_MAX)
+        return INT16_MAX;
+    if (q < -INT16_MAX)
+        return -INT16_MAX;
+    return q;
+}
+
+static void reserve(void** buffer, i32* capacity, i32 length, size_t size)
+{
+    if (length <= *capacity)
+        return;
+    *capacity = maxi(length, 2 * *capacity);
+    *buffer = st_realloc(*buffer, *capacity * size);
+}
+
+static void frame_reserve(SnapshotFrame* frame, i32 num_entities, i32 num_projectiles)
+{
+    reserve((void**)&frame->entities, &frame->entities_capacity, num_entities, sizeof(SnapshotEntity));
+    reserve((void**)&frame->projectiles, &frame->projectiles_capacity, num_projectiles, sizeof(SnapshotProjectile));
+}
+
+static void frame_destroy(SnapshotFrame* frame)
+{
+    st_free(frame->entities);
+    st_free(frame->projectiles);
+    st_free(frame->entity_grid.cell_start);
+    st_free(frame->entity_grid.objects);
+    st_free(frame->projectile_grid.cell_start);
+    st_free(frame->projectile_grid.objects);
+    memset(frame, 0, sizeof(SnapshotFrame));
+}
+
+static i32 cmp_entity_uid(const void* ptr1, const void* ptr2)
+{
+    return ((const SnapshotEntity*)ptr1)->uid - ((const SnapshotEntity*)ptr2)->uid;
+}
+
+static i32 cmp_projectile_uid(const void* ptr1, const void* ptr2)
+{
+    return ((const SnapshotProjectile*)ptr1)->uid - ((const SnapshotProjectile*)ptr2)->uid;
+}
+
+static i32 cmp_uid(const void* ptr1, const void* ptr2)
+{
+    return *(const i32*)ptr1 - *(const i32*)ptr2;
+}
+
+static SnapshotFrame* find_frame(SnapshotFrame* frames, u32 frame)
+{
+    SnapshotFrame* slot = &frames[frame % SNAPSHOT_HISTORY];
+    if (frame == 0 || slot->frame != frame)
+        return NULL;
+    return slot;
+}
+
+static SnapshotEntity* find_entity(SnapshotFrame* frame, i32 uid)
+{
+    SnapshotEntity key = { .uid = uid };
+    return bsearch(&key, frame->entities, frame->num_entities, sizeof(SnapshotEntity), cmp_entity_uid);
+}
+
+static SnapshotProjectile* find_projectile(SnapshotFrame* frame, i32 uid)
+{
+    SnapshotProjectile key = { .uid = uid };
+    return bsearch(&key, frame->projectiles, frame->num_projectiles, sizeof(SnapshotProjectile), cmp_projectile_uid);
+}
+
+static void capture_entity(SnapshotEntity* s, Entity* entity)
+{
+    s->uid = entity->uid;
+    s->position[0] = quantize(entity->position.x, SNAPSHOT_POSITION_SCALE);
+    s->position[1] = quantize(entity->position.z, SNAPSHOT_POSITION_SCALE);
+    s->direction[0] = quantize_i16(entity->direction.x, SNAPSHOT_VECTOR_SCALE);
+    s->direction[1] = quantize_i16(entity->direction.z, SNAPSHOT_VECTOR_SCALE);
+    s->facing[0] = quantize_i16(entity->facing.x, SNAPSHOT_VECTOR_SCALE);
+    s->facing[1] = quantize_i16(entity->facing.z, SNAPSHOT_VECTOR_SCALE);
+    s->health = entity->health;
+    s->max_health = entity->max_health;
+    s->flags = entity->flags;
+    s->state = entity->state;
+    s->frame = entity->frame;
+    s->id = entity->id;
+}
+
+static void capture_projectile(SnapshotProjectile* s, Projectile* proj)
+{
+    s->uid = proj->uid;
+    vec2 position = projectile_position(proj);
+    vec2 direction = projectile_direction(proj);
+    s->position[0] = quantize(position.x, SNAPSHOT_POSITION_SCALE);
+    s->position[1] = quantize(position.z, SNAPSHOT_POSITION_SCALE);
+    s->direction[0] = quantize_i16(direction.x, SNAPSHOT_VECTOR_SCALE);
+    s->direction[1] = quantize_i16(direction.z, SNAPSHOT_VECTOR_SCALE);
+    // facing is an angle, only its value mod 2pi matters
+    s->facing = quantize_i16(remainder(proj->facing, 2 * PI), SNAPSHOT_VECTOR_SCALE);
+    s->tex = proj->tex;
+}
+
+// full or delta position bit, 0 if the position did not change
+static u32 position_changes(i32 a[2], i32 b[2], u32 full, u32 delta)
+{
+    i64 dx = (i64)a[0] - b[0];
+    i64 dz = (i64)a[1] - b[1];
+    if (dx == 0 && dz == 0)
+        return 0;
+    if (dx < INT16_MIN || dx > INT16_MAX || dz < INT16_MIN || dz > INT16_MAX)
+        return full;
+    return delta;
+}
+
+static u16 entity_changes(SnapshotEntity* a, SnapshotEntity* b)
+{
+    u16 mask = 0;
+    if (b == NULL)
+        return ENTITY_FIELD_ALL;
+    mask |= position_changes(a->position, b->position, ENTITY_FIELD_POSITION, ENTITY_FIELD_POSITION_DELTA);
+    if (a->direction[0] != b->direction[0] || a->direction[1] != b->direction[1])
+        mask |= ENTITY_FIELD_DIRECTION;
+    if (a->facing[0] != b->facing[0] || a->facing[1] != b->facing[1])
+        mask |= ENTITY_FIELD_FACING;
+    if (a->health != b->health || a->max_health != b->max_health)
+        mask |= ENTITY_FIELD_HEALTH;
+    if (a->flags != b->flags)
+        mask |= ENTITY_FIELD_FLAGS;
+    if (a->state != b->state)
+        mask |= ENTITY_FIELD_STATE;
+    if (a->frame != b->frame)
+        mask |= ENTITY_FIELD_FRAME;
+    if (a->id != b->id)
+        mask |= ENTITY_FIELD_ID;
+    return mask;
+}
+
+static u8 projectile_changes(SnapshotProjectile* a, SnapshotProjectile* b)
+{
+    u8 mask = 0;
+    if (b == NULL)
+        return PROJECTILE_FIELD_ALL;
+    mask |= position_changes(a->position, b->position, PROJECTILE_FIELD_POSITION, PROJECTILE_FIELD_POSITION_DELTA);
+    if (a->direction[0] != b->direction[0] || a->direction[1] != b->direction[1])
+        mask |= PROJECTILE_FIELD_DIRECTION;
+    if (a->facing != b->facing)
+        mask |= PROJECTILE_FIELD_FACING;
+    if (a->tex != b->tex)
+        mask |= PROJECTILE_FIELD_TEX;
+    return mask;
+}
+
+static i32 entity_record_size(u16 mask)
+{
+    i32 size = sizeof(u16) + sizeof(u16);
+    if (mask & ENTITY_FIELD_POSITION)   size += 2 * sizeof(i32);
+    if (mask & ENTITY_FIELD_POSITION_DELTA) size += 2 * sizeof(i16);
+    if (mask & ENTITY_FIELD_DIRECTION)  size += 2 * sizeof(i16);
+    if (mask & ENTITY_FIELD_FACING)     size += 2 * sizeof(i16);
+    if (mask & ENTITY_FIELD_HEALTH)     size += 2 * sizeof(f32);
+    if (mask & ENTITY_FIELD_FLAGS)      size += sizeof(u32);
+    if (mask & ENTITY_FIELD_STATE)      size += sizeof(i16);
+    if (mask & ENTITY_FIELD_FRAME)      size += sizeof(i16);
+    if (mask & ENTITY_FIELD_ID)         size += sizeof(i16);
+    return size;
+}
+
+static i32 projectile_record_size(u8 mask)
+{
+    i32 size = sizeof(u16) + sizeof(u8);
+    if (mask & PROJECTILE_FIELD_POSITION)   size += 2 * sizeof(i32);
+    if (mask & PROJECTILE_FIELD_POSITION_DELTA) size += 2 * sizeof(i16);
+    if (mask & PROJECTILE_FIELD_DIRECTION)  size += 2 * sizeof(i16);
+    if (mask & PROJECTILE_FIELD_FACING)     size += sizeof(i16);
+    if (mask & PROJECTILE_FIELD_TEX)        size += sizeof(i16);
+    return size;
+}
+
+static void write_position_delta(char** buffer, i32 a[2], i32 b[2])
+{
+    i16 delta[2] = { a[0] - b[0], a[1] - b[1] };
+    memcpyadv(buffer, (char*)delta, sizeof(delta));
+}
+
+static void write_entity_record(char** buffer, SnapshotEntity* s, SnapshotEntity* base, i32 uid, u16 mask)
+{
+    u16 uid16 = uid;
+    memcpyadv(buffer, (char*)&uid16, sizeof(uid16));
+    memcpyadv(buffer, (char*)&mask, sizeof(mask));
+    if (mask & ENTITY_FIELD_POSITION)
+        memcpyadv(buffer, (char*)s->position, sizeof(s->position));
+    if (mask & ENTITY_FIELD_POSITION_DELTA)
+        write_position_delta(buffer, s->position, base->position);
+    if (mask & ENTITY_FIELD_DIRECTION)
+        memcpyadv(buffer, (char*)s->direction, sizeof(s->direction));
+    if (mask & ENTITY_FIELD_FACING)
+        memcpyadv(buffer, (char*)s->facing, sizeof(s->facing));
+    if (mask & ENTITY_FIELD_HEALTH) {
+        memcpyadv(buffer, (char*)&s->health, sizeof(s->health));
+        memcpyadv(buffer, (char*)&s->max_health, sizeof(s->max_health));
+    }
+    if (mask & ENTITY_FIELD_FLAGS)
+        memcpyadv(buffer, (char*)&s->flags, sizeof(s->flags));
+    if (mask & ENTITY_FIELD_STATE)
+        memcpyadv(buffer, (char*)&s->state, sizeof(s->state));
+    if (mask & ENTITY_FIELD_FRAME)
+        memcpyadv(buffer, (char*)&s->frame, sizeof(s->frame));
+    if (mask & ENTITY_FIELD_ID)
+        memcpyadv(buffer, (char*)&s->id, sizeof(s->id));
+}
+
+static void write_projectile_record(char** buffer, SnapshotProjectile* s, SnapshotProjectile* base, i32 uid, u8 mask)
+{
+    u16 uid16 = uid;
+    memcpyadv(buffer, (char*)&uid16, sizeof(uid16));
+    memcpyadv(buffer, (char*)&mask, sizeof(mask));
+    if (mask & PROJECTILE_FIELD_POSITION)
+        memcpyadv(buffer, (char*)s->position, sizeof(s->position));
+    if (mask & PROJECTILE_FIELD_POSITION_DELTA)
+        write_position_delta(buffer, s->position, base->position);
+    if (mask & PROJECTILE_FIELD_DIRECTION)
+        memcpyadv(buffer, (char*)s->direction, sizeof(s->direction));
+    if (mask & PROJECTILE_FIELD_FACING)
+        memcpyadv(buffer, (char*)&s->facing, sizeof(s->facing));
+    if (mask & PROJECTILE_FIELD_TEX)
+        memcpyadv(buffer, (char*)&s->tex, sizeof(s->tex));
+}
+
+static void read_advance(char** buffer, void* dst, size_t size)
+{
+    memcpy(dst, *buffer, size);
+    *buffer += size;
+}
+
+static void read_position_delta(char** buffer, i32 position[2])
+{
+    i16 delta[2];
+    read_advance(buffer, delta, sizeof(delta));
+    position[0] += delta[0];
+    position[1] += delta[1];
+}
+
+// reads the fields in mask over s, which holds the baseline values
+static void read_entity_fields(char** buffer, SnapshotEntity* s, u16 mask)
+{
+    if (mask & ENTITY_FIELD_POSITION)
+        read_advance(buffer, s->position, sizeof(s->position));
+    if (mask & ENTITY_FIELD_POSITION_DELTA)
+        read_position_delta(buffer, s->position);
+    if (mask & ENTITY_FIELD_DIRECTION)
+        read_advance(buffer, s->direction, sizeof(s->direction));
+    if (mask & ENTITY_FIELD_FACING)
+        read_advance(buffer, s->facing, sizeof(s->facing));
+    if (mask & ENTITY_FIELD_HEALTH) {
+        read_advance(buffer, &s->health, sizeof(s->health));
+        read_advance(buffer, &s->max_health, sizeof(s->max_health));
+    }
+    if (mask & ENTITY_FIELD_FLAGS)
+        read_advance(buffer, &s->flags, sizeof(s->flags));
+    if (mask & ENTITY_FIELD_STATE)
+        read_advance(buffer, &s->state, sizeof(s->state));
+    if (mask & ENTITY_FIELD_FRAME)
+        read_advance(buffer, &s->frame, sizeof(s->frame));
+    if (mask & ENTITY_FIELD_ID)
+        read_advance(buffer, &s->id, sizeof(s->id));
+}
+
+static void read_projectile_fields(char** buffer, SnapshotProjectile* s, u8 mask)
+{
+    if (mask & PROJECTILE_FIELD_POSITION)
+        read_advance(buffer, s->position, sizeof(s->position));
+    if (mask & PROJECTILE_FIELD_POSITION_DELTA)
+        read_position_delta(buffer, s->position);
+    if (mask & PROJECTILE_FIELD_DIRECTION)
+        read_advance(buffer, s->direction, sizeof(s->direction));
+    if (mask & PROJECTILE_FIELD_FACING)
+        read_advance(buffer, &s->facing, sizeof(s->facing));
+    if (mask & PROJECTILE_FIELD_TEX)
+        read_advance(buffer, &s->tex, sizeof(s->tex));
+}
+
+static i32 cell_coord(i32 position, i32 num_cells)
+{
+    i32 c = position / (i32)(SNAPSHOT_POSITION_SCALE * SNAPSHOT_INTEREST_CELL_WIDTH);
+    return mini(maxi(c, 0), num_cells - 1);
+}
+
+static i32 cell_of(i32 position[2])
+{
+    return cell_coord(position[1], SNAPSHOT_CELLS_LONG) * SNAPSHOT_CELLS_WIDE
+         + cell_coord(position[0], SNAPSHOT_CELLS_WIDE);
+}
+
+// counting sort of the objects into cells. stride is the size of an
+// object, its position is found at offset
+static void grid_build(SnapshotGrid* grid, char* objects, i32 n, size_t stride, size_t offset)
+{
+    i32 i, sum;
+    if (grid->cell_start == NULL)
+        grid->cell_start = st_malloc((SNAPSHOT_NUM_CELLS + 1) * sizeof(i32));
+    reserve((void**)&grid->objects, &grid->objects_capacity, n, sizeof(i32));
+    memset(grid->cell_start, 0, (SNAPSHOT_NUM_CELLS + 1) * sizeof(i32));
+    for (i = 0; i < n; i++)
+        grid->cell_start[cell_of((i32*)(objects + i * stride + offset))]++;
+    // end of every cell, filled back to front so each
+    // entry ends up at the start of its cell
+    for (i = sum = 0; i <= SNAPSHOT_NUM_CELLS; i++) {
+        sum += grid->cell_start[i];
+        grid->cell_start[i] = sum;
+    }
+    for (i = n - 1; i >= 0; i--)
+        grid->objects[--grid->cell_start[cell_of((i32*)(objects + i * stride + offset))]] = i;
+}
+
+static i32 cmp_candidate(const void* ptr1, const void* ptr2)
+{
+    const SnapshotCandidate* c1 = ptr1;
+    const SnapshotCandidate* c2 = ptr2;
+    if (c1->dist2 != c2->dist2)
+        return (c1->dist2 < c2->dist2) ? -1 : 1;
+    if (c1->type != c2->type)
+        return c1->type - c2->type;
+    return c1->uid - c2->uid;
+}
+
+static void select_candidate(SnapshotSelection* sel, i32 position[2], i32 idx, i32 uid, SnapshotObjectType type, SnapshotInterest* interest, f64 r2)
+{
+    SnapshotCandidate* c;
+    f64 dx = position[0] / SNAPSHOT_POSITION_SCALE - interest->center.x;
+    f64 dz = position[1] / SNAPSHOT_POSITION_SCALE - interest->center.z;
+    f64 d2 = dx * dx + dz * dz;
+    if (interest->radius > 0 && d2 > r2)
+        return;
+    reserve((void**)&sel->candidates, &sel->candidates_capacity, sel->num_candidates + 1, sizeof(SnapshotCandidate));
+    c = &sel->candidates[sel->num_candidates++];
+    // compared in quantized units so the host selects the same
+    // objects every time it looks at this frame again
+    c->dist2 = (interest->radius > 0) ? (i64)(d2 * SNAPSHOT_POSITION_SCALE) : 0;
+    c->idx = idx;
+    c->uid = uid;
+    c->type = type;
+}
+
+// objects of frame inside the area of interest, nearest first
+static void select_objects(SnapshotSelection* sel, SnapshotFrame* frame, SnapshotInterest* interest)
+{
+    SnapshotGrid* grid;
+    f64 r2 = (f64)interest->radius * interest->radius;
+    i32 x1, x2, z1, z2, x, z, cell, k, idx, i;
+
+    sel->num_candidates = 0;
+    reserve((void**)&sel->entity_selected, &sel->entity_capacity, frame->num_entities, sizeof(u8));
+    reserve((void**)&sel->projectile_selected, &sel->projectile_capacity, frame->num_projectiles, sizeof(u8));
+    memset(sel->entity_selected, 0, frame->num_entities * sizeof(u8));
+    memset(sel->projectile_selected, 0, frame->num_projectiles * sizeof(u8));
+
+    if (interest->radius <= 0) {
+        for (i = 0; i < frame->num_entities; i++)
+            select_candidate(sel, frame->entities[i].position, i, frame->entities[i].uid, SNAPSHOT_ENTITY, interest, r2);
+        for (i = 0; i < frame->num_projectiles; i++)
+            select_candidate(sel, frame->projectiles[i].position, i, frame->projectiles[i].uid, SNAPSHOT_PROJECTILE, interest, r2);
+    } else {
+        x1 = cell_coord(quantize(interest->center.x - interest->radius, SNAPSHOT_POSITION_SCALE), SNAPSHOT_CELLS_WIDE);
+        x2 = cell_coord(quantize(interest->center.x + interest->radius, SNAPSHOT_POSITION_SCALE), SNAPSHOT_CELLS_WIDE);
+        z1 = cell_coord(quantize(interest->center.z - interest->radius, SNAPSHOT_POSITION_SCALE), SNAPSHOT_CELLS_LONG);
+        z2 = cell_coord(quantize(interest->center.z + interest->radius, SNAPSHOT_POSITION_SCALE), SNAPSHOT_CELLS_LONG);
+        for (z = z1; z <= z2; z++) {
+            for (x = x1; x <= x2; x++) {
+                cell = z * SNAPSHOT_CELLS_WIDE + x;
+                grid = &frame->entity_grid;
+                for (k = grid->cell_start[cell]; k < grid->cell_start[cell+1]; k++) {
+                    idx = grid->objects[k];
+                    select_candidate(sel, frame->entities[idx].position, idx, frame->entities[idx].uid, SNAPSHOT_ENTITY, interest, r2);
+                }
+                grid = &frame->projectile_grid;
+                for (k = grid->cell_start[cell]; k < grid->cell_start[cell+1]; k++) {
+                    idx = grid->objects[k];
+                    select_candidate(sel, frame->projectiles[idx].position, idx, frame->projectiles[idx].uid, SNAPSHOT_PROJECTILE, interest, r2);
+                }
+            }
+        }
+    }
+
+    qsort(sel->candidates, sel->num_candidates, sizeof(SnapshotCandidate), cmp_candidate);
+    if (interest->max_objects > 0)
+        sel->num_candidates = mini(sel->num_candidates, interest->max_objects);
+    for (i = 0; i < sel->num_candidates; i++) {
+        if (sel->candidates[i].type == SNAPSHOT_ENTITY)
+            sel->entity_selected[sel->candidates[i].idx] = 1;
+        else
+            sel->projectile_selected[sel->candidates[i].idx] = 1;
+    }
+}
+
+static void selection_destroy(SnapshotSelection* sel)
+{
+    st_free(sel->candidates);
+    st_free(sel->entity_selected);
+    st_free(sel->projectile_selected);
+}
+
+void snapshot_init(void)
+{
+    memset(&snapshot_context, 0, sizeof(snapshot_context));
+    pthread_mutex_init(&snapshot_context.mutex, NULL);
+    // 0 sizes the area of interest from the view of each camera
+    snapshot_context.interest_radius = config_get_setting_int(state_context.config, "interest_radius", 0);
+    snapshot_context.max_objects = config_get_setting_int(state_context.config, "interest_max_objects", SNAPSHOT_DEFAULT_MAX_OBJECTS);
+}
+
+void snapshot_cleanup(void)
+{
+    for (i32 i = 0; i < SNAPSHOT_HISTORY; i++) {
+        frame_destroy(&snapshot_context.history[i]);
+        frame_destroy(&snapshot_context.received[i]);
+        frame_destroy(&snapshot_context.assemblies[i].changes);
+        st_free(snapshot_context.assemblies[i].removed);
+    }
+    selection_destroy(&snapshot_context.selection);
+    selection_destroy(&snapshot_context.base_selection);
+    pthread_mutex_destroy(&snapshot_context.mutex);
+}
+
+void snapshot_reset(void)
+{
+    // frame numbers keep counting up, so acks for
+    // frames of the previous map never match
+    pthread_mutex_lock(&snapshot_context.mutex);
+    for (i32 i = 0; i < SNAPSHOT_HISTORY; i++) {
+        snapshot_context.history[i].frame = 0;
+        snapshot_context.received[i].frame = 0;
+        snapshot_context.assemblies[i].frame = 0;
+    }
+    snapshot_context.clock_valid = false;
+    snapshot_context.render_time = 0;
+    pthread_mutex_unlock(&snapshot_context.mutex);
+}
+
+u32 snapshot_capture(Map* map)
+{
+    u32 frame_number = atomic_fetch_add(&snapshot_context.frame, 1) + 1;
+    SnapshotFrame* frame = &snapshot_context.history[frame_number % SNAPSHOT_HISTORY];
+    i32 i;
+    frame->frame = frame_number;
+    frame->time = game_context.time;
+    frame->num_entities = map->entities->length;
+    frame->num_projectiles = map->projectiles->length;
+    frame_reserve(frame, frame->num_entities, frame->num_projectiles);
+    for (i = 0; i < frame->num_entities; i++)
+        capture_entity(&frame->entities[i], list_get(map->entities, i));
+    for (i = 0; i < frame->num_projectiles; i++)
+        capture_projectile(&frame->projectiles[i], list_get(map->projectiles, i));
+    qsort(frame->entities, frame->num_entities, sizeof(SnapshotEntity), cmp_entity_uid);
+    qsort(frame->projectiles, frame->num_projectiles, sizeof(SnapshotProjectile), cmp_projectile_uid);
+    grid_build(&frame->entity_grid, (char*)frame->entities, frame->num_entities,
+               sizeof(SnapshotEntity), offsetof(SnapshotEntity, position));
+    grid_build(&frame->projectile_grid, (char*)frame->projectiles, frame->num_projectiles,
+               sizeof(SnapshotProjectile), offsetof(SnapshotProjectile, position));
+    return frame_number;
+}
+
+typedef struct {
+    char buffers[SNAPSHOT_MAX_PARTS][UDP_MAX_PAYLOAD];
+    Packet packets[SNAPSHOT_MAX_PARTS];
+    SnapshotHeader header;
+    i32 num_parts;
+    char* ptr;
+    char* end;
+    bool overflow;
+} SnapshotWriter;
+
+static void writer_finish_part(SnapshotWriter* w)
+{
+    Packet* packet;
+    if (w->num_parts == 0)
+        return;
+    packet = &w->packets[w->num_parts-1];
+    packet->length = w->ptr - packet->buffer;
+    memcpy(packet->buffer, &w->header, sizeof(w->header));
+}
+
+// makes room for size bytes, starting a new datagram if needed
+static bool writer_reserve(SnapshotWriter* w, i32 size)
+{
+    char* buffer;
+    if (w->num_parts > 0 && w->ptr + size <= w->end)
+        return true;
+    writer_finish_part(w);
+    if (w->num_parts == SNAPSHOT_MAX_PARTS) {
+        w->overflow = true;
+        return false;
+    }
+    buffer = w->buffers[w->num_parts];
+    w->packets[w->num_parts].id = PACKET_SNAPSHOT;
+    w->packets[w->num_parts].buffer = buffer + PACKET_HEADER_BYTES;
+    w->header.part = w->num_parts++;
+    w->header.num_entities = 0;
+    w->header.num_projectiles = 0;
+    w->ptr = buffer + PACKET_HEADER_BYTES + sizeof(SnapshotHeader);
+    w->end = buffer + UDP_MAX_PAYLOAD;
+    return true;
+}
+
+static void write_entity(SnapshotWriter* w, SnapshotEntity* s, SnapshotEntity* base, i32 uid, u16 mask)
+{
+    if (!writer_reserve(w, entity_record_size(mask)))
+        return;
+    write_entity_record(&w->ptr, s, base, uid, mask);
+    w->header.num_entities++;
+}
+
+static void write_projectile(SnapshotWriter* w, SnapshotProjectile* s, SnapshotProjectile* base, i32 uid, u8 mask)
+{
+    if (!writer_reserve(w, projectile_record_size(mask)))
+        return;
+    write_projectile_record(&w->ptr, s, base, uid, mask);
+    w->header.num_projectiles++;
+}
+
+// drops the farthest objects of sel until the frame fits in
+// SNAPSHOT_MAX_PARTS datagrams, assuming every object is written in
+// full and every object of the baseline is removed. a datagram is
+// filled up to within one record, the largest one is left over.
+// returns true if objects were dropped, never all of them: a baseline
+// that fit leaves room for at least one full record after its removals
+static bool selection_fit(SnapshotSelection* sel, SnapshotSelection* base_sel)
+{
+    i32 record_bytes = maxi(entity_record_size(ENTITY_FIELD_ALL), projectile_record_size(PROJECTILE_FIELD_ALL));
+    i32 part_bytes = UDP_MAX_PAYLOAD - PACKET_HEADER_BYTES - sizeof(SnapshotHeader);
+    i64 budget = (i64)SNAPSHOT_MAX_PARTS * (part_bytes - record_bytes);
+    SnapshotCandidate* c;
+    i32 i, n;
+    for (i = 0; base_sel != NULL && i < base_sel->num_candidates; i++)
+        budget -= (base_sel->candidates[i].type == SNAPSHOT_ENTITY) ? entity_record_size(0) : projectile_record_size(0);
+    for (i = 0; i < sel->num_candidates; i++) {
+        c = &sel->candidates[i];
+        budget -= (c->type == SNAPSHOT_ENTITY) ? entity_record_size(ENTITY_FIELD_ALL) : projectile_record_size(PROJECTILE_FIELD_ALL);
+        if (budget < 0)
+            break;
+    }
+    if (i == sel->num_candidates)
+        return false;
+    log_write(WARNING, "Snapshot only fits %d of %d objects", i, sel->num_candidates);
+    for (n = sel->num_candidates, sel->num_candidates = i; i < n; i++) {
+        c = &sel->candidates[i];
+        if (c->type == SNAPSHOT_ENTITY)
+            sel->entity_selected[c->idx] = 0;
+        else
+            sel->projectile_selected[c->idx] = 0;
+    }
+    return true;
+}
+
+// writes the objects of type that left sel since the baseline,
+// then the new and changed ones of sel, nearest first
+static void write_objects(SnapshotWriter* w, SnapshotFrame* frame, SnapshotSelection* sel,
+                          SnapshotFrame* base, SnapshotSelection* base_sel, SnapshotObjectType type)
+{
+    SnapshotCandidate* c;
+    SnapshotEntity* e;
+    SnapshotProjectile* p;
+    i32 i;
+    u16 emask;
+    u8 pmask;
+
+    for (i = 0; base != NULL && i < base_sel->num_candidates; i++) {
+        c = &base_sel->candidates[i];
+        if (c->type != type)
+            continue;
+        if (type == SNAPSHOT_ENTITY) {
+            e = find_entity(frame, c->uid);
+            if (e == NULL || !sel->entity_selected[e - frame->entities])
+                write_entity(w, NULL, NULL, c->uid, 0);
+        } else {
+            p = find_projectile(frame, c->uid);
+            if (p == NULL || !sel->projectile_selected[p - frame->projectiles])
+                write_projectile(w, NULL, NULL, c->uid, 0);
+        }
+    }
+    for (i = 0; i < sel->num_candidates; i++) {
+        c = &sel->candidates[i];
+        if (c->type != type)
+            continue;
+        if (type == SNAPSHOT_ENTITY) {
+            e = (base != NULL) ? find_entity(base, c->uid) : NULL;
+            if (e != NULL && !base_sel->entity_selected[e - base->entities])
+                e = NULL;
+            emask = entity_changes(&frame->entities[c->idx], e);
+            if (emask != 0)
+                write_entity(w, &frame->entities[c->idx], e, c->uid, emask);
+        } else {
+            p = (base != NULL) ? find_projectile(base, c->uid) : NULL;
+            if (p != NULL && !base_sel->projectile_selected[p - base->projectiles])
+                p = NULL;
+            pmask = projectile_changes(&frame->projectiles[c->idx], p);
+            if (pmask != 0)
+                write_projectile(w, &frame->projectiles[c->idx], p, c->uid, pmask);
+        }
+    }
+}
+
+i32 snapshot_write(SnapshotView* view, SnapshotInterest* interest, SnapshotSendFunc send, void* arg)
+{
+    static SnapshotWriter writer;
+    static SnapshotInterest everything;
+    SnapshotWriter* w = &writer;
+    SnapshotFrame* frame = find_frame(snapshot_context.history, atomic_load(&snapshot_context.frame));
+    u32 baseline = atomic_load(&view->ack);
+    SnapshotFrame* base = find_frame(snapshot_context.history, baseline);
+    SnapshotInterest* base_interest = &view->interests[baseline % SNAPSHOT_HISTORY];
+    SnapshotSelection* sel = &snapshot_context.selection;
+    SnapshotSelection* base_sel = &snapshot_context.base_selection;
+    bool fitted;
+    i32 i, bytes;
+
+    if (frame == NULL)
+        return 0;
+    if (interest == NULL)
+        interest = &everything;
+    if (base != NULL && base_interest->frame != base->frame)
+        base = NULL;
+
+    // what the client has of the baseline is what it was sent
+    // of it, select that again from the interest back then
+    if (base != NULL)
+        select_objects(base_sel, base, base_interest);
+    select_objects(sel, frame, interest);
+    fitted = selection_fit(sel, (base != NULL) ? base_sel : NULL);
+    view->interests[frame->frame % SNAPSHOT_HISTORY] = *interest;
+    view->interests[frame->frame % SNAPSHOT_HISTORY].frame = frame->frame;
+    // the objects that fit are the nearest ones, a cap at their
+    // count selects exactly them again
+    if (fitted)
+        view->interests[frame->frame % SNAPSHOT_HISTORY].max_objects = sel->num_candidates;
+
+    w->num_parts = 0;
+    w->overflow = false;
+    w->header.frame = frame->frame;
+    w->header.time = frame->time;
+    w->header.baseline = (base != NULL) ? base->frame : 0;
+
+    // every entity is written before the first projectile, so each
+    // datagram holds its entity records ahead of its projectiles
+    write_objects(w, frame, sel, base, base_sel, SNAPSHOT_ENTITY);
+    write_objects(w, frame, sel, base, base_sel, SNAPSHOT_PROJECTILE);
+
+    // an empty delta still tells the client the frame is complete
+    if (w->num_parts == 0)
+        writer_reserve(w, 0);
+    writer_finish_part(w);
+    log_assert(!w->overflow, "Snapshot %u does not fit in %d datagrams", frame->frame, SNAPSHOT_MAX_PARTS);
+
+    bytes = 0;
+    for (i = 0; i < w->num_parts; i++) {
+        char* buffer = w->packets[i].buffer - PACKET_HEADER_BYTES;
+        SnapshotHeader* header = (SnapshotHeader*)w->packets[i].buffer;
+        header->num_parts = w->num_parts;
+        memcpy(buffer, &w->packets[i].length, sizeof(w->packets[i].length));
+        memcpy(buffer + sizeof(w->packets[i].length), &w->packets[i].id, sizeof(w->packets[i].id));
+        send(&w->packets[i], arg);
+        bytes += w->packets[i].length + PACKET_HEADER_BYTES;
+    }
+    return bytes;
+}
+
+static void send_to_client(Packet* packet, void* arg)
+{
+    game_net_queue_packet_udp(arg, packet);
+}
+
+SnapshotInterest snapshot_client_interest(Client* client)
+{
+    SnapshotInterest interest;
+    Camera* camera = &client->camera;
+    interest.frame = 0;
+    interest.center = camera->target;
+    interest.max_objects = snapshot_context.max_objects;
+    interest.radius = snapshot_context.interest_radius;
+    // the view is 16 * zoom_level tiles high, wider by the aspect
+    // ratio. tilting the camera shows further, so the radius covers
+    // the whole height in every direction
+    if (interest.radius <= 0)
+        interest.radius = 16 * maxi(camera->zoom_level, 1) * maxf(camera->aspect_ratio, 1)
+                        + SNAPSHOT_INTEREST_MARGIN;
+    return interest;
+}
+
+void snapshot_set_rate(SnapshotView* view, i32 rate)
+{
+    view->interval = (rate > 0) ? 1.0f / rate : 0;
+}
+
+void host_send_snapshot(Map* map, f32 dt)
+{
+    SnapshotInterest interest;
+    SnapshotView* view;
+    Client* client;
+    f32 interval;
+    bool captured = false;
+    for (i32 i = 0; i < game_context.clients->length; i++) {
+        client = list_get(game_context.clients, i);
+        if (client == game_context.this_client)
+            continue;
+        view = &client->snapshot_view;
+        interval = (view->interval > 0) ? view->interval : game_context.net_timestep;
+        view->timer -= dt;
+        if (view->timer > 0)
+            continue;
+        view->timer = maxf(view->timer + interval, 0);
+        // one capture serves every client due this tick
+        if (!captured)
+            snapshot_capture(map);
+        captured = true;
+        interest = snapshot_client_interest(client);
+        snapshot_write(view, &interest, send_to_client, client);
+    }
+}
+
+void host_set_snapshot_rate(Packet* packet)
+{
+    Client* client;
+    i32 client_uid, rate;
+    memcpy(&client_uid, packet->buffer, sizeof(client_uid));
+    memcpy(&rate, packet->buffer + sizeof(client_uid), sizeof(rate));
+    if (client_uid < 0 || client_uid >= MAX_UID || game_context.uid_map_type[client_uid] != GAME_OBJ_CLIENT)
+        return;
+    client = game_context.uid_map[client_uid];
+    rate = mini(rate, game_context.tps);
+    snapshot_set_rate(&client->snapshot_view, rate);
+    log_write(INFO, "Sending %s %d snapshots per second", client->username,
+              (rate > 0) ? rate : (i32)lround(1 / game_context.net_timestep));
+}
+
+void host_snapshot_ack(Packet* packet)
+{
+    Client* client;
+    i32 client_uid;
+    u32 frame, ack;
+    memcpy(&client_uid, packet->buffer, sizeof(client_uid));
+    memcpy(&frame, packet->buffer + sizeof(client_uid), sizeof(frame));
+    if (client_uid < 0 || client_uid >= MAX_UID || game_context.uid_map_type[client_uid] != GAME_OBJ_CLIENT)
+        return;
+    client = game_context.uid_map[client_uid];
+    // acks can arrive out of order, keep the newest
+    ack = atomic_load(&client->snapshot_view.ack);
+    while (frame > ack && frame <= atomic_load(&snapshot_context.frame))
+        if (atomic_compare_exchange_weak(&client->snapshot_view.ack, &ack, frame))
+            break;
+}
+
+static void send_ack(u32 frame)
+{
+    Packet packet;
+    static char buffer[PACKET_HEADER_BYTES + sizeof(i32) + sizeof(u32)];
+    Client* client = game_context.this_client;
+    char* ptr = buffer;
+    packet.buffer = buffer + PACKET_HEADER_BYTES;
+    packet.length = sizeof(client->uid) + sizeof(frame);
+    packet.id = PACKET_SNAPSHOT_ACK;
+    memcpyadv(&ptr, (char*)&packet.length, sizeof(packet.length));
+    memcpyadv(&ptr, (char*)&packet.id, sizeof(packet.id));
+    memcpyadv(&ptr, (char*)&client->uid, sizeof(client->uid));
+    memcpyadv(&ptr, (char*)&frame, sizeof(frame));
+    game_net_send_packet_udp(game_context.host_client, &packet);
+}
+
+// builds the received frame from its baseline and the changes
+static void complete_frame(SnapshotAssembly* assembly, SnapshotFrame* base)
+{
+    SnapshotFrame* changes = &assembly->changes;
+    SnapshotFrame* frame = &snapshot_context.received[assembly->frame % SNAPSHOT_HISTORY];
+    i32 i, j, k, n;
+
+    qsort(changes->entities, changes->num_entities, sizeof(SnapshotEntity), cmp_entity_uid);
+    qsort(changes->projectiles, changes->num_projectiles, sizeof(SnapshotProjectile), cmp_projectile_uid);
+    qsort(assembly->removed, assembly->num_removed, sizeof(i32), cmp_uid);
+
+    frame->frame = assembly->frame;
+    frame->time = assembly->time;
+    frame->num_entities = frame->num_projectiles = 0;
+    frame_reserve(frame,
+                  changes->num_entities + ((base != NULL) ? base->num_entities : 0),
+                  changes->num_projectiles + ((base != NULL) ? base->num_projectiles : 0));
+
+    // objects of the baseline that were neither changed nor removed carry over.
+    // uids of entities and projectiles never collide, so one removed list does
+    n = (base != NULL) ? base->num_entities : 0;
+    for (i = j = k = 0; i < changes->num_entities || j < n;) {
+        if (j == n || (i < changes->num_entities && changes->entities[i].uid <= base->entities[j].uid)) {
+            if (j < n && changes->entities[i].uid == base->entities[j].uid)
+                j++;
+            frame->entities[frame->num_entities++] = changes->entities[i++];
+        } else {
+            if (!bsearch(&base->entities[j].uid, assembly->removed, assembly->num_removed, sizeof(i32), cmp_uid))
+                frame->entities[frame->num_entities++] = base->entities[j];
+            j++;
+        }
+    }
+    n = (base != NULL) ? base->num_projectiles : 0;
+    for (i = j = 0; i < changes->num_projectiles || j < n;) {
+        if (j == n || (i < changes->num_projectiles && changes->projectiles[i].uid <= base->projectiles[j].uid)) {
+            if (j < n && changes->projectiles[i].uid == base->projectiles[j].uid)
+                j++;
+            frame->projectiles[frame->num_projectiles++] = changes->projectiles[i++];
+        } else {
+            if (!bsearch(&base->projectiles[j].uid, assembly->removed, assembly->num_removed, sizeof(i32), cmp_uid))
+                frame->projectiles[frame->num_projectiles++] = base->projectiles[j];
+            j++;
+        }
+    }
+    assembly->frame = 0;
+}
+
+// follows the host clock, the interval between snapshots
+// and the jitter of their arrival
+static void update_clock(f64 time)
+{
+    f64 sample = time - pacer_now();
+    f64 deviation;
+    if (!snapshot_context.clock_valid) {
+        snapshot_context.clock_offset = sample;
+        snapshot_context.jitter = 0;
+        snapshot_context.interval = game_context.net_timestep;
+        snapshot_context.newest_time = time;
+        snapshot_context.clock_valid = true;
+        return;
+    }
+    deviation = sample - snapshot_context.clock_offset;
+    snapshot_context.clock_offset += deviation * SNAPSHOT_CLOCK_SMOOTHING;
+    snapshot_context.jitter += (fabs(deviation) - snapshot_context.jitter) * SNAPSHOT_CLOCK_SMOOTHING;
+    if (time > snapshot_context.newest_time) {
+        snapshot_context.interval += (time - snapshot_context.newest_time - snapshot_context.interval) * SNAPSHOT_CLOCK_SMOOTHING;
+        snapshot_context.newest_time = time;
+    }
+}
+
+// the datagram comes from the network, every record has to fit in
+// the bytes left and name a uid that exists before any is read
+static bool snapshot_part_valid(SnapshotHeader* header, char* buffer, i32 length)
+{
+    u16 uid, emask;
+    u8 pmask;
+    i32 size, i;
+    if (header->frame == 0 || header->num_parts == 0 || header->num_parts > SNAPSHOT_MAX_PARTS || header->part >= header->num_parts)
+        return false;
+    for (i = 0; i < header->num_entities; i++) {
+        if (length < entity_record_size(0))
+            return false;
+        memcpy(&uid, buffer, sizeof(uid));
+        memcpy(&emask, buffer + sizeof(uid), sizeof(emask));
+        size = entity_record_size(emask);
+        if (uid >= MAX_UID || size > length)
+            return false;
+        buffer += size;
+        length -= size;
+    }
+    for (i = 0; i < header->num_projectiles; i++) {
+        if (length < projectile_record_size(0))
+            return false;
+        memcpy(&uid, buffer, sizeof(uid));
+        memcpy(&pmask, buffer + sizeof(uid), sizeof(pmask));
+        size = projectile_record_size(pmask);
+        if (uid >= MAX_UID || size > length)
+            return false;
+        buffer += size;
+        length -= size;
+    }
+    return true;
+}
+
+void client_read_snapshot(Packet* packet)
+{
+    SnapshotHeader header;
+    SnapshotAssembly* assembly;
+    SnapshotFrame* base;
+    SnapshotEntity entity, *base_entity;
+    SnapshotProjectile proj, *base_proj;
+    char* buffer = packet->buffer;
+    u16 uid;
+    u16 emask;
+    u8 pmask;
+    bool complete = false;
+
+    if (packet->length < (i32)sizeof(header))
+        return;
+    read_advance(&buffer, &header, sizeof(header));
+    if (!snapshot_part_valid(&header, buffer, packet->length - sizeof(header))) {
+        log_write(WARNING, "Dropped malformed snapshot datagram");
+        return;
+    }
+
+    pthread_mutex_lock(&snapshot_context.mutex);
+
+    // deltas can only be read against a baseline this client has
+    base = find_frame(snapshot_context.received, header.baseline);
+    if (header.baseline != 0 && base == NULL)
+        goto unlock;
+    if (find_frame(snapshot_context.received, header.frame) != NULL)
+        goto unlock;
+
+    assembly = &snapshot_context.assemblies[header.frame % SNAPSHOT_HISTORY];
+    if (assembly->frame != header.frame) {
+        if (assembly->frame > header.frame)
+            goto unlock;
+        assembly->frame = header.frame;
+        assembly->baseline = header.baseline;
+        assembly->time = header.time;
+        assembly->num_parts = header.num_parts;
+        assembly->parts_received = 0;
+        assembly->changes.num_entities = 0;
+        assembly->changes.num_projectiles = 0;
+        assembly->num_removed = 0;
+        memset(assembly->received, 0, sizeof(assembly->received));
+    }
+    if (header.num_parts != assembly->num_parts)
+        goto unlock;
+    if (assembly->received[header.part / 32] & (1u << (header.part % 32)))
+        goto unlock;
+    assembly->received[header.part / 32] |= 1u << (header.part % 32);
+    assembly->parts_received++;
+
+    frame_reserve(&assembly->changes,
+                  assembly->changes.num_entities + header.num_entities,
+                  assembly->changes.num_projectiles + header.num_projectiles);
+    for (i32 i = 0; i < header.num_entities; i++) {
+        read_advance(&buffer, &uid, sizeof(uid));
+        read_advance(&buffer, &emask, sizeof(emask));
+        if (emask == 0) {
+            reserve((void**)&assembly->removed, &assembly->removed_capacity, assembly->num_removed + 1, sizeof(i32));
+            assembly->removed[assembly->num_removed++] = uid;
+            continue;
+        }
+        base_entity = (base != NULL) ? find_entity(base, uid) : NULL;
+        if (base_entity != NULL)
+            entity = *base_entity;
+        else
+            memset(&entity, 0, sizeof(entity));
+        entity.uid = uid;
+        read_entity_fields(&buffer, &entity, emask);
+        assembly->changes.entities[assembly->changes.num_entities++] = entity;
+    }
+    for (i32 i = 0; i < header.num_projectiles; i++) {
+        read_advance(&buffer, &uid, sizeof(uid));
+        read_advance(&buffer, &pmask, sizeof(pmask));
+        if (pmask == 0) {
+            reserve((void**)&assembly->removed, &assembly->removed_capacity, assembly->num_removed + 1, sizeof(i32));
+            assembly->removed[assembly->num_removed++] = uid;
+            continue;
+        }
+        base_proj = (base != NULL) ? find_projectile(base, uid) : NULL;
+        if (base_proj != NULL)
+            proj = *base_proj;
+        else
+            memset(&proj, 0, sizeof(proj));
+        proj.uid = uid;
+        read_projectile_fields(&buffer, &proj, pmask);
+        assembly->changes.projectiles[assembly->changes.num_projectiles++] = proj;
+    }
+
+    if (assembly->num_parts != 0 && assembly->parts_received == assembly->num_parts) {
+        complete_frame(assembly, base);
+        update_clock(header.time);
+        complete = true;
+    }
+
+unlock:
+    pthread_mutex_unlock(&snapshot_context.mutex);
+    if (complete)
+        send_ack(header.frame);
+}
+
+void client_request_snapshot_rate(i32 rate)
+{
+    Packet* packet;
+    i32 buffer[2];
+    if (game_context.host_client == NULL)
+        return;
+    buffer[0] = game_context.this_client->uid;
+    buffer[1] = rate;
+    packet = packet_create(PACKET_CLIENT_SNAPSHOT_RATE, sizeof(buffer), (char*)buffer);
+    game_net_send_packet_tcp(game_context.host_client, packet);
+    packet_destroy(packet);
+}
+
+static vec2 lerp_position(i32 a[2], i32 b[2], f64 t)
+{
+    return vec2_create((a[0] + (b[0] - a[0]) * t) / SNAPSHOT_POSITION_SCALE,
+                       (a[1] + (b[1] - a[1]) * t) / SNAPSHOT_POSITION_SCALE);
+}
+
+static vec2 lerp_vector(i16 a[2], i16 b[2], f64 t)
+{
+    return vec2_create((a[0] + (b[0] - a[0]) * t) / SNAPSHOT_VECTOR_SCALE,
+                       (a[1] + (b[1] - a[1]) * t) / SNAPSHOT_VECTOR_SCALE);
+}
+
+static void interpolate_entities(SnapshotFrame* a, SnapshotFrame* b, f64 t)
+{
+    SnapshotEntity *sa, *sb;
+    Entity* entity;
+    for (i32 i = 0; i < b->num_entities; i++) {
+        sb = &b->entities[i];
+        if (game_context.uid_map_type[sb->uid] != GAME_OBJ_ENTITY || (entity = game_context.uid_map[sb->uid]) == NULL)
+            continue;
+        // entered the area after a, shown as in b
+        sa = (a != b) ? find_entity(a, sb->uid) : sb;
+        if (sa == NULL)
+            sa = sb;
+        entity->prev_position = entity->position;
+        entity->position = lerp_position(sa->position, sb->position, t);
+        entity->direction = lerp_vector(sa->direction, sb->direction, t);
+        entity->facing = lerp_vector(sa->facing, sb->facing, t);
+        entity->health = sa->health;
+        entity->max_health = sa->max_health;
+        entity->flags = sa->flags;
+        entity->state = sa->state;
+        entity->frame = sa->frame;
+        entity->id = sa->id;
+    }
+}
+
+static void interpolate_projectiles(SnapshotFrame* a, SnapshotFrame* b, f64 t)
+{
+    SnapshotProjectile *sa, *sb;
+    Projectile* proj;
+    f64 facing;
+    for (i32 i = 0; i < b->num_projectiles; i++) {
+        sb = &b->projectiles[i];
+        if (game_context.uid_map_type[sb->uid] != GAME_OBJ_PROJECTILE || (proj = game_context.uid_map[sb->uid]) == NULL)
+            continue;
+        sa = (a != b) ? find_projectile(a, sb->uid) : sb;
+        if (sa == NULL)
+            sa = sb;
+        // prev_position was set by the local projectile update
+        projectile_set_position(proj, lerp_position(sa->position, sb->position, t));
+        projectile_set_direction(proj, lerp_vector(sa->direction, sb->direction, t));
+        // facing is an angle, turn the short way around
+        facing = remainder((sb->facing - sa->facing) / SNAPSHOT_VECTOR_SCALE, 2 * PI);
+        proj->facing = sa->facing / SNAPSHOT_VECTOR_SCALE + facing * t;
+        proj->tex = sa->tex;
+    }
+}
+
+void client_interpolate_snapshots(void)
+{
+    SnapshotFrame *a = NULL, *b = NULL, *frame;
+    f64 time, t;
+
+    pthread_mutex_lock(&snapshot_context.mutex);
+    if (!snapshot_context.clock_valid)
+        goto unlock;
+
+    time = pacer_now() + snapshot_context.clock_offset
+         - SNAPSHOT_DELAY_INTERVALS * snapshot_context.interval
+         - SNAPSHOT_DELAY_DEVIATIONS * snapshot_context.jitter;
+    // the estimates move, time as seen by the player does not go back
+    time = fmax(time, snapshot_context.render_time);
+    snapshot_context.render_time = time;
+
+    // newest frame at or before time and the oldest one after it
+    for (i32 i = 0; i < SNAPSHOT_HISTORY; i++) {
+        frame = &snapshot_context.received[i];
+        if (frame->frame == 0)
+            continue;
+        if (frame->time <= time && (a == NULL || frame->time > a->time))
+            a = frame;
+        if (frame->time > time && (b == NULL || frame->time < b->time))
+            b = frame;
+    }
+    // nothing buffered on one side, hold the nearest frame
+    if (a == NULL)
+        a = b;
+    if (b == NULL)
+        b = a;
+    if (a == NULL)
+        goto unlock;
+
+    t = (b->time > a->time) ? (time - a->time) / (b->time - a->time) : 0;
+    t = fmin(fmax(t, 0), 1);
+    interpolate_entities(a, b, t);
+    interpolate_projectiles(a, b, t);
+
+unlock:
+    pthread_mutex_unlock(&snapshot_context.mutex);
+}
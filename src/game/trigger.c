@@ -1,8 +1,8 @@
 #include "../game.h"
 
-Trigger* trigger_create(vec2 position, f32 radius)
+Trigger* trigger_create(Slab* slab, vec2 position, f32 radius)
 {
-    Trigger* trigger = st_malloc(sizeof(Trigger));
+    Trigger* trigger = slab_alloc(slab);
     trigger->map_info = (MapInfo) {0};
     trigger->position = position;
     trigger->radius = radius;
@@ -46,7 +46,7 @@ bool trigger_get_flag(Trigger* trigger, TriggerFlagEnum flag)
     return (trigger->flags >> flag) & 1;
 }
 
-void trigger_destroy(Trigger* trigger)
+void trigger_destroy(Slab* slab, Trigger* trigger)
 {
     if (trigger->destroy == NULL)
         st_free(trigger->data);
@@ -55,5 +55,5 @@ void trigger_destroy(Trigger* trigger)
     bitset_destroy(trigger->bitset);
     list_destroy(trigger->entities);
     game_free_uid(trigger->uid);
-    st_free(trigger);
+    slab_free(slab, trigger);
 }
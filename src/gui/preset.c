@@ -155,6 +155,9 @@ static void update_debug(GUIComp* comp, f32 dt)
     if (map != NULL && map->entities != NULL && data->timer < 0) {
         char* string = string_create(
             "Game dt: %.3f\n"
+            "Frame jitter: %.3f avg %.3f max\n"
+            "Frame sleep: %.0f%%\n"
+            "Dropped steps: %d\n"
             "State dt: %.3f\n"
             "State fps: %.0f\n"
             "Camera target: %.2f %.2f\n"
@@ -172,6 +175,10 @@ static void update_debug(GUIComp* comp, f32 dt)
             "Lines: %d\n"
             "Memory: %d KB",
         1000 * game_context.real_dt,
+        1000 * pacer_jitter_mean(&game_context.pacer),
+        1000 * game_context.pacer.stats.jitter_max,
+        100 * pacer_sleep_ratio(&game_context.pacer),
+        game_context.dropped_steps,
         1000 * state_dt(),
         1 / state_dt(),
         camera_target.x, camera_target.z,
@@ -179,8 +186,8 @@ static void update_debug(GUIComp* comp, f32 dt)
         map->entities->length,
         map->projectiles->length,
         map->aoes->length,
-        map->particles->length,
-        map->parjicles->length,
+        map->particles.length,
+        map->parjicles.length,
         map->obstacles->length,
         map->parstacles->length,
         map->free_walls->length,
@@ -1117,9 +1124,9 @@ static void test_update(GUIComp* comp, f32 dt)
             gui_comp_point_to_text(comp, "4");
         else
             gui_comp_point_to_text(comp, "6");
-        i32 r = randi_range(0, 255);
-        i32 g = randi_range(0, 255);
-        i32 b = randi_range(0, 255);
+        i32 r = rng_range(rng_stream(RNG_STREAM_GUI), 0, 255);
+        i32 g = rng_range(rng_stream(RNG_STREAM_GUI), 0, 255);
+        i32 b = rng_range(rng_stream(RNG_STREAM_GUI), 0, 255);
         gui_comp_set_color(comp, r, g, b, 255);
         data->flag = !data->flag;
         data->timer += 0.1;
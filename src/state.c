@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <pthread.h>
 #include <math.h>
+#include <time.h>
 
 StateContext state_context;
 
@@ -19,6 +20,8 @@ void state_init(void)
     state_context.config = config_create();
 
     thread_link("Main");
+    job_init(config_get_setting_int(state_context.config, "job_workers", JOB_WORKERS_AUTO));
+    rng_init(config_get_setting_int(state_context.config, "seed", time(NULL)));
 
     event_init();
     window_init();
@@ -51,6 +54,7 @@ void state_cleanup(void)
     // add signals so game doesnt cleanup b4 gui finishes with it
     log_unlock();
     game_cleanup();
+    job_cleanup();
     renderer_cleanup();
     window_cleanup();
     event_cleanup();
@@ -13,6 +13,10 @@
 #include "util/trie.h"
 #include "util/json.h"
 #include "util/net.h"
+#include "util/pacer.h"
+#include "util/slab.h"
+#include "util/job.h"
+#include "util/rng.h"
 #include <pthread.h>
 #include <semaphore.h>
 #include <stdlib.h>
@@ -6,7 +6,8 @@
 #include <string.h>
 #include <stdarg.h>
 #include <sys/stat.h>
-#include <glfw.h>
+#include "pacer.h"
+#include "rng.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -26,7 +27,7 @@ void st_sleep(i32 msec)
 
 f64 get_time(void)
 {
-    return glfwGetTime();
+    return pacer_now();
 }
 
 char* string_copy(const char* string)
@@ -120,17 +121,17 @@ f32 lerp(f32 low, f32 high, f32 max_t, f32 t)
 
 f32 randf(void)
 {
-    return (f32)(rand()) / (f32)RAND_MAX;
+    return rng_f32(rng_stream(RNG_STREAM_GAME));
 }
 
 i32 randi_range(i32 low, i32 high)
 {
-    return rand() % (high-low+1) + low;
+    return rng_range(rng_stream(RNG_STREAM_GAME), low, high);
 }
 
 f32 randf_range(f32 low, f32 high)
 {
-    return (f32)(rand()) / (f32)RAND_MAX * (high-low) + low;
+    return rng_range_f32(rng_stream(RNG_STREAM_GAME), low, high);
 }
 
 f32 guass_dist(f32 mean, f32 std)
@@ -30,6 +30,7 @@ f32 maxf(f32 x, f32 y);
 f32 minf(f32 x, f32 y);
 
 f32 lerp(f32 low, f32 high, f32 max_t, f32 t);
+// draw from RNG_STREAM_GAME
 f32 randf(void);
 i32 randi_range(i32 low, i32 high); // inclusive
 f32 randf_range(f32 low, f32 high);
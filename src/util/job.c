@@ -0,0 +1,307 @@
+#include "job.h"
+#include "log.h"
+#include "extra.h"
+#include "malloc.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// chase-lev deque with a fixed ring. only the owner touches bottom,
+// thieves race on top with a cas. slots hold pointers to jobs owned
+// by the submitter, so a slot is a single atomic word
+typedef struct {
+    _Atomic i64 top;
+    char pad[64 - sizeof(i64)];
+    _Atomic i64 bottom;
+    _Atomic(Job*) slots[JOB_DEQUE_LENGTH];
+} JobDeque;
+
+static struct {
+    JobDeque deques[JOB_MAX_DEQUES];
+    _Atomic i32 num_deques;
+    pthread_t workers[JOB_MAX_WORKERS];
+    char names[JOB_MAX_WORKERS][32];
+    i32 num_workers;
+    _Atomic bool running;
+    _Atomic bool kill;
+    // jobs that are queued but not yet taken, workers
+    // only go to sleep while this is zero
+    _Atomic i32 pending;
+    _Atomic i32 sleeping;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    // bumped on every init so threads drop deques from a previous run
+    _Atomic u32 generation;
+} job_context;
+
+static _Thread_local JobDeque* local_deque;
+static _Thread_local u32 local_generation;
+static _Thread_local u32 local_victim;
+
+static i32 num_cores(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    return sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+static bool deque_push(JobDeque* deque, Job* job)
+{
+    i64 b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    i64 t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if (b - t >= JOB_DEQUE_LENGTH)
+        return false;
+    atomic_store_explicit(&deque->slots[b & (JOB_DEQUE_LENGTH - 1)], job, memory_order_relaxed);
+    // publishes the job to thieves that acquire bottom
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_release);
+    return true;
+}
+
+static Job* deque_pop(JobDeque* deque)
+{
+    Job* job;
+    i64 b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    i64 t;
+    atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    if (t > b) {
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+    job = atomic_load_explicit(&deque->slots[b & (JOB_DEQUE_LENGTH - 1)], memory_order_relaxed);
+    if (t == b) {
+        // last job, race the thieves for it
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+            job = NULL;
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    }
+    return job;
+}
+
+static Job* deque_steal(JobDeque* deque)
+{
+    Job* job;
+    i64 t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    i64 b;
+    atomic_thread_fence(memory_order_seq_cst);
+    b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (t >= b)
+        return NULL;
+    job = atomic_load_explicit(&deque->slots[t & (JOB_DEQUE_LENGTH - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+        return NULL;
+    return job;
+}
+
+// deque of the calling thread, claimed on first use. NULL if
+// every deque is taken, jobs are then run inline
+static JobDeque* get_local_deque(void)
+{
+    u32 generation = atomic_load(&job_context.generation);
+    i32 idx;
+    if (local_deque != NULL && local_generation == generation)
+        return local_deque;
+    local_deque = NULL;
+    local_generation = generation;
+    idx = atomic_fetch_add(&job_context.num_deques, 1);
+    if (idx >= JOB_MAX_DEQUES) {
+        atomic_fetch_sub(&job_context.num_deques, 1);
+        log_write(WARNING, "Thread %s could not get a job deque", thread_get_self_name());
+        return NULL;
+    }
+    local_deque = &job_context.deques[idx];
+    return local_deque;
+}
+
+static Job* find_job(void)
+{
+    JobDeque* deque = get_local_deque();
+    Job* job = NULL;
+    i32 num_deques, i;
+    if (deque != NULL)
+        job = deque_pop(deque);
+    if (job == NULL) {
+        num_deques = mini(atomic_load(&job_context.num_deques), JOB_MAX_DEQUES);
+        for (i = 0; i < num_deques && job == NULL; i++) {
+            local_victim = (local_victim + 1) % num_deques;
+            if (&job_context.deques[local_victim] != deque)
+                job = deque_steal(&job_context.deques[local_victim]);
+        }
+    }
+    if (job != NULL)
+        atomic_fetch_sub(&job_context.pending, 1);
+    return job;
+}
+
+static void execute(Job* job)
+{
+    JobCounter* counter = job->counter;
+    if (job->range_func != NULL)
+        job->range_func(job->arg, job->start, job->end);
+    else
+        job->func(job->arg);
+    atomic_fetch_sub_explicit(counter, 1, memory_order_release);
+}
+
+static void* job_worker(void* vargp)
+{
+    i32 idx = (intptr_t)vargp;
+    Job* job;
+
+    thread_link(job_context.names[idx]);
+    local_deque = &job_context.deques[idx];
+    local_generation = atomic_load(&job_context.generation);
+    local_victim = idx;
+
+    while (!atomic_load(&job_context.kill)) {
+        job = find_job();
+        if (job != NULL) {
+            execute(job);
+            continue;
+        }
+        // a failed steal can lose a race with jobs still pending,
+        // only sleep once there is really nothing left
+        pthread_mutex_lock(&job_context.mutex);
+        atomic_fetch_add(&job_context.sleeping, 1);
+        while (atomic_load(&job_context.pending) == 0 && !atomic_load(&job_context.kill))
+            pthread_cond_wait(&job_context.cond, &job_context.mutex);
+        atomic_fetch_sub(&job_context.sleeping, 1);
+        pthread_mutex_unlock(&job_context.mutex);
+    }
+
+    thread_unlink();
+    return NULL;
+}
+
+void job_init(i32 num_workers)
+{
+    i32 i;
+    log_assert(!atomic_load(&job_context.running), "Job system already running");
+    if (num_workers < 0)
+        num_workers = num_cores() - 1;
+    num_workers = mini(num_workers, JOB_MAX_WORKERS);
+
+    memset(job_context.deques, 0, sizeof(job_context.deques));
+    atomic_store(&job_context.num_deques, num_workers);
+    atomic_store(&job_context.pending, 0);
+    atomic_store(&job_context.sleeping, 0);
+    atomic_store(&job_context.kill, false);
+    atomic_fetch_add(&job_context.generation, 1);
+    pthread_mutex_init(&job_context.mutex, NULL);
+    pthread_cond_init(&job_context.cond, NULL);
+    job_context.num_workers = num_workers;
+    for (i = 0; i < num_workers; i++) {
+        snprintf(job_context.names[i], sizeof(job_context.names[i]), "Worker %d", i);
+        pthread_create(&job_context.workers[i], NULL, job_worker, (void*)(intptr_t)i);
+    }
+    atomic_store(&job_context.running, num_workers > 0);
+    log_write(INFO, "Started %d job workers", num_workers);
+}
+
+void job_cleanup(void)
+{
+    i32 i;
+    log_assert(atomic_load(&job_context.pending) == 0, "Stopping job system with %d jobs queued", atomic_load(&job_context.pending));
+    atomic_store(&job_context.running, false);
+    pthread_mutex_lock(&job_context.mutex);
+    atomic_store(&job_context.kill, true);
+    pthread_cond_broadcast(&job_context.cond);
+    pthread_mutex_unlock(&job_context.mutex);
+    for (i = 0; i < job_context.num_workers; i++)
+        pthread_join(job_context.workers[i], NULL);
+    pthread_mutex_destroy(&job_context.mutex);
+    pthread_cond_destroy(&job_context.cond);
+    job_context.num_workers = 0;
+}
+
+i32 job_num_workers(void)
+{
+    return atomic_load(&job_context.running) ? job_context.num_workers : 0;
+}
+
+void job_submit(Job* job, JobCounter* counter)
+{
+    JobDeque* deque;
+    job->counter = counter;
+    atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+    if (!atomic_load(&job_context.running) || (deque = get_local_deque()) == NULL || !deque_push(deque, job)) {
+        execute(job);
+        return;
+    }
+    atomic_fetch_add(&job_context.pending, 1);
+    if (atomic_load(&job_context.sleeping) > 0) {
+        pthread_mutex_lock(&job_context.mutex);
+        pthread_cond_signal(&job_context.cond);
+        pthread_mutex_unlock(&job_context.mutex);
+    }
+}
+
+void job_run(Job* job, JobFunc func, void* arg, JobCounter* counter)
+{
+    job->func = func;
+    job->range_func = NULL;
+    job->arg = arg;
+    job->start = job->end = 0;
+    job_submit(job, counter);
+}
+
+void job_wait(JobCounter* counter)
+{
+    Job* job;
+    while (atomic_load_explicit(counter, memory_order_acquire) > 0) {
+        job = find_job();
+        if (job != NULL)
+            execute(job);
+        else
+            sched_yield();
+    }
+}
+
+void job_parallel_for(JobRangeFunc func, void* arg, i32 n, i32 grain)
+{
+    Job stack_jobs[JOB_PARALLEL_FOR_STACK_JOBS];
+    Job* jobs = stack_jobs;
+    JobCounter counter = 0;
+    i32 num_jobs, i;
+
+    if (n <= 0)
+        return;
+    grain = maxi(grain, 1);
+    num_jobs = (n + grain - 1) / grain;
+    if (num_jobs == 1 || !atomic_load(&job_context.running)) {
+        for (i = 0; i < n; i += grain)
+            func(arg, i, mini(i + grain, n));
+        return;
+    }
+
+    if (num_jobs > JOB_PARALLEL_FOR_STACK_JOBS)
+        jobs = st_malloc(num_jobs * sizeof(Job));
+    // pushed back to front so the owner pops the front ranges and
+    // thieves take the far end first
+    for (i = num_jobs - 1; i >= 1; i--) {
+        jobs[i].func = NULL;
+        jobs[i].range_func = func;
+        jobs[i].arg = arg;
+        jobs[i].start = i * grain;
+        jobs[i].end = mini((i + 1) * grain, n);
+        job_submit(&jobs[i], &counter);
+    }
+    func(arg, 0, grain);
+    job_wait(&counter);
+    if (jobs != stack_jobs)
+        st_free(jobs);
+}
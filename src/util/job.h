@@ -0,0 +1,62 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include "type.h"
+#include "thread.h"
+
+// fixed pool of worker threads fed by work-stealing deques. every
+// thread that submits jobs gets its own deque, pushes and pops at the
+// bottom of it and steals from the top of the others when it runs dry.
+// jobs are tracked with counters: submitting increments the counter,
+// finishing decrements it, and job_wait runs other jobs until it hits
+// zero, so a job can wait on the jobs it spawned without deadlocking.
+// a job depends on another by waiting on its counter.
+
+#define JOB_MAX_WORKERS             NUM_WORKER_THREADS
+// workers plus the threads that submit jobs (main, game, ...)
+#define JOB_MAX_DEQUES              (JOB_MAX_WORKERS + 8)
+// jobs that do not fit are run inline by the submitter
+#define JOB_DEQUE_LENGTH            4096
+#define JOB_PARALLEL_FOR_STACK_JOBS 64
+#define JOB_WORKERS_AUTO            -1
+
+typedef _Atomic i32 JobCounter;
+
+typedef void (*JobFunc)(void* arg);
+typedef void (*JobRangeFunc)(void* arg, i32 start, i32 end);
+
+typedef struct Job {
+    JobFunc func;
+    JobRangeFunc range_func;
+    void* arg;
+    i32 start, end;
+    JobCounter* counter;
+} Job;
+
+// start num_workers workers, or one per core minus the submitting
+// thread for JOB_WORKERS_AUTO. with 0 workers jobs run inline
+void job_init(i32 num_workers);
+
+// stops the workers. no jobs can be in flight
+void job_cleanup(void);
+
+// 0 if the job system is not running, in which
+// case jobs run inline when they are submitted
+i32  job_num_workers(void);
+
+// queue job and increment counter. job is not copied and must
+// stay valid until counter reaches zero
+void job_submit(Job* job, JobCounter* counter);
+
+// fill job with func(arg) and submit it
+void job_run(Job* job, JobFunc func, void* arg, JobCounter* counter);
+
+// run queued jobs on the calling thread until counter reaches zero
+void job_wait(JobCounter* counter);
+
+// calls func(arg, start, end) for every range [k * grain, (k + 1) * grain)
+// covering [0, n), the last one clamped to n, spread across the workers.
+// the calling thread takes a range too and returns once all are done
+void job_parallel_for(JobRangeFunc func, void* arg, i32 n, i32 grain);
+
+#endif
@@ -108,13 +108,13 @@ bool list_empty(List* list)
     return list->length == 0;
 }
 
-void list_shuffle(List* list)
+void list_shuffle(List* list, Rng* rng)
 {
     // modern fisher-yates
     i32 i, j;
     void* tmp;
     for (i = 1; i < list->length; i++) {
-        j = rand() % (i+1);
+        j = rng_range(rng, 0, i);
         tmp = list->buffer[i];
         list->buffer[i] = list->buffer[j];
         list->buffer[j] = tmp;
@@ -2,6 +2,7 @@
 #define LIST_H
 
 #include "type.h"
+#include "rng.h"
 
 #define LIST_RESIZE_LENGTH 16
 
@@ -57,7 +58,7 @@ void* list_get(List* list, i32 idx);
 bool list_empty(List* list);
 
 // randomly rearranges the elements in the list. O(n) time complexity
-void list_shuffle(List* list);
+void list_shuffle(List* list, Rng* rng);
 
 // destroys the list. does not alter any of the list's contents
 void  list_destroy(List* list);
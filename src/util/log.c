@@ -121,6 +121,8 @@ void _log_write(LogLevel severity, const char* message, const char* filename, in
 #else
 void _log_write(LogLevel severity, const char* message, ...)
 {
+    if ((int)severity > level)
+        return;
     int Y, M, D, h, m, s;
     va_list args;
     pthread_mutex_lock(&mutex);
@@ -189,3 +189,40 @@ void print_heap_info(void)
 }
 
 #endif
+
+#ifdef BENCH_BUILD
+
+static _Atomic u64 alloc_count;
+static _Atomic u64 free_count;
+
+void* _st_malloc_counted(size_t size)
+{
+    atomic_fetch_add(&alloc_count, 1);
+    return malloc(size);
+}
+void* _st_realloc_counted(void* ptr, size_t size)
+{
+    atomic_fetch_add(&alloc_count, 1);
+    return realloc(ptr, size);
+}
+void* _st_calloc_counted(int cnt, size_t size)
+{
+    atomic_fetch_add(&alloc_count, 1);
+    return calloc(cnt, size);
+}
+void _st_free_counted(void* ptr)
+{
+    if (ptr != NULL)
+        atomic_fetch_add(&free_count, 1);
+    free(ptr);
+}
+u64 st_alloc_count(void)
+{
+    return alloc_count;
+}
+u64 st_free_count(void)
+{
+    return free_count;
+}
+
+#endif
@@ -18,6 +18,21 @@ void  _st_free(void* ptr, const char* file, int line);
 size_t get_heap_size(void);
 void   print_heap_info(void);
 
+#elif defined(BENCH_BUILD)
+
+// counted allocations, the benchmark reports allocations per tick
+#define st_malloc(size) _st_malloc_counted(size)
+#define st_realloc(ptr, size) _st_realloc_counted(ptr, size)
+#define st_calloc(cnt, size) _st_calloc_counted(cnt, size)
+#define st_free(ptr) _st_free_counted(ptr)
+
+void* _st_malloc_counted(size_t size);
+void* _st_realloc_counted(void* ptr, size_t size);
+void* _st_calloc_counted(int cnt, size_t size);
+void  _st_free_counted(void* ptr);
+u64   st_alloc_count(void);
+u64   st_free_count(void);
+
 #else
 
 #define st_malloc(size) malloc(size)
@@ -14,6 +14,10 @@
 #define PACKET_HEADER_BYTES 8
 #define PACKET_MAX_SIZE (1024 * 1024)
 
+// every queued datagram gets a slot of this size in a SocketBatch
+#define SOCKET_BATCH_SLOT_BYTES (UDP_MAX_PAYLOAD + PACKET_HEADER_BYTES)
+#define SOCKET_RECV_BATCH_MAX 64
+
 typedef struct Packet {
     char* buffer;
     i32 length;
@@ -24,6 +28,18 @@ typedef struct Packet {
 typedef struct Socket Socket;
 typedef struct NetContext NetContext;
 typedef struct SocketAddr SocketAddr;
+typedef struct SocketBatch SocketBatch;
+
+// receive buffer a socket reads packets into in place. each receiving
+// thread owns one and reuses it for every packet, so the receive path
+// does not allocate. packet points into data and stays valid until the
+// next receive into the same buffer, handlers must copy what they keep
+typedef struct PacketBuffer {
+    Packet packet;
+    SocketAddr* addr;
+    char* data;
+    i32 capacity;
+} PacketBuffer;
 
 // initialize a net context. each net context has their own singly-linked list of in use sockets
 NetContext* networking_init(void);
@@ -87,6 +103,32 @@ Packet* socket_recv(Socket* socket);
 // The memory for dst_addr must be freed with st_free
 Packet* socket_recvfrom(Socket* src_socket, SocketAddr** dst_addr);
 
+// Receive a packet into buffer, growing it if the packet does not fit.
+// Packets over PACKET_MAX_SIZE are read and skipped, the next one is
+// returned instead. Returns false on error or disconnect. Socket should be TCP
+bool    socket_recv_into(Socket* socket, PacketBuffer* buffer);
+
+// Receive a datagram into buffer, the sender is written to buffer->addr.
+// Returns false on error or a malformed datagram. Socket should be UDP
+bool    socket_recvfrom_into(Socket* socket, PacketBuffer* buffer);
+
+// Receive up to count datagrams into buffers with one call, waiting only
+// for the first. Returns how many valid packets were moved to the front
+// of buffers, -1 on error. count is capped at SOCKET_RECV_BATCH_MAX
+i32     socket_recvfrom_batch(Socket* socket, PacketBuffer* buffers, i32 count);
+
+// Create a queue of up to length datagrams that socket sends together.
+// One sendmmsg per flush on linux, a sendto loop on windows
+SocketBatch* socket_batch_create(Socket* socket, i32 length);
+void    socket_batch_destroy(SocketBatch* batch);
+
+// Copy packet into the batch, to be sent to dst_addr on the next flush.
+// A full batch is flushed first. Returns false if packet does not fit a datagram
+bool    socket_batch_queue(SocketBatch* batch, SocketAddr* dst_addr, Packet* packet);
+
+// Send every queued datagram and empty the batch. Returns the number sent
+i32     socket_batch_flush(SocketBatch* batch);
+
 // Keep track of a socket's handler thread. 
 void    socket_set_thread_id(Socket* socket, pthread_t thread_id);
 
@@ -101,4 +143,13 @@ Packet* packet_create(u32 id, i32 length, const char* buffer);
 // Frees memory from packet. Undefined if packet is NULL
 void    packet_destroy(Packet* packet);
 
+// Allocate a receive buffer for packets of up to capacity bytes
+void    packet_buffer_init(PacketBuffer* buffer, i32 capacity);
+
+// Make room for packets of up to capacity bytes, the packet is dropped.
+// Returns false if capacity is over PACKET_MAX_SIZE
+bool    packet_buffer_reserve(PacketBuffer* buffer, i32 capacity);
+
+void    packet_buffer_cleanup(PacketBuffer* buffer);
+
 #endif
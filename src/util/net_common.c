@@ -36,3 +36,35 @@ void packet_destroy(Packet* packet)
     st_free(packet->buffer - PACKET_HEADER_BYTES);
     st_free(packet);
 }
+
+void packet_buffer_init(PacketBuffer* buffer, i32 capacity)
+{
+    // placeholder, the receive overwrites it with the sender
+    buffer->addr = socket_address_create("0.0.0.0", "0");
+    buffer->data = st_malloc(capacity + PACKET_HEADER_BYTES);
+    buffer->capacity = capacity;
+    buffer->packet.buffer = buffer->data + PACKET_HEADER_BYTES;
+    buffer->packet.length = 0;
+    buffer->packet.id = 0;
+}
+
+bool packet_buffer_reserve(PacketBuffer* buffer, i32 capacity)
+{
+    if (capacity < 0 || capacity > PACKET_MAX_SIZE)
+        return false;
+    if (capacity > buffer->capacity) {
+        buffer->data = st_realloc(buffer->data, capacity + PACKET_HEADER_BYTES);
+        buffer->capacity = capacity;
+        buffer->packet.buffer = buffer->data + PACKET_HEADER_BYTES;
+    }
+    return true;
+}
+
+void packet_buffer_cleanup(PacketBuffer* buffer)
+{
+    socket_address_destroy(buffer->addr);
+    st_free(buffer->data);
+    buffer->addr = NULL;
+    buffer->data = NULL;
+    buffer->capacity = 0;
+}
@@ -1,5 +1,8 @@
 #ifdef __linux__
 
+// sendmmsg and recvmmsg
+#define _GNU_SOURCE
+
 #include "net.h"
 #include "malloc.h"
 #include "extra.h"
@@ -42,6 +45,16 @@ typedef struct Socket {
     bool tcp;
 } Socket;
 
+typedef struct SocketBatch {
+    Socket* socket;
+    struct mmsghdr* messages;
+    struct iovec* iovecs;
+    SocketAddr* addrs;
+    char* data;
+    i32 length;
+    i32 count;
+} SocketBatch;
+
 typedef struct NetContext {
    pthread_mutex_t mutex;
    Socket* head;
@@ -357,6 +370,190 @@ Packet* socket_recvfrom(Socket* src_socket, SocketAddr** dst_addr)
     return packet;
 }
 
+static bool read_all(Socket* sock, char* buffer, ssize_t size)
+{
+    ssize_t received = 0;
+    ssize_t length;
+    while (received < size) {
+        length = read(sock->fd, buffer + received, size - received);
+        if (length == 0) {
+            log_write(DEBUG, "connection disconnected");
+            return false;
+        }
+        if (length == -1) {
+            log_write(CRITICAL, "read failed: errno = %d", errno);
+            return false;
+        }
+        received += length;
+    }
+    return true;
+}
+
+// reads the body of a packet too big for the buffer and throws it away
+static bool skip_all(Socket* sock, PacketBuffer* buffer, i32 size)
+{
+    i32 n;
+    while (size > 0) {
+        n = mini(size, buffer->capacity);
+        if (!read_all(sock, buffer->data + PACKET_HEADER_BYTES, n))
+            return false;
+        size -= n;
+    }
+    return true;
+}
+
+bool socket_recv_into(Socket* sock, PacketBuffer* buffer)
+{
+    Packet* packet = &buffer->packet;
+    while (true) {
+        if (!read_all(sock, buffer->data, PACKET_HEADER_BYTES))
+            return false;
+        memcpy(&packet->length, buffer->data, sizeof(packet->length));
+        memcpy(&packet->id, buffer->data + sizeof(packet->length), sizeof(packet->id));
+        // a negative length leaves no way to find the next packet
+        if (packet->length < 0) {
+            log_write(CRITICAL, "packet %u has invalid length %d", packet->id, packet->length);
+            return false;
+        }
+        if (packet_buffer_reserve(buffer, packet->length))
+            return read_all(sock, buffer->data + PACKET_HEADER_BYTES, packet->length);
+        log_write(WARNING, "skipped packet %u of %d bytes, over PACKET_MAX_SIZE", packet->id, packet->length);
+        if (!skip_all(sock, buffer, packet->length))
+            return false;
+    }
+}
+
+static bool datagram_valid(PacketBuffer* buffer, ssize_t len)
+{
+    Packet* packet = &buffer->packet;
+    if (len < PACKET_HEADER_BYTES) {
+        log_write(WARNING, "dropped %zd byte datagram", len);
+        return false;
+    }
+    memcpy(&packet->length, buffer->data, sizeof(packet->length));
+    memcpy(&packet->id, buffer->data + sizeof(packet->length), sizeof(packet->id));
+    if (packet->length < 0 || packet->length > len - PACKET_HEADER_BYTES) {
+        log_write(WARNING, "dropped datagram %u, length %d of %zd bytes", packet->id, packet->length, len);
+        return false;
+    }
+    packet->buffer = buffer->data + PACKET_HEADER_BYTES;
+    return true;
+}
+
+bool socket_recvfrom_into(Socket* src_socket, PacketBuffer* buffer)
+{
+    socklen_t client_len = sizeof(buffer->addr->addr);
+    ssize_t len = recvfrom(src_socket->fd, buffer->data, buffer->capacity + PACKET_HEADER_BYTES, 0, (struct sockaddr*)&buffer->addr->addr, &client_len);
+    if (len <= 0) {
+        log_write(CRITICAL, "recvfrom failed: errono = %d", errno);
+        return false;
+    }
+    return datagram_valid(buffer, len);
+}
+
+SocketBatch* socket_batch_create(Socket* sock, i32 length)
+{
+    SocketBatch* batch = st_malloc(sizeof(SocketBatch));
+    batch->socket = sock;
+    batch->messages = st_calloc(length, sizeof(struct mmsghdr));
+    batch->iovecs = st_malloc(length * sizeof(struct iovec));
+    batch->addrs = st_malloc(length * sizeof(SocketAddr));
+    batch->data = st_malloc(length * SOCKET_BATCH_SLOT_BYTES);
+    batch->length = length;
+    batch->count = 0;
+    return batch;
+}
+
+void socket_batch_destroy(SocketBatch* batch)
+{
+    st_free(batch->messages);
+    st_free(batch->iovecs);
+    st_free(batch->addrs);
+    st_free(batch->data);
+    st_free(batch);
+}
+
+bool socket_batch_queue(SocketBatch* batch, SocketAddr* dst_addr, Packet* packet)
+{
+    struct msghdr* header;
+    i32 size = packet->length + PACKET_HEADER_BYTES;
+    i32 i;
+    if (size > SOCKET_BATCH_SLOT_BYTES) {
+        log_write(WARNING, "packet %u of %d bytes does not fit a datagram", packet->id, packet->length);
+        return false;
+    }
+    if (batch->count == batch->length)
+        socket_batch_flush(batch);
+    i = batch->count++;
+    memcpy(batch->data + i * SOCKET_BATCH_SLOT_BYTES, packet->buffer - PACKET_HEADER_BYTES, size);
+    batch->addrs[i] = *dst_addr;
+    batch->iovecs[i].iov_base = batch->data + i * SOCKET_BATCH_SLOT_BYTES;
+    batch->iovecs[i].iov_len = size;
+    header = &batch->messages[i].msg_hdr;
+    header->msg_name = &batch->addrs[i].addr;
+    header->msg_namelen = sizeof(batch->addrs[i].addr);
+    header->msg_iov = &batch->iovecs[i];
+    header->msg_iovlen = 1;
+    return true;
+}
+
+i32 socket_batch_flush(SocketBatch* batch)
+{
+    i32 sent = 0, done = 0, n;
+    while (done < batch->count) {
+        n = sendmmsg(batch->socket->fd, batch->messages + done, batch->count - done, 0);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            // only the first datagram failed, skip it so
+            // one unreachable client does not drop the rest
+            log_write(CRITICAL, "sendmmsg failed: errno = %d", errno);
+            done++;
+            continue;
+        }
+        sent += n;
+        done += n;
+    }
+    batch->count = 0;
+    return sent;
+}
+
+i32 socket_recvfrom_batch(Socket* src_socket, PacketBuffer* buffers, i32 count)
+{
+    struct mmsghdr messages[SOCKET_RECV_BATCH_MAX];
+    struct iovec iovecs[SOCKET_RECV_BATCH_MAX];
+    PacketBuffer swap;
+    i32 num_valid = 0, n, i;
+    count = mini(count, SOCKET_RECV_BATCH_MAX);
+    memset(messages, 0, count * sizeof(struct mmsghdr));
+    for (i = 0; i < count; i++) {
+        iovecs[i].iov_base = buffers[i].data;
+        iovecs[i].iov_len = buffers[i].capacity + PACKET_HEADER_BYTES;
+        messages[i].msg_hdr.msg_name = &buffers[i].addr->addr;
+        messages[i].msg_hdr.msg_namelen = sizeof(buffers[i].addr->addr);
+        messages[i].msg_hdr.msg_iov = &iovecs[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    // blocks for the first datagram, then takes whatever else is queued
+    n = recvmmsg(src_socket->fd, messages, count, MSG_WAITFORONE, NULL);
+    if (n <= 0) {
+        log_write(CRITICAL, "recvmmsg failed: errno = %d", errno);
+        return -1;
+    }
+    // malformed datagrams are dropped, the valid ones moved to the front
+    for (i = 0; i < n; i++) {
+        if (!datagram_valid(&buffers[i], messages[i].msg_len))
+            continue;
+        if (i != num_valid) {
+            swap = buffers[num_valid];
+            buffers[num_valid] = buffers[i];
+            buffers[i] = swap;
+        }
+        num_valid++;
+    }
+    return num_valid;
+}
+
 void socket_set_thread_id(Socket* sock, pthread_t thread_id)
 {
     sock->has_thread = true;
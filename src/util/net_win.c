@@ -31,6 +31,15 @@ typedef struct Socket {
     bool has_thread;
 } Socket;
 
+typedef struct SocketBatch {
+    Socket* socket;
+    SocketAddr* addrs;
+    i32* sizes;
+    char* data;
+    i32 length;
+    i32 count;
+} SocketBatch;
+
 typedef struct NetContext {
     WSADATA wsa_data;
     Socket* head;
@@ -411,6 +420,153 @@ Packet* socket_recvfrom(Socket* src_socket, SocketAddr** dst_addr)
     return packet;
 }
 
+static bool recv_all(Socket* sock, char* buffer, ssize_t size)
+{
+    ssize_t received = 0;
+    ssize_t length;
+    while (received < size) {
+        length = recv(*sock->sock, buffer + received, size - received, 0);
+        if (length == SOCKET_ERROR) {
+            log_write(CRITICAL, "recvfailed: WsaGetLastError() = %d", WSAGetLastError());
+            return false;
+        }
+        if (length == 0) {
+            log_write(DEBUG, "connection disconnected");
+            return false;
+        }
+        received += length;
+    }
+    return true;
+}
+
+// reads the body of a packet too big for the buffer and throws it away
+static bool skip_all(Socket* sock, PacketBuffer* buffer, i32 size)
+{
+    i32 n;
+    while (size > 0) {
+        n = mini(size, buffer->capacity);
+        if (!recv_all(sock, buffer->data + PACKET_HEADER_BYTES, n))
+            return false;
+        size -= n;
+    }
+    return true;
+}
+
+bool socket_recv_into(Socket* sock, PacketBuffer* buffer)
+{
+    Packet* packet = &buffer->packet;
+    while (true) {
+        if (!recv_all(sock, buffer->data, PACKET_HEADER_BYTES))
+            return false;
+        memcpy(&packet->length, buffer->data, sizeof(packet->length));
+        memcpy(&packet->id, buffer->data + sizeof(packet->length), sizeof(packet->id));
+        // a negative length leaves no way to find the next packet
+        if (packet->length < 0) {
+            log_write(CRITICAL, "packet %u has invalid length %d", packet->id, packet->length);
+            return false;
+        }
+        if (packet_buffer_reserve(buffer, packet->length))
+            return recv_all(sock, buffer->data + PACKET_HEADER_BYTES, packet->length);
+        log_write(WARNING, "skipped packet %u of %d bytes, over PACKET_MAX_SIZE", packet->id, packet->length);
+        if (!skip_all(sock, buffer, packet->length))
+            return false;
+    }
+}
+
+static bool datagram_valid(PacketBuffer* buffer, ssize_t len)
+{
+    Packet* packet = &buffer->packet;
+    if (len < PACKET_HEADER_BYTES) {
+        log_write(WARNING, "dropped %zd byte datagram", len);
+        return false;
+    }
+    memcpy(&packet->length, buffer->data, sizeof(packet->length));
+    memcpy(&packet->id, buffer->data + sizeof(packet->length), sizeof(packet->id));
+    if (packet->length < 0 || packet->length > len - PACKET_HEADER_BYTES) {
+        log_write(WARNING, "dropped datagram %u, length %d of %zd bytes", packet->id, packet->length, len);
+        return false;
+    }
+    packet->buffer = buffer->data + PACKET_HEADER_BYTES;
+    return true;
+}
+
+bool socket_recvfrom_into(Socket* src_socket, PacketBuffer* buffer)
+{
+    buffer->addr->len = sizeof(buffer->addr->addr);
+    ssize_t len = recvfrom(*src_socket->sock, buffer->data, buffer->capacity + PACKET_HEADER_BYTES, 0, (struct sockaddr*)&buffer->addr->addr, &buffer->addr->len);
+    if (len == SOCKET_ERROR) {
+        log_write(CRITICAL, "recvfrom failed: WsaGetLastError() = %d", WSAGetLastError());
+        return false;
+    }
+    return datagram_valid(buffer, len);
+}
+
+// no recvmmsg, one datagram per call. errors and malformed
+// datagrams both return 0
+i32 socket_recvfrom_batch(Socket* src_socket, PacketBuffer* buffers, i32 count)
+{
+    if (count <= 0)
+        return 0;
+    return socket_recvfrom_into(src_socket, &buffers[0]) ? 1 : 0;
+}
+
+SocketBatch* socket_batch_create(Socket* sock, i32 length)
+{
+    SocketBatch* batch = st_malloc(sizeof(SocketBatch));
+    batch->socket = sock;
+    batch->addrs = st_malloc(length * sizeof(SocketAddr));
+    batch->sizes = st_malloc(length * sizeof(i32));
+    batch->data = st_malloc(length * SOCKET_BATCH_SLOT_BYTES);
+    batch->length = length;
+    batch->count = 0;
+    return batch;
+}
+
+void socket_batch_destroy(SocketBatch* batch)
+{
+    st_free(batch->addrs);
+    st_free(batch->sizes);
+    st_free(batch->data);
+    st_free(batch);
+}
+
+bool socket_batch_queue(SocketBatch* batch, SocketAddr* dst_addr, Packet* packet)
+{
+    i32 size = packet->length + PACKET_HEADER_BYTES;
+    i32 i;
+    if (size > SOCKET_BATCH_SLOT_BYTES) {
+        log_write(WARNING, "packet %u of %d bytes does not fit a datagram", packet->id, packet->length);
+        return false;
+    }
+    if (batch->count == batch->length)
+        socket_batch_flush(batch);
+    i = batch->count++;
+    memcpy(batch->data + i * SOCKET_BATCH_SLOT_BYTES, packet->buffer - PACKET_HEADER_BYTES, size);
+    batch->addrs[i] = *dst_addr;
+    batch->sizes[i] = size;
+    return true;
+}
+
+// no sendmmsg, one sendto per datagram
+i32 socket_batch_flush(SocketBatch* batch)
+{
+    i32 sent = 0;
+    for (i32 i = 0; i < batch->count; i++) {
+        int res = sendto(*batch->socket->sock,
+                         batch->data + i * SOCKET_BATCH_SLOT_BYTES,
+                         batch->sizes[i],
+                         0,
+                         (struct sockaddr*)&batch->addrs[i].addr,
+                         batch->addrs[i].len);
+        if (res == SOCKET_ERROR)
+            log_write(CRITICAL, "sendto failed: WsaGetLastError() = %d", WSAGetLastError());
+        else
+            sent++;
+    }
+    batch->count = 0;
+    return sent;
+}
+
 bool socket_connected(Socket* sock)
 {
     return sock->connected;
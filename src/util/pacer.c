@@ -0,0 +1,159 @@
+#include "pacer.h"
+#include <math.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+
+f64 pacer_now(void)
+{
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (f64)counter.QuadPart / (f64)frequency.QuadPart;
+}
+
+static void sleep_until(f64 target)
+{
+    f64 remaining = target - pacer_now();
+    // Sleep only has millisecond granularity
+    if (remaining >= 1e-3)
+        Sleep((DWORD)(remaining * 1000));
+}
+
+#else
+#include <time.h>
+#include <errno.h>
+
+f64 pacer_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void sleep_until(f64 target)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)target;
+    ts.tv_nsec = (long)((target - ts.tv_sec) * 1e9);
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+#endif
+
+static i32 clamp_tps(i32 tps)
+{
+    if (tps < PACER_MIN_TPS)
+        return PACER_MIN_TPS;
+    if (tps > PACER_MAX_TPS)
+        return PACER_MAX_TPS;
+    return tps;
+}
+
+void pacer_init(Pacer* pacer, i32 tps)
+{
+    memset(pacer, 0, sizeof(Pacer));
+    pacer->spin_window = PACER_MAX_SPIN_WINDOW / 2;
+    pacer->oversleep = pacer->spin_window;
+    pacer_set_tps(pacer, tps);
+}
+
+void pacer_set_tps(Pacer* pacer, i32 tps)
+{
+    pacer->tps = clamp_tps(tps);
+    pacer->timestep = 1.0 / pacer->tps;
+    pacer_resync(pacer);
+}
+
+void pacer_resync(Pacer* pacer)
+{
+    pacer->deadline = pacer_now() + pacer->timestep;
+}
+
+static void calibrate(Pacer* pacer, f64 oversleep)
+{
+    f64 window;
+    // exponential moving average so one bad wakeup doesnt
+    // force the pacer into spinning for the next few seconds
+    pacer->oversleep = 0.9 * pacer->oversleep + 0.1 * oversleep;
+    window = 2 * pacer->oversleep;
+    if (window < PACER_MIN_SPIN_WINDOW)
+        window = PACER_MIN_SPIN_WINDOW;
+    if (window > PACER_MAX_SPIN_WINDOW)
+        window = PACER_MAX_SPIN_WINDOW;
+    pacer->spin_window = window;
+}
+
+f64 pacer_wait(Pacer* pacer)
+{
+    PacerStats* stats = &pacer->stats;
+    f64 deadline = pacer->deadline;
+    f64 sleep_target, start, now, jitter;
+
+    start = now = pacer_now();
+    if (now >= deadline) {
+        stats->missed++;
+        // more than a full tick behind, dont try to make it up
+        if (now - deadline > pacer->timestep)
+            deadline = now;
+    } else {
+        sleep_target = deadline - pacer->spin_window;
+        if (now < sleep_target) {
+            sleep_until(sleep_target);
+            now = pacer_now();
+            calibrate(pacer, fmax(0, now - sleep_target));
+            stats->sleep_time += now - start;
+        }
+        start = now;
+        while (now < deadline)
+            now = pacer_now();
+        stats->spin_time += now - start;
+    }
+
+    jitter = now - deadline;
+    stats->jitter_sum += jitter;
+    stats->jitter_sum_sq += jitter * jitter;
+    if (jitter > stats->jitter_max)
+        stats->jitter_max = jitter;
+    stats->ticks++;
+
+    pacer->deadline = deadline + pacer->timestep;
+    return now;
+}
+
+void pacer_reset_stats(Pacer* pacer)
+{
+    memset(&pacer->stats, 0, sizeof(PacerStats));
+}
+
+f64 pacer_jitter_mean(Pacer* pacer)
+{
+    if (pacer->stats.ticks == 0)
+        return 0;
+    return pacer->stats.jitter_sum / pacer->stats.ticks;
+}
+
+f64 pacer_jitter_stddev(Pacer* pacer)
+{
+    f64 mean, var;
+    if (pacer->stats.ticks == 0)
+        return 0;
+    mean = pacer_jitter_mean(pacer);
+    var = pacer->stats.jitter_sum_sq / pacer->stats.ticks - mean * mean;
+    return (var > 0) ? sqrt(var) : 0;
+}
+
+f64 pacer_sleep_ratio(Pacer* pacer)
+{
+    f64 total = pacer->stats.sleep_time + pacer->stats.spin_time;
+    if (total == 0)
+        return 0;
+    return pacer->stats.sleep_time / total;
+}
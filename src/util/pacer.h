@@ -0,0 +1,64 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include "type.h"
+
+// frame pacer for fixed-rate loops. sleeps with the os timer until
+// it is close to the next deadline, then spins for the remainder. the
+// spin window is calibrated from how late previous sleeps woke up.
+// deadlines are absolute, so time lost in one tick is not carried
+// into the next (drift correction).
+
+#define PACER_MIN_TPS           1
+#define PACER_MAX_TPS           1000
+#define PACER_MIN_SPIN_WINDOW   50e-6
+#define PACER_MAX_SPIN_WINDOW   2e-3
+
+typedef struct PacerStats {
+    // how late each tick started relative to its deadline, in seconds
+    f64 jitter_sum;
+    f64 jitter_sum_sq;
+    f64 jitter_max;
+    // time spent blocked in the os vs busy waiting, in seconds
+    f64 sleep_time;
+    f64 spin_time;
+    i64 ticks;
+    // ticks where the deadline had already passed before waiting
+    i64 missed;
+} PacerStats;
+
+typedef struct Pacer {
+    PacerStats stats;
+    f64 timestep;
+    f64 deadline;
+    f64 spin_window;
+    f64 oversleep;
+    i32 tps;
+} Pacer;
+
+// monotonic time in seconds, independent of glfw
+f64  pacer_now(void);
+
+void pacer_init(Pacer* pacer, i32 tps);
+
+// change the tick rate. tps is clamped to [PACER_MIN_TPS, PACER_MAX_TPS]
+// and the next deadline is rescheduled from the current time
+void pacer_set_tps(Pacer* pacer, i32 tps);
+
+// block until the next deadline. returns the time the tick started
+f64  pacer_wait(Pacer* pacer);
+
+// restart the deadline schedule from the current time, used after
+// long stalls (map loads) so the pacer does not count them as missed
+void pacer_resync(Pacer* pacer);
+
+void pacer_reset_stats(Pacer* pacer);
+
+// average and standard deviation of tick jitter, in seconds
+f64  pacer_jitter_mean(Pacer* pacer);
+f64  pacer_jitter_stddev(Pacer* pacer);
+
+// fraction of waiting time spent sleeping rather than spinning
+f64  pacer_sleep_ratio(Pacer* pacer);
+
+#endif
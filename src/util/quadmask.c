@@ -1,5 +1,6 @@
 #include "quadmask.h"
 #include "malloc.h"
+#include "extra.h"
 #include <stdio.h>
 
 Quadmask* quadmask_create(i32 width, i32 length)
@@ -29,12 +30,6 @@ void quadmask_unset(Quadmask* qm, i32 x, i32 y)
     qm->data[idx / 64] &= ~(1ULL << (63 - (idx % 64)));
 }
 
-bool quadmask_isset(Quadmask* qm, i32 x, i32 y)
-{
-    i32 idx = y * qm->width + x;
-    return (qm->data[idx / 64] >> (63 - (idx % 64))) & 1;
-}
-
 void quadmask_setall(Quadmask* qm)
 {
     for (i32 i = 0; 64 * i < qm->width * qm->length; i++)
@@ -52,6 +47,141 @@ bool quadmask_in_bounds(Quadmask* qm, i32 x, i32 y)
     return x >= 0 && x < qm->width && y >= 0 && y < qm->length;
 }
 
+// bits are stored row after row, most significant bit first, so a row
+// segment of n bits touches at most n / 64 + 2 words
+
+// the n most significant bits, n in [1, 64]
+static u64 leading_mask(i32 n)
+{
+    return ~0ULL << (64 - n);
+}
+
+// n bits starting at bit idx, most significant bit first
+static u64 get_bits(u64* data, i32 idx, i32 n)
+{
+    i32 w = idx >> 6;
+    i32 o = idx & 63;
+    u64 bits = data[w] << o;
+    if (o + n > 64)
+        bits |= data[w+1] >> (64 - o);
+    return bits & leading_mask(n);
+}
+
+static void or_bits(u64* data, i32 idx, u64 bits, i32 n)
+{
+    i32 w = idx >> 6;
+    i32 o = idx & 63;
+    data[w] |= bits >> o;
+    if (o + n > 64)
+        data[w+1] |= bits << (64 - o);
+}
+
+static void andnot_bits(u64* data, i32 idx, u64 bits, i32 n)
+{
+    i32 w = idx >> 6;
+    i32 o = idx & 63;
+    data[w] &= ~(bits >> o);
+    if (o + n > 64)
+        data[w+1] &= ~(bits << (64 - o));
+}
+
+typedef enum {
+    RANGE_SET,
+    RANGE_CLEAR,
+    RANGE_ANY
+} RangeOp;
+
+// applies op to bits [start, end). returns true if op
+// is RANGE_ANY and one of the bits is set
+static bool range_op(u64* data, i32 start, i32 end, RangeOp op)
+{
+    i32 w1 = start >> 6;
+    i32 w2 = (end - 1) >> 6;
+    u64 first = ~0ULL >> (start & 63);
+    u64 last = ~0ULL << (63 - ((end - 1) & 63));
+    u64 mask;
+    for (i32 w = w1; w <= w2; w++) {
+        mask = ~0ULL;
+        if (w == w1)
+            mask &= first;
+        if (w == w2)
+            mask &= last;
+        if (op == RANGE_SET)
+            data[w] |= mask;
+        else if (op == RANGE_CLEAR)
+            data[w] &= ~mask;
+        else if (data[w] & mask)
+            return true;
+    }
+    return false;
+}
+
+static bool rect_op(Quadmask* qm, i32 x1, i32 y1, i32 x2, i32 y2, RangeOp op)
+{
+    for (i32 y = y1; y <= y2; y++)
+        if (range_op(qm->data, y * qm->width + x1, y * qm->width + x2 + 1, op))
+            return true;
+    return false;
+}
+
+void quadmask_set_rect(Quadmask* qm, i32 x1, i32 y1, i32 x2, i32 y2)
+{
+    rect_op(qm, x1, y1, x2, y2, RANGE_SET);
+}
+
+void quadmask_clear_rect(Quadmask* qm, i32 x1, i32 y1, i32 x2, i32 y2)
+{
+    rect_op(qm, x1, y1, x2, y2, RANGE_CLEAR);
+}
+
+bool quadmask_any_in_rect(Quadmask* qm, i32 x1, i32 y1, i32 x2, i32 y2)
+{
+    return rect_op(qm, x1, y1, x2, y2, RANGE_ANY);
+}
+
+static bool stamp_op(Quadmask* qm, Quadmask* stamp, i32 x, i32 y, RangeOp op)
+{
+    i32 src, dst, n;
+    u64 bits;
+    for (i32 v = 0; v < stamp->length; v++) {
+        src = v * stamp->width;
+        dst = (y + v) * qm->width + x;
+        for (i32 u = 0; u < stamp->width; u += 64) {
+            n = mini(64, stamp->width - u);
+            bits = get_bits(stamp->data, src + u, n);
+            if (bits == 0)
+                continue;
+            if (op == RANGE_SET)
+                or_bits(qm->data, dst + u, bits, n);
+            else if (op == RANGE_CLEAR)
+                andnot_bits(qm->data, dst + u, bits, n);
+            else if (bits & get_bits(qm->data, dst + u, n))
+                return true;
+        }
+    }
+    return false;
+}
+
+bool quadmask_any_in_stamp(Quadmask* qm, Quadmask* stamp, i32 x, i32 y)
+{
+    return stamp_op(qm, stamp, x, y, RANGE_ANY);
+}
+
+void quadmask_set_stamp(Quadmask* qm, Quadmask* stamp, i32 x, i32 y)
+{
+    stamp_op(qm, stamp, x, y, RANGE_SET);
+}
+
+void quadmask_clear_stamp(Quadmask* qm, Quadmask* stamp, i32 x, i32 y)
+{
+    stamp_op(qm, stamp, x, y, RANGE_CLEAR);
+}
+
+void quadmask_set_bits(Quadmask* qm, i32 x, i32 y, u64 bits, i32 n)
+{
+    or_bits(qm->data, y * qm->width + x, bits & leading_mask(n), n);
+}
+
 void quadmask_print(Quadmask* qm)
 {
     for (i32 y = 0; y < qm->length; y++) {
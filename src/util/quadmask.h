@@ -20,8 +20,13 @@ void quadmask_set(Quadmask* qm, i32 x, i32 y);
 // unsets bit at (x, y)
 void quadmask_unset(Quadmask* qm, i32 x, i32 y);
 
-// returns true if bit at (x, y) is set
-bool quadmask_isset(Quadmask* qm, i32 x, i32 y);
+// returns true if bit at (x, y) is set. inline, it is the
+// whole cost of the empty tile case in tilemap collision
+static inline bool quadmask_isset(Quadmask* qm, i32 x, i32 y)
+{
+    i32 idx = y * qm->width + x;
+    return (qm->data[idx / 64] >> (63 - (idx % 64))) & 1;
+}
 
 // sets all bits to 1
 void quadmask_setall(Quadmask* qm);
@@ -32,6 +37,23 @@ void quadmask_clear(Quadmask* qm);
 // returns whether (x, y) is in the bounds of the quadmask
 bool quadmask_in_bounds(Quadmask* qm, i32 x, i32 y);
 
+// rect and stamp functions work on whole words. the rect from
+// (x1, y1) to (x2, y2) is inclusive and must be in bounds
+void quadmask_set_rect(Quadmask* qm, i32 x1, i32 y1, i32 x2, i32 y2);
+void quadmask_clear_rect(Quadmask* qm, i32 x1, i32 y1, i32 x2, i32 y2);
+bool quadmask_any_in_rect(Quadmask* qm, i32 x1, i32 y1, i32 x2, i32 y2);
+
+// stamp is placed with its (0, 0) on (x, y) and must be in bounds.
+// any returns true if a bit is set in both stamp and qm, set and
+// clear set or clear the bits of qm that are set in stamp
+bool quadmask_any_in_stamp(Quadmask* qm, Quadmask* stamp, i32 x, i32 y);
+void quadmask_set_stamp(Quadmask* qm, Quadmask* stamp, i32 x, i32 y);
+void quadmask_clear_stamp(Quadmask* qm, Quadmask* stamp, i32 x, i32 y);
+
+// sets the bits from (x, y) to (x + n - 1, y) that are set in the
+// n most significant bits of bits. n is at most 64
+void quadmask_set_bits(Quadmask* qm, i32 x, i32 y, u64 bits, i32 n);
+
 // prints out the quadmask bits directly to stdout
 void quadmask_print(Quadmask* qm);
 
@@ -0,0 +1,106 @@
+#include "rng.h"
+#include "log.h"
+#include <stdatomic.h>
+
+static struct {
+    Rng streams[NUM_RNG_STREAMS];
+    u64 seed;
+    _Atomic u64 requested_seed;
+    _Atomic bool seed_requested;
+} rng_context;
+
+static u32 rotl(u32 x, i32 k)
+{
+    return (x << k) | (x >> (32 - k));
+}
+
+static u64 splitmix64(u64* x)
+{
+    u64 z = (*x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(Rng* rng, u64 seed, u64 stream)
+{
+    // splitmix64 never yields an all zero state from two draws in a row
+    u64 x = seed ^ splitmix64(&stream);
+    u64 a = splitmix64(&x);
+    u64 b = splitmix64(&x);
+    rng->s[0] = a;
+    rng->s[1] = a >> 32;
+    rng->s[2] = b;
+    rng->s[3] = b >> 32;
+}
+
+u32 rng_u32(Rng* rng)
+{
+    u32* s = rng->s;
+    u32 result = rotl(s[1] * 5, 7) * 9;
+    u32 t = s[1] << 9;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 11);
+    return result;
+}
+
+u64 rng_u64(Rng* rng)
+{
+    u64 hi = rng_u32(rng);
+    return (hi << 32) | rng_u32(rng);
+}
+
+f32 rng_f32(Rng* rng)
+{
+    // top 24 bits, all a f32 mantissa holds
+    return (rng_u32(rng) >> 8) * (1.0f / (1 << 24));
+}
+
+i32 rng_range(Rng* rng, i32 low, i32 high)
+{
+    // multiply and shift instead of modulo, the bias is
+    // below 2^-32 * (high - low + 1)
+    u64 span = (u64)((i64)high - low + 1);
+    return low + (i32)((rng_u32(rng) * span) >> 32);
+}
+
+f32 rng_range_f32(Rng* rng, f32 low, f32 high)
+{
+    return low + rng_f32(rng) * (high - low);
+}
+
+void rng_init(u64 seed)
+{
+    rng_context.seed = seed;
+    log_write(INFO, "Random seed %llu", (unsigned long long)seed);
+    for (i32 i = 0; i < NUM_RNG_STREAMS; i++)
+        rng_seed(&rng_context.streams[i], seed, i);
+}
+
+u64 rng_get_seed(void)
+{
+    return rng_context.seed;
+}
+
+void rng_request_seed(u64 seed)
+{
+    atomic_store_explicit(&rng_context.requested_seed, seed, memory_order_relaxed);
+    atomic_store_explicit(&rng_context.seed_requested, true, memory_order_release);
+}
+
+bool rng_apply_requested_seed(void)
+{
+    if (!atomic_exchange_explicit(&rng_context.seed_requested, false, memory_order_acquire))
+        return false;
+    rng_init(atomic_load_explicit(&rng_context.requested_seed, memory_order_relaxed));
+    return true;
+}
+
+Rng* rng_stream(RngStream stream)
+{
+    return &rng_context.streams[stream];
+}
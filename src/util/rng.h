@@ -0,0 +1,49 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include "type.h"
+
+// xoshiro128** generators. every subsystem draws from its own stream,
+// so the numbers one of them sees only depend on the seed and on its
+// own draws. a stream is not thread safe, it belongs to the thread of
+// its subsystem (game thread for RNG_STREAM_GAME and RNG_STREAM_MAP,
+// main thread for RNG_STREAM_GUI).
+
+typedef struct Rng {
+    u32 s[4];
+} Rng;
+
+typedef enum {
+    // gameplay, randf, randi_range and randf_range draw from it
+    RNG_STREAM_GAME,
+    // seeds of generated maps, each map has its own stream
+    RNG_STREAM_MAP,
+    // cosmetic randomness that must not disturb the simulation
+    RNG_STREAM_GUI,
+    NUM_RNG_STREAMS
+} RngStream;
+
+// seeds rng with seed, different streams of the same
+// seed produce unrelated sequences
+void rng_seed(Rng* rng, u64 seed, u64 stream);
+
+u32 rng_u32(Rng* rng);
+u64 rng_u64(Rng* rng);
+// in [0, 1)
+f32 rng_f32(Rng* rng);
+// in [low, high], inclusive
+i32 rng_range(Rng* rng, i32 low, i32 high);
+f32 rng_range_f32(Rng* rng, f32 low, f32 high);
+
+// reseeds every global stream from seed
+void rng_init(u64 seed);
+u64  rng_get_seed(void);
+// rng_init from another thread, the streams belong to the threads
+// using them so the seed is only stored. the thread of
+// RNG_STREAM_MAP applies it with rng_apply_requested_seed, which
+// returns whether there was a seed to apply
+void rng_request_seed(u64 seed);
+bool rng_apply_requested_seed(void);
+Rng* rng_stream(RngStream stream);
+
+#endif
@@ -0,0 +1,59 @@
+#include "slab.h"
+#include "malloc.h"
+#include "log.h"
+#include <string.h>
+
+void slab_init(Slab* slab, const char* name, size_t item_size, i32 items_per_slab)
+{
+    memset(slab, 0, sizeof(Slab));
+    slab->name = name;
+    // freed items hold the free list link, round up so it stays aligned
+    if (item_size < sizeof(void*))
+        item_size = sizeof(void*);
+    slab->item_size = (item_size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    slab->items_per_slab = items_per_slab;
+}
+
+static void slab_add(Slab* slab)
+{
+    char* items;
+    i32 i;
+    slab->slabs = st_realloc(slab->slabs, (slab->stats.num_slabs + 1) * sizeof(void*));
+    items = st_malloc(slab->items_per_slab * slab->item_size);
+    slab->slabs[slab->stats.num_slabs++] = items;
+    // linked in reverse so the slab fills front to back
+    for (i = slab->items_per_slab - 1; i >= 0; i--) {
+        *(void**)(items + i * slab->item_size) = slab->free_list;
+        slab->free_list = items + i * slab->item_size;
+    }
+}
+
+void* slab_alloc(Slab* slab)
+{
+    void* item;
+    log_assert(slab->items_per_slab > 0, "Slab %s was not initialized", slab->name);
+    if (slab->free_list == NULL)
+        slab_add(slab);
+    item = slab->free_list;
+    slab->free_list = *(void**)item;
+    memset(item, 0, slab->item_size);
+    slab->stats.allocs++;
+    if (++slab->stats.live > slab->stats.peak)
+        slab->stats.peak = slab->stats.live;
+    return item;
+}
+
+void slab_free(Slab* slab, void* item)
+{
+    *(void**)item = slab->free_list;
+    slab->free_list = item;
+    slab->stats.live--;
+}
+
+void slab_destroy(Slab* slab)
+{
+    for (i32 i = 0; i < slab->stats.num_slabs; i++)
+        st_free(slab->slabs[i]);
+    st_free(slab->slabs);
+    memset(slab, 0, sizeof(Slab));
+}
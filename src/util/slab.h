@@ -0,0 +1,39 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "type.h"
+#include <stddef.h>
+
+// fixed size object allocator. items are carved out of slabs of
+// items_per_slab items that are never moved or freed until the whole
+// allocator is destroyed, so pointers stay valid for the lifetime of
+// the item. freed items go on an intrusive free list and are handed
+// out again before a new slab is allocated.
+
+typedef struct SlabStats {
+    i32 live;
+    i32 peak;
+    i32 num_slabs;
+    u64 allocs;
+} SlabStats;
+
+typedef struct Slab {
+    SlabStats stats;
+    const char* name;
+    void** slabs;
+    void* free_list;
+    size_t item_size;
+    i32 items_per_slab;
+} Slab;
+
+void  slab_init(Slab* slab, const char* name, size_t item_size, i32 items_per_slab);
+
+// zeroed item
+void* slab_alloc(Slab* slab);
+void  slab_free(Slab* slab, void* item);
+
+// releases every slab at once, including items that are still live.
+// the allocator can be reused after another slab_init
+void  slab_destroy(Slab* slab);
+
+#endif
@@ -26,6 +26,19 @@ done:
     pthread_mutex_unlock(&mutex);
 }
 
+void thread_unlink(void)
+{
+    pthread_t thread = pthread_self();
+    pthread_mutex_lock(&mutex);
+    for (i32 i = 0; i < NUM_THREADS; i++) {
+        if (threads[i].name != NULL && pthread_equal(thread, threads[i].thread)) {
+            threads[i].name = NULL;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
 i32 thread_get_id(const char* name)
 {
     i32 res = -1;
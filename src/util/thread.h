@@ -3,12 +3,18 @@
 
 #include "type.h"
 
-#define NUM_THREADS 3
+// main, game and the network handlers, plus the job system workers
+#define NUM_WORKER_THREADS  15
+#define NUM_THREADS         (3 + NUM_WORKER_THREADS)
 
 // Permanently associate a thread with name and
 // generate idx for thread in range [0...NUM_THREADS)
 void thread_link(const char* name);
 
+// Release the slot of the current thread so it
+// can be linked again by a thread started later
+void thread_unlink(void);
+
 // Returns idx associated with name. Returns -1
 // if the name is not associated with any thread
 i32  thread_get_id(const char* name);